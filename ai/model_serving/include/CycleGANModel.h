@@ -0,0 +1,102 @@
+#pragma once
+
+#include "TensorFlowLiteModel.h"
+#include "../../utils/include/MidiUtils.h"
+#include <complex>
+#include <vector>
+#include <string>
+
+namespace lmms_magenta {
+
+/**
+ * @brief CycleGAN model implementation
+ *
+ * This class implements the CycleGAN style-transfer model using TensorFlow
+ * Lite. Audio is transformed one batch of STFT magnitude frames at a time;
+ * MIDI is transformed in overlapping windows that are stitched back together.
+ */
+class CycleGANModel : public TensorFlowLiteModel {
+public:
+    /**
+     * @brief Constructor
+     * @param modelPath Path to the TensorFlow Lite model file
+     * @param metadata Model metadata
+     */
+    CycleGANModel(const std::string& modelPath, const ModelMetadata& metadata);
+
+    /**
+     * @brief Destructor
+     */
+    ~CycleGANModel() override;
+
+    /**
+     * @brief Reserve working buffers for a maximum batch size
+     * @param maxFrames Maximum number of frames per call to transformSpectra
+     * @param numBins Number of bins per frame
+     */
+    void reserveFrames(int maxFrames, int numBins);
+
+    /**
+     * @brief Convert spectra to the log magnitudes fed to the model
+     * @param spectra Spectra to convert
+     * @param count Number of bins
+     * @param logMagnitudes Receives count log magnitudes
+     */
+    static void computeLogMagnitudes(const std::complex<float>* spectra, size_t count, float* logMagnitudes);
+
+    /**
+     * @brief Replace the magnitudes of spectra with a blend of styled ones
+     *
+     * The phase of each bin is kept.
+     *
+     * @param spectra Spectra to modify in place
+     * @param logMagnitudes Original log magnitudes
+     * @param styled Styled log magnitudes
+     * @param count Number of bins
+     * @param strength Blend between original (0) and styled (1) magnitudes
+     */
+    static void applyMagnitudes(std::complex<float>* spectra, const float* logMagnitudes,
+                                const float* styled, size_t count, float strength);
+
+    /**
+     * @brief Style a batch of log magnitudes
+     *
+     * Runs the inference into the caller's buffer; with its capacity reserved
+     * for the batch the call does not allocate.
+     *
+     * @param logMagnitudes Log magnitudes laid out as [frame][bin]
+     * @param styled Receives the styled log magnitudes
+     * @return True if the batch was styled
+     */
+    bool styleMagnitudes(const std::vector<float>& logMagnitudes, std::vector<float>& styled);
+
+    /**
+     * @brief Apply style transfer to a batch of spectra in place
+     *
+     * Blocks until the inference finished. Only magnitudes are transformed;
+     * the phase of each bin is kept.
+     *
+     * @param spectra Spectra laid out as [frame][bin]
+     * @param numFrames Number of frames in the batch
+     * @param numBins Number of bins per frame
+     * @param strength Blend between original (0) and styled (1) magnitudes
+     * @return True if the transform was applied
+     */
+    bool transformSpectra(std::complex<float>* spectra, int numFrames, int numBins, float strength);
+
+    /**
+     * @brief Apply style transfer to a MIDI sequence
+     * @param sequence MIDI sequence to transform
+     * @param windowTicks Length of each analysis window in ticks
+     * @param hopTicks Distance between consecutive windows in ticks
+     * @return Transformed MIDI sequence
+     */
+    MidiSequence transformSequence(const MidiSequence& sequence, int windowTicks, int hopTicks);
+
+private:
+    // Log-magnitude buffer fed to the model and the styled result
+    std::vector<float> m_magnitudes;
+    std::vector<float> m_styled;
+};
+
+} // namespace lmms_magenta
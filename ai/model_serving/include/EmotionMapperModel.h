@@ -0,0 +1,165 @@
+#pragma once
+
+#include "TensorFlowLiteModel.h"
+#include <array>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Generation parameters derived from an emotion
+ */
+struct GenerationParameters {
+    float temperature;  // Sampling temperature
+    float density;      // Note density (0-1)
+    float complexity;   // Rhythmic/harmonic complexity (0-1)
+
+    GenerationParameters(float t = 1.0f, float d = 0.5f, float c = 0.5f)
+        : temperature(t), density(d), complexity(c) {}
+};
+
+/**
+ * @brief Dense, interpolated lookup table over emotion control axes
+ *
+ * The table samples a mapping on a regular grid over three axes
+ * (valence, arousal, intensity) and answers queries with trilinear
+ * interpolation. Lookups are constant time and never allocate, so they can
+ * run at audio-block rate.
+ */
+class EmotionLookupTable {
+public:
+    /**
+     * @brief Range of one control axis
+     */
+    struct Axis {
+        float minimum;
+        float maximum;
+    };
+
+    /**
+     * @brief Batched evaluation function
+     *
+     * Receives numPoints rows of 3 axis values and must write numPoints rows
+     * of kNumParameters outputs.
+     */
+    using Evaluator = std::function<bool(const float* inputs, size_t numPoints, float* outputs)>;
+
+    // Number of parameters stored per grid point
+    static constexpr int kNumParameters = 3;
+
+    /**
+     * @brief Constructor
+     * @param resolution Number of grid points per axis (at least 2)
+     * @param axes Ranges of the valence, arousal and intensity axes
+     */
+    EmotionLookupTable(int resolution, const std::array<Axis, 3>& axes);
+
+    /**
+     * @brief Fill the table by evaluating the mapping on every grid point
+     * @param evaluator Batched evaluation function
+     * @return True if the table was built
+     */
+    bool build(const Evaluator& evaluator);
+
+    /**
+     * @brief Look up generation parameters
+     * @param valence Valence (clamped to the axis range)
+     * @param arousal Arousal (clamped to the axis range)
+     * @param intensity Intensity (clamped to the axis range)
+     * @return Interpolated parameters
+     */
+    GenerationParameters lookup(float valence, float arousal, float intensity) const;
+
+    /**
+     * @brief Get the number of grid points per axis
+     * @return Grid resolution
+     */
+    int getResolution() const;
+
+    /**
+     * @brief Get the memory used by the table
+     * @return Size in bytes
+     */
+    size_t getMemoryUsage() const;
+
+    /**
+     * @brief Check whether the table has been built
+     * @return True if build() succeeded
+     */
+    bool isBuilt() const;
+
+private:
+    int m_resolution;
+    std::array<Axis, 3> m_axes;
+    bool m_isBuilt;
+
+    // Grid values laid out as [valence][arousal][intensity][parameter]
+    std::vector<float> m_values;
+
+    // Map a value to a grid cell index and fraction
+    void locate(int axis, float value, int& index, float& fraction) const;
+};
+
+/**
+ * @brief EmotionMapper model implementation
+ *
+ * This class wraps the EmotionMapper network. At load time the network is
+ * evaluated once over a dense grid of control values in a single batched
+ * inference, and all later queries are served from the resulting
+ * EmotionLookupTable.
+ */
+class EmotionMapperModel : public TensorFlowLiteModel {
+public:
+    /**
+     * @brief Constructor
+     * @param modelPath Path to the TensorFlow Lite model file
+     * @param metadata Model metadata
+     * @param resolution Number of grid points per axis
+     */
+    EmotionMapperModel(const std::string& modelPath, const ModelMetadata& metadata, int resolution = 17);
+
+    /**
+     * @brief Destructor
+     */
+    ~EmotionMapperModel() override;
+
+    /**
+     * @brief Initialize the model and compile the lookup table
+     * @return True if initialization was successful
+     */
+    bool initialize() override;
+
+    /**
+     * @brief Get the compiled lookup table
+     * @return Shared pointer to the table, or nullptr if not initialized
+     */
+    std::shared_ptr<const EmotionLookupTable> getLookupTable() const;
+
+    /**
+     * @brief Map an emotion to generation parameters
+     * @param valence Valence (-1 to 1)
+     * @param arousal Arousal (-1 to 1)
+     * @param intensity Intensity (0 to 1)
+     * @return Interpolated parameters (defaults if not initialized)
+     */
+    GenerationParameters mapEmotion(float valence, float arousal, float intensity) const;
+
+protected:
+    /**
+     * @brief Get the memory held by the lookup table
+     * @return Table size in bytes
+     */
+    size_t getCacheMemoryUsage() const override;
+
+private:
+    // Grid points per axis
+    int m_resolution;
+
+    // Compiled table, shared with plugins
+    std::shared_ptr<const EmotionLookupTable> m_table;
+};
+
+} // namespace lmms_magenta
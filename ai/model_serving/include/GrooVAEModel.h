@@ -1,7 +1,8 @@
 #pragma once
 
 #include "TensorFlowLiteModel.h"
-#include "../utils/MidiUtils.h"
+#include "GrooveLibrary.h"
+#include "../../utils/include/MidiUtils.h"
 #include <vector>
 #include <string>
 #include <memory>
@@ -13,6 +14,11 @@ namespace lmms_magenta {
  * 
  * This class implements the GrooVAE model for groove modeling
  * using TensorFlow Lite.
+ *
+ * The model is expected to take a row of [note values | groove embedding]
+ * and return [grooved note values | groove embedding of the input], with
+ * five values per note as in MidiUtils::sequenceToTensor and the notes in
+ * input order.
  */
 class GrooVAEModel : public TensorFlowLiteModel {
 public:
@@ -59,34 +65,51 @@ public:
     
     /**
      * @brief Get available groove styles
-     * @return Vector of available groove style names
+     * @return Names of the grooves in the groove library, by id
      */
     std::vector<std::string> getAvailableGrooveStyles() const;
     
     /**
      * @brief Set groove style
-     * @param styleIndex Index of the groove style to use
+     * @param styleIndex Id of the library groove to use
      */
     void setGrooveStyle(int styleIndex);
     
     /**
      * @brief Get current groove style
-     * @return Index of the current groove style
+     * @return Id of the current library groove
      */
     int getGrooveStyle() const;
     
-private:
-    // Available groove styles
-    std::vector<std::string> m_grooveStyles;
+    /**
+     * @brief Get the library of precomputed grooves
+     * @return Groove library (empty if the model has none)
+     */
+    const GrooveLibrary& getGrooveLibrary() const;
     
+    /**
+     * @brief Get the length of the groove embeddings
+     * @return Dimension of the library, or the default when there is none
+     */
+    size_t getGrooveDimension() const;
+    
+private:
     // Current groove style
     int m_currentGrooveStyle;
     
-    // Precomputed groove patterns
-    std::vector<std::vector<float>> m_groovePatterns;
+    // Precomputed grooves, mapped from the file next to the model
+    GrooveLibrary m_grooveLibrary;
+    
+    // Open the groove library stored next to the model file
+    void loadGroovePatterns(const std::string& modelPath);
+    
+    // Run the model with a target groove; fills the grooved notes and the
+    // groove embedding of the input
+    bool runGroove(const MidiSequence& sequence, const std::vector<float>& groove,
+                   MidiSequence& grooved, std::vector<float>& embedding);
     
-    // Load groove patterns
-    void loadGroovePatterns();
+    // Move the notes of a sequence towards their grooved timing and velocity
+    static MidiSequence blendGroove(const MidiSequence& sequence, const MidiSequence& grooved, float amount);
 };
 
 } // namespace lmms_magenta
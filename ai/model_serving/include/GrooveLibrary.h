@@ -0,0 +1,183 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief A groove to store in a library file
+ */
+struct GrooveEntry {
+    std::string name;               // Unique name
+    std::vector<std::string> tags;  // Tags such as "swing" or "funk" (no commas)
+    std::vector<float> embedding;   // GrooVAE groove vector
+};
+
+/**
+ * @brief Result of a nearest-groove search
+ */
+struct GrooveMatch {
+    uint32_t id;
+    float distance;  // Squared Euclidean distance to the query
+};
+
+/**
+ * @brief Read-only groove library backed by a memory-mapped file
+ *
+ * The file holds fixed-stride groove embeddings and an index of names and
+ * tags, so opening a library only maps the file and checks its header.
+ * Pages are read by the OS when a groove is first touched, which keeps
+ * thousands of grooves available without loading them into memory.
+ *
+ * Layout (little-endian):
+ *
+ *     header       64 bytes: "LMGROOVE", version, dimension, count and
+ *                  the offsets of the sections below
+ *     embeddings   count x dimension floats, page-aligned, id-major
+ *     records      count x 16 bytes: name and tags in the string table
+ *     name order   count x u32 ids sorted by name
+ *     strings      names and comma-separated tags
+ *
+ * A groove's id is its position in the file, so lookups by id are O(1)
+ * and lookups by name are a binary search of the name order. An open
+ * library is immutable and safe to read from any thread.
+ */
+class GrooveLibrary {
+public:
+    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kInvalidId = std::numeric_limits<uint32_t>::max();
+
+    /**
+     * @brief Constructor
+     */
+    GrooveLibrary();
+
+    /**
+     * @brief Destructor, unmaps the file
+     */
+    ~GrooveLibrary();
+
+    GrooveLibrary(const GrooveLibrary&) = delete;
+    GrooveLibrary& operator=(const GrooveLibrary&) = delete;
+
+    /**
+     * @brief Map a library file, closing the current one
+     * @param filePath Library file
+     * @return True if the file is a valid library
+     */
+    bool open(const std::string& filePath);
+
+    /**
+     * @brief Unmap the library file
+     */
+    void close();
+
+    /**
+     * @brief Check if a library is open
+     * @return True if a library is open
+     */
+    bool isOpen() const;
+
+    /**
+     * @brief Get the number of grooves
+     * @return Number of grooves (0 if no library is open)
+     */
+    size_t size() const;
+
+    /**
+     * @brief Get the length of the groove embeddings
+     * @return Floats per embedding
+     */
+    uint32_t getDimension() const;
+
+    /**
+     * @brief Get the embedding of a groove
+     * @param id Groove id
+     * @return Pointer to getDimension() floats inside the mapping, or
+     *         null if the id is out of range
+     */
+    const float* getEmbedding(uint32_t id) const;
+
+    /**
+     * @brief Get the name of a groove
+     * @param id Groove id
+     * @return Name, or an empty string if the id is out of range
+     */
+    std::string getName(uint32_t id) const;
+
+    /**
+     * @brief Get the tags of a groove
+     * @param id Groove id
+     * @return Tags
+     */
+    std::vector<std::string> getTags(uint32_t id) const;
+
+    /**
+     * @brief Find a groove by name
+     * @param name Groove name
+     * @return Groove id, or kInvalidId if there is none
+     */
+    uint32_t findByName(const std::string& name) const;
+
+    /**
+     * @brief Find the grooves with a tag
+     * @param tag Tag
+     * @return Ids in ascending order
+     */
+    std::vector<uint32_t> findByTag(const std::string& tag) const;
+
+    /**
+     * @brief Find the grooves closest to an embedding
+     * @param embedding Query of getDimension() floats
+     * @param count Number of grooves to return
+     * @return Closest grooves, nearest first
+     */
+    std::vector<GrooveMatch> findNearest(const float* embedding, size_t count) const;
+
+    /**
+     * @brief Ask the OS to read the embeddings of a range of grooves ahead
+     * @param firstId First groove id
+     * @param count Number of grooves
+     */
+    void prefetch(uint32_t firstId, size_t count) const;
+
+    /**
+     * @brief Write a library file
+     *
+     * The file is written next to its destination and renamed into place,
+     * so readers never see a partial library.
+     *
+     * @param filePath Library file
+     * @param entries Grooves; all embeddings must have the same length and
+     *                names must be unique
+     * @return True if the file was written
+     */
+    static bool write(const std::string& filePath, const std::vector<GrooveEntry>& entries);
+
+private:
+    // Start and length of the mapping
+    const uint8_t* m_data;
+    size_t m_size;
+
+    uint32_t m_dimension;
+    uint32_t m_count;
+
+    // Sections inside the mapping
+    const float* m_embeddings;
+    const uint8_t* m_records;
+    const uint8_t* m_nameOrder;
+    const char* m_strings;
+    uint64_t m_stringsSize;
+
+    // Check the header and locate the sections
+    bool parseHeader();
+
+    // Locate a string of the string table, false if it is out of bounds
+    bool getString(uint32_t id, size_t field, const char*& text, size_t& length) const;
+};
+
+} // namespace lmms_magenta
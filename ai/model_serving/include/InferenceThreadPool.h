@@ -0,0 +1,196 @@
+#pragma once
+
+#include "../../../core/include/CoreConfig.h"
+#include "../../utils/include/RealtimeChecker.h"
+#include "../../utils/include/ThreadPool.h"
+#include "../../utils/include/Trace.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <vector>
+
+// Forward declarations for TensorFlow Lite
+struct TfLiteExternalContext;
+namespace tflite {
+class ExternalCpuBackendContext;
+}
+
+namespace lmms_magenta {
+
+/**
+ * @brief Process-wide executor for model inference
+ *
+ * Interpreters are built and invoked on a pool of inference threads that
+ * carry the policy from CoreConfig (affinity away from the audio cores, a
+ * background priority, one NUMA node). The pool has one thread per selected
+ * core, and at least two, so inferences of different models run at the same
+ * time and a long generation never holds up a short real-time one; each
+ * model still serializes use of its own interpreter.
+ *
+ * Only the intra-op kernel threads are shared: one CPU backend context,
+ * sized to the selected cores, whose threads are spawned from an inference
+ * thread and inherit its policy. A backend context must not be used by two
+ * interpreters at once, so an inference leases the shared context for its
+ * duration and gets the cores no other running inference occupies. An
+ * inference that starts while the context is leased runs single-threaded
+ * on a private context of its inference thread instead, so the selected
+ * cores are not oversubscribed.
+ */
+class InferenceThreadPool {
+public:
+    static constexpr size_t kMinThreads = 2;
+
+    /**
+     * @brief Get the singleton instance, configured from CoreConfig on first use
+     * @return Reference to the singleton instance
+     */
+    static InferenceThreadPool& getInstance();
+
+    /**
+     * @brief Apply a new threading policy
+     *
+     * Waits for the running inferences, if any. Existing interpreters keep
+     * working and use the new threads from their next inference. Must not be
+     * called from a task running on the pool.
+     *
+     * @param config Threading policy
+     */
+    void configure(const InferenceThreadingConfig& config);
+
+    /**
+     * @brief Run a task on an inference thread and wait for its result
+     *
+     * Runs the task directly when called from an inference thread, keeping
+     * the backend context of the enclosing task.
+     *
+     * @param numThreads Intra-op threads the task may use (0 for all)
+     * @param task Callable to run; it attaches getCurrentCpuBackendContext()
+     *             to its interpreter before using it
+     * @return Result of the task (exceptions are rethrown)
+     */
+    template <typename Func>
+    auto run(int numThreads, Func&& task) -> std::invoke_result_t<std::decay_t<Func>> {
+        if (isInferenceThread()) {
+            return task();
+        }
+
+        LMMS_MAGENTA_ASSERT_NOT_REALTIME("InferenceThreadPool::run");
+        LMMS_MAGENTA_TRACE_TIMESTAMP(queuedAt);
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        DelegatedCpuTime cpuTime;
+        return m_executor->submit([&]() {
+            LMMS_MAGENTA_TRACE_SINCE("scheduler", "inference_queue_wait", queuedAt);
+            ContextLease lease(*this, numThreads);
+            DelegatedCpuTime::Measurement measurement(cpuTime);
+            return task();
+        }).get();
+    }
+
+    /**
+     * @brief Get the number of intra-op threads available to an inference
+     * @return Number of threads
+     */
+    int getNumThreads() const;
+
+    /**
+     * @brief Get the cores the inference threads run on
+     * @return Selected cores
+     */
+    std::vector<int> getCores() const;
+
+    /**
+     * @brief Get the CPU backend context of the task running on this thread
+     * @return Context to install with Interpreter::SetExternalContext, or
+     *         nullptr when not called from a task of the pool
+     */
+    static TfLiteExternalContext* getCurrentCpuBackendContext();
+
+    /**
+     * @brief Get the CPU time inference threads spent on tasks of this thread
+     *
+     * Accumulates the thread CPU time of every task the calling thread ran
+     * through run(), so that callers can charge inferences to the job that
+     * requested them. Intra-op kernel threads are not included.
+     *
+     * @return CPU time in seconds since the calling thread started
+     */
+    static double getDelegatedCpuSeconds();
+
+private:
+    InferenceThreadPool();
+    ~InferenceThreadPool();
+
+    InferenceThreadPool(const InferenceThreadPool&) = delete;
+    InferenceThreadPool& operator=(const InferenceThreadPool&) = delete;
+
+    // Backend context of one task, held while the task runs
+    class ContextLease {
+    public:
+        ContextLease(InferenceThreadPool& pool, int numThreads);
+        ~ContextLease();
+
+        ContextLease(const ContextLease&) = delete;
+        ContextLease& operator=(const ContextLease&) = delete;
+
+    private:
+        InferenceThreadPool& m_pool;
+        bool m_isShared;
+    };
+
+    // CPU time of one task, added to the submitting thread's total
+    class DelegatedCpuTime {
+    public:
+        DelegatedCpuTime() : m_seconds(0.0) {}
+        ~DelegatedCpuTime();
+
+        DelegatedCpuTime(const DelegatedCpuTime&) = delete;
+        DelegatedCpuTime& operator=(const DelegatedCpuTime&) = delete;
+
+        // Measures the inference thread while the task runs
+        class Measurement {
+        public:
+            explicit Measurement(DelegatedCpuTime& cpuTime);
+            ~Measurement();
+
+            Measurement(const Measurement&) = delete;
+            Measurement& operator=(const Measurement&) = delete;
+
+        private:
+            DelegatedCpuTime& m_cpuTime;
+            double m_startSeconds;
+        };
+
+    private:
+        double m_seconds;
+    };
+
+    InferenceThreadingConfig m_config;
+    std::vector<int> m_cores;
+
+    // Threads running the inferences, carrying the policy
+    std::unique_ptr<ThreadPool> m_executor;
+
+    // Shared kernel threads, leased to one inference at a time
+    std::unique_ptr<tflite::ExternalCpuBackendContext> m_sharedContext;
+    std::mutex m_sharedContextMutex;
+
+    // Single-threaded contexts of the inference threads
+    std::vector<std::unique_ptr<tflite::ExternalCpuBackendContext>> m_threadContexts;
+    std::mutex m_threadContextsMutex;
+
+    // Inferences currently running
+    std::atomic<int> m_numRunning;
+
+    // Held shared while a task runs, exclusively while reconfiguring
+    mutable std::shared_mutex m_mutex;
+
+    // Create the private context of the calling inference thread
+    void initializeThread();
+
+    // Whether the calling thread is an inference thread
+    static bool isInferenceThread();
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,236 @@
+#pragma once
+
+#include "TensorFlowLiteModel.h"
+#include "../../utils/include/MidiUtils.h"
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Recurrent state of the MelodyRNN LSTM stack
+ *
+ * Hidden and cell states of all layers are stored flattened. The pending
+ * event is the last event produced but not yet fed back into the network,
+ * so generation can resume from this state without re-running anything.
+ * A generated note still sounding at the end of a continuation is kept as
+ * the held note, so the next continuation can finish it.
+ */
+struct MelodyRNNState {
+    std::vector<float> hidden;
+    std::vector<float> cell;
+    int pendingEvent;
+    int step;
+    int heldPitch;      // Pitch of the generated note still sounding, or -1
+    int heldStartStep;  // Step at which the held note started
+
+    MelodyRNNState() : pendingEvent(0), step(0), heldPitch(-1), heldStartStep(0) {}
+};
+
+/**
+ * @brief MelodyRNN model implementation
+ *
+ * This class implements the MelodyRNN model for melodic continuation using
+ * TensorFlow Lite. The LSTM state is kept between calls, so continuing a
+ * melody by one bar costs one bar of inference steps. Primed states are
+ * cached by primer hash, and several candidate continuations can be
+ * generated in a single batched pass.
+ *
+ * The model is expected to take rows of [event one-hot | hidden | cell] and
+ * return rows of [event logits | hidden | cell].
+ */
+class MelodyRNNModel : public TensorFlowLiteModel {
+public:
+    /**
+     * @brief Constructor
+     * @param modelPath Path to the TensorFlow Lite model file
+     * @param metadata Model metadata
+     */
+    MelodyRNNModel(const std::string& modelPath, const ModelMetadata& metadata);
+
+    /**
+     * @brief Destructor
+     */
+    ~MelodyRNNModel() override;
+
+    /**
+     * @brief Initialize the model
+     * @return True if initialization was successful
+     */
+    bool initialize() override;
+
+    /**
+     * @brief Prime the model with a melody
+     *
+     * If the primer has been seen before, its cached state is reused.
+     *
+     * @param primer Melody to prime with
+     * @return True if priming was successful
+     */
+    bool primeWithSequence(const MidiSequence& primer);
+
+    /**
+     * @brief Continue the current melody
+     *
+     * Notes are returned once they end. A note still sounding after the last
+     * step is kept in the state and returned, with its full length, by the
+     * continuation that ends it.
+     *
+     * @param numSteps Number of sixteenth-note steps to generate
+     * @param temperature Temperature for sampling (randomness)
+     * @return Generated notes, timed from the start of the melody
+     */
+    MidiSequence continueMelody(int numSteps, float temperature = 1.0f);
+
+    /**
+     * @brief Generate several candidate continuations of a primer
+     *
+     * All candidates are advanced together with one batched inference per
+     * step. The model's own state is not modified.
+     *
+     * @param primer Melody to continue
+     * @param numCandidates Number of continuations to generate
+     * @param numSteps Number of sixteenth-note steps per continuation
+     * @param temperature Temperature for sampling (randomness)
+     * @return One sequence per candidate
+     */
+    std::vector<MidiSequence> continueMany(const MidiSequence& primer,
+                                           int numCandidates,
+                                           int numSteps,
+                                           float temperature = 1.0f);
+
+    /**
+     * @brief Reset the recurrent state to the start of a new melody
+     */
+    void resetState();
+
+    /**
+     * @brief Get a copy of the current recurrent state
+     * @return Current state
+     */
+    MelodyRNNState getState() const;
+
+    /**
+     * @brief Restore a previously captured recurrent state
+     * @param state State to restore
+     * @return True if the state matches the model dimensions
+     */
+    bool setState(const MelodyRNNState& state);
+
+    /**
+     * @brief Set the maximum number of cached primer states
+     * @param capacity Maximum number of entries (0 disables caching)
+     */
+    void setPrimerCacheCapacity(size_t capacity);
+
+    /**
+     * @brief Get the number of cached primer states
+     * @return Number of entries in the cache
+     */
+    size_t getPrimerCacheSize() const;
+
+    /**
+     * @brief Remove all cached primer states
+     */
+    void clearPrimerCache();
+
+    /**
+     * @brief Get the number of steps per bar
+     * @return Steps per 4/4 bar
+     */
+    int getStepsPerBar() const;
+
+    /**
+     * @brief Get the number of distinct melody events
+     * @return Size of the event vocabulary
+     */
+    int getNumEvents() const;
+
+    /**
+     * @brief Encode a melody as a sequence of events
+     * @param sequence Melody to encode (monophonic)
+     * @return One event per sixteenth-note step
+     */
+    std::vector<int> sequenceToEvents(const MidiSequence& sequence) const;
+
+    /**
+     * @brief Decode events back to a melody
+     * @param events One event per step
+     * @param startStep Step at which the first event occurs
+     * @param ticksPerQuarter Ticks per quarter note of the result
+     * @return Decoded melody
+     */
+    MidiSequence eventsToSequence(const std::vector<int>& events, int startStep, int ticksPerQuarter) const;
+
+    /**
+     * @brief Decode events that continue a melody
+     * @param events One event per step
+     * @param startStep Step at which the first event occurs
+     * @param ticksPerQuarter Ticks per quarter note of the result
+     * @param heldPitch Pitch sounding before the first event (-1 for none);
+     *                  receives the pitch still sounding after the last one
+     * @param heldStartStep Step at which the held note started; updated with heldPitch
+     * @return Notes that ended within the events
+     */
+    MidiSequence eventsToSequence(const std::vector<int>& events, int startStep, int ticksPerQuarter,
+                                  int& heldPitch, int& heldStartStep) const;
+
+    // Event vocabulary: no event, note off, then one note-on per pitch
+    static constexpr int kNoEvent = 0;
+    static constexpr int kNoteOff = 1;
+    static constexpr int kMinPitch = 48;
+    static constexpr int kMaxPitch = 84;
+
+protected:
+    /**
+     * @brief Get the memory held by the current and cached LSTM states
+     * @return Cache size in bytes
+     */
+    size_t getCacheMemoryUsage() const override;
+
+private:
+    // Size of the flattened hidden (and cell) state
+    int m_stateSize;
+
+    // Steps per quarter note
+    int m_stepsPerQuarter;
+
+    // Current recurrent state
+    MelodyRNNState m_state;
+
+    // Ticks per quarter of the primer, used for generated output
+    int m_ticksPerQuarter;
+
+    // Cache of primed states keyed by primer hash, in LRU order
+    std::list<std::pair<uint64_t, MelodyRNNState>> m_primerCacheOrder;
+    std::unordered_map<uint64_t, std::list<std::pair<uint64_t, MelodyRNNState>>::iterator> m_primerCache;
+    size_t m_primerCacheCapacity;
+
+    // Random number generator for sampling
+    std::mt19937 m_rng;
+
+    // Guards the state, the cache and the generator
+    mutable std::mutex m_mutex;
+
+    // Hash a primer melody
+    static uint64_t hashPrimer(const MidiSequence& primer);
+
+    // Compute the primed state for a melody, using the cache
+    bool primedState(const MidiSequence& primer, MelodyRNNState& state);
+
+    // Advance a batch of states by one step and return the logits
+    bool step(std::vector<MelodyRNNState*>& states, std::vector<float>& logits);
+
+    // Sample an event from a row of logits
+    int sampleEvent(const float* logits, float temperature);
+
+    // Create a zero state
+    MelodyRNNState initialState() const;
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,264 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Summary of a latency histogram, in seconds
+ */
+struct HistogramSnapshot {
+    uint64_t count = 0;
+    double sum = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+    double p50 = 0.0;
+    double p90 = 0.0;
+    double p99 = 0.0;
+    double p999 = 0.0;
+};
+
+/**
+ * @brief Lock-free latency histogram with bounded relative error
+ *
+ * Uses HDR-style log-linear buckets: every power-of-two range is split into
+ * 64 linear sub-buckets, so recorded values keep about two significant
+ * digits (relative error below 1/64) from 1 ns up to about 18 minutes.
+ * Recording is a few relaxed atomic operations on fixed storage.
+ */
+class LatencyHistogram {
+public:
+    static constexpr int kSubBucketBits = 7;
+    static constexpr uint64_t kMaxValue = (uint64_t(1) << 40) - 1;
+
+    LatencyHistogram();
+
+    /**
+     * @brief Record a latency
+     * @param nanoseconds Latency in nanoseconds (clamped to kMaxValue)
+     */
+    void record(uint64_t nanoseconds);
+
+    /**
+     * @brief Record a latency
+     * @param duration Latency
+     */
+    template <typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> duration) {
+        const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+        record(static_cast<uint64_t>(ns > 0 ? ns : 0));
+    }
+
+    /**
+     * @brief Summarize the recorded values
+     * @return Count, sum, extremes and percentiles in seconds
+     */
+    HistogramSnapshot snapshot() const;
+
+    /**
+     * @brief Get the bucket holding a value
+     * @param value Value in nanoseconds
+     * @return Bucket index
+     */
+    static size_t getBucketIndex(uint64_t value);
+
+    /**
+     * @brief Get the largest value a bucket holds
+     * @param index Bucket index
+     * @return Upper bound in nanoseconds
+     */
+    static uint64_t getBucketUpperBound(size_t index);
+
+private:
+    static constexpr size_t kHalfSubBuckets = size_t(1) << (kSubBucketBits - 1);
+    static constexpr size_t kBucketCount = (40 - kSubBucketBits + 2) * kHalfSubBuckets;
+
+    std::array<std::atomic<uint64_t>, kBucketCount> m_buckets;
+    std::atomic<uint64_t> m_sum;
+    std::atomic<uint64_t> m_min;
+    std::atomic<uint64_t> m_max;
+};
+
+/**
+ * @brief Monotonic event counter
+ */
+class MetricCounter {
+public:
+    MetricCounter() : m_value(0) {}
+
+    void increment(uint64_t amount = 1) {
+        m_value.fetch_add(amount, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const {
+        return m_value.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<uint64_t> m_value;
+};
+
+/**
+ * @brief Point-in-time copy of all metrics
+ */
+struct MetricsSnapshot {
+    struct Histogram {
+        std::string name;
+        std::string labelName;   // e.g. "model" or "plugin" (empty for none)
+        std::string labelValue;
+        HistogramSnapshot values;
+    };
+
+    struct Counter {
+        std::string name;
+        std::string labelName;
+        std::string labelValue;
+        uint64_t value = 0;
+    };
+
+    std::vector<Histogram> histograms;
+    std::vector<Counter> counters;
+
+    /**
+     * @brief Find a histogram
+     * @param name Metric name
+     * @param labelValue Label value (empty for unlabeled metrics)
+     * @return Histogram, or nullptr if never recorded
+     */
+    const HistogramSnapshot* findHistogram(const std::string& name, const std::string& labelValue = "") const;
+
+    /**
+     * @brief Get a counter value
+     * @param name Metric name
+     * @param labelValue Label value (empty for unlabeled metrics)
+     * @return Counter value, 0 if never incremented
+     */
+    uint64_t getCounter(const std::string& name, const std::string& labelValue = "") const;
+};
+
+/**
+ * @brief Output format of metric dumps
+ */
+enum class MetricsFormat {
+    Text,       // One human-readable line per metric
+    Prometheus  // Prometheus text exposition format (summaries and counters)
+};
+
+/**
+ * @brief Named latency histograms and counters, labeled by model or plugin
+ *
+ * Metrics are created on first use and live as long as the registry, so
+ * callers on hot paths can look a metric up once and keep the reference.
+ * The registry can periodically write its contents to a file, e.g. for the
+ * Prometheus node exporter's textfile collector.
+ */
+class MetricsRegistry {
+public:
+    // Metric names used by the model server
+    static const char* const kQueueWaitSeconds;
+    static const char* const kInferenceSeconds;
+    static const char* const kRequestSeconds;
+    static const char* const kCacheHits;
+    static const char* const kCacheMisses;
+    static const char* const kModelLoads;
+    static const char* const kModelLoadFailures;
+    static const char* const kModelEvictions;
+    static const char* const kJobsRejected;
+    static const char* const kModelEventsDropped;
+
+    MetricsRegistry();
+
+    /**
+     * @brief Destructor, stops the periodic dump
+     */
+    ~MetricsRegistry();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    /**
+     * @brief Get a histogram, creating it on first use
+     * @param name Metric name
+     * @param labelName Label name (empty for none)
+     * @param labelValue Label value
+     * @return Histogram valid for the lifetime of the registry
+     */
+    LatencyHistogram& getHistogram(const std::string& name, const std::string& labelName = "",
+                                   const std::string& labelValue = "");
+
+    /**
+     * @brief Get a counter, creating it on first use
+     * @param name Metric name
+     * @param labelName Label name (empty for none)
+     * @param labelValue Label value
+     * @return Counter valid for the lifetime of the registry
+     */
+    MetricCounter& getCounter(const std::string& name, const std::string& labelName = "",
+                              const std::string& labelValue = "");
+
+    /**
+     * @brief Copy the current values of all metrics
+     * @return Snapshot sorted by name and label
+     */
+    MetricsSnapshot snapshot() const;
+
+    /**
+     * @brief Format a snapshot
+     * @param snapshot Metrics to format
+     * @param format Output format
+     * @return Formatted metrics
+     */
+    static std::string format(const MetricsSnapshot& snapshot, MetricsFormat format);
+
+    /**
+     * @brief Write a snapshot to a file, replacing it atomically
+     * @param snapshot Metrics to write
+     * @param filePath Output file
+     * @param format Output format
+     * @return True if writing was successful
+     */
+    static bool writeFile(const MetricsSnapshot& snapshot, const std::string& filePath, MetricsFormat format);
+
+    /**
+     * @brief Periodically write snapshots to a file on a background thread
+     * @param snapshotFunction Produces the snapshot to write
+     * @param filePath Output file
+     * @param format Output format
+     * @param interval Time between writes
+     */
+    void startPeriodicDump(std::function<MetricsSnapshot()> snapshotFunction, const std::string& filePath,
+                           MetricsFormat format, std::chrono::milliseconds interval);
+
+    /**
+     * @brief Stop the periodic dump after writing a final snapshot
+     */
+    void stopPeriodicDump();
+
+private:
+    using MetricKey = std::tuple<std::string, std::string, std::string>;
+
+    std::map<MetricKey, std::unique_ptr<LatencyHistogram>> m_histograms;
+    std::map<MetricKey, std::unique_ptr<MetricCounter>> m_counters;
+    mutable std::shared_mutex m_mutex;
+
+    // Periodic dump
+    std::thread m_dumpThread;
+    std::mutex m_dumpMutex;
+    std::condition_variable m_dumpCondition;
+    bool m_isDumpStopping;
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,119 @@
+#pragma once
+
+#include "ModelServer.h"
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace lmms_magenta {
+
+/**
+ * @brief A model lifecycle event
+ */
+struct ModelEvent {
+    ModelType type;
+    std::string name;
+    bool loaded;
+};
+
+/**
+ * @brief Bounded, coalescing queue of model lifecycle events
+ *
+ * Events are delivered in order by a dedicated dispatcher thread, so the
+ * producer never waits for listeners. While an event for a model is still
+ * pending, a newer event for the same model replaces its state in place
+ * (listeners only need the latest state). When the backlog is full the
+ * oldest event is dropped.
+ */
+class ModelEventQueue {
+public:
+    // Called on the dispatcher thread for every delivered event
+    using Dispatcher = std::function<void(const ModelEvent&)>;
+
+    /**
+     * @brief Constructor
+     * @param dispatcher Function that delivers an event to listeners
+     * @param capacity Maximum number of pending events
+     */
+    explicit ModelEventQueue(Dispatcher dispatcher, size_t capacity = 256);
+
+    /**
+     * @brief Destructor, delivers pending events and joins the dispatcher
+     */
+    ~ModelEventQueue();
+
+    ModelEventQueue(const ModelEventQueue&) = delete;
+    ModelEventQueue& operator=(const ModelEventQueue&) = delete;
+
+    /**
+     * @brief Queue an event without blocking on listeners
+     * @param type Model type
+     * @param name Model name
+     * @param loaded Whether the model was loaded or unloaded
+     */
+    void push(ModelType type, const std::string& name, bool loaded);
+
+    /**
+     * @brief Wait until every queued event has been delivered
+     *
+     * Returns immediately when called from the dispatcher thread.
+     */
+    void flush();
+
+    /**
+     * @brief Wait for the event currently being delivered, if any
+     *
+     * Used after removing a listener so that it is not running when its owner
+     * is destroyed. Returns immediately when called from the dispatcher thread.
+     */
+    void waitForDispatch();
+
+    /**
+     * @brief Get the number of events waiting for delivery
+     * @return Number of pending events
+     */
+    size_t getPendingCount() const;
+
+    /**
+     * @brief Get the number of events merged into a pending event
+     * @return Number of coalesced events
+     */
+    uint64_t getCoalescedCount() const;
+
+    /**
+     * @brief Get the number of events dropped because the backlog was full
+     * @return Number of dropped events
+     */
+    uint64_t getDroppedCount() const;
+
+private:
+    Dispatcher m_dispatcher;
+    size_t m_capacity;
+
+    // Pending events in delivery order
+    std::deque<ModelEvent> m_events;
+    uint64_t m_coalescedCount;
+    uint64_t m_droppedCount;
+
+    // Whether the dispatcher is delivering an event
+    bool m_isDispatching;
+    bool m_stopping;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_eventAvailable;
+    std::condition_variable m_idle;
+
+    // Held while an event is being delivered
+    std::mutex m_dispatchMutex;
+
+    std::thread m_thread;
+
+    // Dispatcher thread main loop
+    void dispatchLoop();
+};
+
+} // namespace lmms_magenta
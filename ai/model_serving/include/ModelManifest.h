@@ -0,0 +1,134 @@
+#pragma once
+
+#include "ModelServer.h"
+#include <cstdint>
+#include <map>
+#include <set>
+#include <string>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Cached information about one model file
+ */
+struct ModelManifestEntry {
+    std::string relativePath;  // Path relative to the models directory
+    uint64_t fileSize;         // Size of the file in bytes
+    int64_t modifiedTime;      // Last write time (file clock ticks)
+    ModelMetadata metadata;    // Metadata parsed from the file
+};
+
+/**
+ * @brief Persistent index of the models directory
+ *
+ * The manifest caches the metadata parsed from every model file, keyed by
+ * relative path and validated by file size and modification time, so a scan
+ * only reparses files that changed since the last run.
+ */
+class ModelManifest {
+public:
+    /**
+     * @brief Constructor
+     */
+    ModelManifest();
+
+    /**
+     * @brief Load the manifest from disk
+     * @param manifestPath Path to the manifest file
+     * @return True if a valid manifest was loaded
+     */
+    bool load(const std::string& manifestPath);
+
+    /**
+     * @brief Save the manifest to disk
+     * @param manifestPath Path to the manifest file
+     * @return True if saving was successful
+     */
+    bool save(const std::string& manifestPath) const;
+
+    /**
+     * @brief Find a cached entry that is still valid
+     * @param relativePath Path relative to the models directory
+     * @param fileSize Current size of the file
+     * @param modifiedTime Current last write time of the file
+     * @return Pointer to the entry, or nullptr if missing or stale
+     */
+    const ModelManifestEntry* find(const std::string& relativePath,
+                                   uint64_t fileSize,
+                                   int64_t modifiedTime) const;
+
+    /**
+     * @brief Add or replace an entry
+     * @param entry Entry to store
+     */
+    void update(const ModelManifestEntry& entry);
+
+    /**
+     * @brief Remove entries for files that no longer exist
+     * @param presentPaths Relative paths found during the scan
+     */
+    void retainOnly(const std::set<std::string>& presentPaths);
+
+    /**
+     * @brief Get all entries
+     * @return Entries keyed by relative path
+     */
+    const std::map<std::string, ModelManifestEntry>& getEntries() const;
+
+    /**
+     * @brief Check whether the manifest changed since it was loaded
+     * @return True if it needs to be saved
+     */
+    bool isDirty() const;
+
+    /**
+     * @brief Parse a TensorFlow Lite model file
+     *
+     * Reads the flatbuffer header to fill in version, description, tensor
+     * shapes and quantization, and hashes the file contents.
+     *
+     * @param filePath Path to the .tflite file
+     * @param metadata Metadata to fill (name and type are left untouched)
+     * @return True if the file is a valid TensorFlow Lite model
+     */
+    static bool inspectModelFile(const std::string& filePath, ModelMetadata& metadata);
+
+    /**
+     * @brief Map a model subdirectory name to a model type
+     * @param directoryName Name of the subdirectory (e.g. "musicvae")
+     * @param type Receives the model type
+     * @return True if the name is a known model directory
+     */
+    static bool modelTypeFromDirectory(const std::string& directoryName, ModelType& type);
+
+    /**
+     * @brief Get the model type of a file in the models directory
+     *
+     * The type is given by the top-level subdirectory, so variants may be
+     * grouped below it (e.g. "musicvae/drums/groove_2bar.tflite").
+     *
+     * @param relativePath Path relative to the models directory, with '/' separators
+     * @param type Receives the model type
+     * @return True if the file is inside a known model directory
+     */
+    static bool modelTypeFromPath(const std::string& relativePath, ModelType& type);
+
+    /**
+     * @brief Get the subdirectory name of a model type
+     * @param type Model type
+     * @return Directory name (e.g. "musicvae")
+     */
+    static std::string directoryFromModelType(ModelType type);
+
+    // Name of the manifest file inside the models directory
+    static const char* const kManifestFileName;
+
+private:
+    // Entries keyed by relative path
+    std::map<std::string, ModelManifestEntry> m_entries;
+
+    // Whether the manifest changed since it was loaded
+    bool m_isDirty;
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "ModelServer.h"
+#include "../../utils/include/ThreadPool.h"
+#include <cstdint>
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief A model needed by a project
+ */
+struct PrefetchRequest {
+    ModelType type;
+    std::string modelName;
+    int64_t firstTick;  // Song position where the model is first needed
+};
+
+/**
+ * @brief Loads the models of a project in parallel before they are needed
+ *
+ * Requests are loaded on a pool of loader threads in the order in which
+ * they are first needed during playback, and each newly loaded model is
+ * warmed up with a dummy inference. Loads go through the ModelServer, so a
+ * plugin asking for a model that is being prefetched waits for that load
+ * instead of starting another one.
+ */
+class ModelPrefetcher {
+public:
+    /**
+     * @brief Constructor
+     * @param numThreads Number of loader threads (0 for hardware concurrency)
+     */
+    explicit ModelPrefetcher(size_t numThreads = 0);
+
+    /**
+     * @brief Destructor, waits for the prefetches in progress
+     */
+    ~ModelPrefetcher();
+
+    ModelPrefetcher(const ModelPrefetcher&) = delete;
+    ModelPrefetcher& operator=(const ModelPrefetcher&) = delete;
+
+    /**
+     * @brief Submit models for loading without waiting for them
+     *
+     * Models that are already loaded are skipped.
+     *
+     * @param requests Models needed by the project
+     * @return Number of models submitted
+     */
+    size_t prefetch(const std::vector<PrefetchRequest>& requests);
+
+    /**
+     * @brief Wait until every submitted model has been loaded and warmed up
+     * @return Number of models that failed to load
+     */
+    size_t wait();
+
+    /**
+     * @brief Get the number of submitted models not yet ready
+     * @return Number of prefetches in progress
+     */
+    size_t getPendingCount() const;
+
+    /**
+     * @brief Merge duplicate requests and sort them by first use
+     *
+     * A model requested several times keeps its earliest position; models
+     * needed at the same position keep their original order.
+     *
+     * @param requests Requests to order
+     * @return Ordered, unique requests
+     */
+    static std::vector<PrefetchRequest> orderRequests(const std::vector<PrefetchRequest>& requests);
+
+private:
+    // Loader threads
+    ThreadPool m_pool;
+
+    // Result of every submitted prefetch (true if the model is ready)
+    std::vector<std::future<bool>> m_pending;
+    mutable std::mutex m_mutex;
+
+    // Load and warm up one model (called on a loader thread)
+    static bool loadAndWarmUp(const PrefetchRequest& request);
+};
+
+} // namespace lmms_magenta
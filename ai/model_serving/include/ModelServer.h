@@ -1,14 +1,31 @@
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <memory>
 #include <map>
 #include <vector>
 #include <functional>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <future>
+
+#include "../../utils/include/SnapshotCell.h"
 
 namespace lmms_magenta {
 
+class ModelEventQueue;
+struct ModelEvent;
+class WarmStartCache;
+class QuotaManager;
+class ModelJob;
+struct ClientQuota;
+class MetricsRegistry;
+struct MetricsSnapshot;
+class MetricCounter;
+enum class MetricsFormat;
+
 /**
  * @brief Enum representing the different types of AI models supported
  */
@@ -32,6 +49,25 @@ struct ModelMetadata {
     std::string description;
     bool isQuantized;
     bool supportsGPU;
+    std::string filePath;                       // Path to the model file
+    uint64_t contentHash = 0;                   // Hash of the file contents
+    std::vector<std::vector<int>> inputShapes;  // Shapes of the input tensors
+    std::vector<std::vector<int>> outputShapes; // Shapes of the output tensors
+    std::vector<std::pair<uint64_t, uint64_t>> weightBuffers; // Hash and size of each constant buffer
+};
+
+/**
+ * @brief Breakdown of the memory held by a loaded model
+ */
+struct ModelMemoryStats {
+    size_t sharedWeightBytes = 0;  // Mapped model file, shared with models of the same weightKey
+    size_t weightBytes = 0;        // Constant weights private to this model (e.g. dequantized)
+    size_t arenaBytes = 0;         // Interpreter tensor arena
+    size_t scratchBytes = 0;       // Dynamically allocated tensors and staging buffers
+    size_t cacheBytes = 0;         // Caches kept by the model wrapper (states, lookup tables)
+    uint64_t weightKey = 0;        // Identifies the shared weights (0 if not shared)
+    
+    size_t total() const { return sharedWeightBytes + weightBytes + arenaBytes + scratchBytes + cacheBytes; }
 };
 
 /**
@@ -64,6 +100,81 @@ public:
      * @return Memory usage in bytes
      */
     virtual size_t getMemoryUsage() const = 0;
+    
+    /**
+     * @brief Get the memory usage of the model by category
+     * @return Memory breakdown (all weights by default)
+     */
+    virtual ModelMemoryStats getMemoryStats() const {
+        ModelMemoryStats stats;
+        stats.weightBytes = getMemoryUsage();
+        return stats;
+    }
+    
+    /**
+     * @brief Run a throwaway inference so the first real call is not slowed
+     *        down by one-time costs (kernel preparation, page faults)
+     * @return True if warm-up was successful (does nothing by default)
+     */
+    virtual bool warmUp() { return true; }
+};
+
+/**
+ * @brief A published version of a model
+ */
+struct ModelVersion {
+    std::shared_ptr<Model> model;  // nullptr while the model is not loaded
+    uint64_t generation = 0;       // Incremented every time the model changes
+};
+
+/**
+ * @brief Reference to a model that follows version updates
+ *
+ * A handle resolves to whichever version of the model the ModelServer has
+ * published most recently. Resolve it once per request and keep the returned
+ * pointer until the request is done: the request then finishes on the version
+ * it started with, and an old version is freed when its last user drops it.
+ */
+class ModelHandle {
+public:
+    ModelHandle() = default;
+    
+    /**
+     * @brief Get the current version of the model
+     * @return Shared pointer to the model, or nullptr if it is not loaded
+     */
+    std::shared_ptr<Model> get() const {
+        return m_slot ? m_slot->current.load()->model : nullptr;
+    }
+    
+    /**
+     * @brief Get the generation of the current version
+     *
+     * Changes whenever a new version is published or the model is unloaded.
+     *
+     * @return Generation number (0 for an empty handle)
+     */
+    uint64_t getGeneration() const {
+        return m_slot ? m_slot->current.load()->generation : 0;
+    }
+    
+    /**
+     * @brief Check if the handle refers to a model
+     * @return True if the handle was returned by the ModelServer
+     */
+    bool isValid() const { return m_slot != nullptr; }
+    
+private:
+    friend class ModelServer;
+    
+    // Shared by all handles to the same model and updated by the ModelServer
+    struct Slot {
+        SnapshotCell<ModelVersion> current;
+    };
+    
+    explicit ModelHandle(std::shared_ptr<Slot> slot) : m_slot(std::move(slot)) {}
+    
+    std::shared_ptr<Slot> m_slot;
 };
 
 /**
@@ -75,6 +186,9 @@ public:
  */
 class ModelServer {
 public:
+    // Creates an uninitialized model instance for the given metadata
+    using ModelFactory = std::function<std::shared_ptr<Model>(const ModelMetadata&)>;
+    
     /**
      * @brief Get the singleton instance
      * @return Reference to the singleton instance
@@ -94,6 +208,11 @@ public:
     
     /**
      * @brief Load a model into memory
+     *
+     * Concurrent requests for the same model are coalesced: the first caller
+     * performs the load and the others wait for its result, so each model is
+     * loaded once and a failure is reported to every waiting caller.
+     *
      * @param type Type of model to load
      * @param modelName Name of the model (if multiple models of same type exist)
      * @return True if loading was successful
@@ -108,8 +227,50 @@ public:
      */
     std::shared_ptr<Model> getModel(ModelType type, const std::string& modelName = "");
     
+    /**
+     * @brief Get a handle that always resolves to the current model version
+     *
+     * Loads the model if it is not loaded yet.
+     *
+     * @param type Type of model to get
+     * @param modelName Name of the model (if multiple models of same type exist)
+     * @return Handle to the model, or an invalid handle if loading failed
+     */
+    ModelHandle getModelHandle(ModelType type, const std::string& modelName = "");
+    
+    /**
+     * @brief Replace a model with a new version without interrupting its users
+     *
+     * The new version is loaded and initialized while the current one keeps
+     * serving, then validated with a smoke inference (Model::warmUp) and
+     * published in one step. Requests already running finish on the old
+     * version. The update is rejected if the new version fails to load, fails
+     * the smoke inference, or has different input or output shapes. If the
+     * model is not loaded, only its metadata is updated.
+     *
+     * Blocks while the new version loads, so call it from a worker thread.
+     *
+     * @param type Type of model to update
+     * @param modelName Name of the model
+     * @param modelPath Path of the new model file (empty to reload the current file)
+     * @return True if the new version was published
+     */
+    bool updateModel(ModelType type, const std::string& modelName, const std::string& modelPath = "");
+    
+    /**
+     * @brief Check if a model is loaded, without loading it
+     * @param type Type of model to check
+     * @param modelName Name of the model (if multiple models of same type exist)
+     * @return True if the model is loaded
+     */
+    bool isModelLoaded(ModelType type, const std::string& modelName = "") const;
+    
     /**
      * @brief Unload a model from memory
+     *
+     * Handles to the model resolve to nullptr afterwards. Users still holding
+     * the model pointer keep it alive until they release it.
+     *
      * @param type Type of model to unload
      * @param modelName Name of the model (if multiple models of same type exist)
      * @return True if unloading was successful
@@ -134,6 +295,12 @@ public:
      */
     size_t getTotalMemoryUsage() const;
     
+    /**
+     * @brief Get the memory breakdown of every loaded model
+     * @return Metadata and memory statistics of each loaded model
+     */
+    std::vector<std::pair<ModelMetadata, ModelMemoryStats>> getMemoryBreakdown() const;
+    
     /**
      * @brief Set maximum memory usage
      * @param maxMemoryUsage Maximum memory usage in bytes (0 for unlimited)
@@ -160,6 +327,11 @@ public:
     
     /**
      * @brief Register a callback for model loading events
+     *
+     * Callbacks run on the event dispatcher thread, never on the thread that
+     * loaded or unloaded the model. Events for the same model that are still
+     * pending are coalesced into its latest state.
+     *
      * @param callback Function to call when a model is loaded or unloaded
      * @return ID of the registered callback
      */
@@ -167,13 +339,133 @@ public:
     
     /**
      * @brief Unregister a model callback
+     *
+     * Waits for the callback to return if it is being invoked.
+     *
      * @param callbackId ID of the callback to unregister
      */
     void unregisterModelCallback(int callbackId);
     
+    /**
+     * @brief Wait until all queued model events have been delivered
+     */
+    void flushModelEvents();
+    
+    /**
+     * @brief Enable or disable warm-start snapshots for models loaded later
+     *
+     * Snapshots are stored in a ".warm_start" directory inside the models
+     * directory. Enabled by default.
+     *
+     * @param enable Whether to use warm-start snapshots
+     */
+    void setWarmStartEnabled(bool enable);
+    
+    /**
+     * @brief Set the resource quota of a client
+     *
+     * A client is usually one plugin instance. Clients without a quota are
+     * not limited.
+     *
+     * @param clientId Client identifier
+     * @param quota Limits on concurrent jobs, CPU time and scratch memory
+     */
+    void setClientQuota(const std::string& clientId, const ClientQuota& quota);
+    
+    /**
+     * @brief Request admission for a model job of a client
+     *
+     * The returned ticket must be kept while the job runs. When the job is
+     * rejected, its status tells which limit was hit and getRetryAfter()
+     * suggests when to try again.
+     *
+     * @param clientId Client identifier
+     * @param scratchBytes Scratch memory the job will hold while running
+     * @param timeout How long to wait for admission (0 to return immediately)
+     * @return Admission ticket
+     */
+    ModelJob beginJob(const std::string& clientId, size_t scratchBytes = 0,
+                      std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+    
+    /**
+     * @brief Forget the quota and usage of a client that went away
+     * @param clientId Client identifier
+     */
+    void removeClient(const std::string& clientId);
+    
+    /**
+     * @brief Get the registry holding the latency histograms and counters
+     *
+     * Models record queue wait, inference and request latency into it; the
+     * server records cache hits and misses, loads, evictions, rejected jobs
+     * and the request latency of each client.
+     *
+     * @return Registry living as long as the server
+     */
+    MetricsRegistry& getMetrics();
+    
+    /**
+     * @brief Copy the current values of all metrics
+     * @return Histograms per model and plugin, and counters
+     */
+    MetricsSnapshot metricsSnapshot() const;
+    
+    /**
+     * @brief Periodically write the metrics to a file
+     * @param filePath Output file, or an empty string to stop writing
+     * @param format Output format (text or Prometheus)
+     * @param interval Time between writes
+     */
+    void setMetricsDumpFile(const std::string& filePath, MetricsFormat format,
+                            std::chrono::milliseconds interval = std::chrono::seconds(10));
+    
+    /**
+     * @brief Get the label identifying a model in metrics
+     * @param type Model type
+     * @param modelName Name of the model
+     * @return Label such as "musicvae/default"
+     */
+    static std::string getModelLabel(ModelType type, const std::string& modelName);
+    
+    /**
+     * @brief Replace the factory used to create model instances
+     * @param factory Factory to use, or nullptr to restore the default
+     */
+    void setModelFactory(ModelFactory factory);
+    
 private:
+    // Key identifying a model by type and name
+    using ModelKey = std::pair<ModelType, std::string>;
+    
+    // Counters of one model, resolved once so that lookups need no registry lock
+    struct ModelCounters {
+        MetricCounter* cacheHits = nullptr;
+        MetricCounter* cacheMisses = nullptr;
+        MetricCounter* loads = nullptr;
+        MetricCounter* loadFailures = nullptr;
+        MetricCounter* evictions = nullptr;
+    };
+    
+    // Entry of the available-model snapshot
+    struct AvailableModel {
+        ModelMetadata metadata;
+        ModelCounters counters;
+    };
+    
+    // Entry of the loaded-model snapshot
+    struct LoadedModel {
+        std::shared_ptr<Model> model;
+        ModelCounters counters;
+    };
+    
+    // Immutable registry snapshots published to readers
+    using LoadedModelMap = std::map<ModelKey, LoadedModel>;
+    using AvailableModelMap = std::map<ModelKey, AvailableModel>;
+    using CallbackMap = std::map<int, std::function<void(ModelType, const std::string&, bool)>>;
+    
     // Private constructor for singleton
     ModelServer();
+    ~ModelServer();
     
     // Prevent copying and assignment
     ModelServer(const ModelServer&) = delete;
@@ -181,28 +473,80 @@ private:
     
     // Private implementation details
     std::string m_modelsDirectory;
-    size_t m_maxMemoryUsage;
-    bool m_enableGPU;
-    bool m_isInitialized;
+    std::atomic<size_t> m_maxMemoryUsage;
+    std::atomic<bool> m_enableGPU;
+    std::atomic<bool> m_isInitialized;
     
-    // Map of loaded models
-    std::map<std::pair<ModelType, std::string>, std::shared_ptr<Model>> m_loadedModels;
+    // Snapshot of loaded models, replaced as a whole on every change (read lock-free)
+    SnapshotCell<LoadedModelMap> m_loadedModels;
     
-    // Map of available models
-    std::map<std::pair<ModelType, std::string>, ModelMetadata> m_availableModels;
+    // Snapshot of available models, replaced when the directory is scanned
+    SnapshotCell<AvailableModelMap> m_availableModels;
     
     // Callbacks for model loading events
-    std::map<int, std::function<void(ModelType, const std::string&, bool)>> m_callbacks;
+    CallbackMap m_callbacks;
     int m_nextCallbackId;
     
-    // Mutex for thread safety
-    mutable std::mutex m_mutex;
+    // Slots shared with the handles given out, by model
+    std::map<ModelKey, std::shared_ptr<ModelHandle::Slot>> m_modelSlots;
+    
+    // Serializes model updates
+    std::mutex m_updateMutex;
+    
+    // Loads and updates in progress, shared by every caller requesting the
+    // same model; an update resolves to nullptr if it failed
+    std::map<ModelKey, std::shared_future<std::shared_ptr<Model>>> m_pendingLoads;
+    
+    // Factory used to create model instances (nullptr for the default)
+    ModelFactory m_modelFactory;
+    
+    // Warm-start snapshots handed to new models (nullptr when disabled)
+    std::shared_ptr<const WarmStartCache> m_warmStartCache;
+    bool m_isWarmStartEnabled;
+    
+    // Serializes writers of the registry snapshots and guards pending loads
+    mutable std::mutex m_registryMutex;
+    
+    // Guards the callback map
+    mutable std::mutex m_callbackMutex;
+    
+    // Delivers lifecycle events to the callbacks off the caller's thread
+    std::unique_ptr<ModelEventQueue> m_eventQueue;
+    
+    // Per-client limits on model jobs
+    std::unique_ptr<QuotaManager> m_quotaManager;
+    
+    // Latency histograms and counters
+    std::unique_ptr<MetricsRegistry> m_metrics;
+    
+    // Read the current snapshots
+    std::shared_ptr<const LoadedModelMap> loadedModelsSnapshot() const;
+    std::shared_ptr<const AvailableModelMap> availableModelsSnapshot() const;
+    
+    // Publish a new loaded-model snapshot and repoint the handles (m_registryMutex must be held)
+    void publishLoadedModels(std::shared_ptr<const LoadedModelMap> models);
+    
+    // Point every alias of a model at a new version of its file (m_registryMutex must be held)
+    void publishAvailableVersion(const std::vector<ModelKey>& aliases, const ModelMetadata& metadata);
+    
+    // Invoke the registered callbacks (called on the dispatcher thread)
+    void dispatchEvent(const ModelEvent& event);
+    
+    // Create and initialize a model, throwing on failure (called without any lock held)
+    std::shared_ptr<Model> createModel(const ModelMetadata& metadata, const ModelFactory& factory,
+                                       const std::shared_ptr<const WarmStartCache>& warmStartCache);
     
     // Scan for available models in the models directory
     void scanForModels();
     
-    // Unload models to free memory if necessary
-    void unloadModelsIfNeeded(size_t requiredMemory);
+    // Look up the counters of a model in the metrics registry
+    ModelCounters resolveCounters(ModelType type, const std::string& modelName);
+    
+    // Memory used by a set of models, counting shared weights once
+    static size_t sumMemoryUsage(const LoadedModelMap& models);
+    
+    // Remove models from the map until requiredMemory fits (m_registryMutex must be held)
+    void unloadModelsIfNeeded(LoadedModelMap& models, size_t requiredMemory);
 };
 
 } // namespace lmms_magenta
@@ -13,6 +13,14 @@ namespace lmms_magenta {
  * 
  * This class implements the MusicVAE model for pattern generation
  * using TensorFlow Lite.
+ *
+ * The model is expected to take rows of [note values | z] and return
+ * [note values decoded from z | z encoded from the input notes], with five
+ * values per note as in MidiUtils::sequenceToTensor, zero-padded to the
+ * note capacity of the row.
+ *
+ * Temperature scales the latent vector, so it is applied either when
+ * sampling the prior or when decoding, never both.
  */
 class MusicVAEModel : public TensorFlowLiteModel {
 public:
@@ -28,6 +36,12 @@ public:
      */
     ~MusicVAEModel() override;
     
+    /**
+     * @brief Initialize the model
+     * @return True if initialization was successful
+     */
+    bool initialize() override;
+    
     /**
      * @brief Encode a MIDI sequence to latent space
      * @param sequence MIDI sequence to encode
@@ -44,12 +58,30 @@ public:
     MidiSequence decode(const std::vector<float>& z, float temperature = 1.0f);
     
     /**
-     * @brief Sample from the prior distribution
+     * @brief Decode several latent vectors with one batched inference
+     * @param latents Latent vectors of getLatentDimension() values each
      * @param temperature Temperature for sampling (randomness)
+     * @return One MIDI sequence per latent vector, or none on failure
+     */
+    std::vector<MidiSequence> decodeBatch(const std::vector<std::vector<float>>& latents,
+                                          float temperature = 1.0f);
+    
+    /**
+     * @brief Sample from the prior distribution
+     * @param temperature Temperature for sampling (randomness); decode the
+     *                    result with a temperature of 1
      * @return Vector of latent variables (z)
      */
     std::vector<float> samplePrior(float temperature = 1.0f);
     
+    /**
+     * @brief Sample and decode several patterns with one batched inference
+     * @param count Number of patterns
+     * @param temperature Temperature for sampling (randomness)
+     * @return count MIDI sequences, or none on failure
+     */
+    std::vector<MidiSequence> sampleBatch(size_t count, float temperature = 1.0f);
+    
     /**
      * @brief Interpolate between two MIDI sequences
      * @param sequence1 First MIDI sequence
@@ -85,8 +117,17 @@ private:
     // Ticks per quarter note
     int m_ticksPerQuarter;
     
+    // Notes per input row
+    int m_noteCapacity;
+    
     // Apply temperature to latent vector
     std::vector<float> applyTemperature(const std::vector<float>& z, float temperature);
+    
+    // Note values of a sequence, fitted to the model length and note capacity
+    std::vector<float> toNoteValues(const MidiSequence& sequence) const;
+    
+    // Run rows of [note values | z] through the model
+    bool runRows(const std::vector<float>& input, std::vector<float>& output);
 };
 
 } // namespace lmms_magenta
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace lmms_magenta {
+
+class QuotaManager;
+
+/**
+ * @brief Resource limits of one client (usually one plugin instance)
+ */
+struct ClientQuota {
+    size_t maxConcurrentJobs = 0;  // Jobs running at the same time (0 for unlimited)
+    double cpuBudget = 0.0;        // CPU seconds per second of wall time (0 for unlimited)
+    size_t maxScratchBytes = 0;    // Scratch memory held by running jobs (0 for unlimited)
+};
+
+/**
+ * @brief Outcome of a job admission request
+ */
+enum class JobStatus {
+    Admitted,             // The job may run
+    TooManyJobs,          // The client already runs its maximum number of jobs
+    CpuBudgetExhausted,   // The client used up its CPU time, retry later
+    ScratchLimitExceeded  // The job would exceed the client's scratch memory
+};
+
+/**
+ * @brief Admission ticket for one job of a client
+ *
+ * Holds the client's job slot and scratch reservation until the ticket is
+ * finished or destroyed, at which point the CPU time used by the job is
+ * charged to the client. CPU time is measured on the thread that created the
+ * ticket, together with the time the inference threads spent on inferences
+ * that thread ran in the meantime; other work can be added with addCpuTime().
+ * A ticket finished on another thread is charged wall time instead. A ticket
+ * must not outlive the QuotaManager that issued it.
+ */
+class ModelJob {
+public:
+    /**
+     * @brief Create a ticket that was not admitted
+     * @param status Reason for the rejection
+     * @param retryAfter Suggested delay before trying again
+     */
+    explicit ModelJob(JobStatus status = JobStatus::TooManyJobs,
+                      std::chrono::milliseconds retryAfter = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Destructor, finishes the job
+     */
+    ~ModelJob();
+
+    ModelJob(ModelJob&& other) noexcept;
+    ModelJob& operator=(ModelJob&& other) noexcept;
+    ModelJob(const ModelJob&) = delete;
+    ModelJob& operator=(const ModelJob&) = delete;
+
+    /**
+     * @brief Check if the job was admitted
+     * @return True if the job may run
+     */
+    bool isAdmitted() const;
+
+    /**
+     * @brief Get the admission status
+     * @return Admission status
+     */
+    JobStatus getStatus() const;
+
+    /**
+     * @brief Get the suggested delay before submitting a rejected job again
+     *
+     * Zero when the job can be retried as soon as another job of the client
+     * finishes.
+     *
+     * @return Delay
+     */
+    std::chrono::milliseconds getRetryAfter() const;
+
+    /**
+     * @brief Charge CPU time spent on other threads (e.g. a ThreadPool)
+     * @param cpuSeconds CPU time in seconds
+     */
+    void addCpuTime(double cpuSeconds);
+
+    /**
+     * @brief Release the job's resources and charge its CPU time
+     */
+    void finish();
+
+private:
+    friend class QuotaManager;
+
+    QuotaManager* m_manager;
+    std::string m_clientId;
+    JobStatus m_status;
+    std::chrono::milliseconds m_retryAfter;
+    size_t m_scratchBytes;
+    double m_extraCpuSeconds;
+
+    // Where and when the job started, for measuring its CPU time
+    std::thread::id m_threadId;
+    double m_startThreadCpuSeconds;
+    double m_startDelegatedCpuSeconds;
+    std::chrono::steady_clock::time_point m_startTime;
+
+    // Release the ticket without charging it
+    void reset();
+};
+
+/**
+ * @brief Enforces per-client quotas on model jobs
+ *
+ * Each client has a limit on concurrent jobs, on scratch memory held by its
+ * running jobs, and a CPU budget. The budget is a token bucket refilled at
+ * cpuBudget CPU-seconds per second and holding at most one second's worth;
+ * a job is admitted while the bucket is not empty and charged its actual CPU
+ * time when it finishes, so a client that overspends is held back until the
+ * debt is repaid. Clients without an explicit quota use the default quota.
+ */
+class QuotaManager {
+public:
+    /**
+     * @brief Constructor
+     */
+    QuotaManager();
+
+    QuotaManager(const QuotaManager&) = delete;
+    QuotaManager& operator=(const QuotaManager&) = delete;
+
+    /**
+     * @brief Set the quota of a client
+     * @param clientId Client identifier
+     * @param quota Quota to apply to jobs started from now on
+     */
+    void setQuota(const std::string& clientId, const ClientQuota& quota);
+
+    /**
+     * @brief Set the quota of clients without an explicit quota
+     * @param quota Default quota (unlimited unless set)
+     */
+    void setDefaultQuota(const ClientQuota& quota);
+
+    /**
+     * @brief Get the quota that applies to a client
+     * @param clientId Client identifier
+     * @return Quota of the client
+     */
+    ClientQuota getQuota(const std::string& clientId) const;
+
+    /**
+     * @brief Request admission for a job
+     * @param clientId Client identifier
+     * @param scratchBytes Scratch memory the job will hold while running
+     * @param timeout How long to wait for admission (0 to return immediately)
+     * @return Ticket holding the admission status
+     */
+    ModelJob beginJob(const std::string& clientId, size_t scratchBytes = 0,
+                      std::chrono::milliseconds timeout = std::chrono::milliseconds(0));
+
+    /**
+     * @brief Forget a client's quota and usage (its running jobs still finish)
+     * @param clientId Client identifier
+     */
+    void removeClient(const std::string& clientId);
+
+    /**
+     * @brief Set a function called with the client and wall time of every finished job
+     *
+     * Must be set before jobs are started. Called on the thread finishing the job.
+     *
+     * @param callback Function to call, or nullptr for none
+     */
+    void setJobFinishedCallback(std::function<void(const std::string&, std::chrono::nanoseconds)> callback);
+
+    /**
+     * @brief Get the number of running jobs of a client
+     * @param clientId Client identifier
+     * @return Number of admitted jobs not yet finished
+     */
+    size_t getActiveJobCount(const std::string& clientId) const;
+
+    /**
+     * @brief Get the scratch memory reserved by the running jobs of a client
+     * @param clientId Client identifier
+     * @return Reserved scratch memory in bytes
+     */
+    size_t getScratchUsage(const std::string& clientId) const;
+
+private:
+    friend class ModelJob;
+
+    // Usage of one client
+    struct ClientState {
+        ClientQuota quota;
+        bool hasQuota = false;
+        size_t activeJobs = 0;
+        size_t scratchBytes = 0;
+        double cpuCredit = 0.0;  // CPU seconds available (negative when in debt)
+        std::chrono::steady_clock::time_point lastRefill;
+    };
+
+    std::map<std::string, ClientState> m_clients;
+    ClientQuota m_defaultQuota;
+    std::function<void(const std::string&, std::chrono::nanoseconds)> m_jobFinishedCallback;
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_jobFinished;
+
+    // Get a client's state, creating it on first use (m_mutex must be held)
+    ClientState& getClient(const std::string& clientId);
+
+    // Refill the CPU bucket up to now (m_mutex must be held)
+    static void refillCpuCredit(ClientState& client, std::chrono::steady_clock::time_point now);
+
+    // Check whether a job fits, setting the retry delay if not (m_mutex must be held)
+    static JobStatus checkAdmission(const ClientState& client, size_t scratchBytes,
+                                    std::chrono::milliseconds& retryAfter);
+
+    // Release a finished job and charge its CPU time
+    void endJob(const std::string& clientId, size_t scratchBytes, double cpuSeconds);
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,174 @@
+#pragma once
+
+#include "TensorFlowLiteModel.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace lmms_magenta {
+
+class ThreadPool;
+
+/**
+ * @brief Strategy used by the SequenceDecoder
+ */
+enum class DecodingStrategy {
+    BeamSearch,  // Keep the highest scoring prefixes
+    Sampling     // Draw independent candidates with top-k/nucleus filtering
+};
+
+/**
+ * @brief Options controlling a decoding run
+ */
+struct DecodingOptions {
+    DecodingStrategy strategy;
+    int beamWidth;        // Beams kept per step (beam search)
+    int numCandidates;    // Independent candidates (sampling)
+    int maxSteps;         // Maximum number of generated tokens
+    int startToken;       // Token fed at the first step
+    int endToken;         // Token that finishes a candidate (-1 for none)
+    int topK;             // Keep only the k most likely tokens (0 for all)
+    float topP;           // Nucleus probability mass (1 for all)
+    float temperature;    // Softmax temperature
+    uint32_t seed;        // Random seed for sampling
+
+    DecodingOptions()
+        : strategy(DecodingStrategy::BeamSearch), beamWidth(4), numCandidates(4), maxSteps(32),
+          startToken(0), endToken(-1), topK(0), topP(1.0f), temperature(1.0f), seed(0) {}
+};
+
+/**
+ * @brief A decoded token sequence and its log probability
+ */
+struct DecodedSequence {
+    std::vector<int> tokens;
+    float logProbability;
+};
+
+/**
+ * @brief Immutable recurrent state shared between candidates
+ *
+ * Candidates forked from the same parent hold the same pointer until the
+ * next step produces a fresh state, so forking never copies state vectors.
+ */
+using DecoderStatePtr = std::shared_ptr<const std::vector<float>>;
+
+/**
+ * @brief Generic decoding engine for autoregressive models
+ *
+ * Runs beam search or multi-candidate sampling on top of a batched step
+ * function. All live candidates are advanced with one step call per
+ * timestep, pruning uses partial sorts instead of full sorts, and token
+ * prefixes are shared between candidates as immutable linked nodes.
+ * Independent groups can be decoded concurrently on a ThreadPool.
+ */
+class SequenceDecoder {
+public:
+    /**
+     * @brief Batched step function
+     *
+     * Called with one token and one state per row. Must fill logits with
+     * rows x vocabSize values and newStates with one state per row.
+     */
+    using StepFunction = std::function<bool(const std::vector<int>& tokens,
+                                            const std::vector<DecoderStatePtr>& states,
+                                            std::vector<float>& logits,
+                                            std::vector<DecoderStatePtr>& newStates)>;
+
+    /**
+     * @brief Constructor
+     * @param stepFunction Batched step function
+     * @param vocabSize Number of distinct tokens
+     */
+    SequenceDecoder(StepFunction stepFunction, int vocabSize);
+
+    /**
+     * @brief Create a step function for a TensorFlow Lite model
+     *
+     * The model must take rows of [token one-hot | state] and return rows of
+     * [logits | state], with the batch as the leading dimension. A step with
+     * a token outside the vocabulary or a state of the wrong size fails
+     * without running the model.
+     *
+     * @param model Model to run
+     * @param vocabSize Number of distinct tokens
+     * @param stateSize Size of the flattened recurrent state
+     * @return Step function running one batched inference per call
+     */
+    static StepFunction fromModel(std::shared_ptr<TensorFlowLiteModel> model, int vocabSize, int stateSize);
+
+    /**
+     * @brief Decode a single group
+     * @param initialState State before the first step
+     * @param options Decoding options
+     * @return Decoded sequences, best first; empty if the start or end token
+     *         is outside the vocabulary
+     */
+    std::vector<DecodedSequence> decode(const DecoderStatePtr& initialState,
+                                        const DecodingOptions& options) const;
+
+    /**
+     * @brief Decode several independent groups concurrently
+     *
+     * The step function must be safe to call from several threads at once.
+     *
+     * @param initialStates One initial state per group
+     * @param options Decoding options shared by all groups
+     * @param pool Thread pool to run the groups on
+     * @return Decoded sequences per group, best first; every group is empty
+     *         if the start or end token is outside the vocabulary
+     */
+    std::vector<std::vector<DecodedSequence>> decodeGroups(const std::vector<DecoderStatePtr>& initialStates,
+                                                          const DecodingOptions& options,
+                                                          ThreadPool& pool) const;
+
+    /**
+     * @brief Get the vocabulary size
+     * @return Number of distinct tokens
+     */
+    int getVocabSize() const;
+
+private:
+    // Node in a shared, immutable token prefix
+    struct PrefixNode {
+        int token;
+        std::shared_ptr<const PrefixNode> parent;
+    };
+
+    // Live candidate
+    struct Candidate {
+        std::shared_ptr<const PrefixNode> prefix;
+        DecoderStatePtr state;
+        int lastToken;
+        float score;
+        bool finished;
+    };
+
+    StepFunction m_stepFunction;
+    int m_vocabSize;
+
+    // Check the tokens of the options against the vocabulary
+    bool validateOptions(const DecodingOptions& options) const;
+
+    // Check that a step returned one row per live candidate
+    bool validateStep(size_t numRows, const std::vector<float>& logits,
+                      const std::vector<DecoderStatePtr>& newStates) const;
+
+    // Beam search over one group
+    std::vector<DecodedSequence> beamSearch(const DecoderStatePtr& initialState,
+                                            const DecodingOptions& options) const;
+
+    // Top-k/nucleus sampling of independent candidates in one group
+    std::vector<DecodedSequence> sample(const DecoderStatePtr& initialState,
+                                        const DecodingOptions& options,
+                                        uint32_t seed) const;
+
+    // Convert logits to log probabilities in place
+    static void logSoftmax(float* values, int count, float temperature);
+
+    // Flatten a prefix into tokens
+    static std::vector<int> unwindPrefix(const std::shared_ptr<const PrefixNode>& prefix);
+};
+
+} // namespace lmms_magenta
@@ -3,9 +3,11 @@
 #include "ModelServer.h"
 #include <string>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 // Forward declarations for TensorFlow Lite
+struct TfLiteDelegate;
 namespace tflite {
 class FlatBufferModel;
 class Interpreter;
@@ -13,6 +15,9 @@ class Interpreter;
 
 namespace lmms_magenta {
 
+class WarmStartCache;
+class LatencyHistogram;
+
 /**
  * @brief Base class for TensorFlow Lite models
  * 
@@ -57,6 +62,25 @@ public:
      */
     size_t getMemoryUsage() const override;
     
+    /**
+     * @brief Get the memory usage of the model by category
+     *
+     * Shared weights are the bytes of the model allocation, private weights
+     * the constants the interpreter materialized, the arena is the sum of the
+     * interpreter's arena-planned tensors, and scratch covers dynamically
+     * allocated tensors. The figures are refreshed after allocation and after
+     * every inference.
+     *
+     * @return Memory breakdown
+     */
+    ModelMemoryStats getMemoryStats() const override;
+    
+    /**
+     * @brief Run one inference on a zero-filled input of the planned shape
+     * @return True if the inference succeeded and all outputs are finite
+     */
+    bool warmUp() override;
+    
     /**
      * @brief Run inference on the model
      * @param inputTensor Input tensor data
@@ -64,6 +88,18 @@ public:
      */
     virtual std::vector<float> runInference(const std::vector<float>& inputTensor);
     
+    /**
+     * @brief Run inference into a caller-owned buffer
+     *
+     * The output is resized to the size of the output tensor, so a buffer
+     * reserved for the largest batch is never reallocated.
+     *
+     * @param inputTensor Input tensor data
+     * @param output Receives the output tensor data (cleared on failure)
+     * @return True if the inference succeeded
+     */
+    bool runInference(const std::vector<float>& inputTensor, std::vector<float>& output);
+    
     /**
      * @brief Get the input tensor shape
      * @return Vector containing the dimensions of the input tensor
@@ -78,7 +114,11 @@ public:
     
     /**
      * @brief Set the number of threads to use for inference
-     * @param numThreads Number of threads (0 for auto)
+     *
+     * Inference always runs on the shared InferenceThreadPool; this limits how
+     * many of its kernel threads one inference of this model may use.
+     *
+     * @param numThreads Number of threads (0 for all threads of the pool)
      */
     void setNumThreads(int numThreads);
     
@@ -95,6 +135,17 @@ public:
      */
     bool isUsingGPU() const;
     
+    /**
+     * @brief Use warm-start snapshots when initializing this model
+     *
+     * Must be called before initialize(). Packed weights are mapped from the
+     * snapshot instead of being repacked, and the interpreter is allocated
+     * for the input shape recorded in the previous session.
+     *
+     * @param cache Snapshot cache, or nullptr to disable
+     */
+    void setWarmStartCache(std::shared_ptr<const WarmStartCache> cache);
+    
 protected:
     /**
      * @brief Prepare input tensor for inference
@@ -105,9 +156,16 @@ protected:
     
     /**
      * @brief Extract output tensor after inference
-     * @return Output data from the model
+     * @param output Receives the output data from the model
+     * @return True if extraction was successful
+     */
+    virtual bool extractOutputTensor(std::vector<float>& output);
+    
+    /**
+     * @brief Get the memory held by caches of a derived model
+     * @return Cache size in bytes
      */
-    virtual std::vector<float> extractOutputTensor();
+    virtual size_t getCacheMemoryUsage() const;
     
 private:
     // Model path
@@ -117,7 +175,7 @@ private:
     ModelMetadata m_metadata;
     
     // TensorFlow Lite model and interpreter
-    std::unique_ptr<tflite::FlatBufferModel> m_model;
+    std::shared_ptr<const tflite::FlatBufferModel> m_model;
     std::unique_ptr<tflite::Interpreter> m_interpreter;
     
     // Model state
@@ -125,8 +183,41 @@ private:
     bool m_isUsingGPU;
     int m_numThreads;
     
+    // Accelerator delegate (must outlive the interpreter)
+    std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)> m_delegate;
+    
+    // Warm-start snapshot cache and the state recorded into it
+    std::shared_ptr<const WarmStartCache> m_warmStartCache;
+    std::string m_weightCachePath;
+    std::vector<int> m_plannedInputShape;
+    bool m_isPlanChanged;
+    
+    // Serializes use of the interpreter
+    std::mutex m_inferenceMutex;
+    
     // Memory usage tracking
-    size_t m_memoryUsage;
+    ModelMemoryStats m_memoryStats;
+    mutable std::mutex m_statsMutex;
+    
+    // Latency metrics of this model, owned by the ModelServer's registry
+    LatencyHistogram* m_queueWaitHistogram;
+    LatencyHistogram* m_inferenceHistogram;
+    LatencyHistogram* m_requestHistogram;
+    
+    // Recompute the interpreter part of the memory statistics
+    void updateMemoryStats();
+    
+    // Apply the XNNPACK delegate with the snapshot's weight cache, if enabled
+    void applyDelegate();
+    
+    // Create and allocate the interpreter (called on an inference thread)
+    bool buildInterpreter();
+    
+    // Install the backend context of the running pool task
+    void attachCpuBackendContext();
+    
+    // Intra-op threads for this model, limited by the shared pool
+    int getEffectiveNumThreads() const;
 };
 
 } // namespace lmms_magenta
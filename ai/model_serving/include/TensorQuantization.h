@@ -0,0 +1,58 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Affine quantization between float and 8-bit tensor data
+ *
+ * Implements the TensorFlow Lite scheme real = (q - zeroPoint) * scale.
+ * Quantized values are rounded to nearest and saturated to the range of
+ * the target type.
+ */
+class TensorQuantization {
+public:
+    /**
+     * @brief Quantize float values to int8
+     * @param input Values to quantize
+     * @param count Number of values
+     * @param scale Quantization scale
+     * @param zeroPoint Quantization zero point
+     * @param output Receives count quantized values
+     */
+    static void quantize(const float* input, size_t count, float scale, int zeroPoint, int8_t* output);
+
+    /**
+     * @brief Quantize float values to uint8
+     * @param input Values to quantize
+     * @param count Number of values
+     * @param scale Quantization scale
+     * @param zeroPoint Quantization zero point
+     * @param output Receives count quantized values
+     */
+    static void quantize(const float* input, size_t count, float scale, int zeroPoint, uint8_t* output);
+
+    /**
+     * @brief Dequantize int8 values to float
+     * @param input Values to dequantize
+     * @param count Number of values
+     * @param scale Quantization scale
+     * @param zeroPoint Quantization zero point
+     * @param output Receives count float values
+     */
+    static void dequantize(const int8_t* input, size_t count, float scale, int zeroPoint, float* output);
+
+    /**
+     * @brief Dequantize uint8 values to float
+     * @param input Values to dequantize
+     * @param count Number of values
+     * @param scale Quantization scale
+     * @param zeroPoint Quantization zero point
+     * @param output Receives count float values
+     */
+    static void dequantize(const uint8_t* input, size_t count, float scale, int zeroPoint, float* output);
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "ModelServer.h"
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Allocation plan recorded from a previous run of a model
+ */
+struct WarmStartPlan {
+    std::vector<int> inputShape;  // Input shape the interpreter was last allocated for
+    size_t arenaBytes = 0;        // Arena size planned for that shape
+};
+
+/**
+ * @brief On-disk warm-start snapshots of prepared models
+ *
+ * Each model gets a snapshot directory per CPU type holding the XNNPACK
+ * weight cache (weights already packed for the selected GEMM kernels, mapped
+ * on later loads instead of repacked) and the last allocation plan, so the
+ * interpreter is allocated once for the shape it will actually run with.
+ * Snapshots are keyed by the model content hash, so a changed model file
+ * never reuses a stale snapshot.
+ */
+class WarmStartCache {
+public:
+    /**
+     * @brief Constructor
+     * @param cacheDirectory Directory holding all snapshots
+     */
+    explicit WarmStartCache(const std::string& cacheDirectory);
+
+    /**
+     * @brief Get the snapshot directory of a model, creating it if needed
+     * @param metadata Model metadata (contentHash must be set)
+     * @return Directory path, or an empty string if unavailable
+     */
+    std::string getSnapshotDirectory(const ModelMetadata& metadata) const;
+
+    /**
+     * @brief Get the path of the packed weight cache of a model
+     * @param metadata Model metadata
+     * @return File path, or an empty string if unavailable
+     */
+    std::string getWeightCachePath(const ModelMetadata& metadata) const;
+
+    /**
+     * @brief Load the allocation plan of a model
+     * @param metadata Model metadata
+     * @param plan Receives the plan
+     * @return True if a plan was found
+     */
+    bool loadPlan(const ModelMetadata& metadata, WarmStartPlan& plan) const;
+
+    /**
+     * @brief Save the allocation plan of a model
+     * @param metadata Model metadata
+     * @param plan Plan to store
+     * @return True if saving was successful
+     */
+    bool savePlan(const ModelMetadata& metadata, const WarmStartPlan& plan) const;
+
+    /**
+     * @brief Get a key identifying the CPU's instruction set features
+     *
+     * Packed weight layouts depend on the kernels XNNPACK selects for the
+     * CPU, so snapshots are only reused on CPUs with the same key.
+     *
+     * @return CPU key (e.g. "x86_64-3f2a...")
+     */
+    static std::string getCpuKey();
+
+private:
+    std::string m_cacheDirectory;
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "ModelServer.h"
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Forward declarations for TensorFlow Lite
+namespace tflite {
+class FlatBufferModel;
+}
+
+namespace lmms_magenta {
+
+/**
+ * @brief Content-addressed store of mapped model weights
+ *
+ * Model buffers are keyed by the content hash recorded in the manifest and
+ * reference counted, so every Model instance created from identical weights
+ * (the same file registered under several names, copies in several model
+ * directories, or one file loaded by several plugins) shares a single
+ * FlatBufferModel. The buffer is released when its last user goes away.
+ */
+class WeightStore {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the singleton instance
+     */
+    static WeightStore& getInstance();
+
+    /**
+     * @brief Get the weights of a model, mapping them on first use
+     * @param metadata Model metadata (filePath and contentHash are used)
+     * @return Shared model buffer, or nullptr if the file could not be loaded
+     */
+    std::shared_ptr<const tflite::FlatBufferModel> acquire(const ModelMetadata& metadata);
+
+    /**
+     * @brief Get the number of distinct weight buffers currently resident
+     * @return Number of resident buffers
+     */
+    size_t getResidentCount() const;
+
+    /**
+     * @brief Compute how many weight bytes are duplicated across models
+     *
+     * Uses the per-buffer hashes from the manifest. Identical tensors stored
+     * in different files cannot share memory, so this reports how much would
+     * be saved by exporting the common part (e.g. a shared encoder) as its
+     * own model file.
+     *
+     * @param models Metadata of the models to compare
+     * @return Bytes of constant buffers that are stored more than once
+     */
+    static uint64_t findDuplicateWeightBytes(const std::vector<ModelMetadata>& models);
+
+private:
+    WeightStore() = default;
+    WeightStore(const WeightStore&) = delete;
+    WeightStore& operator=(const WeightStore&) = delete;
+
+    // Resident buffers by content hash
+    std::unordered_map<uint64_t, std::weak_ptr<const tflite::FlatBufferModel>> m_buffers;
+
+    mutable std::mutex m_mutex;
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,155 @@
+#include "CycleGANModel.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace lmms_magenta {
+
+namespace {
+
+// Floor applied before taking the log of a magnitude
+constexpr float kMagnitudeFloor = 1e-7f;
+
+} // namespace
+
+CycleGANModel::CycleGANModel(const std::string& modelPath, const ModelMetadata& metadata)
+    : TensorFlowLiteModel(modelPath, metadata) {
+}
+
+CycleGANModel::~CycleGANModel() {
+}
+
+void CycleGANModel::reserveFrames(int maxFrames, int numBins) {
+    m_magnitudes.reserve(static_cast<size_t>(maxFrames) * numBins);
+    m_styled.reserve(static_cast<size_t>(maxFrames) * numBins);
+}
+
+void CycleGANModel::computeLogMagnitudes(const std::complex<float>* spectra, size_t count, float* logMagnitudes) {
+    for (size_t i = 0; i < count; ++i) {
+        logMagnitudes[i] = std::log(std::abs(spectra[i]) + kMagnitudeFloor);
+    }
+}
+
+void CycleGANModel::applyMagnitudes(std::complex<float>* spectra, const float* logMagnitudes,
+                                    const float* styled, size_t count, float strength) {
+    strength = std::max(0.0f, std::min(1.0f, strength));
+
+    for (size_t i = 0; i < count; ++i) {
+        const float logMagnitude = (1.0f - strength) * logMagnitudes[i] + strength * styled[i];
+        const float magnitude = std::exp(logMagnitude);
+        const float phase = std::arg(spectra[i]);
+        spectra[i] = std::polar(magnitude, phase);
+    }
+}
+
+bool CycleGANModel::styleMagnitudes(const std::vector<float>& logMagnitudes, std::vector<float>& styled) {
+    // Check if model is initialized
+    if (!isInitialized() || logMagnitudes.empty()) {
+        return false;
+    }
+
+    try {
+        // Run the whole batch through the model in one call
+        if (!runInference(logMagnitudes, styled)) {
+            return false;
+        }
+
+        if (styled.size() != logMagnitudes.size()) {
+            std::cerr << "Unexpected CycleGAN output size: " << styled.size() << std::endl;
+            return false;
+        }
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error styling magnitudes: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool CycleGANModel::transformSpectra(std::complex<float>* spectra, int numFrames, int numBins, float strength) {
+    if (numFrames <= 0 || numBins <= 0) {
+        return false;
+    }
+
+    // Convert the batch to log magnitudes; no allocation once reserved
+    const size_t count = static_cast<size_t>(numFrames) * numBins;
+    m_magnitudes.resize(count);
+    computeLogMagnitudes(spectra, count, m_magnitudes.data());
+
+    if (!styleMagnitudes(m_magnitudes, m_styled)) {
+        return false;
+    }
+
+    // Blend magnitudes and keep the original phase
+    applyMagnitudes(spectra, m_magnitudes.data(), m_styled.data(), count, strength);
+    return true;
+}
+
+MidiSequence CycleGANModel::transformSequence(const MidiSequence& sequence, int windowTicks, int hopTicks) {
+    MidiSequence result(sequence.ticksPerQuarter, sequence.totalTicks,
+                        sequence.timeSignatureNumerator, sequence.timeSignatureDenominator);
+
+    // Check if model is initialized
+    if (!isInitialized()) {
+        std::cerr << "Model not initialized" << std::endl;
+        return sequence;
+    }
+
+    if (windowTicks <= 0 || hopTicks <= 0 || hopTicks > windowTicks) {
+        std::cerr << "Invalid window parameters" << std::endl;
+        return sequence;
+    }
+
+    try {
+        // Each window owns the centered hop-sized region of its output, so
+        // overlapping windows never emit the same note twice
+        const int margin = (windowTicks - hopTicks) / 2;
+
+        for (int windowStart = -margin; windowStart < sequence.totalTicks; windowStart += hopTicks) {
+            const int windowEnd = windowStart + windowTicks;
+            const int ownedStart = (windowStart + margin <= 0) ? 0 : windowStart + margin;
+            const int ownedEnd = (windowStart + margin + hopTicks >= sequence.totalTicks)
+                ? sequence.totalTicks
+                : windowStart + margin + hopTicks;
+
+            // Gather the window contents relative to its start
+            MidiSequence window(sequence.ticksPerQuarter, windowTicks,
+                                sequence.timeSignatureNumerator, sequence.timeSignatureDenominator);
+            for (const auto& note : sequence.notes) {
+                if (note.startTime >= windowStart && note.startTime < windowEnd) {
+                    MidiNote shifted = note;
+                    shifted.startTime -= windowStart;
+                    window.notes.push_back(shifted);
+                }
+            }
+
+            // Transform the window
+            std::vector<float> output = runInference(MidiUtils::sequenceToTensor(window));
+            MidiSequence styled = MidiUtils::tensorToSequence(output, sequence.ticksPerQuarter, windowTicks);
+
+            // Keep only the notes this window owns
+            for (auto note : styled.notes) {
+                note.startTime += windowStart;
+                if (note.startTime >= ownedStart && note.startTime < ownedEnd) {
+                    note.duration = std::min(note.duration, sequence.totalTicks - note.startTime);
+                    result.notes.push_back(note);
+                }
+            }
+        }
+
+        // Sort notes by start time
+        std::sort(result.notes.begin(), result.notes.end(),
+                  [](const MidiNote& a, const MidiNote& b) {
+                      return a.startTime < b.startTime;
+                  });
+
+        return result;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error transforming sequence: " << e.what() << std::endl;
+        return sequence;
+    }
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,160 @@
+#include "EmotionMapperModel.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace lmms_magenta {
+
+EmotionLookupTable::EmotionLookupTable(int resolution, const std::array<Axis, 3>& axes)
+    : m_resolution(std::max(2, resolution))
+    , m_axes(axes)
+    , m_isBuilt(false) {
+    const size_t numPoints = static_cast<size_t>(m_resolution) * m_resolution * m_resolution;
+    m_values.assign(numPoints * kNumParameters, 0.0f);
+}
+
+bool EmotionLookupTable::build(const Evaluator& evaluator) {
+    const size_t numPoints = static_cast<size_t>(m_resolution) * m_resolution * m_resolution;
+
+    // Enumerate all grid points in table order
+    std::vector<float> inputs(numPoints * 3);
+    size_t row = 0;
+    for (int i = 0; i < m_resolution; ++i) {
+        for (int j = 0; j < m_resolution; ++j) {
+            for (int k = 0; k < m_resolution; ++k) {
+                const int indices[3] = {i, j, k};
+                for (int axis = 0; axis < 3; ++axis) {
+                    const float t = static_cast<float>(indices[axis]) / (m_resolution - 1);
+                    inputs[row * 3 + axis] = m_axes[axis].minimum + t * (m_axes[axis].maximum - m_axes[axis].minimum);
+                }
+                ++row;
+            }
+        }
+    }
+
+    if (!evaluator(inputs.data(), numPoints, m_values.data())) {
+        m_isBuilt = false;
+        return false;
+    }
+
+    m_isBuilt = true;
+    return true;
+}
+
+GenerationParameters EmotionLookupTable::lookup(float valence, float arousal, float intensity) const {
+    int index[3];
+    float fraction[3];
+    locate(0, valence, index[0], fraction[0]);
+    locate(1, arousal, index[1], fraction[1]);
+    locate(2, intensity, index[2], fraction[2]);
+
+    const size_t strideK = kNumParameters;
+    const size_t strideJ = strideK * m_resolution;
+    const size_t strideI = strideJ * m_resolution;
+    const float* base = &m_values[index[0] * strideI + index[1] * strideJ + index[2] * strideK];
+
+    // Trilinear interpolation over the 8 corners of the cell
+    float result[kNumParameters] = {0.0f, 0.0f, 0.0f};
+    for (int corner = 0; corner < 8; ++corner) {
+        const int di = (corner >> 2) & 1;
+        const int dj = (corner >> 1) & 1;
+        const int dk = corner & 1;
+
+        const float weight = (di ? fraction[0] : 1.0f - fraction[0]) *
+                             (dj ? fraction[1] : 1.0f - fraction[1]) *
+                             (dk ? fraction[2] : 1.0f - fraction[2]);
+
+        const float* values = base + di * strideI + dj * strideJ + dk * strideK;
+        for (int p = 0; p < kNumParameters; ++p) {
+            result[p] += weight * values[p];
+        }
+    }
+
+    return GenerationParameters(result[0], result[1], result[2]);
+}
+
+int EmotionLookupTable::getResolution() const {
+    return m_resolution;
+}
+
+size_t EmotionLookupTable::getMemoryUsage() const {
+    return m_values.size() * sizeof(float);
+}
+
+bool EmotionLookupTable::isBuilt() const {
+    return m_isBuilt;
+}
+
+void EmotionLookupTable::locate(int axis, float value, int& index, float& fraction) const {
+    const Axis& range = m_axes[axis];
+    const float span = range.maximum - range.minimum;
+
+    float position = (span != 0.0f) ? (value - range.minimum) / span : 0.0f;
+    position = std::max(0.0f, std::min(1.0f, position)) * (m_resolution - 1);
+
+    // Keep the upper corner inside the grid
+    index = std::min(static_cast<int>(position), m_resolution - 2);
+    fraction = position - index;
+}
+
+EmotionMapperModel::EmotionMapperModel(const std::string& modelPath, const ModelMetadata& metadata, int resolution)
+    : TensorFlowLiteModel(modelPath, metadata)
+    , m_resolution(resolution) {
+}
+
+EmotionMapperModel::~EmotionMapperModel() {
+}
+
+bool EmotionMapperModel::initialize() {
+    if (!TensorFlowLiteModel::initialize()) {
+        return false;
+    }
+
+    try {
+        auto table = std::make_shared<EmotionLookupTable>(
+            m_resolution,
+            std::array<EmotionLookupTable::Axis, 3>{{{-1.0f, 1.0f}, {-1.0f, 1.0f}, {0.0f, 1.0f}}});
+
+        // Evaluate the whole grid in one batched inference
+        const bool built = table->build([this](const float* inputs, size_t numPoints, float* outputs) {
+            std::vector<float> output = runInference(std::vector<float>(inputs, inputs + numPoints * 3));
+            if (output.size() != numPoints * EmotionLookupTable::kNumParameters) {
+                std::cerr << "Unexpected EmotionMapper output size: " << output.size() << std::endl;
+                return false;
+            }
+
+            std::copy(output.begin(), output.end(), outputs);
+            return true;
+        });
+
+        if (!built) {
+            std::cerr << "Failed to compile emotion lookup table" << std::endl;
+            return false;
+        }
+
+        m_table = table;
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error compiling emotion lookup table: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+std::shared_ptr<const EmotionLookupTable> EmotionMapperModel::getLookupTable() const {
+    return m_table;
+}
+
+size_t EmotionMapperModel::getCacheMemoryUsage() const {
+    return m_table ? m_table->getMemoryUsage() : 0;
+}
+
+GenerationParameters EmotionMapperModel::mapEmotion(float valence, float arousal, float intensity) const {
+    if (!m_table) {
+        return GenerationParameters();
+    }
+
+    return m_table->lookup(valence, arousal, intensity);
+}
+
+} // namespace lmms_magenta
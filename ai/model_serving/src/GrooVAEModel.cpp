@@ -2,179 +2,186 @@
 #include <iostream>
 #include <algorithm>
 #include <cmath>
+#include <filesystem>
 
 namespace lmms_magenta {
 
-GrooVAEModel::GrooVAEModel(const std::string& modelPath)
-    : TensorFlowLiteModel(modelPath)
-    , m_temperature(1.0f)
-    , m_humanize(0.5f) {
+namespace {
+
+// Embedding length used when the model has no groove library
+constexpr size_t kDefaultGrooveDimension = 256;
+
+// Delay off-beat eighths by up to a triplet eighth
+MidiSequence applySwing(MidiSequence sequence, float swingAmount) {
+    const int eighth = sequence.ticksPerQuarter / 2;
+    const int maxDelay = sequence.ticksPerQuarter / 6;
+    const int delay = static_cast<int>(std::lround(std::max(0.0f, std::min(1.0f, swingAmount)) * maxDelay));
+    if (delay == 0 || eighth == 0) {
+        return sequence;
+    }
+
+    for (auto& note : sequence.notes) {
+        if (note.startTime % sequence.ticksPerQuarter == eighth) {
+            note.startTime += delay;
+            note.duration = std::max(1, note.duration - delay);
+        }
+    }
+    return sequence;
+}
+
+} // namespace
+
+GrooVAEModel::GrooVAEModel(const std::string& modelPath, const ModelMetadata& metadata)
+    : TensorFlowLiteModel(modelPath, metadata)
+    , m_currentGrooveStyle(0) {
+    loadGroovePatterns(modelPath);
 }
 
 GrooVAEModel::~GrooVAEModel() {
 }
 
-bool GrooVAEModel::applyGroove(const std::vector<MidiNote>& inputNotes, 
-                             std::vector<MidiNote>& outputNotes) {
-    // Check if model is loaded
-    if (!isLoaded()) {
-        if (!load()) {
-            std::cerr << "Failed to load model" << std::endl;
-            return false;
+MidiSequence GrooVAEModel::applyGroove(const MidiSequence& sequence, 
+                                       float grooveAmount, 
+                                       float swingAmount) {
+    // Without a library the model humanizes towards no particular groove
+    std::vector<float> groove(getGrooveDimension(), 0.0f);
+    if (m_grooveLibrary.size() > 0) {
+        const float* embedding = m_grooveLibrary.getEmbedding(static_cast<uint32_t>(m_currentGrooveStyle));
+        if (embedding) {
+            groove.assign(embedding, embedding + groove.size());
         }
     }
-    
-    try {
-        // Convert MIDI notes to tensor representation
-        std::vector<float> inputTensor = MidiUtils::notesToTensor(inputNotes);
-        
-        // Set input tensor
-        if (!setInputTensor("input_sequence", inputTensor)) {
-            std::cerr << "Failed to set input tensor" << std::endl;
-            return false;
-        }
-        
-        // Set the temperature
-        if (!setInputTensor("temperature", {m_temperature})) {
-            std::cerr << "Failed to set temperature" << std::endl;
-            return false;
-        }
-        
-        // Set the humanize parameter
-        if (!setInputTensor("humanize", {m_humanize})) {
-            std::cerr << "Failed to set humanize parameter" << std::endl;
-            return false;
-        }
-        
-        // Run the model
-        if (!run()) {
-            std::cerr << "Failed to run model" << std::endl;
-            return false;
-        }
-        
-        // Get the output tensor
-        std::vector<float> outputTensor = getOutputTensor("output_sequence");
-        
-        // Convert tensor to MIDI notes
-        outputNotes = MidiUtils::tensorToNotes(outputTensor);
-        
-        return true;
+
+    MidiSequence grooved;
+    std::vector<float> embedding;
+    if (!runGroove(sequence, groove, grooved, embedding)) {
+        std::cerr << "Failed to apply groove" << std::endl;
+        return sequence;
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error applying groove: " << e.what() << std::endl;
-        return false;
+
+    return applySwing(blendGroove(sequence, grooved, grooveAmount), swingAmount);
+}
+
+std::vector<float> GrooVAEModel::extractGroove(const MidiSequence& sequence) {
+    MidiSequence grooved;
+    std::vector<float> embedding;
+    if (!runGroove(sequence, std::vector<float>(getGrooveDimension(), 0.0f), grooved, embedding)) {
+        std::cerr << "Failed to extract groove" << std::endl;
+        return std::vector<float>();
     }
+
+    return embedding;
 }
 
-bool GrooVAEModel::extractGroove(const std::vector<MidiNote>& notes, std::vector<float>& groove) {
-    // Check if model is loaded
-    if (!isLoaded()) {
-        if (!load()) {
-            std::cerr << "Failed to load model" << std::endl;
-            return false;
-        }
+MidiSequence GrooVAEModel::applyExtractedGroove(const MidiSequence& sequence, 
+                                                const std::vector<float>& groove,
+                                                float amount) {
+    if (groove.size() != getGrooveDimension()) {
+        std::cerr << "Groove has " << groove.size() << " values, expected " << getGrooveDimension() << std::endl;
+        return sequence;
     }
-    
-    try {
-        // Convert MIDI notes to tensor representation
-        std::vector<float> inputTensor = MidiUtils::notesToTensor(notes);
-        
-        // Set input tensor
-        if (!setInputTensor("input_sequence", inputTensor)) {
-            std::cerr << "Failed to set input tensor" << std::endl;
-            return false;
-        }
-        
-        // Run the model
-        if (!run()) {
-            std::cerr << "Failed to run model" << std::endl;
-            return false;
-        }
-        
-        // Get the groove vector from the output tensor
-        groove = getOutputTensor("groove_embedding");
-        
-        return true;
+
+    MidiSequence grooved;
+    std::vector<float> embedding;
+    if (!runGroove(sequence, groove, grooved, embedding)) {
+        std::cerr << "Failed to apply extracted groove" << std::endl;
+        return sequence;
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error extracting groove: " << e.what() << std::endl;
-        return false;
+
+    return blendGroove(sequence, grooved, amount);
+}
+
+std::vector<std::string> GrooVAEModel::getAvailableGrooveStyles() const {
+    std::vector<std::string> styles;
+    styles.reserve(m_grooveLibrary.size());
+    for (uint32_t id = 0; id < m_grooveLibrary.size(); ++id) {
+        styles.push_back(m_grooveLibrary.getName(id));
     }
+    return styles;
 }
 
-bool GrooVAEModel::applyGrooveVector(const std::vector<MidiNote>& inputNotes, 
-                                   const std::vector<float>& groove, 
-                                   std::vector<MidiNote>& outputNotes) {
-    // Check if model is loaded
-    if (!isLoaded()) {
-        if (!load()) {
-            std::cerr << "Failed to load model" << std::endl;
-            return false;
-        }
+void GrooVAEModel::setGrooveStyle(int styleIndex) {
+    if (styleIndex >= 0 && static_cast<size_t>(styleIndex) < m_grooveLibrary.size()) {
+        m_currentGrooveStyle = styleIndex;
     }
-    
+}
+
+int GrooVAEModel::getGrooveStyle() const {
+    return m_currentGrooveStyle;
+}
+
+const GrooveLibrary& GrooVAEModel::getGrooveLibrary() const {
+    return m_grooveLibrary;
+}
+
+size_t GrooVAEModel::getGrooveDimension() const {
+    return m_grooveLibrary.isOpen() ? m_grooveLibrary.getDimension() : kDefaultGrooveDimension;
+}
+
+void GrooVAEModel::loadGroovePatterns(const std::string& modelPath) {
+    // The library sits next to the model: drums.tflite -> drums.lmgroove
+    std::filesystem::path libraryPath(modelPath);
+    libraryPath.replace_extension(".lmgroove");
+
+    std::error_code error;
+    if (!std::filesystem::exists(libraryPath, error)) {
+        return;
+    }
+
+    // Only maps the file; grooves are paged in when first used
+    if (m_grooveLibrary.open(libraryPath.string())) {
+        std::cout << "Loaded groove library with " << m_grooveLibrary.size() << " grooves: "
+                  << libraryPath.string() << std::endl;
+    }
+}
+
+bool GrooVAEModel::runGroove(const MidiSequence& sequence, const std::vector<float>& groove,
+                             MidiSequence& grooved, std::vector<float>& embedding) {
+    // Check if model is initialized
+    if (!isInitialized()) {
+        std::cerr << "Model not initialized" << std::endl;
+        return false;
+    }
+
     try {
-        // Convert MIDI notes to tensor representation
-        std::vector<float> inputTensor = MidiUtils::notesToTensor(inputNotes);
-        
-        // Set input tensor
-        if (!setInputTensor("input_sequence", inputTensor)) {
-            std::cerr << "Failed to set input tensor" << std::endl;
-            return false;
-        }
-        
-        // Set the groove vector
-        if (!setInputTensor("groove_embedding", groove)) {
-            std::cerr << "Failed to set groove vector" << std::endl;
-            return false;
-        }
-        
-        // Set the temperature
-        if (!setInputTensor("temperature", {m_temperature})) {
-            std::cerr << "Failed to set temperature" << std::endl;
-            return false;
-        }
-        
-        // Set the humanize parameter
-        if (!setInputTensor("humanize", {m_humanize})) {
-            std::cerr << "Failed to set humanize parameter" << std::endl;
-            return false;
-        }
-        
-        // Run the model
-        if (!run()) {
-            std::cerr << "Failed to run model" << std::endl;
+        // One row: [note values | groove embedding]
+        std::vector<float> input = MidiUtils::sequenceToTensor(sequence);
+        const size_t noteValues = input.size();
+        input.insert(input.end(), groove.begin(), groove.end());
+
+        const std::vector<float> output = runInference(input);
+        if (output.size() != noteValues + groove.size()) {
+            std::cerr << "Unexpected GrooVAE output size: " << output.size() << std::endl;
             return false;
         }
-        
-        // Get the output tensor
-        std::vector<float> outputTensor = getOutputTensor("output_sequence");
-        
-        // Convert tensor to MIDI notes
-        outputNotes = MidiUtils::tensorToNotes(outputTensor);
-        
+
+        grooved = MidiUtils::tensorToSequence(std::vector<float>(output.begin(), output.begin() + noteValues),
+                                              sequence.ticksPerQuarter, sequence.totalTicks);
+        embedding.assign(output.begin() + noteValues, output.end());
         return true;
     }
     catch (const std::exception& e) {
-        std::cerr << "Error applying groove vector: " << e.what() << std::endl;
+        std::cerr << "Error running GrooVAE: " << e.what() << std::endl;
         return false;
     }
 }
 
-void GrooVAEModel::setTemperature(float temperature) {
-    m_temperature = std::max(0.0001f, std::min(2.0f, temperature));
-}
+MidiSequence GrooVAEModel::blendGroove(const MidiSequence& sequence, const MidiSequence& grooved, float amount) {
+    amount = std::max(0.0f, std::min(1.0f, amount));
 
-float GrooVAEModel::getTemperature() const {
-    return m_temperature;
-}
-
-void GrooVAEModel::setHumanize(float humanize) {
-    m_humanize = std::max(0.0f, std::min(1.0f, humanize));
-}
+    // Notes come back in input order, so they are matched by index
+    MidiSequence result = sequence;
+    const size_t count = std::min(result.notes.size(), grooved.notes.size());
+    for (size_t i = 0; i < count; ++i) {
+        MidiNote& note = result.notes[i];
+        const MidiNote& target = grooved.notes[i];
+        note.startTime += static_cast<int>(std::lround(amount * (target.startTime - note.startTime)));
+        note.velocity += static_cast<int>(std::lround(amount * (target.velocity - note.velocity)));
+        note.startTime = std::max(0, note.startTime);
+        note.velocity = std::max(1, std::min(127, note.velocity));
+    }
 
-float GrooVAEModel::getHumanize() const {
-    return m_humanize;
+    return result;
 }
 
 } // namespace lmms_magenta
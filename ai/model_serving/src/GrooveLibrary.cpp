@@ -0,0 +1,479 @@
+#include "GrooveLibrary.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <queue>
+#include <set>
+#include <string_view>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lmms_magenta {
+
+namespace {
+
+constexpr char kMagic[8] = {'L', 'M', 'G', 'R', 'O', 'O', 'V', 'E'};
+constexpr size_t kHeaderSize = 64;
+constexpr size_t kRecordSize = 16;
+constexpr size_t kPageSize = 4096;
+
+// Record fields: offset and length of the name, then of the tags
+constexpr size_t kNameField = 0;
+constexpr size_t kTagsField = 1;
+
+bool isLittleEndian() {
+    const uint16_t value = 1;
+    uint8_t firstByte;
+    std::memcpy(&firstByte, &value, 1);
+    return firstByte == 1;
+}
+
+uint32_t readU32(const uint8_t* in) {
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+uint64_t readU64(const uint8_t* in) {
+    return static_cast<uint64_t>(readU32(in)) | static_cast<uint64_t>(readU32(in + 4)) << 32;
+}
+
+void appendU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out += static_cast<char>(value >> (8 * i));
+    }
+}
+
+void appendU64(std::string& out, uint64_t value) {
+    appendU32(out, static_cast<uint32_t>(value));
+    appendU32(out, static_cast<uint32_t>(value >> 32));
+}
+
+void padTo(std::string& out, size_t alignment) {
+    out.append((alignment - out.size() % alignment) % alignment, '\0');
+}
+
+// Whether [offset, offset + length) lies inside a file of the given size
+bool isInFile(uint64_t offset, uint64_t length, uint64_t fileSize) {
+    return offset <= fileSize && length <= fileSize - offset;
+}
+
+float getSquaredDistance(const float* a, const float* b, uint32_t dimension) {
+    float distance = 0.0f;
+    for (uint32_t i = 0; i < dimension; ++i) {
+        const float difference = a[i] - b[i];
+        distance += difference * difference;
+    }
+    return distance;
+}
+
+} // namespace
+
+GrooveLibrary::GrooveLibrary()
+    : m_data(nullptr)
+    , m_size(0)
+    , m_dimension(0)
+    , m_count(0)
+    , m_embeddings(nullptr)
+    , m_records(nullptr)
+    , m_nameOrder(nullptr)
+    , m_strings(nullptr)
+    , m_stringsSize(0) {
+}
+
+GrooveLibrary::~GrooveLibrary() {
+    close();
+}
+
+bool GrooveLibrary::open(const std::string& filePath) {
+    close();
+
+    if (!isLittleEndian()) {
+        std::cerr << "Groove libraries are only supported on little-endian systems" << std::endl;
+        return false;
+    }
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Failed to open groove library: " << filePath << std::endl;
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    HANDLE mapping = nullptr;
+    if (GetFileSizeEx(file, &fileSize) && fileSize.QuadPart >= static_cast<LONGLONG>(kHeaderSize)) {
+        mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    }
+    if (mapping) {
+        m_data = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        m_size = static_cast<size_t>(fileSize.QuadPart);
+        CloseHandle(mapping);
+    }
+    CloseHandle(file);
+#else
+    const int file = ::open(filePath.c_str(), O_RDONLY);
+    if (file < 0) {
+        std::cerr << "Failed to open groove library: " << filePath << std::endl;
+        return false;
+    }
+    struct stat status;
+    if (fstat(file, &status) == 0 && status.st_size >= static_cast<off_t>(kHeaderSize)) {
+        void* data = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (data != MAP_FAILED) {
+            m_data = static_cast<const uint8_t*>(data);
+            m_size = static_cast<size_t>(status.st_size);
+        }
+    }
+    ::close(file);
+#endif
+
+    if (!m_data) {
+        std::cerr << "Failed to map groove library: " << filePath << std::endl;
+        m_size = 0;
+        return false;
+    }
+
+    if (!parseHeader()) {
+        std::cerr << "Invalid groove library: " << filePath << std::endl;
+        close();
+        return false;
+    }
+    return true;
+}
+
+void GrooveLibrary::close() {
+    if (m_data) {
+#ifdef _WIN32
+        UnmapViewOfFile(m_data);
+#else
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+    }
+
+    m_data = nullptr;
+    m_size = 0;
+    m_dimension = 0;
+    m_count = 0;
+    m_embeddings = nullptr;
+    m_records = nullptr;
+    m_nameOrder = nullptr;
+    m_strings = nullptr;
+    m_stringsSize = 0;
+}
+
+bool GrooveLibrary::isOpen() const {
+    return m_data != nullptr;
+}
+
+size_t GrooveLibrary::size() const {
+    return m_count;
+}
+
+uint32_t GrooveLibrary::getDimension() const {
+    return m_dimension;
+}
+
+const float* GrooveLibrary::getEmbedding(uint32_t id) const {
+    if (id >= m_count) {
+        return nullptr;
+    }
+    return m_embeddings + static_cast<size_t>(id) * m_dimension;
+}
+
+std::string GrooveLibrary::getName(uint32_t id) const {
+    const char* text;
+    size_t length;
+    if (!getString(id, kNameField, text, length)) {
+        return std::string();
+    }
+    return std::string(text, length);
+}
+
+std::vector<std::string> GrooveLibrary::getTags(uint32_t id) const {
+    std::vector<std::string> tags;
+    const char* text;
+    size_t length;
+    if (!getString(id, kTagsField, text, length)) {
+        return tags;
+    }
+
+    size_t start = 0;
+    while (start < length) {
+        const char* separator = static_cast<const char*>(std::memchr(text + start, ',', length - start));
+        const size_t end = separator ? static_cast<size_t>(separator - text) : length;
+        if (end > start) {
+            tags.emplace_back(text + start, end - start);
+        }
+        start = end + 1;
+    }
+    return tags;
+}
+
+uint32_t GrooveLibrary::findByName(const std::string& name) const {
+    const std::string_view key(name);
+
+    // Binary search of the ids sorted by name
+    size_t low = 0;
+    size_t high = m_count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        const uint32_t id = readU32(m_nameOrder + middle * sizeof(uint32_t));
+
+        const char* text;
+        size_t length;
+        if (!getString(id, kNameField, text, length)) {
+            return kInvalidId;
+        }
+
+        const int order = std::string_view(text, length).compare(key);
+        if (order == 0) {
+            return id;
+        }
+        if (order < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return kInvalidId;
+}
+
+std::vector<uint32_t> GrooveLibrary::findByTag(const std::string& tag) const {
+    std::vector<uint32_t> ids;
+    for (uint32_t id = 0; id < m_count; ++id) {
+        const auto tags = getTags(id);
+        if (std::find(tags.begin(), tags.end(), tag) != tags.end()) {
+            ids.push_back(id);
+        }
+    }
+    return ids;
+}
+
+std::vector<GrooveMatch> GrooveLibrary::findNearest(const float* embedding, size_t count) const {
+    std::vector<GrooveMatch> matches;
+    if (!embedding || count == 0) {
+        return matches;
+    }
+
+    // Keep the closest grooves in a max-heap while streaming the embeddings
+    const auto isCloser = [](const GrooveMatch& a, const GrooveMatch& b) {
+        return a.distance < b.distance || (a.distance == b.distance && a.id < b.id);
+    };
+    std::priority_queue<GrooveMatch, std::vector<GrooveMatch>, decltype(isCloser)> closest(isCloser);
+
+    for (uint32_t id = 0; id < m_count; ++id) {
+        const GrooveMatch match{id, getSquaredDistance(getEmbedding(id), embedding, m_dimension)};
+        if (closest.size() < count) {
+            closest.push(match);
+        } else if (isCloser(match, closest.top())) {
+            closest.pop();
+            closest.push(match);
+        }
+    }
+
+    matches.resize(closest.size());
+    for (size_t i = matches.size(); i > 0; --i) {
+        matches[i - 1] = closest.top();
+        closest.pop();
+    }
+    return matches;
+}
+
+void GrooveLibrary::prefetch(uint32_t firstId, size_t count) const {
+    if (firstId >= m_count || count == 0) {
+        return;
+    }
+#ifndef _WIN32
+    const size_t stride = static_cast<size_t>(m_dimension) * sizeof(float);
+    const size_t lastId = std::min<size_t>(m_count, static_cast<size_t>(firstId) + count);
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(getEmbedding(firstId));
+    const uintptr_t end = reinterpret_cast<uintptr_t>(m_embeddings) + lastId * stride;
+    const uintptr_t pageBegin = begin & ~static_cast<uintptr_t>(kPageSize - 1);
+    madvise(reinterpret_cast<void*>(pageBegin), end - pageBegin, MADV_WILLNEED);
+#endif
+}
+
+bool GrooveLibrary::write(const std::string& filePath, const std::vector<GrooveEntry>& entries) {
+    const uint32_t dimension = entries.empty() ? 0 : static_cast<uint32_t>(entries[0].embedding.size());
+    if (!entries.empty() && dimension == 0) {
+        std::cerr << "Groove embeddings must not be empty" << std::endl;
+        return false;
+    }
+    if (entries.size() >= kInvalidId) {
+        std::cerr << "Too many grooves: " << entries.size() << std::endl;
+        return false;
+    }
+
+    // Records and string table
+    std::string records;
+    std::string strings;
+    std::set<std::string> names;
+    for (const auto& entry : entries) {
+        if (entry.embedding.size() != dimension) {
+            std::cerr << "Groove " << entry.name << " has " << entry.embedding.size()
+                      << " values, expected " << dimension << std::endl;
+            return false;
+        }
+        if (entry.name.empty() || !names.insert(entry.name).second) {
+            std::cerr << "Groove names must be unique and not empty: " << entry.name << std::endl;
+            return false;
+        }
+
+        std::string tags;
+        for (const auto& tag : entry.tags) {
+            if (tag.find(',') != std::string::npos) {
+                std::cerr << "Groove tags must not contain commas: " << tag << std::endl;
+                return false;
+            }
+            tags += (tags.empty() ? "" : ",") + tag;
+        }
+
+        appendU32(records, static_cast<uint32_t>(strings.size()));
+        appendU32(records, static_cast<uint32_t>(entry.name.size()));
+        strings += entry.name;
+        appendU32(records, static_cast<uint32_t>(strings.size()));
+        appendU32(records, static_cast<uint32_t>(tags.size()));
+        strings += tags;
+
+        if (strings.size() > std::numeric_limits<uint32_t>::max()) {
+            std::cerr << "Groove library string table too large" << std::endl;
+            return false;
+        }
+    }
+
+    // Ids sorted by name
+    std::vector<uint32_t> order(entries.size());
+    for (uint32_t id = 0; id < order.size(); ++id) {
+        order[id] = id;
+    }
+    std::sort(order.begin(), order.end(), [&entries](uint32_t a, uint32_t b) {
+        return entries[a].name < entries[b].name;
+    });
+    std::string nameOrder;
+    for (uint32_t id : order) {
+        appendU32(nameOrder, id);
+    }
+
+    // Embeddings start on a page so the mapping pages them in groove by groove
+    const uint64_t embeddingsOffset = kPageSize;
+    const uint64_t embeddingsSize = static_cast<uint64_t>(entries.size()) * dimension * sizeof(float);
+    const uint64_t recordsOffset = embeddingsOffset + embeddingsSize;
+    const uint64_t nameOrderOffset = recordsOffset + records.size();
+    const uint64_t stringsOffset = nameOrderOffset + nameOrder.size();
+
+    std::string header(kMagic, sizeof(kMagic));
+    appendU32(header, kVersion);
+    appendU32(header, dimension);
+    appendU32(header, static_cast<uint32_t>(entries.size()));
+    appendU32(header, 0);
+    appendU64(header, embeddingsOffset);
+    appendU64(header, recordsOffset);
+    appendU64(header, nameOrderOffset);
+    appendU64(header, stringsOffset);
+    appendU64(header, strings.size());
+    padTo(header, kPageSize);
+
+    const std::string temporaryPath = filePath + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to write groove library: " << filePath << std::endl;
+            return false;
+        }
+
+        file.write(header.data(), static_cast<std::streamsize>(header.size()));
+        for (const auto& entry : entries) {
+            std::string values;
+            values.reserve(entry.embedding.size() * sizeof(float));
+            for (float value : entry.embedding) {
+                uint32_t bits;
+                std::memcpy(&bits, &value, sizeof(bits));
+                appendU32(values, bits);
+            }
+            file.write(values.data(), static_cast<std::streamsize>(values.size()));
+        }
+        file.write(records.data(), static_cast<std::streamsize>(records.size()));
+        file.write(nameOrder.data(), static_cast<std::streamsize>(nameOrder.size()));
+        file.write(strings.data(), static_cast<std::streamsize>(strings.size()));
+
+        if (!file) {
+            std::cerr << "Failed to write groove library: " << filePath << std::endl;
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, filePath, error);
+    if (error) {
+        std::cerr << "Failed to replace groove library: " << filePath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+bool GrooveLibrary::parseHeader() {
+    if (m_size < kHeaderSize || std::memcmp(m_data, kMagic, sizeof(kMagic)) != 0 ||
+        readU32(m_data + 8) != kVersion) {
+        return false;
+    }
+
+    const uint32_t dimension = readU32(m_data + 12);
+    const uint32_t count = readU32(m_data + 16);
+    const uint64_t embeddingsOffset = readU64(m_data + 24);
+    const uint64_t recordsOffset = readU64(m_data + 32);
+    const uint64_t nameOrderOffset = readU64(m_data + 40);
+    const uint64_t stringsOffset = readU64(m_data + 48);
+    const uint64_t stringsSize = readU64(m_data + 56);
+
+    if ((count > 0 && dimension == 0) || count == kInvalidId || embeddingsOffset % sizeof(float) != 0) {
+        return false;
+    }
+
+    // Every section must lie inside the file
+    const uint64_t embeddingsSize = static_cast<uint64_t>(count) * dimension * sizeof(float);
+    if (!isInFile(embeddingsOffset, embeddingsSize, m_size) ||
+        !isInFile(recordsOffset, static_cast<uint64_t>(count) * kRecordSize, m_size) ||
+        !isInFile(nameOrderOffset, static_cast<uint64_t>(count) * sizeof(uint32_t), m_size) ||
+        !isInFile(stringsOffset, stringsSize, m_size)) {
+        return false;
+    }
+
+    m_dimension = dimension;
+    m_count = count;
+    m_embeddings = reinterpret_cast<const float*>(m_data + embeddingsOffset);
+    m_records = m_data + recordsOffset;
+    m_nameOrder = m_data + nameOrderOffset;
+    m_strings = reinterpret_cast<const char*>(m_data + stringsOffset);
+    m_stringsSize = stringsSize;
+    return true;
+}
+
+bool GrooveLibrary::getString(uint32_t id, size_t field, const char*& text, size_t& length) const {
+    if (id >= m_count) {
+        return false;
+    }
+
+    const uint8_t* record = m_records + static_cast<size_t>(id) * kRecordSize + field * 2 * sizeof(uint32_t);
+    const uint32_t offset = readU32(record);
+    length = readU32(record + sizeof(uint32_t));
+    if (!isInFile(offset, length, m_stringsSize)) {
+        return false;
+    }
+
+    text = m_strings + offset;
+    return true;
+}
+
+} // namespace lmms_magenta
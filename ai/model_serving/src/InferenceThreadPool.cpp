@@ -0,0 +1,154 @@
+#include "InferenceThreadPool.h"
+#include "../../utils/include/ThreadPolicy.h"
+#include "tensorflow/lite/external_cpu_backend_context.h"
+#include "tensorflow/lite/kernels/cpu_backend_context.h"
+#include <algorithm>
+#include <iostream>
+
+namespace lmms_magenta {
+
+namespace {
+
+// Set on the inference threads so nested tasks run inline
+thread_local bool t_isInferenceThread = false;
+
+// Private context of an inference thread
+thread_local tflite::ExternalCpuBackendContext* t_threadContext = nullptr;
+
+// Context of the task running on this thread
+thread_local tflite::ExternalCpuBackendContext* t_currentContext = nullptr;
+
+// CPU time inference threads spent on tasks submitted by this thread
+thread_local double t_delegatedCpuSeconds = 0.0;
+
+std::unique_ptr<tflite::ExternalCpuBackendContext> createContext(int numThreads) {
+    // Kernel threads are spawned lazily by the first inference using the
+    // context, so they inherit the policy of an inference thread
+    auto internal = std::make_unique<tflite::CpuBackendContext>();
+    internal->SetMaxNumThreads(numThreads);
+
+    auto context = std::make_unique<tflite::ExternalCpuBackendContext>();
+    context->set_internal_backend_context(std::move(internal));
+    return context;
+}
+
+} // namespace
+
+InferenceThreadPool& InferenceThreadPool::getInstance() {
+    static InferenceThreadPool instance;
+    return instance;
+}
+
+InferenceThreadPool::InferenceThreadPool()
+    : m_numRunning(0) {
+    configure(CoreConfig::getInstance().getInferenceThreading());
+}
+
+InferenceThreadPool::~InferenceThreadPool() {
+    // Join the inference threads before the contexts their kernels use
+    m_executor.reset();
+}
+
+void InferenceThreadPool::configure(const InferenceThreadingConfig& config) {
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+
+    m_config = config;
+    m_cores = ThreadPolicy::selectCores(config);
+
+    // Finish queued inferences on the old threads before replacing them
+    m_executor.reset();
+    m_threadContexts.clear();
+
+    // A fresh shared context makes its kernel threads inherit the new policy
+    m_sharedContext = createContext(static_cast<int>(m_cores.size()));
+
+    // At least two threads, so one long inference cannot hold up all others
+    const size_t numThreads = std::max<size_t>(kMinThreads, m_cores.size());
+    m_executor = std::make_unique<ThreadPool>(numThreads, [this, config, cores = m_cores]() {
+        t_isInferenceThread = true;
+        ThreadPolicy::applyToCurrentThread(config, cores);
+        LMMS_MAGENTA_TRACE_THREAD_NAME("inference");
+        initializeThread();
+    });
+
+    std::cout << "Inference threads: " << numThreads << " on " << m_cores.size() << " core(s)"
+              << (config.pinThreads ? ", pinned" : "") << std::endl;
+}
+
+int InferenceThreadPool::getNumThreads() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return static_cast<int>(m_cores.size());
+}
+
+std::vector<int> InferenceThreadPool::getCores() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+    return m_cores;
+}
+
+TfLiteExternalContext* InferenceThreadPool::getCurrentCpuBackendContext() {
+    return t_currentContext;
+}
+
+double InferenceThreadPool::getDelegatedCpuSeconds() {
+    return t_delegatedCpuSeconds;
+}
+
+void InferenceThreadPool::initializeThread() {
+    auto context = createContext(1);
+    t_threadContext = context.get();
+
+    std::lock_guard<std::mutex> lock(m_threadContextsMutex);
+    m_threadContexts.push_back(std::move(context));
+}
+
+bool InferenceThreadPool::isInferenceThread() {
+    return t_isInferenceThread;
+}
+
+InferenceThreadPool::ContextLease::ContextLease(InferenceThreadPool& pool, int numThreads)
+    : m_pool(pool)
+    , m_isShared(pool.m_sharedContextMutex.try_lock()) {
+    const int numRunning = ++m_pool.m_numRunning;
+
+    if (!m_isShared) {
+        t_currentContext = t_threadContext;
+        return;
+    }
+
+    // Leave one core to each other running inference
+    const int available = std::max(1, static_cast<int>(m_pool.m_cores.size()) - (numRunning - 1));
+    const int threads = numThreads > 0 ? std::min(numThreads, available) : available;
+
+    auto* context = static_cast<tflite::CpuBackendContext*>(m_pool.m_sharedContext->internal_backend_context());
+    if (context && context->max_num_threads() != threads) {
+        context->SetMaxNumThreads(threads);
+    }
+    t_currentContext = m_pool.m_sharedContext.get();
+}
+
+InferenceThreadPool::ContextLease::~ContextLease() {
+    t_currentContext = nullptr;
+    --m_pool.m_numRunning;
+    if (m_isShared) {
+        m_pool.m_sharedContextMutex.unlock();
+    }
+}
+
+InferenceThreadPool::DelegatedCpuTime::~DelegatedCpuTime() {
+    // Runs on the submitting thread after the task finished
+    t_delegatedCpuSeconds += m_seconds;
+}
+
+InferenceThreadPool::DelegatedCpuTime::Measurement::Measurement(DelegatedCpuTime& cpuTime)
+    : m_cpuTime(cpuTime)
+    , m_startSeconds(ThreadPolicy::getThreadCpuSeconds()) {
+}
+
+InferenceThreadPool::DelegatedCpuTime::Measurement::~Measurement() {
+    const double endSeconds = ThreadPolicy::getThreadCpuSeconds();
+    if (m_startSeconds >= 0.0 && endSeconds >= m_startSeconds) {
+        m_cpuTime.m_seconds = endSeconds - m_startSeconds;
+    }
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,445 @@
+#include "MelodyRNNModel.h"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+namespace lmms_magenta {
+
+namespace {
+
+// Default flattened LSTM state size (2 layers x 128 units)
+constexpr int kDefaultStateSize = 256;
+
+} // namespace
+
+MelodyRNNModel::MelodyRNNModel(const std::string& modelPath, const ModelMetadata& metadata)
+    : TensorFlowLiteModel(modelPath, metadata)
+    , m_stateSize(kDefaultStateSize)
+    , m_stepsPerQuarter(4)
+    , m_ticksPerQuarter(480)
+    , m_primerCacheCapacity(64)
+    , m_rng(std::random_device{}()) {
+    m_state = initialState();
+}
+
+MelodyRNNModel::~MelodyRNNModel() {
+}
+
+bool MelodyRNNModel::initialize() {
+    if (!TensorFlowLiteModel::initialize()) {
+        return false;
+    }
+
+    // Derive the state size from the input row: [events | hidden | cell]
+    std::vector<int> inputShape = getInputShape();
+    if (!inputShape.empty()) {
+        const int rowSize = inputShape.back();
+        if (rowSize > getNumEvents() && (rowSize - getNumEvents()) % 2 == 0) {
+            m_stateSize = (rowSize - getNumEvents()) / 2;
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state = initialState();
+    return true;
+}
+
+bool MelodyRNNModel::primeWithSequence(const MidiSequence& primer) {
+    // Check if model is initialized
+    if (!isInitialized()) {
+        std::cerr << "Model not initialized" << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MelodyRNNState state;
+    if (!primedState(primer, state)) {
+        return false;
+    }
+
+    // Notes of the primer belong to the caller; only generated notes are held
+    state.heldPitch = -1;
+
+    m_state = state;
+    m_ticksPerQuarter = primer.ticksPerQuarter;
+    return true;
+}
+
+MidiSequence MelodyRNNModel::continueMelody(int numSteps, float temperature) {
+    // Check if model is initialized
+    if (!isInitialized()) {
+        std::cerr << "Model not initialized" << std::endl;
+        return MidiSequence();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The first generated event follows the pending one
+    const int startStep = m_state.step + 1;
+    std::vector<int> events;
+    events.reserve(numSteps);
+
+    std::vector<MelodyRNNState*> states = {&m_state};
+    std::vector<float> logits;
+
+    // Only the new steps are computed; earlier context lives in m_state
+    for (int i = 0; i < numSteps; ++i) {
+        if (!step(states, logits)) {
+            std::cerr << "Failed to continue melody" << std::endl;
+            break;
+        }
+
+        const int event = sampleEvent(logits.data(), temperature);
+        m_state.pendingEvent = event;
+        events.push_back(event);
+    }
+
+    // A note held at the end is finished by the next continuation
+    return eventsToSequence(events, startStep, m_ticksPerQuarter, m_state.heldPitch, m_state.heldStartStep);
+}
+
+std::vector<MidiSequence> MelodyRNNModel::continueMany(const MidiSequence& primer,
+                                                      int numCandidates,
+                                                      int numSteps,
+                                                      float temperature) {
+    std::vector<MidiSequence> results;
+
+    // Check if model is initialized
+    if (!isInitialized()) {
+        std::cerr << "Model not initialized" << std::endl;
+        return results;
+    }
+
+    if (numCandidates <= 0) {
+        return results;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    MelodyRNNState primed;
+    if (!primedState(primer, primed)) {
+        return results;
+    }
+
+    // All candidates start from the same primed state
+    std::vector<MelodyRNNState> candidates(numCandidates, primed);
+    std::vector<MelodyRNNState*> states;
+    states.reserve(numCandidates);
+    for (auto& candidate : candidates) {
+        states.push_back(&candidate);
+    }
+
+    std::vector<std::vector<int>> events(numCandidates);
+    for (auto& candidateEvents : events) {
+        candidateEvents.reserve(numSteps);
+    }
+
+    // One batched inference per step for all candidates
+    std::vector<float> logits;
+    for (int i = 0; i < numSteps; ++i) {
+        if (!step(states, logits)) {
+            std::cerr << "Failed to continue melody candidates" << std::endl;
+            break;
+        }
+
+        for (int c = 0; c < numCandidates; ++c) {
+            const int event = sampleEvent(&logits[static_cast<size_t>(c) * getNumEvents()], temperature);
+            candidates[c].pendingEvent = event;
+            events[c].push_back(event);
+        }
+    }
+
+    results.reserve(numCandidates);
+    for (const auto& candidateEvents : events) {
+        results.push_back(eventsToSequence(candidateEvents, primed.step + 1, primer.ticksPerQuarter));
+    }
+
+    return results;
+}
+
+void MelodyRNNModel::resetState() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_state = initialState();
+}
+
+MelodyRNNState MelodyRNNModel::getState() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_state;
+}
+
+bool MelodyRNNModel::setState(const MelodyRNNState& state) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // initialize() may resize the state while we check it
+    if (static_cast<int>(state.hidden.size()) != m_stateSize ||
+        static_cast<int>(state.cell.size()) != m_stateSize ||
+        state.pendingEvent < 0 || state.pendingEvent >= getNumEvents()) {
+        std::cerr << "State does not match model dimensions" << std::endl;
+        return false;
+    }
+
+    m_state = state;
+    return true;
+}
+
+void MelodyRNNModel::setPrimerCacheCapacity(size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_primerCacheCapacity = capacity;
+
+    // Evict least recently used entries
+    while (m_primerCacheOrder.size() > m_primerCacheCapacity) {
+        m_primerCache.erase(m_primerCacheOrder.back().first);
+        m_primerCacheOrder.pop_back();
+    }
+}
+
+size_t MelodyRNNModel::getPrimerCacheSize() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_primerCache.size();
+}
+
+size_t MelodyRNNModel::getCacheMemoryUsage() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto stateBytes = [](const MelodyRNNState& state) {
+        return sizeof(MelodyRNNState) + (state.hidden.capacity() + state.cell.capacity()) * sizeof(float);
+    };
+
+    size_t bytes = stateBytes(m_state);
+    for (const auto& entry : m_primerCacheOrder) {
+        bytes += stateBytes(entry.second);
+    }
+    return bytes;
+}
+
+void MelodyRNNModel::clearPrimerCache() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_primerCache.clear();
+    m_primerCacheOrder.clear();
+}
+
+int MelodyRNNModel::getStepsPerBar() const {
+    return m_stepsPerQuarter * 4;
+}
+
+int MelodyRNNModel::getNumEvents() const {
+    return 2 + (kMaxPitch - kMinPitch + 1);
+}
+
+std::vector<int> MelodyRNNModel::sequenceToEvents(const MidiSequence& sequence) const {
+    const int ticksPerStep = std::max(1, sequence.ticksPerQuarter / m_stepsPerQuarter);
+    const int numSteps = std::max(1, (sequence.totalTicks + ticksPerStep - 1) / ticksPerStep);
+
+    std::vector<int> events(numSteps, kNoEvent);
+
+    // Sort notes by start time so later notes cut earlier ones
+    std::vector<MidiNote> notes = sequence.notes;
+    std::sort(notes.begin(), notes.end(),
+              [](const MidiNote& a, const MidiNote& b) {
+                  return a.startTime < b.startTime;
+              });
+
+    for (const auto& note : notes) {
+        const int startStep = (note.startTime + ticksPerStep / 2) / ticksPerStep;
+        const int endStep = (note.startTime + note.duration + ticksPerStep / 2) / ticksPerStep;
+        if (startStep >= numSteps) {
+            continue;
+        }
+
+        const int pitch = std::max(kMinPitch, std::min(kMaxPitch, note.pitch));
+        events[startStep] = 2 + (pitch - kMinPitch);
+
+        if (endStep > startStep && endStep < numSteps && events[endStep] == kNoEvent) {
+            events[endStep] = kNoteOff;
+        }
+    }
+
+    return events;
+}
+
+MidiSequence MelodyRNNModel::eventsToSequence(const std::vector<int>& events,
+                                              int startStep,
+                                              int ticksPerQuarter) const {
+    int heldPitch = -1;
+    int heldStartStep = startStep;
+    MidiSequence sequence = eventsToSequence(events, startStep, ticksPerQuarter, heldPitch, heldStartStep);
+
+    // A standalone melody ends with its events
+    if (heldPitch >= 0) {
+        const int ticksPerStep = std::max(1, ticksPerQuarter / m_stepsPerQuarter);
+        const int endStep = startStep + static_cast<int>(events.size());
+        if (endStep > heldStartStep) {
+            sequence.notes.emplace_back(heldPitch, 100, heldStartStep * ticksPerStep,
+                                        (endStep - heldStartStep) * ticksPerStep);
+        }
+    }
+
+    return sequence;
+}
+
+MidiSequence MelodyRNNModel::eventsToSequence(const std::vector<int>& events,
+                                              int startStep,
+                                              int ticksPerQuarter,
+                                              int& heldPitch,
+                                              int& heldStartStep) const {
+    const int ticksPerStep = std::max(1, ticksPerQuarter / m_stepsPerQuarter);
+    const int numSteps = static_cast<int>(events.size());
+
+    MidiSequence sequence(ticksPerQuarter, numSteps * ticksPerStep);
+
+    // Steps are absolute here, so a held note keeps its start
+    auto closeNote = [&](int endStep) {
+        if (heldPitch >= 0 && endStep > heldStartStep) {
+            sequence.notes.emplace_back(heldPitch, 100,
+                                        heldStartStep * ticksPerStep,
+                                        (endStep - heldStartStep) * ticksPerStep);
+        }
+        heldPitch = -1;
+    };
+
+    for (int i = 0; i < numSteps; ++i) {
+        const int event = events[i];
+        if (event == kNoteOff) {
+            closeNote(startStep + i);
+        } else if (event >= 2) {
+            closeNote(startStep + i);
+            heldPitch = kMinPitch + (event - 2);
+            heldStartStep = startStep + i;
+        }
+    }
+
+    return sequence;
+}
+
+uint64_t MelodyRNNModel::hashPrimer(const MidiSequence& primer) {
+    // FNV-1a over the fields that affect the event encoding
+    uint64_t hash = 14695981039346656037ULL;
+    auto mix = [&hash](int64_t value) {
+        for (int i = 0; i < 8; ++i) {
+            hash ^= static_cast<uint64_t>((value >> (i * 8)) & 0xff);
+            hash *= 1099511628211ULL;
+        }
+    };
+
+    mix(primer.ticksPerQuarter);
+    mix(primer.totalTicks);
+    for (const auto& note : primer.notes) {
+        mix(note.pitch);
+        mix(note.startTime);
+        mix(note.duration);
+    }
+
+    return hash;
+}
+
+bool MelodyRNNModel::primedState(const MidiSequence& primer, MelodyRNNState& state) {
+    const uint64_t hash = hashPrimer(primer);
+
+    // Reuse a cached state if this primer has been seen before
+    auto cached = m_primerCache.find(hash);
+    if (cached != m_primerCache.end()) {
+        m_primerCacheOrder.splice(m_primerCacheOrder.begin(), m_primerCacheOrder, cached->second);
+        state = cached->second->second;
+        return true;
+    }
+
+    std::vector<int> events = sequenceToEvents(primer);
+
+    // Feed all but the last event; the last one stays pending
+    state = initialState();
+    std::vector<MelodyRNNState*> states = {&state};
+    std::vector<float> logits;
+
+    for (size_t i = 0; i < events.size(); ++i) {
+        state.pendingEvent = events[i];
+        if (i + 1 == events.size()) {
+            break;
+        }
+        if (!step(states, logits)) {
+            std::cerr << "Failed to prime melody" << std::endl;
+            return false;
+        }
+    }
+
+    // Cache the primed state
+    if (m_primerCacheCapacity > 0) {
+        m_primerCacheOrder.emplace_front(hash, state);
+        m_primerCache[hash] = m_primerCacheOrder.begin();
+
+        while (m_primerCacheOrder.size() > m_primerCacheCapacity) {
+            m_primerCache.erase(m_primerCacheOrder.back().first);
+            m_primerCacheOrder.pop_back();
+        }
+    }
+
+    return true;
+}
+
+bool MelodyRNNModel::step(std::vector<MelodyRNNState*>& states, std::vector<float>& logits) {
+    const int numEvents = getNumEvents();
+    const size_t rowSize = static_cast<size_t>(numEvents) + 2 * m_stateSize;
+    const size_t batchSize = states.size();
+
+    try {
+        // Build one input row per state: [pending event one-hot | hidden | cell]
+        std::vector<float> input(batchSize * rowSize, 0.0f);
+        for (size_t b = 0; b < batchSize; ++b) {
+            float* row = &input[b * rowSize];
+            row[states[b]->pendingEvent] = 1.0f;
+            std::copy(states[b]->hidden.begin(), states[b]->hidden.end(), row + numEvents);
+            std::copy(states[b]->cell.begin(), states[b]->cell.end(), row + numEvents + m_stateSize);
+        }
+
+        std::vector<float> output = runInference(input);
+        if (output.size() != batchSize * rowSize) {
+            std::cerr << "Unexpected MelodyRNN output size: " << output.size() << std::endl;
+            return false;
+        }
+
+        // Split the output back into logits and updated states
+        logits.resize(batchSize * numEvents);
+        for (size_t b = 0; b < batchSize; ++b) {
+            const float* row = &output[b * rowSize];
+            std::copy(row, row + numEvents, &logits[b * numEvents]);
+            std::copy(row + numEvents, row + numEvents + m_stateSize, states[b]->hidden.begin());
+            std::copy(row + numEvents + m_stateSize, row + rowSize, states[b]->cell.begin());
+            ++states[b]->step;
+        }
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error running MelodyRNN step: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+int MelodyRNNModel::sampleEvent(const float* logits, float temperature) {
+    const int numEvents = getNumEvents();
+    temperature = std::max(0.0001f, temperature);
+
+    // Softmax with temperature
+    const float maxLogit = *std::max_element(logits, logits + numEvents);
+    std::vector<double> probabilities(numEvents);
+    for (int i = 0; i < numEvents; ++i) {
+        probabilities[i] = std::exp((logits[i] - maxLogit) / temperature);
+    }
+
+    std::discrete_distribution<int> dist(probabilities.begin(), probabilities.end());
+    return dist(m_rng);
+}
+
+MelodyRNNState MelodyRNNModel::initialState() const {
+    MelodyRNNState state;
+    state.hidden.assign(m_stateSize, 0.0f);
+    state.cell.assign(m_stateSize, 0.0f);
+    state.pendingEvent = kNoEvent;
+    state.step = 0;
+    state.heldPitch = -1;
+    state.heldStartStep = 0;
+    return state;
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,338 @@
+#include "MetricsRegistry.h"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace lmms_magenta {
+
+const char* const MetricsRegistry::kQueueWaitSeconds = "lmms_magenta_queue_wait_seconds";
+const char* const MetricsRegistry::kInferenceSeconds = "lmms_magenta_inference_seconds";
+const char* const MetricsRegistry::kRequestSeconds = "lmms_magenta_request_seconds";
+const char* const MetricsRegistry::kCacheHits = "lmms_magenta_model_cache_hits_total";
+const char* const MetricsRegistry::kCacheMisses = "lmms_magenta_model_cache_misses_total";
+const char* const MetricsRegistry::kModelLoads = "lmms_magenta_model_loads_total";
+const char* const MetricsRegistry::kModelLoadFailures = "lmms_magenta_model_load_failures_total";
+const char* const MetricsRegistry::kModelEvictions = "lmms_magenta_model_evictions_total";
+const char* const MetricsRegistry::kJobsRejected = "lmms_magenta_jobs_rejected_total";
+const char* const MetricsRegistry::kModelEventsDropped = "lmms_magenta_model_events_dropped_total";
+
+namespace {
+
+int floorLog2(uint64_t value) {
+    int result = 0;
+    while (value >>= 1) {
+        ++result;
+    }
+    return result;
+}
+
+// Format a label set, e.g. {model="musicvae/default"}
+std::string formatLabels(const std::string& labelName, const std::string& labelValue,
+                         const char* extraName = nullptr, const std::string& extraValue = "") {
+    std::string labels;
+    auto append = [&labels](const std::string& name, const std::string& value) {
+        labels += labels.empty() ? "{" : ",";
+        labels += name + "=\"";
+        for (char c : value) {
+            if (c == '"' || c == '\\') {
+                labels += '\\';
+            }
+            labels += c == '\n' ? 'n' : c;
+        }
+        labels += "\"";
+    };
+
+    if (!labelName.empty()) {
+        append(labelName, labelValue);
+    }
+    if (extraName) {
+        append(extraName, extraValue);
+    }
+    return labels.empty() ? labels : labels + "}";
+}
+
+std::string formatNumber(double value) {
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.9g", value);
+    return buffer;
+}
+
+} // namespace
+
+LatencyHistogram::LatencyHistogram()
+    : m_sum(0), m_min(UINT64_MAX), m_max(0) {
+    for (auto& bucket : m_buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::getBucketIndex(uint64_t value) {
+    value = std::min(value, kMaxValue);
+    if (value < (uint64_t(1) << kSubBucketBits)) {
+        return static_cast<size_t>(value);
+    }
+
+    // Keep the top kSubBucketBits bits; the shift selects the power-of-two range
+    const int shift = floorLog2(value) - (kSubBucketBits - 1);
+    return static_cast<size_t>(shift) * kHalfSubBuckets + static_cast<size_t>(value >> shift);
+}
+
+uint64_t LatencyHistogram::getBucketUpperBound(size_t index) {
+    if (index < (size_t(1) << kSubBucketBits)) {
+        return index;
+    }
+
+    const size_t shift = index / kHalfSubBuckets - 1;
+    const uint64_t subBucket = index - shift * kHalfSubBuckets;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds) {
+    nanoseconds = std::min(nanoseconds, kMaxValue);
+
+    m_buckets[getBucketIndex(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+    uint64_t current = m_min.load(std::memory_order_relaxed);
+    while (nanoseconds < current && !m_min.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {
+    }
+    current = m_max.load(std::memory_order_relaxed);
+    while (nanoseconds > current && !m_max.compare_exchange_weak(current, nanoseconds, std::memory_order_relaxed)) {
+    }
+}
+
+HistogramSnapshot LatencyHistogram::snapshot() const {
+    // Buckets are read one by one while writers continue, so the total is
+    // taken from the buckets themselves to keep the percentiles consistent
+    std::vector<uint64_t> counts(kBucketCount);
+    uint64_t total = 0;
+    for (size_t i = 0; i < kBucketCount; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    HistogramSnapshot snapshot;
+    snapshot.count = total;
+    if (total == 0) {
+        return snapshot;
+    }
+
+    snapshot.sum = static_cast<double>(m_sum.load(std::memory_order_relaxed)) * 1e-9;
+    snapshot.min = static_cast<double>(m_min.load(std::memory_order_relaxed)) * 1e-9;
+    snapshot.max = static_cast<double>(m_max.load(std::memory_order_relaxed)) * 1e-9;
+
+    // Report each percentile as the upper bound of its bucket, capped by the maximum
+    const double percentiles[] = {0.5, 0.9, 0.99, 0.999};
+    double* results[] = {&snapshot.p50, &snapshot.p90, &snapshot.p99, &snapshot.p999};
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kBucketCount && next < 4; ++i) {
+        seen += counts[i];
+        while (next < 4 && seen > 0 && seen >= static_cast<uint64_t>(percentiles[next] * total + 0.5)) {
+            *results[next] = std::min(static_cast<double>(getBucketUpperBound(i)) * 1e-9, snapshot.max);
+            ++next;
+        }
+    }
+    return snapshot;
+}
+
+const HistogramSnapshot* MetricsSnapshot::findHistogram(const std::string& name, const std::string& labelValue) const {
+    for (const auto& histogram : histograms) {
+        if (histogram.name == name && histogram.labelValue == labelValue) {
+            return &histogram.values;
+        }
+    }
+    return nullptr;
+}
+
+uint64_t MetricsSnapshot::getCounter(const std::string& name, const std::string& labelValue) const {
+    for (const auto& counter : counters) {
+        if (counter.name == name && counter.labelValue == labelValue) {
+            return counter.value;
+        }
+    }
+    return 0;
+}
+
+MetricsRegistry::MetricsRegistry()
+    : m_isDumpStopping(false) {
+}
+
+MetricsRegistry::~MetricsRegistry() {
+    stopPeriodicDump();
+}
+
+LatencyHistogram& MetricsRegistry::getHistogram(const std::string& name, const std::string& labelName,
+                                                const std::string& labelValue) {
+    MetricKey key(name, labelName, labelValue);
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_histograms.find(key);
+        if (it != m_histograms.end()) {
+            return *it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto& histogram = m_histograms[key];
+    if (!histogram) {
+        histogram = std::make_unique<LatencyHistogram>();
+    }
+    return *histogram;
+}
+
+MetricCounter& MetricsRegistry::getCounter(const std::string& name, const std::string& labelName,
+                                           const std::string& labelValue) {
+    MetricKey key(name, labelName, labelValue);
+    {
+        std::shared_lock<std::shared_mutex> lock(m_mutex);
+        auto it = m_counters.find(key);
+        if (it != m_counters.end()) {
+            return *it->second;
+        }
+    }
+
+    std::unique_lock<std::shared_mutex> lock(m_mutex);
+    auto& counter = m_counters[key];
+    if (!counter) {
+        counter = std::make_unique<MetricCounter>();
+    }
+    return *counter;
+}
+
+MetricsSnapshot MetricsRegistry::snapshot() const {
+    std::shared_lock<std::shared_mutex> lock(m_mutex);
+
+    MetricsSnapshot snapshot;
+    snapshot.histograms.reserve(m_histograms.size());
+    for (const auto& entry : m_histograms) {
+        snapshot.histograms.push_back({std::get<0>(entry.first), std::get<1>(entry.first),
+                                       std::get<2>(entry.first), entry.second->snapshot()});
+    }
+
+    snapshot.counters.reserve(m_counters.size());
+    for (const auto& entry : m_counters) {
+        snapshot.counters.push_back({std::get<0>(entry.first), std::get<1>(entry.first),
+                                     std::get<2>(entry.first), entry.second->get()});
+    }
+    return snapshot;
+}
+
+std::string MetricsRegistry::format(const MetricsSnapshot& snapshot, MetricsFormat format) {
+    std::ostringstream out;
+
+    if (format == MetricsFormat::Text) {
+        for (const auto& histogram : snapshot.histograms) {
+            const HistogramSnapshot& v = histogram.values;
+            out << histogram.name << formatLabels(histogram.labelName, histogram.labelValue)
+                << " count=" << v.count
+                << " mean_ms=" << formatNumber(v.count ? v.sum / v.count * 1e3 : 0.0)
+                << " p50_ms=" << formatNumber(v.p50 * 1e3)
+                << " p90_ms=" << formatNumber(v.p90 * 1e3)
+                << " p99_ms=" << formatNumber(v.p99 * 1e3)
+                << " p999_ms=" << formatNumber(v.p999 * 1e3)
+                << " max_ms=" << formatNumber(v.max * 1e3) << "\n";
+        }
+        for (const auto& counter : snapshot.counters) {
+            out << counter.name << formatLabels(counter.labelName, counter.labelValue)
+                << " " << counter.value << "\n";
+        }
+        return out.str();
+    }
+
+    // Prometheus: histograms are exported as summaries with fixed quantiles
+    std::string lastName;
+    for (const auto& histogram : snapshot.histograms) {
+        if (histogram.name != lastName) {
+            out << "# TYPE " << histogram.name << " summary\n";
+            lastName = histogram.name;
+        }
+        const HistogramSnapshot& v = histogram.values;
+        const std::pair<const char*, double> quantiles[] = {
+            {"0.5", v.p50}, {"0.9", v.p90}, {"0.99", v.p99}, {"0.999", v.p999}
+        };
+        for (const auto& quantile : quantiles) {
+            out << histogram.name
+                << formatLabels(histogram.labelName, histogram.labelValue, "quantile", quantile.first)
+                << " " << formatNumber(quantile.second) << "\n";
+        }
+        const std::string labels = formatLabels(histogram.labelName, histogram.labelValue);
+        out << histogram.name << "_sum" << labels << " " << formatNumber(v.sum) << "\n";
+        out << histogram.name << "_count" << labels << " " << v.count << "\n";
+    }
+
+    lastName.clear();
+    for (const auto& counter : snapshot.counters) {
+        if (counter.name != lastName) {
+            out << "# TYPE " << counter.name << " counter\n";
+            lastName = counter.name;
+        }
+        out << counter.name << formatLabels(counter.labelName, counter.labelValue)
+            << " " << counter.value << "\n";
+    }
+    return out.str();
+}
+
+bool MetricsRegistry::writeFile(const MetricsSnapshot& snapshot, const std::string& filePath, MetricsFormat format) {
+    // Write next to the target and rename, so readers never see a partial file
+    const std::string tempPath = filePath + ".tmp";
+    {
+        std::ofstream file(tempPath, std::ios::trunc);
+        if (!file) {
+            std::cerr << "Failed to open metrics file: " << tempPath << std::endl;
+            return false;
+        }
+        file << MetricsRegistry::format(snapshot, format);
+        if (!file) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(tempPath, filePath, error);
+    if (error) {
+        std::cerr << "Failed to write metrics file: " << filePath << " (" << error.message() << ")" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void MetricsRegistry::startPeriodicDump(std::function<MetricsSnapshot()> snapshotFunction,
+                                        const std::string& filePath, MetricsFormat format,
+                                        std::chrono::milliseconds interval) {
+    stopPeriodicDump();
+
+    {
+        std::lock_guard<std::mutex> lock(m_dumpMutex);
+        m_isDumpStopping = false;
+    }
+
+    m_dumpThread = std::thread([this, snapshotFunction, filePath, format, interval]() {
+        std::unique_lock<std::mutex> lock(m_dumpMutex);
+        bool isStopping = false;
+        while (!isStopping) {
+            isStopping = m_dumpCondition.wait_for(lock, interval, [this]() { return m_isDumpStopping; });
+
+            lock.unlock();
+            writeFile(snapshotFunction(), filePath, format);
+            lock.lock();
+        }
+    });
+}
+
+void MetricsRegistry::stopPeriodicDump() {
+    {
+        std::lock_guard<std::mutex> lock(m_dumpMutex);
+        m_isDumpStopping = true;
+    }
+    m_dumpCondition.notify_all();
+
+    if (m_dumpThread.joinable()) {
+        m_dumpThread.join();
+    }
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,122 @@
+#include "ModelEventQueue.h"
+#include "../../utils/include/Trace.h"
+#include <iostream>
+
+namespace lmms_magenta {
+
+ModelEventQueue::ModelEventQueue(Dispatcher dispatcher, size_t capacity)
+    : m_dispatcher(std::move(dispatcher))
+    , m_capacity(capacity > 0 ? capacity : 1)
+    , m_coalescedCount(0)
+    , m_droppedCount(0)
+    , m_isDispatching(false)
+    , m_stopping(false) {
+    m_thread = std::thread(&ModelEventQueue::dispatchLoop, this);
+}
+
+ModelEventQueue::~ModelEventQueue() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_eventAvailable.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void ModelEventQueue::push(ModelType type, const std::string& name, bool loaded) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // Merge with a pending event for the same model
+        for (auto& event : m_events) {
+            if (event.type == type && event.name == name) {
+                event.loaded = loaded;
+                ++m_coalescedCount;
+                return;
+            }
+        }
+
+        if (m_events.size() >= m_capacity) {
+            m_events.pop_front();
+            ++m_droppedCount;
+        }
+
+        m_events.push_back(ModelEvent{type, name, loaded});
+    }
+    m_eventAvailable.notify_one();
+}
+
+void ModelEventQueue::flush() {
+    if (std::this_thread::get_id() == m_thread.get_id()) {
+        return;
+    }
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_idle.wait(lock, [this]() { return m_events.empty() && !m_isDispatching; });
+}
+
+void ModelEventQueue::waitForDispatch() {
+    if (std::this_thread::get_id() == m_thread.get_id()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_dispatchMutex);
+}
+
+size_t ModelEventQueue::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_events.size();
+}
+
+uint64_t ModelEventQueue::getCoalescedCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_coalescedCount;
+}
+
+uint64_t ModelEventQueue::getDroppedCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_droppedCount;
+}
+
+void ModelEventQueue::dispatchLoop() {
+    LMMS_MAGENTA_TRACE_THREAD_NAME("model events");
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        m_eventAvailable.wait(lock, [this]() { return m_stopping || !m_events.empty(); });
+
+        if (m_events.empty()) {
+            // Stopping and fully drained
+            break;
+        }
+
+        ModelEvent event = std::move(m_events.front());
+        m_events.pop_front();
+        m_isDispatching = true;
+
+        // Deliver without holding the queue lock so producers never wait
+        lock.unlock();
+        {
+            std::lock_guard<std::mutex> dispatchLock(m_dispatchMutex);
+            try {
+                m_dispatcher(event);
+            }
+            catch (const std::exception& e) {
+                std::cerr << "Error in model event listener: " << e.what() << std::endl;
+            }
+        }
+        lock.lock();
+
+        m_isDispatching = false;
+        if (m_events.empty()) {
+            m_idle.notify_all();
+        }
+    }
+
+    m_idle.notify_all();
+}
+
+} // namespace lmms_magenta
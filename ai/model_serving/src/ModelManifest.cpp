@@ -0,0 +1,541 @@
+#include "ModelManifest.h"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace lmms_magenta {
+
+const char* const ModelManifest::kManifestFileName = ".model_manifest";
+
+namespace {
+
+// Manifest format version; bump when the layout changes
+constexpr int kManifestVersion = 3;
+
+// TensorFlow Lite tensor types that indicate a quantized model
+constexpr int8_t kTensorTypeUInt8 = 3;
+constexpr int8_t kTensorTypeInt8 = 9;
+constexpr int8_t kTensorTypeInt16 = 7;
+
+/**
+ * Minimal bounds-checked reader for the flatbuffer tables used by the
+ * TensorFlow Lite schema. Every accessor returns a neutral value and clears
+ * the ok flag instead of reading out of range.
+ */
+class FlatBufferReader {
+public:
+    FlatBufferReader(const uint8_t* data, size_t size)
+        : m_data(data), m_size(size), m_ok(true) {}
+
+    bool ok() const { return m_ok; }
+
+    template <typename T>
+    T read(size_t position) {
+        T value{};
+        if (position > m_size || m_size - position < sizeof(T)) {
+            m_ok = false;
+            return value;
+        }
+        std::memcpy(&value, m_data + position, sizeof(T));
+        return value;
+    }
+
+    // Position of the root table
+    size_t root() {
+        return read<uint32_t>(0);
+    }
+
+    // Absolute position of a field in a table, or 0 if absent
+    size_t field(size_t table, int index) {
+        if (table == 0) {
+            return 0;
+        }
+        const size_t vtable = table - read<int32_t>(table);
+        const uint16_t vtableSize = read<uint16_t>(vtable);
+        const size_t entry = 4 + static_cast<size_t>(index) * 2;
+        if (entry + 2 > vtableSize) {
+            return 0;
+        }
+        const uint16_t offset = read<uint16_t>(vtable + entry);
+        return offset ? table + offset : 0;
+    }
+
+    // Follow an offset field to the referenced object
+    size_t indirect(size_t position) {
+        if (position == 0) {
+            return 0;
+        }
+        return position + read<uint32_t>(position);
+    }
+
+    // Length of a vector at the given position
+    uint32_t vectorLength(size_t vector) {
+        return vector ? read<uint32_t>(vector) : 0;
+    }
+
+    // Position of a table element in a vector of tables
+    size_t tableAt(size_t vector, uint32_t index) {
+        return indirect(vector + 4 + static_cast<size_t>(index) * 4);
+    }
+
+    std::string string(size_t position) {
+        if (position == 0) {
+            return std::string();
+        }
+        const uint32_t length = read<uint32_t>(position);
+        if (!m_ok || position + 4 > m_size || m_size - position - 4 < length) {
+            m_ok = false;
+            return std::string();
+        }
+        return std::string(reinterpret_cast<const char*>(m_data + position + 4), length);
+    }
+
+    std::vector<int> intVector(size_t vector) {
+        std::vector<int> values;
+        const uint32_t length = vectorLength(vector);
+        values.reserve(std::min<uint32_t>(length, 16));
+        for (uint32_t i = 0; i < length && m_ok; ++i) {
+            values.push_back(read<int32_t>(vector + 4 + static_cast<size_t>(i) * 4));
+        }
+        return values;
+    }
+
+private:
+    const uint8_t* m_data;
+    size_t m_size;
+    bool m_ok;
+};
+
+// FNV-1a over a byte range
+uint64_t hashBytes(const uint8_t* data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i) {
+        hash ^= data[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string formatShape(const std::vector<int>& shape) {
+    std::ostringstream stream;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        if (i > 0) {
+            stream << ',';
+        }
+        stream << shape[i];
+    }
+    return stream.str();
+}
+
+// Escape a text field so that it stays on one line
+std::string escapeField(const std::string& text) {
+    std::string escaped;
+    escaped.reserve(text.size());
+    for (char c : text) {
+        switch (c) {
+            case '\\':
+                escaped += "\\\\";
+                break;
+            case '\n':
+                escaped += "\\n";
+                break;
+            case '\r':
+                escaped += "\\r";
+                break;
+            default:
+                escaped += c;
+                break;
+        }
+    }
+    return escaped;
+}
+
+std::string unescapeField(const std::string& text) {
+    std::string unescaped;
+    unescaped.reserve(text.size());
+    for (size_t i = 0; i < text.size(); ++i) {
+        if (text[i] != '\\' || i + 1 == text.size()) {
+            unescaped += text[i];
+            continue;
+        }
+        switch (text[++i]) {
+            case 'n':
+                unescaped += '\n';
+                break;
+            case 'r':
+                unescaped += '\r';
+                break;
+            default:
+                unescaped += text[i];
+                break;
+        }
+    }
+    return unescaped;
+}
+
+std::vector<int> parseShape(const std::string& text) {
+    std::vector<int> shape;
+    std::istringstream stream(text);
+    std::string dimension;
+    while (std::getline(stream, dimension, ',')) {
+        if (!dimension.empty()) {
+            shape.push_back(std::stoi(dimension));
+        }
+    }
+    return shape;
+}
+
+} // namespace
+
+ModelManifest::ModelManifest()
+    : m_isDirty(false) {
+}
+
+bool ModelManifest::load(const std::string& manifestPath) {
+    m_entries.clear();
+    m_isDirty = false;
+
+    std::ifstream file(manifestPath);
+    if (!file.good()) {
+        return false;
+    }
+
+    try {
+        std::string header;
+        int version = 0;
+        file >> header >> version;
+        if (header != "lmms-magenta-manifest" || version != kManifestVersion) {
+            // Unknown format: start over and rewrite it on the next save
+            m_isDirty = true;
+            return false;
+        }
+
+        ModelManifestEntry entry;
+        std::string line;
+        while (std::getline(file, line)) {
+            const size_t space = line.find(' ');
+            const std::string key = line.substr(0, space);
+            const std::string value = (space == std::string::npos) ? std::string() : line.substr(space + 1);
+
+            if (key == "model") {
+                entry = ModelManifestEntry();
+                entry.relativePath = unescapeField(value);
+            } else if (key == "size") {
+                entry.fileSize = std::stoull(value);
+            } else if (key == "mtime") {
+                entry.modifiedTime = std::stoll(value);
+            } else if (key == "hash") {
+                entry.metadata.contentHash = std::stoull(value, nullptr, 16);
+            } else if (key == "type") {
+                entry.metadata.type = static_cast<ModelType>(std::stoi(value));
+            } else if (key == "name") {
+                entry.metadata.name = unescapeField(value);
+            } else if (key == "version") {
+                entry.metadata.version = unescapeField(value);
+            } else if (key == "memory") {
+                entry.metadata.memorySize = std::stoull(value);
+            } else if (key == "quantized") {
+                entry.metadata.isQuantized = (value == "1");
+            } else if (key == "gpu") {
+                entry.metadata.supportsGPU = (value == "1");
+            } else if (key == "input") {
+                entry.metadata.inputShapes.push_back(parseShape(value));
+            } else if (key == "output") {
+                entry.metadata.outputShapes.push_back(parseShape(value));
+            } else if (key == "weight") {
+                std::istringstream fields(value);
+                std::string hash;
+                uint64_t size = 0;
+                fields >> hash >> size;
+                entry.metadata.weightBuffers.emplace_back(std::stoull(hash, nullptr, 16), size);
+            } else if (key == "description") {
+                entry.metadata.description = unescapeField(value);
+            } else if (key == "end") {
+                m_entries[entry.relativePath] = entry;
+            }
+        }
+
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error reading model manifest: " << e.what() << std::endl;
+        m_entries.clear();
+        m_isDirty = true;
+        return false;
+    }
+}
+
+bool ModelManifest::save(const std::string& manifestPath) const {
+    // Write to a temporary file first so a crash never leaves a torn manifest
+    const std::string temporaryPath = manifestPath + ".tmp";
+
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        if (!file.good()) {
+            std::cerr << "Failed to write model manifest: " << temporaryPath << std::endl;
+            return false;
+        }
+
+        file << "lmms-magenta-manifest " << kManifestVersion << "\n";
+        for (const auto& pair : m_entries) {
+            const ModelManifestEntry& entry = pair.second;
+            const ModelMetadata& metadata = entry.metadata;
+
+            file << "model " << escapeField(entry.relativePath) << "\n";
+            file << "size " << entry.fileSize << "\n";
+            file << "mtime " << entry.modifiedTime << "\n";
+            file << "hash " << std::hex << metadata.contentHash << std::dec << "\n";
+            file << "type " << static_cast<int>(metadata.type) << "\n";
+            file << "name " << escapeField(metadata.name) << "\n";
+            file << "version " << escapeField(metadata.version) << "\n";
+            file << "memory " << metadata.memorySize << "\n";
+            file << "quantized " << (metadata.isQuantized ? 1 : 0) << "\n";
+            file << "gpu " << (metadata.supportsGPU ? 1 : 0) << "\n";
+            for (const auto& shape : metadata.inputShapes) {
+                file << "input " << formatShape(shape) << "\n";
+            }
+            for (const auto& shape : metadata.outputShapes) {
+                file << "output " << formatShape(shape) << "\n";
+            }
+            for (const auto& buffer : metadata.weightBuffers) {
+                file << "weight " << std::hex << buffer.first << std::dec << " " << buffer.second << "\n";
+            }
+            file << "description " << escapeField(metadata.description) << "\n";
+            file << "end\n";
+        }
+
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, manifestPath, error);
+    if (error) {
+        std::cerr << "Failed to replace model manifest: " << manifestPath << std::endl;
+        return false;
+    }
+    return true;
+}
+
+const ModelManifestEntry* ModelManifest::find(const std::string& relativePath,
+                                              uint64_t fileSize,
+                                              int64_t modifiedTime) const {
+    auto it = m_entries.find(relativePath);
+    if (it == m_entries.end()) {
+        return nullptr;
+    }
+
+    // Stale if the file changed since it was indexed
+    if (it->second.fileSize != fileSize || it->second.modifiedTime != modifiedTime) {
+        return nullptr;
+    }
+
+    return &it->second;
+}
+
+void ModelManifest::update(const ModelManifestEntry& entry) {
+    m_entries[entry.relativePath] = entry;
+    m_isDirty = true;
+}
+
+void ModelManifest::retainOnly(const std::set<std::string>& presentPaths) {
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (presentPaths.count(it->first) == 0) {
+            it = m_entries.erase(it);
+            m_isDirty = true;
+        } else {
+            ++it;
+        }
+    }
+}
+
+const std::map<std::string, ModelManifestEntry>& ModelManifest::getEntries() const {
+    return m_entries;
+}
+
+bool ModelManifest::isDirty() const {
+    return m_isDirty;
+}
+
+bool ModelManifest::inspectModelFile(const std::string& filePath, ModelMetadata& metadata) {
+    std::ifstream file(filePath, std::ios::binary | std::ios::ate);
+    if (!file.good()) {
+        std::cerr << "Model file not found: " << filePath << std::endl;
+        return false;
+    }
+
+    const std::streamsize size = file.tellg();
+    if (size < 8) {
+        std::cerr << "Model file too small: " << filePath << std::endl;
+        return false;
+    }
+
+    std::vector<uint8_t> data(static_cast<size_t>(size));
+    file.seekg(0);
+    if (!file.read(reinterpret_cast<char*>(data.data()), size)) {
+        std::cerr << "Failed to read model file: " << filePath << std::endl;
+        return false;
+    }
+
+    // Check the TensorFlow Lite file identifier
+    if (std::memcmp(data.data() + 4, "TFL3", 4) != 0) {
+        std::cerr << "Not a TensorFlow Lite model: " << filePath << std::endl;
+        return false;
+    }
+
+    FlatBufferReader reader(data.data(), data.size());
+    const size_t model = reader.root();
+
+    // Model: version(0), operator_codes(1), subgraphs(2), description(3), buffers(4)
+    const size_t versionField = reader.field(model, 0);
+    const size_t subgraphs = reader.indirect(reader.field(model, 2));
+    const size_t description = reader.indirect(reader.field(model, 3));
+
+    metadata.version = versionField ? std::to_string(reader.read<uint32_t>(versionField)) : "0";
+    metadata.description = reader.string(description);
+    metadata.inputShapes.clear();
+    metadata.outputShapes.clear();
+    metadata.isQuantized = false;
+
+    if (reader.vectorLength(subgraphs) > 0) {
+        // SubGraph: tensors(0), inputs(1), outputs(2)
+        const size_t subgraph = reader.tableAt(subgraphs, 0);
+        const size_t tensors = reader.indirect(reader.field(subgraph, 0));
+        const std::vector<int> inputs = reader.intVector(reader.indirect(reader.field(subgraph, 1)));
+        const std::vector<int> outputs = reader.intVector(reader.indirect(reader.field(subgraph, 2)));
+        const uint32_t numTensors = reader.vectorLength(tensors);
+
+        // Tensor: shape(0), type(1), buffer(2), name(3), quantization(4)
+        auto tensorShape = [&](int index) {
+            if (index < 0 || static_cast<uint32_t>(index) >= numTensors) {
+                return std::vector<int>();
+            }
+            return reader.intVector(reader.indirect(reader.field(reader.tableAt(tensors, index), 0)));
+        };
+
+        for (int index : inputs) {
+            metadata.inputShapes.push_back(tensorShape(index));
+        }
+        for (int index : outputs) {
+            metadata.outputShapes.push_back(tensorShape(index));
+        }
+
+        // Quantized if any tensor uses an integer type with quantization scales
+        for (uint32_t i = 0; i < numTensors && reader.ok() && !metadata.isQuantized; ++i) {
+            const size_t tensor = reader.tableAt(tensors, i);
+            const size_t typeField = reader.field(tensor, 1);
+            const int8_t type = typeField ? reader.read<int8_t>(typeField) : 0;
+
+            // QuantizationParameters: min(0), max(1), scale(2), zero_point(3)
+            const size_t quantization = reader.indirect(reader.field(tensor, 4));
+            const size_t scales = reader.indirect(reader.field(quantization, 2));
+
+            if ((type == kTensorTypeInt8 || type == kTensorTypeUInt8 || type == kTensorTypeInt16) &&
+                reader.vectorLength(scales) > 0) {
+                metadata.isQuantized = true;
+            }
+        }
+    }
+
+    // Buffer: data(0), offset(1), size(2); hash every constant weight buffer
+    metadata.weightBuffers.clear();
+    const size_t buffers = reader.indirect(reader.field(model, 4));
+    const uint32_t numBuffers = reader.vectorLength(buffers);
+    for (uint32_t i = 0; i < numBuffers && reader.ok(); ++i) {
+        const size_t buffer = reader.tableAt(buffers, i);
+        const size_t bufferData = reader.indirect(reader.field(buffer, 0));
+        const size_t offsetField = reader.field(buffer, 1);
+        const size_t sizeField = reader.field(buffer, 2);
+
+        // Weights are either inline or, for large models, stored after the flatbuffer
+        uint64_t start = 0;
+        uint64_t length = 0;
+        if (bufferData) {
+            start = bufferData + 4;
+            length = reader.vectorLength(bufferData);
+        } else if (offsetField && sizeField) {
+            start = reader.read<uint64_t>(offsetField);
+            length = reader.read<uint64_t>(sizeField);
+        }
+
+        if (length == 0) {
+            continue;
+        }
+        if (start > data.size() || data.size() - start < length) {
+            std::cerr << "Corrupt TensorFlow Lite model: " << filePath << std::endl;
+            return false;
+        }
+        metadata.weightBuffers.emplace_back(hashBytes(data.data() + start, static_cast<size_t>(length)), length);
+    }
+
+    if (!reader.ok()) {
+        std::cerr << "Corrupt TensorFlow Lite model: " << filePath << std::endl;
+        return false;
+    }
+
+    metadata.filePath = filePath;
+    metadata.memorySize = static_cast<size_t>(size);
+    metadata.contentHash = hashBytes(data.data(), data.size());
+
+    // The GPU delegate only runs float models
+    metadata.supportsGPU = !metadata.isQuantized;
+
+    return true;
+}
+
+namespace {
+
+const std::map<std::string, ModelType>& getModelDirectories() {
+    static const std::map<std::string, ModelType> kDirectories = {
+        {"musicvae", ModelType::MusicVAE},
+        {"groovae", ModelType::GrooVAE},
+        {"melodyrnn", ModelType::MelodyRNN},
+        {"cyclegan", ModelType::CycleGAN},
+        {"smartgain", ModelType::SmartGain},
+        {"emotionmapper", ModelType::EmotionMapper}
+    };
+    return kDirectories;
+}
+
+} // namespace
+
+bool ModelManifest::modelTypeFromDirectory(const std::string& directoryName, ModelType& type) {
+    std::string name = directoryName;
+    std::transform(name.begin(), name.end(), name.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    const auto& directories = getModelDirectories();
+    auto it = directories.find(name);
+    if (it == directories.end()) {
+        return false;
+    }
+
+    type = it->second;
+    return true;
+}
+
+bool ModelManifest::modelTypeFromPath(const std::string& relativePath, ModelType& type) {
+    // Files directly in the models directory have no type
+    const size_t separator = relativePath.find('/');
+    if (separator == std::string::npos) {
+        return false;
+    }
+
+    return modelTypeFromDirectory(relativePath.substr(0, separator), type);
+}
+
+std::string ModelManifest::directoryFromModelType(ModelType type) {
+    for (const auto& entry : getModelDirectories()) {
+        if (entry.second == type) {
+            return entry.first;
+        }
+    }
+    return "unknown";
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,123 @@
+#include "ModelPrefetcher.h"
+#include "../../utils/include/Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <map>
+
+namespace lmms_magenta {
+
+ModelPrefetcher::ModelPrefetcher(size_t numThreads)
+    : m_pool(numThreads, []() { LMMS_MAGENTA_TRACE_THREAD_NAME("model loader"); }) {
+    // Construct the server first so it outlives the loader threads
+    ModelServer::getInstance();
+}
+
+ModelPrefetcher::~ModelPrefetcher() {
+    wait();
+}
+
+size_t ModelPrefetcher::prefetch(const std::vector<PrefetchRequest>& requests) {
+    ModelServer& server = ModelServer::getInstance();
+    std::vector<PrefetchRequest> ordered = orderRequests(requests);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Drop prefetches that have completed
+    m_pending.erase(std::remove_if(m_pending.begin(), m_pending.end(),
+        [](const std::future<bool>& future) {
+            return future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }), m_pending.end());
+
+    size_t submitted = 0;
+    for (const auto& request : ordered) {
+        if (server.isModelLoaded(request.type, request.modelName)) {
+            continue;
+        }
+
+        // The pool runs tasks in submission order, so earlier models load first.
+        // A plugin may load the model itself before this task runs; it is
+        // still warmed up then, since nothing has run it yet.
+        m_pending.push_back(m_pool.submit([request]() {
+            return loadAndWarmUp(request);
+        }));
+        ++submitted;
+    }
+
+    return submitted;
+}
+
+size_t ModelPrefetcher::wait() {
+    std::vector<std::future<bool>> pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        pending.swap(m_pending);
+    }
+
+    size_t failed = 0;
+    for (auto& future : pending) {
+        if (!future.get()) {
+            ++failed;
+        }
+    }
+    return failed;
+}
+
+size_t ModelPrefetcher::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    return static_cast<size_t>(std::count_if(m_pending.begin(), m_pending.end(),
+        [](const std::future<bool>& future) {
+            return future.wait_for(std::chrono::seconds(0)) != std::future_status::ready;
+        }));
+}
+
+std::vector<PrefetchRequest> ModelPrefetcher::orderRequests(const std::vector<PrefetchRequest>& requests) {
+    std::vector<PrefetchRequest> ordered;
+    std::map<std::pair<ModelType, std::string>, size_t> indices;
+
+    for (const auto& request : requests) {
+        auto key = std::make_pair(request.type, request.modelName);
+        auto it = indices.find(key);
+        if (it == indices.end()) {
+            indices.emplace(key, ordered.size());
+            ordered.push_back(request);
+        }
+        else {
+            ordered[it->second].firstTick = std::min(ordered[it->second].firstTick, request.firstTick);
+        }
+    }
+
+    std::stable_sort(ordered.begin(), ordered.end(),
+        [](const PrefetchRequest& a, const PrefetchRequest& b) {
+            return a.firstTick < b.firstTick;
+        });
+    return ordered;
+}
+
+bool ModelPrefetcher::loadAndWarmUp(const PrefetchRequest& request) {
+    ModelServer& server = ModelServer::getInstance();
+
+    try {
+        if (!server.loadModel(request.type, request.modelName)) {
+            std::cerr << "Failed to prefetch model: " << request.modelName << std::endl;
+            return false;
+        }
+
+        std::shared_ptr<Model> model = server.getModel(request.type, request.modelName);
+        if (!model) {
+            return false;
+        }
+
+        if (!model->warmUp()) {
+            std::cerr << "Failed to warm up model: " << request.modelName << std::endl;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error prefetching model " << request.modelName << ": " << e.what() << std::endl;
+        return false;
+    }
+}
+
+} // namespace lmms_magenta
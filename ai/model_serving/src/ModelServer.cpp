@@ -1,7 +1,23 @@
 #include "ModelServer.h"
+#include "ModelManifest.h"
+#include "ModelEventQueue.h"
+#include "WeightStore.h"
+#include "WarmStartCache.h"
+#include "QuotaManager.h"
+#include "MetricsRegistry.h"
+#include "TensorFlowLiteModel.h"
+#include "../../utils/include/RealtimeChecker.h"
+#include "../../utils/include/Trace.h"
+#include "MusicVAEModel.h"
+#include "GrooVAEModel.h"
+#include "MelodyRNNModel.h"
+#include "CycleGANModel.h"
+#include "EmotionMapperModel.h"
 #include <filesystem>
+#include <stdexcept>
 #include <algorithm>
 #include <iostream>
+#include <set>
 
 namespace lmms_magenta {
 
@@ -16,12 +32,33 @@ ModelServer::ModelServer()
     , m_maxMemoryUsage(0)
     , m_enableGPU(false)
     , m_isInitialized(false)
-    , m_nextCallbackId(0) {
+    , m_loadedModels(std::make_shared<const LoadedModelMap>())
+    , m_availableModels(std::make_shared<const AvailableModelMap>())
+    , m_nextCallbackId(0)
+    , m_isWarmStartEnabled(true)
+    , m_eventQueue(std::make_unique<ModelEventQueue>(
+          [this](const ModelEvent& event) { dispatchEvent(event); }))
+    , m_quotaManager(std::make_unique<QuotaManager>())
+    , m_metrics(std::make_unique<MetricsRegistry>()) {
+    // Request latency per plugin is the wall time of its jobs
+    m_quotaManager->setJobFinishedCallback([this](const std::string& clientId, std::chrono::nanoseconds wallTime) {
+        m_metrics->getHistogram(MetricsRegistry::kRequestSeconds, "plugin", clientId).record(wallTime);
+    });
+}
+
+ModelServer::~ModelServer() {
+    // The final metrics dump reads the event queue
+    m_metrics->stopPeriodicDump();
+    
+    // Deliver pending events before the callbacks go away
+    m_eventQueue.reset();
 }
 
 bool ModelServer::initialize(const std::string& modelsDirectory, 
                            size_t maxMemoryUsage, 
                            bool enableGPU) {
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    
     // Check if already initialized
     if (m_isInitialized) {
         std::cerr << "ModelServer already initialized" << std::endl;
@@ -43,13 +80,19 @@ bool ModelServer::initialize(const std::string& modelsDirectory,
     // Scan for available models
     scanForModels();
     
+    if (m_isWarmStartEnabled) {
+        m_warmStartCache = std::make_shared<const WarmStartCache>(
+            (std::filesystem::path(modelsDirectory) / ".warm_start").string());
+    }
+    
     m_isInitialized = true;
     return true;
 }
 
 bool ModelServer::loadModel(ModelType type, const std::string& modelName) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
+    LMMS_MAGENTA_TRACE_SCOPE("model_server", "load");
+    LMMS_MAGENTA_ASSERT_NOT_REALTIME("ModelServer::loadModel");
+
     // Check if initialized
     if (!m_isInitialized) {
         std::cerr << "ModelServer not initialized" << std::endl;
@@ -59,58 +102,110 @@ bool ModelServer::loadModel(ModelType type, const std::string& modelName) {
     // Create key for model
     auto key = std::make_pair(type, modelName);
     
-    // Check if model is already loaded
-    if (m_loadedModels.find(key) != m_loadedModels.end()) {
-        // Model already loaded
+    // Fast path: model already loaded
+    if (loadedModelsSnapshot()->count(key)) {
         return true;
     }
     
-    // Check if model is available
-    if (m_availableModels.find(key) == m_availableModels.end()) {
-        std::cerr << "Model not available: " << static_cast<int>(type) << " " << modelName << std::endl;
-        return false;
+    std::promise<std::shared_ptr<Model>> promise;
+    std::shared_future<std::shared_ptr<Model>> pending;
+    ModelMetadata metadata;
+    ModelCounters counters;
+    ModelFactory factory;
+    std::shared_ptr<const WarmStartCache> warmStartCache;
+    bool isLeader = false;
+    {
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        
+        // Another caller may have finished loading while we waited for the lock
+        if (loadedModelsSnapshot()->count(key)) {
+            return true;
+        }
+        
+        auto inFlight = m_pendingLoads.find(key);
+        if (inFlight != m_pendingLoads.end()) {
+            // Join the load that is already running
+            pending = inFlight->second;
+        } else {
+            // Check if model is available
+            auto available = availableModelsSnapshot();
+            auto it = available->find(key);
+            if (it == available->end()) {
+                std::cerr << "Model not available: " << static_cast<int>(type) << " " << modelName << std::endl;
+                return false;
+            }
+            
+            // Become the leader for this key
+            metadata = it->second.metadata;
+            counters = it->second.counters;
+            factory = m_modelFactory;
+            warmStartCache = m_warmStartCache;
+            pending = promise.get_future().share();
+            m_pendingLoads[key] = pending;
+            isLeader = true;
+        }
     }
     
-    // Get model metadata
-    const auto& metadata = m_availableModels[key];
-    
-    // Check if we need to unload other models to free memory
-    if (m_maxMemoryUsage > 0) {
-        unloadModelsIfNeeded(metadata.memorySize);
+    if (!isLeader) {
+        try {
+            pending.get();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Error loading model: " << e.what() << std::endl;
+            return false;
+        }
+        
+        // An update publishes only the names that were loaded, or nothing if
+        // it failed; load the others from the version now available
+        if (!loadedModelsSnapshot()->count(key)) {
+            return loadModel(type, modelName);
+        }
+        return true;
     }
     
-    // Create model instance based on type
+    // Create and initialize the model without holding any lock
     std::shared_ptr<Model> model;
-    
     try {
-        // Create model instance based on type
-        // This is a placeholder for actual model creation
-        // In a real implementation, we would create the appropriate model type
-        
-        // For now, just log that we're loading the model
         std::cout << "Loading model: " << metadata.name << " (" << metadata.description << ")" << std::endl;
-        
-        // Model loading would happen here
-        
-        // Add model to loaded models
-        m_loadedModels[key] = model;
-        
-        // Notify callbacks
-        for (const auto& callback : m_callbacks) {
-            callback.second(type, modelName, true);
-        }
-        
-        return true;
+        model = createModel(metadata, factory, warmStartCache);
     }
     catch (const std::exception& e) {
         std::cerr << "Error loading model: " << e.what() << std::endl;
+        counters.loadFailures->increment();
+        {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            m_pendingLoads.erase(key);
+        }
+        promise.set_exception(std::current_exception());
         return false;
     }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        
+        // Work on a private copy and publish it once complete
+        auto models = std::make_shared<LoadedModelMap>(*loadedModelsSnapshot());
+        
+        // Check if we need to unload other models to free memory
+        if (m_maxMemoryUsage > 0) {
+            unloadModelsIfNeeded(*models, model->getMemoryUsage());
+        }
+        
+        // Publish the model and retire the pending load in one step
+        (*models)[key] = LoadedModel{model, counters};
+        publishLoadedModels(models);
+        m_pendingLoads.erase(key);
+        
+        // Queued under the lock so events follow the order of the snapshots
+        m_eventQueue->push(type, modelName, true);
+    }
+    promise.set_value(model);
+    counters.loads->increment();
+    
+    return true;
 }
 
 std::shared_ptr<Model> ModelServer::getModel(ModelType type, const std::string& modelName) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
     // Check if initialized
     if (!m_isInitialized) {
         std::cerr << "ModelServer not initialized" << std::endl;
@@ -120,20 +215,64 @@ std::shared_ptr<Model> ModelServer::getModel(ModelType type, const std::string&
     // Create key for model
     auto key = std::make_pair(type, modelName);
     
-    // Check if model is loaded
-    if (m_loadedModels.find(key) == m_loadedModels.end()) {
-        // Try to load the model
-        if (!loadModel(type, modelName)) {
-            return nullptr;
+    // Lock-free lookup in the current snapshot
+    {
+        auto models = loadedModelsSnapshot();
+        auto it = models->find(key);
+        if (it != models->end()) {
+            it->second.counters.cacheHits->increment();
+            return it->second.model;
         }
     }
     
-    return m_loadedModels[key];
+    // Try to load the model (unknown models are not counted)
+    {
+        auto available = availableModelsSnapshot();
+        auto it = available->find(key);
+        if (it != available->end()) {
+            it->second.counters.cacheMisses->increment();
+        }
+    }
+    if (!loadModel(type, modelName)) {
+        return nullptr;
+    }
+    
+    auto models = loadedModelsSnapshot();
+    auto it = models->find(key);
+    return it != models->end() ? it->second.model : nullptr;
 }
 
-bool ModelServer::unloadModel(ModelType type, const std::string& modelName) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+ModelHandle ModelServer::getModelHandle(ModelType type, const std::string& modelName) {
+    if (!loadModel(type, modelName)) {
+        return ModelHandle();
+    }
+    
+    auto key = std::make_pair(type, modelName);
+    
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    
+    // Handles to the same model share one slot, repointed on every publish
+    auto& slot = m_modelSlots[key];
+    if (!slot) {
+        auto version = std::make_shared<ModelVersion>();
+        auto models = loadedModelsSnapshot();
+        auto it = models->find(key);
+        if (it != models->end()) {
+            version->model = it->second.model;
+        }
+        version->generation = 1;
+        
+        slot = std::make_shared<ModelHandle::Slot>();
+        slot->current.store(version);
+    }
     
+    return ModelHandle(slot);
+}
+
+bool ModelServer::updateModel(ModelType type, const std::string& modelName, const std::string& modelPath) {
+    LMMS_MAGENTA_TRACE_SCOPE("model_server", "update");
+    LMMS_MAGENTA_ASSERT_NOT_REALTIME("ModelServer::updateModel");
+
     // Check if initialized
     if (!m_isInitialized) {
         std::cerr << "ModelServer not initialized" << std::endl;
@@ -143,85 +282,259 @@ bool ModelServer::unloadModel(ModelType type, const std::string& modelName) {
     // Create key for model
     auto key = std::make_pair(type, modelName);
     
-    // Check if model is loaded
-    if (m_loadedModels.find(key) == m_loadedModels.end()) {
-        // Model not loaded
-        return true;
+    std::lock_guard<std::mutex> updateLock(m_updateMutex);
+    
+    ModelMetadata current;
+    {
+        auto available = availableModelsSnapshot();
+        auto it = available->find(key);
+        if (it == available->end()) {
+            std::cerr << "Model not available: " << static_cast<int>(type) << " " << modelName << std::endl;
+            return false;
+        }
+        current = it->second.metadata;
     }
     
-    // Remove model from loaded models
-    m_loadedModels.erase(key);
+    ModelMetadata metadata = current;
+    metadata.filePath = modelPath.empty() ? current.filePath : modelPath;
+    if (!ModelManifest::inspectModelFile(metadata.filePath, metadata)) {
+        std::cerr << "Invalid model file: " << metadata.filePath << std::endl;
+        return false;
+    }
     
-    // Notify callbacks
-    for (const auto& callback : m_callbacks) {
-        callback.second(type, modelName, false);
+    // Users of the model are built around its tensor shapes
+    if ((!current.inputShapes.empty() && metadata.inputShapes != current.inputShapes) ||
+        (!current.outputShapes.empty() && metadata.outputShapes != current.outputShapes)) {
+        std::cerr << "New version of " << modelName << " has different tensor shapes" << std::endl;
+        return false;
+    }
+    
+    // Loads of any name of the same file (e.g. the default alias) join the
+    // update from here on, so none of them can resolve the old version
+    std::promise<std::shared_ptr<Model>> promise;
+    std::vector<ModelKey> aliases;
+    ModelFactory factory;
+    std::shared_ptr<const WarmStartCache> warmStartCache;
+    for (;;) {
+        std::shared_future<std::shared_ptr<Model>> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_registryMutex);
+            
+            auto available = availableModelsSnapshot();
+            aliases.clear();
+            for (const auto& pair : *available) {
+                if (pair.first.first == type && pair.second.metadata.filePath == current.filePath) {
+                    aliases.push_back(pair.first);
+                    auto inFlight = m_pendingLoads.find(pair.first);
+                    if (inFlight != m_pendingLoads.end()) {
+                        pending = inFlight->second;
+                    }
+                }
+            }
+            
+            if (!pending.valid()) {
+                // Not loaded: the next load picks up the new version
+                auto models = loadedModelsSnapshot();
+                const bool isLoaded = std::any_of(aliases.begin(), aliases.end(),
+                                                  [&models](const ModelKey& alias) { return models->count(alias) > 0; });
+                if (!isLoaded) {
+                    publishAvailableVersion(aliases, metadata);
+                    return true;
+                }
+                
+                factory = m_modelFactory;
+                warmStartCache = m_warmStartCache;
+                std::shared_future<std::shared_ptr<Model>> marker = promise.get_future().share();
+                for (const auto& alias : aliases) {
+                    m_pendingLoads[alias] = marker;
+                }
+                break;
+            }
+        }
+        
+        // Let a load of the current version finish so that it cannot be
+        // published over the new one
+        pending.wait();
+    }
+    
+    // Load the new version while the current one keeps serving
+    std::shared_ptr<Model> model;
+    try {
+        std::cout << "Updating model: " << metadata.name << " (" << metadata.version << ")" << std::endl;
+        model = createModel(metadata, factory, warmStartCache);
+    }
+    catch (const std::exception& e) {
+        std::cerr << "Error loading new model version: " << e.what() << std::endl;
+    }
+    
+    // Smoke inference before anyone can see the new version
+    if (model && !model->warmUp()) {
+        std::cerr << "New version of " << modelName << " failed validation" << std::endl;
+        model.reset();
+    }
+    
+    {
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        for (const auto& alias : aliases) {
+            m_pendingLoads.erase(alias);
+        }
+        
+        if (model) {
+            publishAvailableVersion(aliases, metadata);
+            
+            auto models = std::make_shared<LoadedModelMap>(*loadedModelsSnapshot());
+            std::vector<ModelKey> loadedAliases;
+            for (const auto& alias : aliases) {
+                if (models->erase(alias) > 0) {
+                    loadedAliases.push_back(alias);
+                }
+            }
+            
+            if (m_maxMemoryUsage > 0) {
+                unloadModelsIfNeeded(*models, model->getMemoryUsage());
+            }
+            
+            // Publish the new version in one step; the old one is freed with its last user
+            auto available = availableModelsSnapshot();
+            for (const auto& alias : loadedAliases) {
+                (*models)[alias] = LoadedModel{model, available->at(alias).counters};
+                m_eventQueue->push(alias.first, alias.second, true);
+            }
+            publishLoadedModels(models);
+        }
+    }
+    
+    // Joined loads see the new version, or retry against the current one
+    promise.set_value(model);
+    return model != nullptr;
+}
+
+void ModelServer::publishAvailableVersion(const std::vector<ModelKey>& aliases, const ModelMetadata& metadata) {
+    auto available = std::make_shared<AvailableModelMap>(*availableModelsSnapshot());
+    for (const auto& alias : aliases) {
+        auto it = available->find(alias);
+        if (it != available->end()) {
+            const std::string name = it->second.metadata.name;
+            it->second.metadata = metadata;
+            it->second.metadata.name = name;
+        }
+    }
+    m_availableModels.store(available);
+}
+
+bool ModelServer::isModelLoaded(ModelType type, const std::string& modelName) const {
+    auto models = loadedModelsSnapshot();
+    return models->find(std::make_pair(type, modelName)) != models->end();
+}
+
+bool ModelServer::unloadModel(ModelType type, const std::string& modelName) {
+    LMMS_MAGENTA_TRACE_SCOPE("model_server", "unload");
+
+    // Check if initialized
+    if (!m_isInitialized) {
+        std::cerr << "ModelServer not initialized" << std::endl;
+        return false;
+    }
+    
+    // Create key for model
+    auto key = std::make_pair(type, modelName);
+    
+    {
+        std::lock_guard<std::mutex> lock(m_registryMutex);
+        
+        auto current = loadedModelsSnapshot();
+        
+        // Check if model is loaded
+        if (current->find(key) == current->end()) {
+            // Model not loaded
+            return true;
+        }
+        
+        // Remove model from loaded models
+        auto models = std::make_shared<LoadedModelMap>(*current);
+        models->erase(key);
+        publishLoadedModels(models);
+        
+        // Notify callbacks
+        m_eventQueue->push(type, modelName, false);
     }
     
     return true;
 }
 
 std::vector<ModelMetadata> ModelServer::getAvailableModels() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    auto available = availableModelsSnapshot();
     
     std::vector<ModelMetadata> models;
-    models.reserve(m_availableModels.size());
+    models.reserve(available->size());
     
-    for (const auto& pair : m_availableModels) {
-        models.push_back(pair.second);
+    for (const auto& pair : *available) {
+        // Skip the default-model aliases registered under the empty name
+        if (pair.first.second.empty()) {
+            continue;
+        }
+        models.push_back(pair.second.metadata);
     }
     
     return models;
 }
 
 std::vector<ModelMetadata> ModelServer::getLoadedModels() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    auto loaded = loadedModelsSnapshot();
+    auto available = availableModelsSnapshot();
     
     std::vector<ModelMetadata> models;
-    models.reserve(m_loadedModels.size());
+    models.reserve(loaded->size());
     
-    for (const auto& pair : m_loadedModels) {
-        const auto& key = pair.first;
-        const auto& metadata = m_availableModels.at(key);
-        models.push_back(metadata);
+    for (const auto& pair : *loaded) {
+        auto it = available->find(pair.first);
+        if (it != available->end()) {
+            models.push_back(it->second.metadata);
+        }
     }
     
     return models;
 }
 
 size_t ModelServer::getTotalMemoryUsage() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    return sumMemoryUsage(*loadedModelsSnapshot());
+}
+
+std::vector<std::pair<ModelMetadata, ModelMemoryStats>> ModelServer::getMemoryBreakdown() const {
+    auto models = loadedModelsSnapshot();
     
-    size_t total = 0;
-    for (const auto& pair : m_loadedModels) {
-        total += pair.second->getMemoryUsage();
+    std::vector<std::pair<ModelMetadata, ModelMemoryStats>> breakdown;
+    breakdown.reserve(models->size());
+    
+    for (const auto& pair : *models) {
+        if (pair.second.model) {
+            breakdown.emplace_back(pair.second.model->getMetadata(), pair.second.model->getMemoryStats());
+        }
     }
     
-    return total;
+    return breakdown;
 }
 
 void ModelServer::setMaxMemoryUsage(size_t maxMemoryUsage) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
     m_maxMemoryUsage = maxMemoryUsage;
     
     // If max memory usage is reduced, unload models if necessary
-    if (m_maxMemoryUsage > 0) {
-        size_t currentUsage = getTotalMemoryUsage();
-        if (currentUsage > m_maxMemoryUsage) {
-            unloadModelsIfNeeded(0);
-        }
+    if (maxMemoryUsage == 0 || getTotalMemoryUsage() <= maxMemoryUsage) {
+        return;
     }
+    
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    
+    auto models = std::make_shared<LoadedModelMap>(*loadedModelsSnapshot());
+    unloadModelsIfNeeded(*models, 0);
+    publishLoadedModels(models);
 }
 
 void ModelServer::enableGPU(bool enable) {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
     m_enableGPU = enable;
 }
 
 bool ModelServer::isGPUEnabled() const {
-    std::lock_guard<std::mutex> lock(m_mutex);
-    
     return m_enableGPU;
 }
 
@@ -232,7 +545,7 @@ bool ModelServer::isGPUAvailable() const {
 }
 
 int ModelServer::registerModelCallback(std::function<void(ModelType, const std::string&, bool)> callback) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    std::lock_guard<std::mutex> lock(m_callbackMutex);
     
     int id = m_nextCallbackId++;
     m_callbacks[id] = callback;
@@ -240,64 +553,319 @@ int ModelServer::registerModelCallback(std::function<void(ModelType, const std::
 }
 
 void ModelServer::unregisterModelCallback(int callbackId) {
-    std::lock_guard<std::mutex> lock(m_mutex);
+    {
+        std::lock_guard<std::mutex> lock(m_callbackMutex);
+        m_callbacks.erase(callbackId);
+    }
     
-    m_callbacks.erase(callbackId);
+    // Make sure the callback is not still running on the dispatcher thread
+    m_eventQueue->waitForDispatch();
 }
 
-void ModelServer::scanForModels() {
-    // Placeholder for actual model scanning
-    // In a real implementation, we would scan the models directory for model files
-    // and create metadata for each model
+void ModelServer::setModelFactory(ModelFactory factory) {
+    std::lock_guard<std::mutex> lock(m_registryMutex);
     
-    // For now, just add some placeholder models
+    m_modelFactory = std::move(factory);
+}
+
+void ModelServer::setClientQuota(const std::string& clientId, const ClientQuota& quota) {
+    m_quotaManager->setQuota(clientId, quota);
+}
+
+ModelJob ModelServer::beginJob(const std::string& clientId, size_t scratchBytes,
+                               std::chrono::milliseconds timeout) {
+    ModelJob job = m_quotaManager->beginJob(clientId, scratchBytes, timeout);
+    if (!job.isAdmitted()) {
+        m_metrics->getCounter(MetricsRegistry::kJobsRejected, "plugin", clientId).increment();
+    }
+    return job;
+}
+
+void ModelServer::removeClient(const std::string& clientId) {
+    m_quotaManager->removeClient(clientId);
+}
+
+MetricsRegistry& ModelServer::getMetrics() {
+    return *m_metrics;
+}
+
+MetricsSnapshot ModelServer::metricsSnapshot() const {
+    MetricsSnapshot snapshot = m_metrics->snapshot();
     
-    // MusicVAE model
-    {
-        ModelMetadata metadata;
-        metadata.name = "MusicVAE";
-        metadata.type = ModelType::MusicVAE;
-        metadata.version = "1.0.0";
-        metadata.memorySize = 100 * 1024 * 1024; // 100 MB
-        metadata.description = "MusicVAE model for pattern generation";
-        metadata.isQuantized = true;
-        metadata.supportsGPU = true;
+    // Events are dropped by the queue itself, so its count is read here
+    MetricsSnapshot::Counter dropped;
+    dropped.name = MetricsRegistry::kModelEventsDropped;
+    dropped.value = m_eventQueue->getDroppedCount();
+    snapshot.counters.push_back(dropped);
+    
+    return snapshot;
+}
+
+void ModelServer::setMetricsDumpFile(const std::string& filePath, MetricsFormat format,
+                                     std::chrono::milliseconds interval) {
+    if (filePath.empty()) {
+        m_metrics->stopPeriodicDump();
+        return;
+    }
+    
+    m_metrics->startPeriodicDump([this]() { return metricsSnapshot(); }, filePath, format, interval);
+}
+
+std::string ModelServer::getModelLabel(ModelType type, const std::string& modelName) {
+    return ModelManifest::directoryFromModelType(type) + "/" + (modelName.empty() ? "default" : modelName);
+}
+
+void ModelServer::setWarmStartEnabled(bool enable) {
+    std::lock_guard<std::mutex> lock(m_registryMutex);
+    
+    m_isWarmStartEnabled = enable;
+    if (!enable) {
+        m_warmStartCache.reset();
+    } else if (!m_warmStartCache && !m_modelsDirectory.empty()) {
+        m_warmStartCache = std::make_shared<const WarmStartCache>(
+            (std::filesystem::path(m_modelsDirectory) / ".warm_start").string());
+    }
+}
+
+std::shared_ptr<Model> ModelServer::createModel(const ModelMetadata& metadata, const ModelFactory& factory,
+                                                const std::shared_ptr<const WarmStartCache>& warmStartCache) {
+    LMMS_MAGENTA_TRACE_SCOPE("model_server", "create_model");
+    std::shared_ptr<Model> model;
+    
+    if (factory) {
+        model = factory(metadata);
+    } else {
+        // Create model instance based on type
+        switch (metadata.type) {
+            case ModelType::MusicVAE:
+                model = std::make_shared<MusicVAEModel>(metadata.filePath, metadata);
+                break;
+            case ModelType::GrooVAE:
+                model = std::make_shared<GrooVAEModel>(metadata.filePath, metadata);
+                break;
+            case ModelType::MelodyRNN:
+                model = std::make_shared<MelodyRNNModel>(metadata.filePath, metadata);
+                break;
+            case ModelType::CycleGAN:
+                model = std::make_shared<CycleGANModel>(metadata.filePath, metadata);
+                break;
+            case ModelType::EmotionMapper:
+                model = std::make_shared<EmotionMapperModel>(metadata.filePath, metadata);
+                break;
+            default:
+                // Models without a specialized wrapper run through the generic interpreter
+                model = std::make_shared<TensorFlowLiteModel>(metadata.filePath, metadata);
+                break;
+        }
+    }
+    
+    if (!model) {
+        throw std::runtime_error("No model implementation for " + metadata.name);
+    }
+    
+    // Interpreter-backed models can start from a prepared snapshot
+    if (auto interpreterModel = std::dynamic_pointer_cast<TensorFlowLiteModel>(model)) {
+        interpreterModel->setWarmStartCache(warmStartCache);
+    }
+    
+    if (!model->isInitialized() && !model->initialize()) {
+        throw std::runtime_error("Failed to initialize model " + metadata.name);
+    }
+    
+    return model;
+}
+
+ModelServer::ModelCounters ModelServer::resolveCounters(ModelType type, const std::string& modelName) {
+    const std::string label = getModelLabel(type, modelName);
+    
+    ModelCounters counters;
+    counters.cacheHits = &m_metrics->getCounter(MetricsRegistry::kCacheHits, "model", label);
+    counters.cacheMisses = &m_metrics->getCounter(MetricsRegistry::kCacheMisses, "model", label);
+    counters.loads = &m_metrics->getCounter(MetricsRegistry::kModelLoads, "model", label);
+    counters.loadFailures = &m_metrics->getCounter(MetricsRegistry::kModelLoadFailures, "model", label);
+    counters.evictions = &m_metrics->getCounter(MetricsRegistry::kModelEvictions, "model", label);
+    return counters;
+}
+
+std::shared_ptr<const ModelServer::LoadedModelMap> ModelServer::loadedModelsSnapshot() const {
+    return m_loadedModels.load();
+}
+
+std::shared_ptr<const ModelServer::AvailableModelMap> ModelServer::availableModelsSnapshot() const {
+    return m_availableModels.load();
+}
+
+void ModelServer::publishLoadedModels(std::shared_ptr<const LoadedModelMap> models) {
+    // Point every handle at the model now published under its key
+    for (auto it = m_modelSlots.begin(); it != m_modelSlots.end();) {
+        // No handle left
+        if (it->second.use_count() == 1) {
+            it = m_modelSlots.erase(it);
+            continue;
+        }
         
-        m_availableModels[std::make_pair(ModelType::MusicVAE, "")] = metadata;
+        auto loaded = models->find(it->first);
+        std::shared_ptr<Model> model = loaded != models->end() ? loaded->second.model : nullptr;
+        
+        auto current = it->second->current.load();
+        if (current->model != model) {
+            auto version = std::make_shared<ModelVersion>();
+            version->model = std::move(model);
+            version->generation = current->generation + 1;
+            it->second->current.store(version);
+        }
+        ++it;
     }
     
-    // GrooVAE model
+    m_loadedModels.store(std::move(models));
+}
+
+void ModelServer::flushModelEvents() {
+    m_eventQueue->flush();
+}
+
+void ModelServer::dispatchEvent(const ModelEvent& event) {
+    LMMS_MAGENTA_TRACE_SCOPE("callback", "model_event");
+
+    // Copy the callbacks so listeners may register or unregister while being notified
+    CallbackMap callbacks;
     {
+        std::lock_guard<std::mutex> lock(m_callbackMutex);
+        callbacks = m_callbacks;
+    }
+    
+    for (const auto& callback : callbacks) {
+        callback.second(event.type, event.name, event.loaded);
+    }
+}
+
+void ModelServer::scanForModels() {
+    namespace fs = std::filesystem;
+    
+    // Load the cached index so unchanged files are not reparsed
+    const std::string manifestPath = (fs::path(m_modelsDirectory) / ModelManifest::kManifestFileName).string();
+    ModelManifest manifest;
+    manifest.load(manifestPath);
+    
+    auto availableModels = std::make_shared<AvailableModelMap>();
+    std::set<std::string> presentPaths;
+    std::map<ModelType, std::string> defaultModels;
+    size_t parsedCount = 0;
+    
+    std::error_code error;
+    for (fs::recursive_directory_iterator it(m_modelsDirectory, error), end; it != end; it.increment(error)) {
+        if (error) {
+            std::cerr << "Error scanning models directory: " << error.message() << std::endl;
+            break;
+        }
+        
+        const fs::path& path = it->path();
+        if (!it->is_regular_file() || path.extension() != ".tflite") {
+            continue;
+        }
+        
+        // The model type is given by the top-level subdirectory (e.g. models/musicvae/)
+        const std::string relativePath = fs::relative(path, m_modelsDirectory).generic_string();
+        ModelType type;
+        if (!ModelManifest::modelTypeFromPath(relativePath, type)) {
+            std::cerr << "Skipping model outside a model type directory: " << relativePath << std::endl;
+            continue;
+        }
+        
+        const uint64_t fileSize = static_cast<uint64_t>(it->file_size());
+        const int64_t modifiedTime = static_cast<int64_t>(it->last_write_time().time_since_epoch().count());
+        presentPaths.insert(relativePath);
+        
         ModelMetadata metadata;
-        metadata.name = "GrooVAE";
-        metadata.type = ModelType::GrooVAE;
-        metadata.version = "1.0.0";
-        metadata.memorySize = 50 * 1024 * 1024; // 50 MB
-        metadata.description = "GrooVAE model for groove modeling";
-        metadata.isQuantized = true;
-        metadata.supportsGPU = true;
+        const ModelManifestEntry* cached = manifest.find(relativePath, fileSize, modifiedTime);
+        if (cached) {
+            metadata = cached->metadata;
+            metadata.filePath = path.string();
+        } else {
+            // New or changed file: parse its header and update the index
+            metadata.name = path.stem().string();
+            metadata.type = type;
+            if (!ModelManifest::inspectModelFile(path.string(), metadata)) {
+                continue;
+            }
+            
+            ModelManifestEntry entry;
+            entry.relativePath = relativePath;
+            entry.fileSize = fileSize;
+            entry.modifiedTime = modifiedTime;
+            entry.metadata = metadata;
+            manifest.update(entry);
+            ++parsedCount;
+        }
+        
+        const ModelKey key = std::make_pair(type, metadata.name);
+        (*availableModels)[key] = AvailableModel{metadata, resolveCounters(type, metadata.name)};
         
-        m_availableModels[std::make_pair(ModelType::GrooVAE, "")] = metadata;
+        // The default model of a type is "default.tflite", else the first by name
+        auto current = defaultModels.find(type);
+        if (current == defaultModels.end() ||
+            (current->second != "default" && (metadata.name == "default" || metadata.name < current->second))) {
+            defaultModels[type] = metadata.name;
+        }
     }
     
-    // MelodyRNN model
-    {
-        ModelMetadata metadata;
-        metadata.name = "MelodyRNN";
-        metadata.type = ModelType::MelodyRNN;
-        metadata.version = "1.0.0";
-        metadata.memorySize = 30 * 1024 * 1024; // 30 MB
-        metadata.description = "MelodyRNN model for melodic completion";
-        metadata.isQuantized = true;
-        metadata.supportsGPU = true;
+    // Plugins that do not pick a model use the empty name
+    for (const auto& pair : defaultModels) {
+        (*availableModels)[std::make_pair(pair.first, std::string())] = AvailableModel{
+            (*availableModels)[std::make_pair(pair.first, pair.second)].metadata,
+            resolveCounters(pair.first, std::string())};
+    }
+    
+    m_availableModels.store(availableModels);
+    
+    // Drop entries for deleted files and persist the index if it changed
+    manifest.retainOnly(presentPaths);
+    if (manifest.isDirty() && !manifest.save(manifestPath)) {
+        std::cerr << "Failed to save model manifest: " << manifestPath << std::endl;
+    }
+    
+    std::cout << "Found " << presentPaths.size() << " models (" << parsedCount << " parsed)" << std::endl;
+    
+    // Point out weights that could be shared if exported as a separate model
+    std::vector<ModelMetadata> models;
+    for (const auto& pair : *availableModels) {
+        if (!pair.first.second.empty()) {
+            models.push_back(pair.second.metadata);
+        }
+    }
+    const uint64_t duplicateBytes = WeightStore::findDuplicateWeightBytes(models);
+    if (duplicateBytes > 0) {
+        std::cout << "Model files contain " << duplicateBytes / 1024 << " KB of duplicated weights" << std::endl;
+    }
+}
+
+size_t ModelServer::sumMemoryUsage(const LoadedModelMap& models) {
+    size_t total = 0;
+    std::set<uint64_t> sharedWeights;
+    std::set<const Model*> counted;
+    
+    for (const auto& pair : models) {
+        // The same instance may be registered under its name and the default alias
+        if (!pair.second.model || !counted.insert(pair.second.model.get()).second) {
+            continue;
+        }
         
-        m_availableModels[std::make_pair(ModelType::MelodyRNN, "")] = metadata;
+        const ModelMemoryStats stats = pair.second.model->getMemoryStats();
+        total += stats.total();
+        
+        // Files mapped through the WeightStore are resident only once; weights
+        // materialized by each interpreter are not shared
+        if (stats.weightKey != 0 && !sharedWeights.insert(stats.weightKey).second) {
+            total -= stats.sharedWeightBytes;
+        }
     }
+    
+    return total;
 }
 
-void ModelServer::unloadModelsIfNeeded(size_t requiredMemory) {
+void ModelServer::unloadModelsIfNeeded(LoadedModelMap& models, size_t requiredMemory) {
     // Calculate current memory usage
-    size_t currentUsage = getTotalMemoryUsage();
+    size_t currentUsage = sumMemoryUsage(models);
     
     // Check if we need to unload models
     if (currentUsage + requiredMemory <= m_maxMemoryUsage) {
@@ -305,37 +873,29 @@ void ModelServer::unloadModelsIfNeeded(size_t requiredMemory) {
         return;
     }
     
+    LMMS_MAGENTA_TRACE_SCOPE("model_server", "evict");
+
     // Calculate how much memory we need to free
     size_t memoryToFree = currentUsage + requiredMemory - m_maxMemoryUsage;
     
     // Get loaded models sorted by last access time (not implemented yet)
     // For now, just unload models until we have enough memory
     
-    // Create a copy of the loaded models
-    auto loadedModels = m_loadedModels;
-    
     // Unload models until we have enough memory
     size_t freedMemory = 0;
-    for (const auto& pair : loadedModels) {
-        const auto& key = pair.first;
-        const auto& model = pair.second;
-        
+    for (auto it = models.begin(); it != models.end() && freedMemory < memoryToFree;) {
         // Skip if this is the only model
-        if (loadedModels.size() == 1) {
+        if (models.size() == 1) {
             break;
         }
         
-        // Unload model
-        size_t modelMemory = model->getMemoryUsage();
-        unloadModel(key.first, key.second);
+        // Unload model (shared weights are only freed with their last user)
+        m_eventQueue->push(it->first.first, it->first.second, false);
+        it->second.counters.evictions->increment();
+        it = models.erase(it);
         
-        // Update freed memory
-        freedMemory += modelMemory;
-        
-        // Check if we have freed enough memory
-        if (freedMemory >= memoryToFree) {
-            break;
-        }
+        const size_t remainingUsage = sumMemoryUsage(models);
+        freedMemory = currentUsage > remainingUsage ? currentUsage - remainingUsage : 0;
     }
 }
 
@@ -6,194 +6,227 @@
 
 namespace lmms_magenta {
 
-MusicVAEModel::MusicVAEModel(const std::string& modelPath)
-    : TensorFlowLiteModel(modelPath)
-    , m_temperature(1.0f)
-    , m_zDimension(256) {
+namespace {
+
+// Default latent dimension and notes per row
+constexpr int kDefaultLatentDimension = 256;
+constexpr int kDefaultNoteCapacity = 64;
+
+// Values per note, as in MidiUtils::sequenceToTensor
+constexpr int kValuesPerNote = 5;
+
+} // namespace
+
+MusicVAEModel::MusicVAEModel(const std::string& modelPath, const ModelMetadata& metadata)
+    : TensorFlowLiteModel(modelPath, metadata)
+    , m_latentDimension(kDefaultLatentDimension)
+    , m_maxSequenceLength(3840)  // Two bars of 4/4
+    , m_ticksPerQuarter(480)
+    , m_noteCapacity(kDefaultNoteCapacity) {
 }
 
 MusicVAEModel::~MusicVAEModel() {
 }
 
-bool MusicVAEModel::encode(const std::vector<MidiNote>& notes, std::vector<float>& latentVector) {
-    // Check if model is loaded
-    if (!isLoaded()) {
-        if (!load()) {
-            std::cerr << "Failed to load model" << std::endl;
-            return false;
-        }
+bool MusicVAEModel::initialize() {
+    if (!TensorFlowLiteModel::initialize()) {
+        return false;
     }
-    
-    try {
-        // Convert MIDI notes to tensor representation
-        std::vector<float> inputTensor = MidiUtils::notesToTensor(notes);
-        
-        // Set input tensor
-        if (!setInputTensor("encoder_input", inputTensor)) {
-            std::cerr << "Failed to set input tensor" << std::endl;
-            return false;
-        }
-        
-        // Run the model
-        if (!run()) {
-            std::cerr << "Failed to run model" << std::endl;
-            return false;
+
+    // Derive the note capacity from the input row: [note values | z]
+    std::vector<int> inputShape = getInputShape();
+    if (!inputShape.empty()) {
+        const int rowSize = inputShape.back();
+        if (rowSize > m_latentDimension && (rowSize - m_latentDimension) % kValuesPerNote == 0) {
+            m_noteCapacity = (rowSize - m_latentDimension) / kValuesPerNote;
         }
-        
-        // Get the latent vector from the output tensor
-        latentVector = getOutputTensor("z");
-        
-        return true;
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error encoding MIDI: " << e.what() << std::endl;
-        return false;
+
+    return true;
+}
+
+std::vector<float> MusicVAEModel::encode(const MidiSequence& sequence) {
+    // One row: [note values | z], the z part is ignored by the encoder
+    std::vector<float> input = toNoteValues(sequence);
+    const size_t noteValues = input.size();
+    input.resize(noteValues + m_latentDimension, 0.0f);
+
+    std::vector<float> output;
+    if (!runRows(input, output)) {
+        std::cerr << "Failed to encode sequence" << std::endl;
+        return std::vector<float>();
     }
+
+    return std::vector<float>(output.begin() + noteValues, output.end());
 }
 
-bool MusicVAEModel::decode(const std::vector<float>& latentVector, std::vector<MidiNote>& notes) {
-    // Check if model is loaded
-    if (!isLoaded()) {
-        if (!load()) {
-            std::cerr << "Failed to load model" << std::endl;
-            return false;
-        }
+MidiSequence MusicVAEModel::decode(const std::vector<float>& z, float temperature) {
+    std::vector<MidiSequence> sequences = decodeBatch({z}, temperature);
+    if (sequences.empty()) {
+        return MidiSequence(m_ticksPerQuarter, m_maxSequenceLength);
     }
-    
-    try {
-        // Set the latent vector as input tensor
-        if (!setInputTensor("z", latentVector)) {
-            std::cerr << "Failed to set input tensor" << std::endl;
-            return false;
-        }
-        
-        // Set the temperature
-        if (!setInputTensor("temperature", {m_temperature})) {
-            std::cerr << "Failed to set temperature" << std::endl;
-            return false;
-        }
-        
-        // Run the model
-        if (!run()) {
-            std::cerr << "Failed to run model" << std::endl;
-            return false;
+
+    return sequences.front();
+}
+
+std::vector<MidiSequence> MusicVAEModel::decodeBatch(const std::vector<std::vector<float>>& latents,
+                                                     float temperature) {
+    if (latents.empty()) {
+        return {};
+    }
+
+    // Stack one [empty notes | z] row per latent vector
+    const size_t noteValues = static_cast<size_t>(m_noteCapacity) * kValuesPerNote;
+    const size_t rowSize = noteValues + m_latentDimension;
+    std::vector<float> input;
+    input.reserve(latents.size() * rowSize);
+    for (const auto& z : latents) {
+        if (z.size() != static_cast<size_t>(m_latentDimension)) {
+            std::cerr << "Invalid latent vector size: " << z.size() << std::endl;
+            return {};
         }
-        
-        // Get the output tensor
-        std::vector<float> outputTensor = getOutputTensor("decoder_output");
-        
-        // Convert tensor to MIDI notes
-        notes = MidiUtils::tensorToNotes(outputTensor);
-        
-        return true;
+        const std::vector<float> scaled = applyTemperature(z, temperature);
+        input.insert(input.end(), noteValues, 0.0f);
+        input.insert(input.end(), scaled.begin(), scaled.end());
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error decoding latent vector: " << e.what() << std::endl;
-        return false;
+
+    std::vector<float> output;
+    if (!runRows(input, output)) {
+        std::cerr << "Failed to decode latent vectors" << std::endl;
+        return {};
+    }
+
+    // Split the output into one sequence per row, dropping the padding
+    std::vector<MidiSequence> sequences;
+    sequences.reserve(latents.size());
+    for (size_t row = 0; row < latents.size(); ++row) {
+        const auto rowBegin = output.begin() + row * rowSize;
+        MidiSequence sequence = MidiUtils::tensorToSequence(std::vector<float>(rowBegin, rowBegin + noteValues),
+                                                            m_ticksPerQuarter, m_maxSequenceLength);
+        sequence.notes.erase(std::remove_if(sequence.notes.begin(), sequence.notes.end(),
+                                            [](const MidiNote& note) {
+                                                return note.velocity <= 0 || note.duration <= 0;
+                                            }),
+                             sequence.notes.end());
+        sequences.push_back(std::move(sequence));
     }
+
+    return sequences;
 }
 
-bool MusicVAEModel::sample(std::vector<MidiNote>& notes) {
-    // Check if model is loaded
-    if (!isLoaded()) {
-        if (!load()) {
-            std::cerr << "Failed to load model" << std::endl;
-            return false;
-        }
+std::vector<float> MusicVAEModel::samplePrior(float temperature) {
+    thread_local std::mt19937 generator(std::random_device{}());
+    std::normal_distribution<float> distribution(0.0f, 1.0f);
+
+    std::vector<float> z(m_latentDimension);
+    for (auto& value : z) {
+        value = distribution(generator);
     }
-    
-    try {
-        // Generate random latent vector
-        std::vector<float> latentVector = generateRandomLatentVector();
-        
-        // Decode the latent vector
-        return decode(latentVector, notes);
+
+    return applyTemperature(z, temperature);
+}
+
+std::vector<MidiSequence> MusicVAEModel::sampleBatch(size_t count, float temperature) {
+    // Temperature is applied once, when decoding
+    std::vector<std::vector<float>> latents;
+    latents.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        latents.push_back(samplePrior());
     }
-    catch (const std::exception& e) {
-        std::cerr << "Error sampling from model: " << e.what() << std::endl;
-        return false;
+
+    return decodeBatch(latents, temperature);
+}
+
+std::vector<MidiSequence> MusicVAEModel::interpolate(const MidiSequence& sequence1,
+                                                     const MidiSequence& sequence2,
+                                                     int numSteps,
+                                                     float temperature) {
+    const std::vector<float> z1 = encode(sequence1);
+    const std::vector<float> z2 = encode(sequence2);
+    if (z1.empty() || z2.empty()) {
+        std::cerr << "Failed to encode interpolation endpoints" << std::endl;
+        return {};
     }
+
+    // Ensure at least 2 steps, and decode them all in one batch
+    numSteps = std::max(2, numSteps);
+    std::vector<std::vector<float>> latents(numSteps, std::vector<float>(m_latentDimension));
+    for (int step = 0; step < numSteps; ++step) {
+        const float t = static_cast<float>(step) / (numSteps - 1);
+        for (int i = 0; i < m_latentDimension; ++i) {
+            latents[step][i] = (1.0f - t) * z1[i] + t * z2[i];
+        }
+    }
+
+    return decodeBatch(latents, temperature);
 }
 
-bool MusicVAEModel::interpolate(const std::vector<MidiNote>& startNotes, 
-                              const std::vector<MidiNote>& endNotes, 
-                              int steps, 
-                              std::vector<std::vector<MidiNote>>& interpolatedSequences) {
-    // Check if model is loaded
-    if (!isLoaded()) {
-        if (!load()) {
-            std::cerr << "Failed to load model" << std::endl;
-            return false;
+int MusicVAEModel::getLatentDimension() const {
+    return m_latentDimension;
+}
+
+int MusicVAEModel::getMaxSequenceLength() const {
+    return m_maxSequenceLength;
+}
+
+std::vector<float> MusicVAEModel::applyTemperature(const std::vector<float>& z, float temperature) {
+    // Scale the distance from the prior mean
+    std::vector<float> scaled = z;
+    if (temperature != 1.0f) {
+        for (auto& value : scaled) {
+            value *= temperature;
         }
     }
-    
-    try {
-        // Encode start and end notes
-        std::vector<float> startLatent, endLatent;
-        
-        if (!encode(startNotes, startLatent)) {
-            std::cerr << "Failed to encode start notes" << std::endl;
-            return false;
+
+    return scaled;
+}
+
+std::vector<float> MusicVAEModel::toNoteValues(const MidiSequence& sequence) const {
+    // Rescale to the model's resolution and keep what fits in one row
+    MidiSequence fitted(m_ticksPerQuarter, m_maxSequenceLength,
+                        sequence.timeSignatureNumerator, sequence.timeSignatureDenominator);
+    const double scale = sequence.ticksPerQuarter > 0
+                             ? static_cast<double>(m_ticksPerQuarter) / sequence.ticksPerQuarter
+                             : 1.0;
+    for (const auto& note : sequence.notes) {
+        if (fitted.notes.size() >= static_cast<size_t>(m_noteCapacity)) {
+            break;
         }
-        
-        if (!encode(endNotes, endLatent)) {
-            std::cerr << "Failed to encode end notes" << std::endl;
-            return false;
+        MidiNote scaled = note;
+        scaled.startTime = static_cast<int>(std::lround(note.startTime * scale));
+        scaled.duration = static_cast<int>(std::lround(note.duration * scale));
+        if (scaled.startTime < 0 || scaled.startTime >= m_maxSequenceLength) {
+            continue;
         }
-        
-        // Interpolate between latent vectors
-        interpolatedSequences.clear();
-        interpolatedSequences.resize(steps);
-        
-        for (int i = 0; i < steps; ++i) {
-            // Calculate interpolation factor
-            float t = static_cast<float>(i) / (steps - 1);
-            
-            // Interpolate latent vectors
-            std::vector<float> interpolatedLatent(m_zDimension);
-            for (size_t j = 0; j < m_zDimension; ++j) {
-                interpolatedLatent[j] = (1.0f - t) * startLatent[j] + t * endLatent[j];
-            }
-            
-            // Decode interpolated latent vector
-            std::vector<MidiNote> notes;
-            if (!decode(interpolatedLatent, notes)) {
-                std::cerr << "Failed to decode interpolated latent vector at step " << i << std::endl;
-                return false;
-            }
-            
-            interpolatedSequences[i] = notes;
+        scaled.duration = std::max(1, std::min(scaled.duration, m_maxSequenceLength - scaled.startTime));
+        fitted.notes.push_back(scaled);
+    }
+
+    std::vector<float> values = MidiUtils::sequenceToTensor(fitted);
+    values.resize(static_cast<size_t>(m_noteCapacity) * kValuesPerNote, 0.0f);
+    return values;
+}
+
+bool MusicVAEModel::runRows(const std::vector<float>& input, std::vector<float>& output) {
+    // Check if model is initialized
+    if (!isInitialized()) {
+        std::cerr << "Model not initialized" << std::endl;
+        return false;
+    }
+
+    try {
+        // The input's batch dimension is resized to the number of rows
+        output = runInference(input);
+        if (output.size() != input.size()) {
+            std::cerr << "Unexpected MusicVAE output size: " << output.size() << std::endl;
+            return false;
         }
-        
         return true;
     }
     catch (const std::exception& e) {
-        std::cerr << "Error interpolating: " << e.what() << std::endl;
+        std::cerr << "Error running MusicVAE: " << e.what() << std::endl;
         return false;
     }
 }
 
-void MusicVAEModel::setTemperature(float temperature) {
-    m_temperature = std::max(0.0001f, std::min(2.0f, temperature));
-}
-
-float MusicVAEModel::getTemperature() const {
-    return m_temperature;
-}
-
-std::vector<float> MusicVAEModel::generateRandomLatentVector() const {
-    // Create random number generator
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::normal_distribution<float> dist(0.0f, 1.0f);
-    
-    // Generate random latent vector
-    std::vector<float> latentVector(m_zDimension);
-    for (size_t i = 0; i < m_zDimension; ++i) {
-        latentVector[i] = dist(gen);
-    }
-    
-    return latentVector;
-}
-
 } // namespace lmms_magenta
@@ -0,0 +1,276 @@
+#include "QuotaManager.h"
+#include "InferenceThreadPool.h"
+#include "../../utils/include/ThreadPolicy.h"
+#include <algorithm>
+#include <cmath>
+
+namespace lmms_magenta {
+
+ModelJob::ModelJob(JobStatus status, std::chrono::milliseconds retryAfter)
+    : m_manager(nullptr)
+    , m_status(status)
+    , m_retryAfter(retryAfter)
+    , m_scratchBytes(0)
+    , m_extraCpuSeconds(0.0)
+    , m_startThreadCpuSeconds(0.0)
+    , m_startDelegatedCpuSeconds(0.0) {
+}
+
+ModelJob::~ModelJob() {
+    finish();
+}
+
+ModelJob::ModelJob(ModelJob&& other) noexcept
+    : m_manager(other.m_manager)
+    , m_clientId(std::move(other.m_clientId))
+    , m_status(other.m_status)
+    , m_retryAfter(other.m_retryAfter)
+    , m_scratchBytes(other.m_scratchBytes)
+    , m_extraCpuSeconds(other.m_extraCpuSeconds)
+    , m_threadId(other.m_threadId)
+    , m_startThreadCpuSeconds(other.m_startThreadCpuSeconds)
+    , m_startDelegatedCpuSeconds(other.m_startDelegatedCpuSeconds)
+    , m_startTime(other.m_startTime) {
+    other.reset();
+}
+
+ModelJob& ModelJob::operator=(ModelJob&& other) noexcept {
+    if (this != &other) {
+        finish();
+        m_manager = other.m_manager;
+        m_clientId = std::move(other.m_clientId);
+        m_status = other.m_status;
+        m_retryAfter = other.m_retryAfter;
+        m_scratchBytes = other.m_scratchBytes;
+        m_extraCpuSeconds = other.m_extraCpuSeconds;
+        m_threadId = other.m_threadId;
+        m_startThreadCpuSeconds = other.m_startThreadCpuSeconds;
+        m_startDelegatedCpuSeconds = other.m_startDelegatedCpuSeconds;
+        m_startTime = other.m_startTime;
+        other.reset();
+    }
+    return *this;
+}
+
+bool ModelJob::isAdmitted() const {
+    return m_status == JobStatus::Admitted;
+}
+
+JobStatus ModelJob::getStatus() const {
+    return m_status;
+}
+
+std::chrono::milliseconds ModelJob::getRetryAfter() const {
+    return m_retryAfter;
+}
+
+void ModelJob::addCpuTime(double cpuSeconds) {
+    m_extraCpuSeconds += cpuSeconds;
+}
+
+void ModelJob::finish() {
+    if (!m_manager) {
+        return;
+    }
+
+    // Thread CPU time is only meaningful on the thread that started the job
+    double cpuSeconds;
+    if (std::this_thread::get_id() == m_threadId && m_startThreadCpuSeconds >= 0.0) {
+        cpuSeconds = ThreadPolicy::getThreadCpuSeconds() - m_startThreadCpuSeconds;
+
+        // Inferences run on the inference threads on behalf of this thread
+        addCpuTime(InferenceThreadPool::getDelegatedCpuSeconds() - m_startDelegatedCpuSeconds);
+    } else {
+        cpuSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+    }
+
+    m_manager->endJob(m_clientId, m_scratchBytes, cpuSeconds + m_extraCpuSeconds);
+    if (m_manager->m_jobFinishedCallback) {
+        m_manager->m_jobFinishedCallback(m_clientId, std::chrono::steady_clock::now() - m_startTime);
+    }
+    m_manager = nullptr;
+}
+
+void ModelJob::reset() {
+    m_manager = nullptr;
+    m_scratchBytes = 0;
+    m_extraCpuSeconds = 0.0;
+}
+
+QuotaManager::QuotaManager() = default;
+
+void QuotaManager::setQuota(const std::string& clientId, const ClientQuota& quota) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // A client that was not limited before starts with a full bucket
+        ClientState& client = getClient(clientId);
+        client.cpuCredit = client.quota.cpuBudget > 0.0 ? std::min(client.cpuCredit, quota.cpuBudget)
+                                                        : quota.cpuBudget;
+        client.quota = quota;
+        client.hasQuota = true;
+    }
+
+    // A raised limit may admit waiting jobs
+    m_jobFinished.notify_all();
+}
+
+void QuotaManager::setDefaultQuota(const ClientQuota& quota) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        m_defaultQuota = quota;
+        for (auto& pair : m_clients) {
+            ClientState& client = pair.second;
+            if (!client.hasQuota) {
+                client.cpuCredit = client.quota.cpuBudget > 0.0 ? std::min(client.cpuCredit, quota.cpuBudget)
+                                                                : quota.cpuBudget;
+                client.quota = quota;
+            }
+        }
+    }
+    m_jobFinished.notify_all();
+}
+
+ClientQuota QuotaManager::getQuota(const std::string& clientId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_clients.find(clientId);
+    return it != m_clients.end() ? it->second.quota : m_defaultQuota;
+}
+
+ModelJob QuotaManager::beginJob(const std::string& clientId, size_t scratchBytes,
+                                std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+        const auto now = std::chrono::steady_clock::now();
+        ClientState& client = getClient(clientId);
+        refillCpuCredit(client, now);
+
+        std::chrono::milliseconds retryAfter(0);
+        const JobStatus status = checkAdmission(client, scratchBytes, retryAfter);
+
+        if (status == JobStatus::Admitted) {
+            ++client.activeJobs;
+            client.scratchBytes += scratchBytes;
+
+            ModelJob job(JobStatus::Admitted);
+            job.m_manager = this;
+            job.m_clientId = clientId;
+            job.m_scratchBytes = scratchBytes;
+            job.m_threadId = std::this_thread::get_id();
+            job.m_startThreadCpuSeconds = ThreadPolicy::getThreadCpuSeconds();
+            job.m_startDelegatedCpuSeconds = InferenceThreadPool::getDelegatedCpuSeconds();
+            job.m_startTime = now;
+            return job;
+        }
+
+        // A job larger than the whole scratch quota can never be admitted
+        const bool canNeverFit = status == JobStatus::ScratchLimitExceeded &&
+                                 scratchBytes > client.quota.maxScratchBytes;
+        if (now >= deadline || canNeverFit) {
+            return ModelJob(status, retryAfter);
+        }
+
+        // Wait for a job to finish, or for the CPU bucket to refill
+        auto wakeUp = deadline;
+        if (retryAfter.count() > 0) {
+            wakeUp = std::min(wakeUp, now + retryAfter);
+        }
+        m_jobFinished.wait_until(lock, wakeUp);
+    }
+}
+
+void QuotaManager::removeClient(const std::string& clientId) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_clients.erase(clientId);
+}
+
+void QuotaManager::setJobFinishedCallback(std::function<void(const std::string&, std::chrono::nanoseconds)> callback) {
+    m_jobFinishedCallback = std::move(callback);
+}
+
+size_t QuotaManager::getActiveJobCount(const std::string& clientId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_clients.find(clientId);
+    return it != m_clients.end() ? it->second.activeJobs : 0;
+}
+
+size_t QuotaManager::getScratchUsage(const std::string& clientId) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_clients.find(clientId);
+    return it != m_clients.end() ? it->second.scratchBytes : 0;
+}
+
+QuotaManager::ClientState& QuotaManager::getClient(const std::string& clientId) {
+    auto it = m_clients.find(clientId);
+    if (it == m_clients.end()) {
+        ClientState client;
+        client.quota = m_defaultQuota;
+        client.cpuCredit = m_defaultQuota.cpuBudget;
+        client.lastRefill = std::chrono::steady_clock::now();
+        it = m_clients.emplace(clientId, client).first;
+    }
+    return it->second;
+}
+
+void QuotaManager::refillCpuCredit(ClientState& client, std::chrono::steady_clock::time_point now) {
+    const double elapsed = std::chrono::duration<double>(now - client.lastRefill).count();
+    client.lastRefill = now;
+
+    // The bucket holds at most one second's worth of budget
+    if (client.quota.cpuBudget > 0.0) {
+        client.cpuCredit = std::min(client.quota.cpuBudget,
+                                    client.cpuCredit + elapsed * client.quota.cpuBudget);
+    }
+}
+
+JobStatus QuotaManager::checkAdmission(const ClientState& client, size_t scratchBytes,
+                                       std::chrono::milliseconds& retryAfter) {
+    const ClientQuota& quota = client.quota;
+
+    if (quota.maxConcurrentJobs > 0 && client.activeJobs >= quota.maxConcurrentJobs) {
+        return JobStatus::TooManyJobs;
+    }
+
+    if (quota.maxScratchBytes > 0 && client.scratchBytes + scratchBytes > quota.maxScratchBytes) {
+        return JobStatus::ScratchLimitExceeded;
+    }
+
+    if (quota.cpuBudget > 0.0 && client.cpuCredit <= 0.0) {
+        // Time until the debt is repaid
+        const double seconds = -client.cpuCredit / quota.cpuBudget;
+        retryAfter = std::chrono::milliseconds(std::max<int64_t>(1, static_cast<int64_t>(std::ceil(seconds * 1000.0))));
+        return JobStatus::CpuBudgetExhausted;
+    }
+
+    return JobStatus::Admitted;
+}
+
+void QuotaManager::endJob(const std::string& clientId, size_t scratchBytes, double cpuSeconds) {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        // The client may have been removed while the job was running
+        auto it = m_clients.find(clientId);
+        if (it != m_clients.end()) {
+            ClientState& client = it->second;
+            client.activeJobs = client.activeJobs > 0 ? client.activeJobs - 1 : 0;
+            client.scratchBytes = client.scratchBytes > scratchBytes ? client.scratchBytes - scratchBytes : 0;
+
+            refillCpuCredit(client, std::chrono::steady_clock::now());
+            if (client.quota.cpuBudget > 0.0) {
+                client.cpuCredit -= std::max(0.0, cpuSeconds);
+            }
+        }
+    }
+    m_jobFinished.notify_all();
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,377 @@
+#include "SequenceDecoder.h"
+#include "../../utils/include/ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <numeric>
+#include <random>
+
+namespace lmms_magenta {
+
+SequenceDecoder::SequenceDecoder(StepFunction stepFunction, int vocabSize)
+    : m_stepFunction(std::move(stepFunction))
+    , m_vocabSize(vocabSize) {
+}
+
+SequenceDecoder::StepFunction SequenceDecoder::fromModel(std::shared_ptr<TensorFlowLiteModel> model,
+                                                         int vocabSize, int stateSize) {
+    return [model, vocabSize, stateSize](const std::vector<int>& tokens,
+                                         const std::vector<DecoderStatePtr>& states,
+                                         std::vector<float>& logits,
+                                         std::vector<DecoderStatePtr>& newStates) {
+        const size_t rowSize = static_cast<size_t>(vocabSize) + stateSize;
+        const size_t batchSize = tokens.size();
+        if (states.size() != batchSize) {
+            std::cerr << "Decoder step has " << states.size() << " states for " << batchSize << " tokens" << std::endl;
+            return false;
+        }
+
+        // Pack the whole batch into a single input tensor
+        std::vector<float> input(batchSize * rowSize, 0.0f);
+        for (size_t b = 0; b < batchSize; ++b) {
+            if (tokens[b] < 0 || tokens[b] >= vocabSize) {
+                std::cerr << "Decoder token out of range: " << tokens[b] << std::endl;
+                return false;
+            }
+            if (states[b] && states[b]->size() != static_cast<size_t>(stateSize)) {
+                std::cerr << "Unexpected decoder state size: " << states[b]->size() << std::endl;
+                return false;
+            }
+
+            float* row = &input[b * rowSize];
+            row[tokens[b]] = 1.0f;
+            if (states[b]) {
+                std::copy(states[b]->begin(), states[b]->end(), row + vocabSize);
+            }
+        }
+
+        std::vector<float> output = model->runInference(input);
+        if (output.size() != batchSize * rowSize) {
+            std::cerr << "Unexpected decoder output size: " << output.size() << std::endl;
+            return false;
+        }
+
+        logits.resize(batchSize * vocabSize);
+        newStates.resize(batchSize);
+        for (size_t b = 0; b < batchSize; ++b) {
+            const float* row = &output[b * rowSize];
+            std::copy(row, row + vocabSize, &logits[b * vocabSize]);
+            newStates[b] = std::make_shared<const std::vector<float>>(row + vocabSize, row + rowSize);
+        }
+
+        return true;
+    };
+}
+
+std::vector<DecodedSequence> SequenceDecoder::decode(const DecoderStatePtr& initialState,
+                                                     const DecodingOptions& options) const {
+    if (!validateOptions(options)) {
+        return std::vector<DecodedSequence>();
+    }
+
+    if (options.strategy == DecodingStrategy::BeamSearch) {
+        return beamSearch(initialState, options);
+    }
+
+    return sample(initialState, options, options.seed);
+}
+
+std::vector<std::vector<DecodedSequence>> SequenceDecoder::decodeGroups(
+        const std::vector<DecoderStatePtr>& initialStates,
+        const DecodingOptions& options,
+        ThreadPool& pool) const {
+    if (!validateOptions(options)) {
+        return std::vector<std::vector<DecodedSequence>>(initialStates.size());
+    }
+
+    std::vector<std::future<std::vector<DecodedSequence>>> futures;
+    futures.reserve(initialStates.size());
+
+    // Each group is independent, so groups run on separate workers
+    for (size_t g = 0; g < initialStates.size(); ++g) {
+        const DecoderStatePtr state = initialStates[g];
+        const uint32_t seed = options.seed + static_cast<uint32_t>(g) * 7919u;
+
+        futures.push_back(pool.submit([this, state, options, seed]() {
+            if (options.strategy == DecodingStrategy::BeamSearch) {
+                return beamSearch(state, options);
+            }
+            return sample(state, options, seed);
+        }));
+    }
+
+    std::vector<std::vector<DecodedSequence>> results;
+    results.reserve(futures.size());
+    for (auto& future : futures) {
+        results.push_back(future.get());
+    }
+
+    return results;
+}
+
+int SequenceDecoder::getVocabSize() const {
+    return m_vocabSize;
+}
+
+bool SequenceDecoder::validateOptions(const DecodingOptions& options) const {
+    if (options.startToken < 0 || options.startToken >= m_vocabSize) {
+        std::cerr << "Start token " << options.startToken << " outside vocabulary of " << m_vocabSize << std::endl;
+        return false;
+    }
+
+    // -1 disables the end token
+    if (options.endToken < -1 || options.endToken >= m_vocabSize) {
+        std::cerr << "End token " << options.endToken << " outside vocabulary of " << m_vocabSize << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+bool SequenceDecoder::validateStep(size_t numRows, const std::vector<float>& logits,
+                                   const std::vector<DecoderStatePtr>& newStates) const {
+    if (logits.size() != numRows * m_vocabSize || newStates.size() != numRows) {
+        std::cerr << "Decoder step returned " << logits.size() << " logits and " << newStates.size()
+                  << " states for " << numRows << " rows" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+std::vector<DecodedSequence> SequenceDecoder::beamSearch(const DecoderStatePtr& initialState,
+                                                         const DecodingOptions& options) const {
+    const int beamWidth = std::max(1, options.beamWidth);
+
+    std::vector<Candidate> beams;
+    beams.push_back(Candidate{nullptr, initialState, options.startToken, 0.0f, false});
+
+    std::vector<int> tokens;
+    std::vector<DecoderStatePtr> states;
+    std::vector<size_t> activeIndices;
+    std::vector<float> logits;
+    std::vector<DecoderStatePtr> newStates;
+    std::vector<int> order(m_vocabSize);
+
+    // Expansion: (score, beam index, token); token -1 keeps a finished beam
+    struct Expansion {
+        float score;
+        size_t beam;
+        int token;
+    };
+    std::vector<Expansion> expansions;
+
+    for (int step = 0; step < options.maxSteps; ++step) {
+        tokens.clear();
+        states.clear();
+        activeIndices.clear();
+        for (size_t i = 0; i < beams.size(); ++i) {
+            if (!beams[i].finished) {
+                tokens.push_back(beams[i].lastToken);
+                states.push_back(beams[i].state);
+                activeIndices.push_back(i);
+            }
+        }
+
+        if (activeIndices.empty()) {
+            break;
+        }
+
+        // Advance all live beams with one batched step
+        if (!m_stepFunction(tokens, states, logits, newStates) ||
+            !validateStep(activeIndices.size(), logits, newStates)) {
+            std::cerr << "Decoder step failed" << std::endl;
+            break;
+        }
+
+        expansions.clear();
+        for (size_t i = 0; i < beams.size(); ++i) {
+            if (beams[i].finished) {
+                expansions.push_back(Expansion{beams[i].score, i, -1});
+            }
+        }
+
+        for (size_t a = 0; a < activeIndices.size(); ++a) {
+            float* row = &logits[a * m_vocabSize];
+            logSoftmax(row, m_vocabSize, options.temperature);
+
+            // Only the best beamWidth tokens of a beam can survive pruning
+            const int keep = std::min(beamWidth, m_vocabSize);
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + keep, order.end(),
+                              [row](int x, int y) { return row[x] > row[y]; });
+
+            const Candidate& beam = beams[activeIndices[a]];
+            for (int k = 0; k < keep; ++k) {
+                expansions.push_back(Expansion{beam.score + row[order[k]], a, order[k]});
+            }
+        }
+
+        // Global top-k over the per-beam survivors
+        const size_t keep = std::min(static_cast<size_t>(beamWidth), expansions.size());
+        std::partial_sort(expansions.begin(), expansions.begin() + keep, expansions.end(),
+                          [](const Expansion& x, const Expansion& y) { return x.score > y.score; });
+
+        std::vector<Candidate> next;
+        next.reserve(keep);
+        for (size_t k = 0; k < keep; ++k) {
+            const Expansion& expansion = expansions[k];
+            if (expansion.token < 0) {
+                next.push_back(beams[expansion.beam]);
+                continue;
+            }
+
+            const Candidate& parent = beams[activeIndices[expansion.beam]];
+
+            // Children share the parent's prefix and the step's new state
+            auto node = std::make_shared<const PrefixNode>(PrefixNode{expansion.token, parent.prefix});
+            next.push_back(Candidate{node, newStates[expansion.beam], expansion.token, expansion.score,
+                                     expansion.token == options.endToken});
+        }
+
+        beams.swap(next);
+    }
+
+    std::vector<DecodedSequence> results;
+    results.reserve(beams.size());
+    for (const auto& beam : beams) {
+        results.push_back(DecodedSequence{unwindPrefix(beam.prefix), beam.score});
+    }
+
+    std::sort(results.begin(), results.end(),
+              [](const DecodedSequence& x, const DecodedSequence& y) {
+                  return x.logProbability > y.logProbability;
+              });
+
+    return results;
+}
+
+std::vector<DecodedSequence> SequenceDecoder::sample(const DecoderStatePtr& initialState,
+                                                     const DecodingOptions& options,
+                                                     uint32_t seed) const {
+    const int numCandidates = std::max(1, options.numCandidates);
+    const int topK = (options.topK > 0) ? std::min(options.topK, m_vocabSize) : m_vocabSize;
+    const float topP = std::max(0.0f, std::min(1.0f, options.topP));
+
+    std::mt19937 rng(seed);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+    std::vector<Candidate> candidates(numCandidates,
+                                      Candidate{nullptr, initialState, options.startToken, 0.0f, false});
+
+    std::vector<int> tokens;
+    std::vector<DecoderStatePtr> states;
+    std::vector<size_t> activeIndices;
+    std::vector<float> logits;
+    std::vector<DecoderStatePtr> newStates;
+    std::vector<int> order(m_vocabSize);
+
+    for (int step = 0; step < options.maxSteps; ++step) {
+        tokens.clear();
+        states.clear();
+        activeIndices.clear();
+        for (size_t i = 0; i < candidates.size(); ++i) {
+            if (!candidates[i].finished) {
+                tokens.push_back(candidates[i].lastToken);
+                states.push_back(candidates[i].state);
+                activeIndices.push_back(i);
+            }
+        }
+
+        if (activeIndices.empty()) {
+            break;
+        }
+
+        // Advance all live candidates with one batched step
+        if (!m_stepFunction(tokens, states, logits, newStates) ||
+            !validateStep(activeIndices.size(), logits, newStates)) {
+            std::cerr << "Decoder step failed" << std::endl;
+            break;
+        }
+
+        for (size_t a = 0; a < activeIndices.size(); ++a) {
+            float* row = &logits[a * m_vocabSize];
+            logSoftmax(row, m_vocabSize, options.temperature);
+
+            // Top-k by partial sort
+            std::iota(order.begin(), order.end(), 0);
+            std::partial_sort(order.begin(), order.begin() + topK, order.end(),
+                              [row](int x, int y) { return row[x] > row[y]; });
+
+            // Nucleus: smallest prefix of the top-k covering topP of the mass
+            int cutoff = 0;
+            float mass = 0.0f;
+            while (cutoff < topK) {
+                mass += std::exp(row[order[cutoff]]);
+                ++cutoff;
+                if (mass >= topP) {
+                    break;
+                }
+            }
+
+            // Sample from the renormalized truncated distribution
+            float target = uniform(rng) * mass;
+            int token = order[cutoff - 1];
+            for (int k = 0; k < cutoff; ++k) {
+                target -= std::exp(row[order[k]]);
+                if (target <= 0.0f) {
+                    token = order[k];
+                    break;
+                }
+            }
+
+            Candidate& candidate = candidates[activeIndices[a]];
+            candidate.prefix = std::make_shared<const PrefixNode>(PrefixNode{token, candidate.prefix});
+            candidate.state = newStates[a];
+            candidate.lastToken = token;
+            candidate.score += row[token];
+            candidate.finished = (token == options.endToken);
+        }
+    }
+
+    std::vector<DecodedSequence> results;
+    results.reserve(candidates.size());
+    for (const auto& candidate : candidates) {
+        results.push_back(DecodedSequence{unwindPrefix(candidate.prefix), candidate.score});
+    }
+
+    std::sort(results.begin(), results.end(),
+              [](const DecodedSequence& x, const DecodedSequence& y) {
+                  return x.logProbability > y.logProbability;
+              });
+
+    return results;
+}
+
+void SequenceDecoder::logSoftmax(float* values, int count, float temperature) {
+    const float invTemperature = 1.0f / std::max(0.0001f, temperature);
+
+    float maxValue = -std::numeric_limits<float>::infinity();
+    for (int i = 0; i < count; ++i) {
+        values[i] *= invTemperature;
+        maxValue = std::max(maxValue, values[i]);
+    }
+
+    double sum = 0.0;
+    for (int i = 0; i < count; ++i) {
+        sum += std::exp(values[i] - maxValue);
+    }
+
+    const float logSum = maxValue + static_cast<float>(std::log(sum));
+    for (int i = 0; i < count; ++i) {
+        values[i] -= logSum;
+    }
+}
+
+std::vector<int> SequenceDecoder::unwindPrefix(const std::shared_ptr<const PrefixNode>& prefix) {
+    std::vector<int> tokens;
+    for (const PrefixNode* node = prefix.get(); node; node = node->parent.get()) {
+        tokens.push_back(node->token);
+    }
+
+    std::reverse(tokens.begin(), tokens.end());
+    return tokens;
+}
+
+} // namespace lmms_magenta
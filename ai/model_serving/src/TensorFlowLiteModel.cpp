@@ -1,28 +1,67 @@
 #include "TensorFlowLiteModel.h"
+#include "WeightStore.h"
+#include "WarmStartCache.h"
+#include "InferenceThreadPool.h"
+#include "TensorQuantization.h"
+#include "MetricsRegistry.h"
+#include "../../utils/include/Trace.h"
+#include "tensorflow/lite/core/subgraph.h"
+#include "tensorflow/lite/interpreter.h"
+#include "tensorflow/lite/kernels/register.h"
+#include "tensorflow/lite/model.h"
+#ifdef LMMS_MAGENTA_ENABLE_XNNPACK
+#include "tensorflow/lite/delegates/xnnpack/xnnpack_delegate.h"
+#endif
+#include <algorithm>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
 
 namespace lmms_magenta {
 
-TensorFlowLiteModel::TensorFlowLiteModel(const std::string& modelPath)
+TensorFlowLiteModel::TensorFlowLiteModel(const std::string& modelPath, const ModelMetadata& metadata)
     : m_modelPath(modelPath)
-    , m_interpreter(nullptr)
+    , m_metadata(metadata)
     , m_model(nullptr)
-    , m_isLoaded(false)
-    , m_enableGPU(false) {
+    , m_interpreter(nullptr)
+    , m_isInitialized(false)
+    , m_isUsingGPU(false)
+    , m_numThreads(0)
+    , m_delegate(nullptr, nullptr)
+    , m_isPlanChanged(false) {
+    // Look the histograms up once; recording is then lock-free
+    MetricsRegistry& metrics = ModelServer::getInstance().getMetrics();
+    const std::string label = ModelServer::getModelLabel(metadata.type, metadata.name);
+    m_queueWaitHistogram = &metrics.getHistogram(MetricsRegistry::kQueueWaitSeconds, "model", label);
+    m_inferenceHistogram = &metrics.getHistogram(MetricsRegistry::kInferenceSeconds, "model", label);
+    m_requestHistogram = &metrics.getHistogram(MetricsRegistry::kRequestSeconds, "model", label);
 }
 
 TensorFlowLiteModel::~TensorFlowLiteModel() {
-    unload();
+    // Remember the shape this session ran with for the next warm start
+    if (m_warmStartCache && m_isPlanChanged) {
+        WarmStartPlan plan;
+        plan.inputShape = m_plannedInputShape;
+        plan.arenaBytes = getMemoryStats().arenaBytes;
+        m_warmStartCache->savePlan(m_metadata, plan);
+    }
+    
+    // The interpreter references the delegate and the model buffer, so it must go first
+    m_interpreter.reset();
+    m_delegate.reset();
+    m_model.reset();
 }
 
-bool TensorFlowLiteModel::load() {
-    // Check if already loaded
-    if (m_isLoaded) {
+bool TensorFlowLiteModel::initialize() {
+    std::lock_guard<std::mutex> lock(m_inferenceMutex);
+
+    // Check if already initialized
+    if (m_isInitialized) {
         return true;
     }
-    
+
     try {
         // Check if model file exists
         std::ifstream modelFile(m_modelPath, std::ios::binary);
@@ -30,136 +69,402 @@ bool TensorFlowLiteModel::load() {
             std::cerr << "Model file not found: " << m_modelPath << std::endl;
             return false;
         }
-        
-        // In a real implementation, we would:
-        // 1. Load the TensorFlow Lite model
-        // 2. Create an interpreter
-        // 3. Allocate tensors
-        
-        // For now, just log that we're loading the model
-        std::cout << "Loading TensorFlow Lite model: " << m_modelPath << std::endl;
-        
-        // Set loaded flag
-        m_isLoaded = true;
-        
-        return true;
+
+        // Map the model file, sharing it with other instances of identical weights
+        ModelMetadata source = m_metadata;
+        source.filePath = m_modelPath;
+        m_model = WeightStore::getInstance().acquire(source);
+        if (!m_model) {
+            std::cerr << "Failed to load TensorFlow Lite model: " << m_modelPath << std::endl;
+            return false;
+        }
     }
     catch (const std::exception& e) {
         std::cerr << "Error loading TensorFlow Lite model: " << e.what() << std::endl;
+        m_model.reset();
         return false;
     }
+
+    // Build on an inference thread so that kernel and delegate threads inherit
+    // its policy, and the arena is first touched on its NUMA node
+    return InferenceThreadPool::getInstance().run(m_numThreads, [this]() { return buildInterpreter(); });
 }
 
-void TensorFlowLiteModel::unload() {
-    if (!m_isLoaded) {
-        return;
+bool TensorFlowLiteModel::buildInterpreter() {
+    LMMS_MAGENTA_TRACE_SCOPE("model", "build_interpreter");
+
+    try {
+        // Create the interpreter
+        tflite::ops::builtin::BuiltinOpResolver resolver;
+        tflite::InterpreterBuilder builder(*m_model, resolver);
+        builder.SetNumThreads(getEffectiveNumThreads());
+        if (builder(&m_interpreter) != kTfLiteOk || !m_interpreter) {
+            std::cerr << "Failed to create interpreter for: " << m_modelPath << std::endl;
+            m_model.reset();
+            return false;
+        }
+
+        // Run the kernels on the context leased by this task
+        attachCpuBackendContext();
+
+        applyDelegate();
+
+        // Allocate for the shape recorded by the previous session, if any
+        WarmStartPlan plan;
+        if (m_warmStartCache && m_warmStartCache->loadPlan(m_metadata, plan) && !m_interpreter->inputs().empty()) {
+            if (m_interpreter->ResizeInputTensor(m_interpreter->inputs()[0], plan.inputShape) != kTfLiteOk) {
+                std::cerr << "Ignoring stale warm-start plan for: " << m_modelPath << std::endl;
+            }
+        }
+
+        // Plan and allocate the tensor arena
+        if (m_interpreter->AllocateTensors() != kTfLiteOk) {
+            std::cerr << "Failed to allocate tensors for: " << m_modelPath << std::endl;
+            m_interpreter.reset();
+            m_model.reset();
+            return false;
+        }
+
+        m_plannedInputShape = getInputShape();
+        updateMemoryStats();
+        m_isInitialized = true;
+        return true;
     }
-    
-    // In a real implementation, we would:
-    // 1. Delete the interpreter
-    // 2. Delete the model
-    
-    // For now, just log that we're unloading the model
-    std::cout << "Unloading TensorFlow Lite model: " << m_modelPath << std::endl;
-    
-    // Reset member variables
-    m_interpreter = nullptr;
-    m_model = nullptr;
-    m_isLoaded = false;
+    catch (const std::exception& e) {
+        std::cerr << "Error loading TensorFlow Lite model: " << e.what() << std::endl;
+        m_interpreter.reset();
+        m_model.reset();
+        return false;
+    }
+}
+
+bool TensorFlowLiteModel::isInitialized() const {
+    return m_isInitialized;
 }
 
-bool TensorFlowLiteModel::isLoaded() const {
-    return m_isLoaded;
+ModelMetadata TensorFlowLiteModel::getMetadata() const {
+    return m_metadata;
 }
 
 size_t TensorFlowLiteModel::getMemoryUsage() const {
-    // In a real implementation, we would return the actual memory usage
-    // For now, just return a placeholder value
-    return 50 * 1024 * 1024; // 50 MB
+    return getMemoryStats().total();
 }
 
-void TensorFlowLiteModel::enableGPU(bool enable) {
-    m_enableGPU = enable;
-    
-    // If model is already loaded, reload it with new GPU setting
-    if (m_isLoaded) {
-        unload();
-        load();
+ModelMemoryStats TensorFlowLiteModel::getMemoryStats() const {
+    ModelMemoryStats stats;
+    {
+        std::lock_guard<std::mutex> lock(m_statsMutex);
+        stats = m_memoryStats;
     }
+    stats.cacheBytes = getCacheMemoryUsage();
+    return stats;
 }
 
-bool TensorFlowLiteModel::isGPUEnabled() const {
-    return m_enableGPU;
+bool TensorFlowLiteModel::warmUp() {
+    LMMS_MAGENTA_TRACE_SCOPE("model", "warm_up");
+    std::lock_guard<std::mutex> lock(m_inferenceMutex);
+
+    if (!m_isInitialized) {
+        std::cerr << "Model not initialized" << std::endl;
+        return false;
+    }
+
+    return InferenceThreadPool::getInstance().run(m_numThreads, [this]() {
+        attachCpuBackendContext();
+
+        // Use the current (planned) shape so the arena is not replanned
+        const TfLiteTensor* tensor = m_interpreter->tensor(m_interpreter->inputs()[0]);
+        size_t inputSize = 1;
+        for (int i = 0; i < tensor->dims->size; ++i) {
+            inputSize *= static_cast<size_t>(tensor->dims->data[i]);
+        }
+
+        if (!prepareInputTensor(std::vector<float>(inputSize, 0.0f))) {
+            return false;
+        }
+
+        // The first Invoke prepares kernels and touches every weight page
+        if (m_interpreter->Invoke() != kTfLiteOk) {
+            std::cerr << "Warm-up inference failed: " << m_modelPath << std::endl;
+            return false;
+        }
+
+        // A broken model usually shows up as NaN or infinite outputs
+        std::vector<float> output;
+        if (!extractOutputTensor(output)) {
+            return false;
+        }
+        for (float value : output) {
+            if (!std::isfinite(value)) {
+                std::cerr << "Warm-up inference produced invalid output: " << m_modelPath << std::endl;
+                return false;
+            }
+        }
+
+        updateMemoryStats();
+        return true;
+    });
 }
 
-bool TensorFlowLiteModel::isGPUAvailable() const {
-    // Placeholder for actual GPU availability check
-    // In a real implementation, we would check if TensorFlow can use GPU
-    return false;
+std::vector<float> TensorFlowLiteModel::runInference(const std::vector<float>& inputTensor) {
+    std::vector<float> output;
+    runInference(inputTensor, output);
+    return output;
 }
 
-std::vector<std::string> TensorFlowLiteModel::getInputNames() const {
-    // In a real implementation, we would return the actual input names
-    // For now, just return placeholder values
-    return {"input"};
+bool TensorFlowLiteModel::runInference(const std::vector<float>& inputTensor, std::vector<float>& output) {
+    const auto requestStart = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(m_inferenceMutex);
+
+    // Check if model is initialized
+    if (!m_isInitialized) {
+        std::cerr << "Model not initialized" << std::endl;
+        output.clear();
+        return false;
+    }
+
+    const bool isSuccess = InferenceThreadPool::getInstance().run(m_numThreads, [&]() {
+        // Waiting for other inferences of this model and for an inference thread
+        m_queueWaitHistogram->record(std::chrono::steady_clock::now() - requestStart);
+        attachCpuBackendContext();
+
+        {
+            LMMS_MAGENTA_TRACE_SCOPE("inference", "tensor_prep");
+            if (!prepareInputTensor(inputTensor)) {
+                return false;
+            }
+        }
+
+        {
+            LMMS_MAGENTA_TRACE_SCOPE("inference", "invoke");
+            const auto invokeStart = std::chrono::steady_clock::now();
+            if (m_interpreter->Invoke() != kTfLiteOk) {
+                std::cerr << "Inference failed: " << m_modelPath << std::endl;
+                return false;
+            }
+            m_inferenceHistogram->record(std::chrono::steady_clock::now() - invokeStart);
+        }
+
+        {
+            LMMS_MAGENTA_TRACE_SCOPE("inference", "result_conversion");
+            if (!extractOutputTensor(output)) {
+                return false;
+            }
+        }
+
+        // Dynamic tensors may have grown during the call
+        updateMemoryStats();
+
+        return true;
+    });
+
+    if (!isSuccess) {
+        output.clear();
+    }
+
+    m_requestHistogram->record(std::chrono::steady_clock::now() - requestStart);
+    return isSuccess;
 }
 
-std::vector<std::string> TensorFlowLiteModel::getOutputNames() const {
-    // In a real implementation, we would return the actual output names
-    // For now, just return placeholder values
-    return {"output"};
+std::vector<int> TensorFlowLiteModel::getInputShape() const {
+    if (!m_interpreter || m_interpreter->inputs().empty()) {
+        return m_metadata.inputShapes.empty() ? std::vector<int>() : m_metadata.inputShapes[0];
+    }
+
+    const TfLiteTensor* tensor = m_interpreter->tensor(m_interpreter->inputs()[0]);
+    return std::vector<int>(tensor->dims->data, tensor->dims->data + tensor->dims->size);
 }
 
-std::vector<int> TensorFlowLiteModel::getInputShape(const std::string& name) const {
-    // In a real implementation, we would return the actual input shape
-    // For now, just return placeholder values
-    return {1, 128, 128, 3};
+std::vector<int> TensorFlowLiteModel::getOutputShape() const {
+    if (!m_interpreter || m_interpreter->outputs().empty()) {
+        return m_metadata.outputShapes.empty() ? std::vector<int>() : m_metadata.outputShapes[0];
+    }
+
+    const TfLiteTensor* tensor = m_interpreter->tensor(m_interpreter->outputs()[0]);
+    return std::vector<int>(tensor->dims->data, tensor->dims->data + tensor->dims->size);
 }
 
-std::vector<int> TensorFlowLiteModel::getOutputShape(const std::string& name) const {
-    // In a real implementation, we would return the actual output shape
-    // For now, just return placeholder values
-    return {1, 10};
+void TensorFlowLiteModel::setNumThreads(int numThreads) {
+    std::lock_guard<std::mutex> lock(m_inferenceMutex);
+
+    // Applied to each inference; the kernel threads themselves are shared
+    m_numThreads = numThreads;
 }
 
-bool TensorFlowLiteModel::setInputTensor(const std::string& name, const std::vector<float>& data) {
-    // Check if model is loaded
-    if (!m_isLoaded) {
-        std::cerr << "Model not loaded" << std::endl;
-        return false;
+void TensorFlowLiteModel::attachCpuBackendContext() {
+    TfLiteExternalContext* context = InferenceThreadPool::getCurrentCpuBackendContext();
+    if (context) {
+        m_interpreter->SetExternalContext(kTfLiteCpuBackendContext, context);
     }
-    
-    // In a real implementation, we would set the input tensor data
-    // For now, just log that we're setting the input tensor
-    std::cout << "Setting input tensor: " << name << std::endl;
-    
-    return true;
 }
 
-bool TensorFlowLiteModel::run() {
-    // Check if model is loaded
-    if (!m_isLoaded) {
-        std::cerr << "Model not loaded" << std::endl;
-        return false;
+int TensorFlowLiteModel::getEffectiveNumThreads() const {
+    const int available = InferenceThreadPool::getInstance().getNumThreads();
+    return m_numThreads > 0 ? std::min(m_numThreads, available) : available;
+}
+
+bool TensorFlowLiteModel::setUseGPU(bool useGPU) {
+    if (!useGPU) {
+        m_isUsingGPU = false;
+        return true;
     }
-    
-    // In a real implementation, we would run the model
-    // For now, just log that we're running the model
-    std::cout << "Running TensorFlow Lite model" << std::endl;
-    
-    return true;
+
+    // No GPU delegate is linked into this build
+    std::cerr << "GPU acceleration not available for: " << m_modelPath << std::endl;
+    m_isUsingGPU = false;
+    return false;
 }
 
-std::vector<float> TensorFlowLiteModel::getOutputTensor(const std::string& name) const {
-    // Check if model is loaded
-    if (!m_isLoaded) {
-        std::cerr << "Model not loaded" << std::endl;
-        return {};
+bool TensorFlowLiteModel::isUsingGPU() const {
+    return m_isUsingGPU;
+}
+
+void TensorFlowLiteModel::setWarmStartCache(std::shared_ptr<const WarmStartCache> cache) {
+    std::lock_guard<std::mutex> lock(m_inferenceMutex);
+
+    if (m_isInitialized) {
+        std::cerr << "Warm-start cache must be set before initialization" << std::endl;
+        return;
     }
-    
-    // In a real implementation, we would get the output tensor data
-    // For now, just return placeholder values
-    return std::vector<float>(10, 0.1f);
+
+    m_warmStartCache = std::move(cache);
+}
+
+void TensorFlowLiteModel::applyDelegate() {
+#ifdef LMMS_MAGENTA_ENABLE_XNNPACK
+    TfLiteXNNPackDelegateOptions options = TfLiteXNNPackDelegateOptionsDefault();
+    options.num_threads = getEffectiveNumThreads();
+
+    // Packed weights are written on the first load and mapped on later ones
+    if (m_warmStartCache) {
+        m_weightCachePath = m_warmStartCache->getWeightCachePath(m_metadata);
+        if (!m_weightCachePath.empty()) {
+            options.weight_cache_file_path = m_weightCachePath.c_str();
+        }
+    }
+
+    m_delegate = std::unique_ptr<TfLiteDelegate, void (*)(TfLiteDelegate*)>(
+        TfLiteXNNPackDelegateCreate(&options), TfLiteXNNPackDelegateDelete);
+
+    if (!m_delegate || m_interpreter->ModifyGraphWithDelegate(m_delegate.get()) != kTfLiteOk) {
+        // The built-in kernels still run the model
+        std::cerr << "XNNPACK delegate not applied for: " << m_modelPath << std::endl;
+    }
+#endif
+}
+
+bool TensorFlowLiteModel::prepareInputTensor(const std::vector<float>& inputData) {
+    const int inputIndex = m_interpreter->inputs()[0];
+    TfLiteTensor* tensor = m_interpreter->tensor(inputIndex);
+
+    // Resize the batch dimension when a different number of rows is passed
+    size_t rowSize = 1;
+    for (int i = 1; i < tensor->dims->size; ++i) {
+        rowSize *= static_cast<size_t>(tensor->dims->data[i]);
+    }
+
+    const size_t currentSize = tensor->dims->size > 0 ? rowSize * tensor->dims->data[0] : 1;
+    if (inputData.size() != currentSize) {
+        if (tensor->dims->size == 0 || rowSize == 0 || inputData.size() % rowSize != 0) {
+            std::cerr << "Input size " << inputData.size() << " does not match model input" << std::endl;
+            return false;
+        }
+
+        std::vector<int> shape(tensor->dims->data, tensor->dims->data + tensor->dims->size);
+        shape[0] = static_cast<int>(inputData.size() / rowSize);
+        if (m_interpreter->ResizeInputTensor(inputIndex, shape) != kTfLiteOk ||
+            m_interpreter->AllocateTensors() != kTfLiteOk) {
+            std::cerr << "Failed to resize model input" << std::endl;
+            return false;
+        }
+
+        // The arena was replanned
+        updateMemoryStats();
+        m_plannedInputShape = shape;
+        m_isPlanChanged = true;
+        tensor = m_interpreter->tensor(inputIndex);
+    }
+
+    switch (tensor->type) {
+        case kTfLiteFloat32:
+            std::copy(inputData.begin(), inputData.end(), tensor->data.f);
+            return true;
+        case kTfLiteInt8:
+            TensorQuantization::quantize(inputData.data(), inputData.size(), tensor->params.scale,
+                                         tensor->params.zero_point, tensor->data.int8);
+            return true;
+        case kTfLiteUInt8:
+            TensorQuantization::quantize(inputData.data(), inputData.size(), tensor->params.scale,
+                                         tensor->params.zero_point, tensor->data.uint8);
+            return true;
+        default:
+            std::cerr << "Unsupported input tensor type: " << tensor->type << std::endl;
+            return false;
+    }
+}
+
+bool TensorFlowLiteModel::extractOutputTensor(std::vector<float>& output) {
+    const TfLiteTensor* tensor = m_interpreter->tensor(m_interpreter->outputs()[0]);
+
+    size_t size = 1;
+    for (int i = 0; i < tensor->dims->size; ++i) {
+        size *= static_cast<size_t>(tensor->dims->data[i]);
+    }
+
+    // Reuses the caller's capacity, so a reserved buffer is never reallocated
+    output.resize(size);
+    switch (tensor->type) {
+        case kTfLiteFloat32:
+            std::copy(tensor->data.f, tensor->data.f + size, output.begin());
+            return true;
+        case kTfLiteInt8:
+            TensorQuantization::dequantize(tensor->data.int8, size, tensor->params.scale,
+                                           tensor->params.zero_point, output.data());
+            return true;
+        case kTfLiteUInt8:
+            TensorQuantization::dequantize(tensor->data.uint8, size, tensor->params.scale,
+                                           tensor->params.zero_point, output.data());
+            return true;
+        default:
+            std::cerr << "Unsupported output tensor type: " << tensor->type << std::endl;
+            return false;
+    }
+}
+
+size_t TensorFlowLiteModel::getCacheMemoryUsage() const {
+    return 0;
+}
+
+void TensorFlowLiteModel::updateMemoryStats() {
+    ModelMemoryStats stats;
+
+    // Shared weights: the model buffer (mapped from the file when possible)
+    if (m_model && m_model->allocation()) {
+        stats.sharedWeightBytes = m_model->allocation()->bytes();
+        stats.weightKey = m_metadata.contentHash;
+    }
+
+    if (m_interpreter) {
+        // Arena sizes as planned by each subgraph's allocator (tensors share arena space,
+        // so summing tensor sizes would overcount)
+        for (size_t i = 0; i < m_interpreter->subgraphs_size(); ++i) {
+            tflite::SubgraphAllocInfo info = {};
+            m_interpreter->subgraph(static_cast<int>(i))->GetMemoryAllocInfo(&info);
+            stats.arenaBytes += info.arena_size + info.arena_persist_size;
+            stats.scratchBytes += info.dynamic_size + info.resource_size;
+        }
+
+        // Constants materialized by this interpreter at prepare time (e.g. dequantized weights)
+        for (size_t i = 0; i < m_interpreter->tensors_size(); ++i) {
+            const TfLiteTensor* tensor = m_interpreter->tensor(static_cast<int>(i));
+            if (tensor && tensor->allocation_type == kTfLitePersistentRo) {
+                stats.weightBytes += tensor->bytes;
+            }
+        }
+    }
+
+    std::lock_guard<std::mutex> lock(m_statsMutex);
+    m_memoryStats = stats;
 }
 
 } // namespace lmms_magenta
@@ -0,0 +1,43 @@
+#include "TensorQuantization.h"
+#include <algorithm>
+#include <cmath>
+
+namespace lmms_magenta {
+
+namespace {
+
+template <typename T>
+void quantizeValues(const float* input, size_t count, float scale, int zeroPoint, T* output,
+                    float minValue, float maxValue) {
+    for (size_t i = 0; i < count; ++i) {
+        const float q = std::round(input[i] / scale) + zeroPoint;
+        output[i] = static_cast<T>(std::max(minValue, std::min(maxValue, q)));
+    }
+}
+
+template <typename T>
+void dequantizeValues(const T* input, size_t count, float scale, int zeroPoint, float* output) {
+    for (size_t i = 0; i < count; ++i) {
+        output[i] = (static_cast<int>(input[i]) - zeroPoint) * scale;
+    }
+}
+
+} // namespace
+
+void TensorQuantization::quantize(const float* input, size_t count, float scale, int zeroPoint, int8_t* output) {
+    quantizeValues(input, count, scale, zeroPoint, output, -128.0f, 127.0f);
+}
+
+void TensorQuantization::quantize(const float* input, size_t count, float scale, int zeroPoint, uint8_t* output) {
+    quantizeValues(input, count, scale, zeroPoint, output, 0.0f, 255.0f);
+}
+
+void TensorQuantization::dequantize(const int8_t* input, size_t count, float scale, int zeroPoint, float* output) {
+    dequantizeValues(input, count, scale, zeroPoint, output);
+}
+
+void TensorQuantization::dequantize(const uint8_t* input, size_t count, float scale, int zeroPoint, float* output) {
+    dequantizeValues(input, count, scale, zeroPoint, output);
+}
+
+} // namespace lmms_magenta
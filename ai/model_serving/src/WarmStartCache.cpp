@@ -0,0 +1,186 @@
+#include "WarmStartCache.h"
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace lmms_magenta {
+
+namespace {
+
+constexpr int kPlanVersion = 1;
+const char* const kPlanFileName = "plan";
+const char* const kWeightCacheFileName = "xnnpack.cache";
+
+// FNV-1a over a string
+uint64_t hashString(const std::string& text) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : text) {
+        hash ^= c;
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+std::string architectureName() {
+#if defined(__x86_64__) || defined(_M_X64)
+    return "x86_64";
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    return "arm64";
+#elif defined(__arm__)
+    return "arm";
+#else
+    return "generic";
+#endif
+}
+
+// Instruction set features that change the kernels XNNPACK picks
+std::string cpuFeatures() {
+    std::ostringstream features;
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+    features << "sse41=" << (__builtin_cpu_supports("sse4.1") ? 1 : 0)
+             << " avx=" << (__builtin_cpu_supports("avx") ? 1 : 0)
+             << " avx2=" << (__builtin_cpu_supports("avx2") ? 1 : 0)
+             << " fma=" << (__builtin_cpu_supports("fma") ? 1 : 0)
+             << " avx512f=" << (__builtin_cpu_supports("avx512f") ? 1 : 0)
+             << " avx512vnni=" << (__builtin_cpu_supports("avx512vnni") ? 1 : 0);
+#else
+    // Use the kernel's feature list where available (e.g. ARM)
+    std::ifstream cpuinfo("/proc/cpuinfo");
+    std::string line;
+    while (std::getline(cpuinfo, line)) {
+        if (line.compare(0, 8, "Features") == 0 || line.compare(0, 5, "flags") == 0) {
+            features << line;
+            break;
+        }
+    }
+#endif
+
+    return features.str();
+}
+
+std::string formatShape(const std::vector<int>& shape) {
+    std::ostringstream stream;
+    for (size_t i = 0; i < shape.size(); ++i) {
+        stream << (i > 0 ? "," : "") << shape[i];
+    }
+    return stream.str();
+}
+
+} // namespace
+
+WarmStartCache::WarmStartCache(const std::string& cacheDirectory)
+    : m_cacheDirectory(cacheDirectory) {
+}
+
+std::string WarmStartCache::getSnapshotDirectory(const ModelMetadata& metadata) const {
+    if (metadata.contentHash == 0 || m_cacheDirectory.empty()) {
+        return std::string();
+    }
+
+    std::ostringstream name;
+    name << std::hex << std::setw(16) << std::setfill('0') << metadata.contentHash << "-" << getCpuKey();
+
+    const std::filesystem::path directory = std::filesystem::path(m_cacheDirectory) / name.str();
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create warm-start directory: " << directory.string() << std::endl;
+        return std::string();
+    }
+
+    return directory.string();
+}
+
+std::string WarmStartCache::getWeightCachePath(const ModelMetadata& metadata) const {
+    const std::string directory = getSnapshotDirectory(metadata);
+    if (directory.empty()) {
+        return std::string();
+    }
+
+    return (std::filesystem::path(directory) / kWeightCacheFileName).string();
+}
+
+bool WarmStartCache::loadPlan(const ModelMetadata& metadata, WarmStartPlan& plan) const {
+    const std::string directory = getSnapshotDirectory(metadata);
+    if (directory.empty()) {
+        return false;
+    }
+
+    std::ifstream file(std::filesystem::path(directory) / kPlanFileName);
+    if (!file.good()) {
+        return false;
+    }
+
+    std::string header;
+    int version = 0;
+    file >> header >> version;
+    if (header != "lmms-magenta-warm-start" || version != kPlanVersion) {
+        return false;
+    }
+
+    WarmStartPlan loaded;
+    std::string key;
+    while (file >> key) {
+        if (key == "input") {
+            std::string shape;
+            file >> shape;
+            std::istringstream dimensions(shape);
+            std::string dimension;
+            while (std::getline(dimensions, dimension, ',')) {
+                loaded.inputShape.push_back(std::atoi(dimension.c_str()));
+            }
+        } else if (key == "arena") {
+            file >> loaded.arenaBytes;
+        }
+    }
+
+    if (loaded.inputShape.empty()) {
+        return false;
+    }
+
+    plan = loaded;
+    return true;
+}
+
+bool WarmStartCache::savePlan(const ModelMetadata& metadata, const WarmStartPlan& plan) const {
+    const std::string directory = getSnapshotDirectory(metadata);
+    if (directory.empty() || plan.inputShape.empty()) {
+        return false;
+    }
+
+    // Write to a temporary file first so a crash never leaves a torn plan
+    const std::filesystem::path path = std::filesystem::path(directory) / kPlanFileName;
+    const std::string temporaryPath = path.string() + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::trunc);
+        if (!file.good()) {
+            return false;
+        }
+
+        file << "lmms-magenta-warm-start " << kPlanVersion << "\n";
+        file << "input " << formatShape(plan.inputShape) << "\n";
+        file << "arena " << plan.arenaBytes << "\n";
+        if (!file.good()) {
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporaryPath, path, error);
+    return !error;
+}
+
+std::string WarmStartCache::getCpuKey() {
+    static const std::string key = [] {
+        std::ostringstream stream;
+        stream << architectureName() << "-" << std::hex << (hashString(cpuFeatures()) & 0xffffffffULL);
+        return stream.str();
+    }();
+    return key;
+}
+
+} // namespace lmms_magenta
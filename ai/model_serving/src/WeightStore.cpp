@@ -0,0 +1,77 @@
+#include "WeightStore.h"
+#include "tensorflow/lite/model.h"
+#include <iostream>
+#include <set>
+
+namespace lmms_magenta {
+
+WeightStore& WeightStore::getInstance() {
+    static WeightStore instance;
+    return instance;
+}
+
+std::shared_ptr<const tflite::FlatBufferModel> WeightStore::acquire(const ModelMetadata& metadata) {
+    // Without a content hash the weights cannot be identified, so do not share them
+    if (metadata.contentHash == 0) {
+        return std::shared_ptr<const tflite::FlatBufferModel>(
+            tflite::FlatBufferModel::BuildFromFile(metadata.filePath.c_str()));
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto it = m_buffers.find(metadata.contentHash);
+    if (it != m_buffers.end()) {
+        if (auto buffer = it->second.lock()) {
+            return buffer;
+        }
+    }
+
+    std::shared_ptr<const tflite::FlatBufferModel> buffer(
+        tflite::FlatBufferModel::BuildFromFile(metadata.filePath.c_str()));
+    if (!buffer) {
+        std::cerr << "Failed to map model weights: " << metadata.filePath << std::endl;
+        return nullptr;
+    }
+
+    m_buffers[metadata.contentHash] = buffer;
+
+    // Drop entries whose buffers have been released
+    for (auto entry = m_buffers.begin(); entry != m_buffers.end();) {
+        entry = entry->second.expired() ? m_buffers.erase(entry) : std::next(entry);
+    }
+
+    return buffer;
+}
+
+size_t WeightStore::getResidentCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t count = 0;
+    for (const auto& entry : m_buffers) {
+        count += entry.second.expired() ? 0 : 1;
+    }
+    return count;
+}
+
+uint64_t WeightStore::findDuplicateWeightBytes(const std::vector<ModelMetadata>& models) {
+    std::set<uint64_t> seenFiles;
+    std::set<uint64_t> seenBuffers;
+    uint64_t duplicateBytes = 0;
+
+    for (const auto& metadata : models) {
+        // Identical files are already shared as a whole
+        if (metadata.contentHash != 0 && !seenFiles.insert(metadata.contentHash).second) {
+            continue;
+        }
+
+        for (const auto& buffer : metadata.weightBuffers) {
+            if (!seenBuffers.insert(buffer.first).second) {
+                duplicateBytes += buffer.second;
+            }
+        }
+    }
+
+    return duplicateBytes;
+}
+
+} // namespace lmms_magenta
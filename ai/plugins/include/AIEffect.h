@@ -1,7 +1,10 @@
 #pragma once
 
 #include "AIPlugin.h"
+#include "AutomatableModel.h"
 #include "Effect.h"
+#include "MidiEvent.h"
+#include "TimePos.h"
 
 namespace lmms_magenta {
 
@@ -32,12 +35,46 @@ public:
      */
     bool initialize() override;
     
+    /**
+     * @brief Process an audio buffer (called by the host)
+     *
+     * Dispatches to processAudio() once the settings are loaded and the
+     * model is ready.
+     *
+     * @param buf Buffer to process
+     * @param frames Number of frames in the buffer
+     * @return True if the buffer was processed
+     */
+    bool processAudioBuffer(lmms::SampleFrame* buf, const lmms::fpp_t frames);
+    
     /**
      * @brief Process audio
      * @param buf Buffer to process
      */
     virtual void processAudio(lmms::SampleFrame* buf);
     
+    /**
+     * @brief Get the processing latency introduced by the effect
+     * @return Latency in frames, reported to the host for compensation
+     */
+    virtual int getLatencyFrames() const;
+    
+    /**
+     * @brief Handle a MIDI event
+     * @param event MIDI event
+     * @param time Position of the event
+     * @param offset Frame offset of the event in the current period
+     * @return True if the event was handled
+     */
+    virtual bool handleMidiEvent(const lmms::MidiEvent& event, const lmms::TimePos& time, lmms::f_cnt_t offset);
+    
+signals:
+    /**
+     * @brief Emitted when the latency reported by getLatencyFrames() changes
+     * @param frames New latency in frames
+     */
+    void latencyChanged(int frames);
+    
 protected:
     /**
      * @brief Handle parameter change
@@ -45,6 +82,34 @@ protected:
      * @param value New value
      */
     virtual void handleParameterChange(const lmms::AutomatableModel* param, float value);
+    
+    /**
+     * @brief Report changes of a parameter to handleParameterChange()
+     * @param model Parameter owned by the derived effect
+     */
+    void bindParameter(lmms::FloatModel* model);
+    
+    /**
+     * @brief Save effect-specific settings
+     * @param doc Document the settings are saved into
+     * @param element Settings element of this plugin
+     */
+    virtual void saveEffectSpecificSettings(QDomDocument& doc, QDomElement& element);
+    
+    /**
+     * @brief Load effect-specific settings
+     *
+     * Called on a ProjectStateLoader thread (see materializeSettings()).
+     *
+     * @param element Settings element of this plugin
+     */
+    virtual void loadEffectSpecificSettings(const QDomElement& element);
+    
+    /**
+     * @brief Load the plugin and effect-specific settings
+     * @param element Settings element of this plugin
+     */
+    void materializeSettings(const QDomElement& element) override;
 };
 
 } // namespace lmms_magenta
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "AIPlugin.h"
+#include "AutomatableModel.h"
 #include "InstrumentTrack.h"
 
 namespace lmms_magenta {
@@ -73,6 +74,25 @@ protected:
      * @return True if the event was handled
      */
     virtual bool handleMidiEvent(const lmms::MidiEvent& event);
+    
+    /**
+     * @brief Handle parameter change
+     * @param param Parameter
+     * @param value New value
+     */
+    virtual void handleParameterChange(const lmms::AutomatableModel* param, float value);
+    
+    /**
+     * @brief Report changes of a parameter to handleParameterChange()
+     * @param model Parameter owned by the derived instrument
+     */
+    void bindParameter(lmms::FloatModel* model);
+    
+    /**
+     * @brief Load the plugin and instrument-specific settings
+     * @param element Settings element of this plugin
+     */
+    void materializeSettings(const QDomElement& element) override;
 };
 
 } // namespace lmms_magenta
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <functional>
@@ -8,6 +9,8 @@
 #include "Plugin.h"
 #include "Model.h"
 
+#include <QDomElement>
+
 // Include our model server
 #include "../../model_serving/include/ModelServer.h"
 
@@ -76,6 +79,14 @@ public:
      */
     bool loadModel();
     
+    /**
+     * @brief Load a model and use it for this plugin
+     * @param type Model type
+     * @param modelName Model name
+     * @return True if loading was successful
+     */
+    bool loadModel(ModelType type, const std::string& modelName);
+    
     /**
      * @brief Unload the model used by this plugin
      * @return True if unloading was successful
@@ -88,6 +99,12 @@ public:
      */
     bool isModelLoaded() const;
     
+    /**
+     * @brief Get the identifier under which this plugin's jobs are accounted
+     * @return Client identifier, unique among live plugin instances
+     */
+    std::string getClientId() const;
+    
     /**
      * @brief Register a callback for model loading events
      * @param callback Function to call when the model is loaded or unloaded
@@ -101,7 +118,44 @@ public:
      */
     void unregisterModelCallback(int callbackId);
     
+    /**
+     * @brief Wait until settings loaded from a project are in place
+     *
+     * loadSettings() only parses the project; the model and the plugin
+     * state are loaded later on a ProjectStateLoader thread.
+     */
+    void waitForSettings();
+    
+    /**
+     * @brief Check if the settings loaded from a project are in place
+     *
+     * Does not block, so audio and MIDI callbacks use it to skip processing
+     * until the plugin's state is ready.
+     *
+     * @return True unless settings are still being loaded
+     */
+    bool isSettingsReady() const;
+    
+signals:
+    /**
+     * @brief Emitted when the model is loaded or unloaded
+     * @param loaded Whether the model is loaded
+     */
+    void modelStatusChanged(bool loaded);
+    
 protected:
+    /**
+     * @brief Load the plugin state from its settings element
+     *
+     * Called on a ProjectStateLoader thread, with an element copied out of
+     * the project. Subclasses that add settings call the base version
+     * first.
+     *
+     * @param element Settings element of this plugin
+     */
+    virtual void materializeSettings(const QDomElement& element);
+    
+
     /**
      * @brief Handle model loading events
      * @param type Model type
@@ -113,10 +167,19 @@ protected:
 private:
     // Model used by this plugin
     std::shared_ptr<Model> m_model;
+    ModelType m_modelType;
+    std::string m_modelName;
+    
+    // Written by ProjectStateLoader threads and model server events, read
+    // by audio and MIDI callbacks
+    std::atomic<bool> m_isModelLoaded;
     
     // Whether the plugin is initialized
     bool m_isInitialized;
     
+    // False while settings loaded from a project are being materialized
+    std::atomic<bool> m_isSettingsReady;
+    
     // Callback ID for model server events
     int m_modelCallbackId;
     
@@ -1,15 +1,22 @@
 #pragma once
 
 #include "AIEffect.h"
+#include "AutomatableModel.h"
 #include "../../model_serving/include/GrooVAEModel.h"
+#include "../../utils/include/Semaphore.h"
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <thread>
 
 namespace lmms_magenta {
 
 /**
  * @brief GrooVAE effect plugin
  * 
- * This effect uses GrooVAE to apply groove to MIDI patterns.
+ * This effect uses GrooVAE to apply groove to MIDI patterns. Presets
+ * triggered from MIDI are applied by a preset worker, so the MIDI callback
+ * never runs the model.
  */
 class GrooVAEEffect : public AIEffect {
     Q_OBJECT
@@ -44,6 +51,19 @@ public:
      */
     std::string getModelName() const override;
     
+    /**
+     * @brief Handle a MIDI event
+     *
+     * Notes C2-B2 select the groove preset of the same index and have the
+     * preset worker apply it to the last processed pattern.
+     *
+     * @param event MIDI event
+     * @param time Position of the event
+     * @param offset Frame offset of the event in the current period
+     * @return True if the event was handled
+     */
+    bool handleMidiEvent(const lmms::MidiEvent& event, const lmms::TimePos& time, lmms::f_cnt_t offset) override;
+    
     /**
      * @brief Process a pattern
      * @param pattern Pattern to process
@@ -66,6 +86,55 @@ public:
      */
     std::shared_ptr<GrooVAEModel> getGrooVAEModel();
     
+    /**
+     * @brief Get the last processed pattern with the last triggered preset applied
+     * @return Grooved sequence (empty until a preset has been applied)
+     */
+    MidiSequence getGroovedSequence();
+    
+    /**
+     * @brief Set a groove preset
+     * @param index Index of the preset to replace
+     * @param groove Groove embedding
+     */
+    void setGroovePreset(int index, const std::vector<float>& groove);
+    
+    /**
+     * @brief Get a groove preset
+     * @param index Index of the preset
+     * @return Groove embedding (empty if the index is invalid)
+     */
+    std::vector<float> getGroovePreset(int index);
+    
+    /**
+     * @brief Load a preset from the model's groove library
+     * @param index Index of the preset to replace
+     * @param grooveName Name of the groove in the library
+     * @return True if the groove was found
+     */
+    bool setGroovePresetFromLibrary(int index, const std::string& grooveName);
+    
+    /**
+     * @brief Find the library grooves closest to a preset
+     * @param presetIndex Index of the preset
+     * @param count Number of grooves to return
+     * @return Names of the closest grooves, nearest first
+     */
+    std::vector<std::string> findSimilarGrooves(int presetIndex, size_t count);
+    
+    /**
+     * @brief Get the preset selected last
+     * @return Index of the current preset
+     */
+    int getCurrentPreset() const;
+    
+signals:
+    /**
+     * @brief Emitted by the preset worker when a preset has been applied
+     * @param index Index of the preset
+     */
+    void groovePresetApplied(int index);
+    
 protected:
     /**
      * @brief Handle parameter change
@@ -74,12 +143,32 @@ protected:
      */
     void handleParameterChange(const lmms::AutomatableModel* param, float value) override;
     
+    /**
+     * @brief Save the groove settings and presets
+     * @param doc Document the settings are saved into
+     * @param element Settings element of this plugin
+     */
+    void saveEffectSpecificSettings(QDomDocument& doc, QDomElement& element) override;
+    
+    /**
+     * @brief Load the groove settings and presets
+     * @param element Settings element of this plugin
+     */
+    void loadEffectSpecificSettings(const QDomElement& element) override;
+    
 private:
-    // Groove amount
-    float m_grooveAmount;
+    // Number of presets, triggered from C2 upwards
+    static constexpr int kNumPresets = 4;
+    
+    // Groove amount, written by automation
+    std::atomic<float> m_grooveAmount;
     
-    // Swing amount
-    float m_swingAmount;
+    // Swing amount, written by automation
+    std::atomic<float> m_swingAmount;
+    
+    // Automatable groove and swing knobs
+    lmms::FloatModel m_grooveModel;
+    lmms::FloatModel m_swingModel;
     
     // Groove style
     int m_grooveStyle;
@@ -87,11 +176,34 @@ private:
     // Whether to quantize before applying groove
     bool m_quantizeBeforeGroove;
     
+    // Groove embeddings triggered from MIDI (guarded by m_presetMutex), and
+    // the one selected last
+    std::vector<std::vector<float>> m_groovePresets;
+    std::atomic<int> m_currentPreset;
+    
+    // Last processed pattern and the result of the last applied preset
+    // (guarded by m_presetMutex)
+    MidiSequence m_sourceSequence;
+    MidiSequence m_groovedSequence;
+    
+    // Preset requested from the MIDI thread (-1 for none); only the latest
+    // request is applied
+    std::atomic<int> m_pendingPreset;
+    
+    // Applies requested presets; the MIDI thread never takes m_presetMutex
+    std::thread m_presetWorker;
+    std::atomic<bool> m_isStopping;
+    std::mutex m_presetMutex;
+    Semaphore m_presetRequested;
+    
+    // Apply requested presets until stopped (preset worker)
+    void runPresetWorker();
+    
     // Convert LMMS pattern to MIDI sequence
     MidiSequence patternToSequence(lmms::Pattern* pattern);
     
-    // Convert MIDI sequence to LMMS pattern
-    lmms::Pattern* sequenceToPattern(const MidiSequence& sequence);
+    // Replace the notes of an LMMS pattern with a MIDI sequence
+    void sequenceToPattern(const MidiSequence& sequence, lmms::Pattern* pattern);
 };
 
 } // namespace lmms_magenta
@@ -2,6 +2,8 @@
 
 #include "AIInstrument.h"
 #include "../../model_serving/include/MusicVAEModel.h"
+#include "../../model_serving/include/EmotionMapperModel.h"
+#include <atomic>
 #include <memory>
 #include <vector>
 
@@ -86,6 +88,44 @@ public:
      */
     std::shared_ptr<MusicVAEModel> getMusicVAEModel();
     
+    /**
+     * @brief Enable or disable emotion-driven generation parameters
+     * @param enable Whether to drive parameters from the EmotionMapper
+     * @return True if the EmotionMapper lookup table is available
+     */
+    bool setEmotionMappingEnabled(bool enable);
+    
+    /**
+     * @brief Set the emotion driving the generation parameters
+     *
+     * This is a lookup in the EmotionMapper's precompiled table, not an
+     * inference, so automation can call it once per audio block.
+     *
+     * @param valence Valence (-1 to 1)
+     * @param arousal Arousal (-1 to 1)
+     * @param intensity Intensity (0 to 1)
+     */
+    void setEmotion(float valence, float arousal, float intensity);
+    
+    /**
+     * @brief Get the note density used for generation
+     *
+     * Below 0.5 generated patterns are thinned out, keeping the loudest notes.
+     *
+     * @return Note density (0-1)
+     */
+    float getNoteDensity() const;
+    
+    /**
+     * @brief Get the complexity used for generation
+     *
+     * Below 0.5 generated patterns use fewer distinct pitches; the others are
+     * moved to the nearest pitch that is kept.
+     *
+     * @return Complexity (0-1)
+     */
+    float getComplexity() const;
+    
 protected:
     /**
      * @brief Handle note on event
@@ -109,12 +149,42 @@ protected:
      */
     bool handleMidiEvent(const lmms::MidiEvent& event) override;
     
+    /**
+     * @brief Handle parameter change
+     *
+     * Valence, arousal and intensity automation drives the generation
+     * parameters through setEmotion().
+     *
+     * @param param Parameter
+     * @param value New value
+     */
+    void handleParameterChange(const lmms::AutomatableModel* param, float value) override;
+    
 private:
     // Current latent vector
     std::vector<float> m_currentLatentVector;
     
-    // Temperature for sampling
-    float m_temperature;
+    // Temperature for sampling; written by automation while generating
+    std::atomic<float> m_temperature;
+    
+    // Note density and complexity (0-1)
+    std::atomic<float> m_noteDensity;
+    std::atomic<float> m_complexity;
+    
+    // Emotion set by automation
+    std::atomic<float> m_valence;
+    std::atomic<float> m_arousal;
+    std::atomic<float> m_intensity;
+    
+    // Automatable emotion knobs
+    lmms::FloatModel m_valenceModel;
+    lmms::FloatModel m_arousalModel;
+    lmms::FloatModel m_intensityModel;
+    
+    // Compiled emotion-to-parameter table, null when mapping is disabled;
+    // replaced by the GUI thread while automation reads it, so it is only
+    // accessed through std::atomic_load() and std::atomic_store()
+    std::shared_ptr<const EmotionLookupTable> m_emotionTable;
     
     // Whether to use the seed pattern
     bool m_useSeedPattern;
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <mutex>
+#include <vector>
+
+#include <QDomDocument>
+#include <QDomElement>
+
+#include "../../model_serving/include/ModelPrefetcher.h"
+
+namespace lmms_magenta {
+
+/**
+ * @brief Prefetches the models of every AI plugin in a project
+ *
+ * When a project is opened, the first AI plugin whose settings are loaded
+ * hands the whole project document to this class. It collects the model of
+ * every AI plugin in the project and loads them in parallel, ordered by the
+ * position of the first clip of the track that uses them, so the plugins
+ * loaded afterwards find their model loaded or being loaded.
+ */
+class ProjectModelPrefetcher {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the singleton instance
+     */
+    static ProjectModelPrefetcher& getInstance();
+
+    /**
+     * @brief Prefetch the models of a project
+     *
+     * Each project is scanned once, however many plugins it contains.
+     *
+     * @param project Project document
+     */
+    void prefetchProject(const QDomDocument& project);
+
+    /**
+     * @brief Collect the models used by the AI plugins in a project
+     *
+     * Models of mixer effects are needed from the start of the song, and
+     * models on tracks without clips are needed last.
+     *
+     * @param root Root element of the project
+     * @return Models in document order
+     */
+    static std::vector<PrefetchRequest> scanProject(const QDomElement& root);
+
+private:
+    ProjectModelPrefetcher();
+
+    ProjectModelPrefetcher(const ProjectModelPrefetcher&) = delete;
+    ProjectModelPrefetcher& operator=(const ProjectModelPrefetcher&) = delete;
+
+    // Loads models on a pool of loader threads
+    ModelPrefetcher m_prefetcher;
+
+    // Root of the project being prefetched (released once prefetching is done)
+    QDomElement m_project;
+    std::mutex m_mutex;
+};
+
+} // namespace lmms_magenta
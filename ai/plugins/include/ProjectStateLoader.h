@@ -0,0 +1,105 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+
+#include "../../utils/include/ThreadPool.h"
+
+namespace lmms_magenta {
+
+/**
+ * @brief Materializes the settings of AI plugins in parallel
+ *
+ * Loading a project is split in two phases. While LMMS walks the project
+ * document, each AI plugin only parses what it needs from its element (the
+ * parse phase) and defers the expensive part, decoding its state and
+ * resolving its model, to this loader (the materialization phase). The
+ * deferred tasks of all plugins run in parallel on a pool of loader
+ * threads, so opening a project takes about as long as its slowest plugin
+ * instead of the sum of all of them.
+ *
+ * Tasks of the same owner run in submission order. Before playback starts,
+ * the host joins every deferred task with waitForAll(); a plugin that is
+ * used earlier joins its own tasks with wait().
+ */
+class ProjectStateLoader {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the singleton instance
+     */
+    static ProjectStateLoader& getInstance();
+
+    /**
+     * @brief Constructor
+     * @param numThreads Number of loader threads (0 for hardware concurrency)
+     */
+    explicit ProjectStateLoader(size_t numThreads = 0);
+
+    /**
+     * @brief Destructor, waits for the deferred tasks
+     */
+    ~ProjectStateLoader();
+
+    ProjectStateLoader(const ProjectStateLoader&) = delete;
+    ProjectStateLoader& operator=(const ProjectStateLoader&) = delete;
+
+    /**
+     * @brief Run a task on a loader thread after the owner's earlier tasks
+     * @param owner Object the task materializes (usually a plugin)
+     * @param task Task to run; returns false if materialization failed
+     */
+    void defer(const void* owner, std::function<bool()> task);
+
+    /**
+     * @brief Wait for the deferred tasks of one owner
+     *
+     * Must not be called from a loader thread.
+     *
+     * @param owner Object passed to defer()
+     * @return True if every task of the owner succeeded (or none was deferred)
+     */
+    bool wait(const void* owner);
+
+    /**
+     * @brief Wait for the deferred tasks of every owner
+     * @return Number of owners whose materialization failed
+     */
+    size_t waitForAll();
+
+    /**
+     * @brief Check if an owner has deferred tasks that were not waited for
+     * @param owner Object passed to defer()
+     * @return True if a task of the owner may still be running
+     */
+    bool isPending(const void* owner) const;
+
+    /**
+     * @brief Get the number of owners with deferred tasks
+     * @return Number of owners not yet waited for
+     */
+    size_t getPendingCount() const;
+
+private:
+    // Loader threads
+    ThreadPool m_pool;
+
+    // Last deferred task of an owner; it completes after the owner's
+    // earlier tasks, so its result stands for all of them
+    struct PendingTask {
+        std::shared_future<bool> result;
+        uint64_t id;
+    };
+
+    std::map<const void*, PendingTask> m_pending;
+    uint64_t m_nextTaskId;
+    mutable std::mutex m_mutex;
+
+    // Forget an owner's tasks unless more were deferred while waiting
+    void release(const void* owner, uint64_t id);
+};
+
+} // namespace lmms_magenta
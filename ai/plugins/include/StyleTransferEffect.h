@@ -0,0 +1,199 @@
+#pragma once
+
+#include "AIEffect.h"
+#include "AutomatableModel.h"
+#include "../../model_serving/include/CycleGANModel.h"
+#include "../../utils/include/Semaphore.h"
+#include "../../utils/include/SpectralProcessor.h"
+#include "../../utils/include/SpscRing.h"
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief CycleGAN style-transfer effect plugin
+ *
+ * This effect uses CycleGAN to transfer the style of audio or MIDI. Audio is
+ * processed with a streaming STFT: frames from both channels are batched into
+ * a single inference call and resynthesized with overlap-add.
+ *
+ * The audio thread never waits for the model. Each batch is handed to a style
+ * worker through a lock-free ring and resynthesized one batch later; a batch
+ * the worker has not finished by then passes through unstyled. While the song
+ * is exported every batch is styled on the rendering thread instead, so the
+ * exported audio does not depend on timing. The total latency is reported
+ * through getLatencyFrames() and latencyChanged().
+ */
+class StyleTransferEffect : public AIEffect {
+    Q_OBJECT
+public:
+    /**
+     * @brief Constructor
+     * @param parent Parent model
+     * @param descriptor Plugin descriptor
+     */
+    StyleTransferEffect(lmms::Model* parent, const lmms::Plugin::Descriptor* descriptor);
+
+    /**
+     * @brief Destructor
+     */
+    ~StyleTransferEffect() override;
+
+    /**
+     * @brief Initialize the effect
+     * @return True if initialization was successful
+     */
+    bool initialize() override;
+
+    /**
+     * @brief Get the model type used by this plugin
+     * @return Model type
+     */
+    ModelType getModelType() const override;
+
+    /**
+     * @brief Get the model name used by this plugin
+     * @return Model name
+     */
+    std::string getModelName() const override;
+
+    /**
+     * @brief Process audio
+     * @param buf Buffer to process
+     */
+    void processAudio(lmms::SampleFrame* buf) override;
+
+    /**
+     * @brief Get the processing latency introduced by the effect
+     * @return Latency in frames
+     */
+    int getLatencyFrames() const override;
+
+    /**
+     * @brief Apply style transfer to a MIDI sequence
+     * @param sequence MIDI sequence to transform
+     * @return Transformed MIDI sequence
+     */
+    MidiSequence processSequence(const MidiSequence& sequence);
+
+    /**
+     * @brief Get the CycleGAN model
+     * @return Shared pointer to the CycleGAN model
+     */
+    std::shared_ptr<CycleGANModel> getCycleGANModel();
+
+protected:
+    /**
+     * @brief Handle parameter change
+     * @param param Parameter
+     * @param value New value
+     */
+    void handleParameterChange(const lmms::AutomatableModel* param, float value) override;
+
+    /**
+     * @brief Save the strength and mix
+     * @param doc Document the settings are saved into
+     * @param element Settings element of this plugin
+     */
+    void saveEffectSpecificSettings(QDomDocument& doc, QDomElement& element) override;
+
+    /**
+     * @brief Load the strength and mix
+     * @param element Settings element of this plugin
+     */
+    void loadEffectSpecificSettings(const QDomElement& element) override;
+
+private:
+    // STFT frame size and hop
+    static constexpr int kFftSize = 1024;
+    static constexpr int kHopSize = 256;
+
+    // Frames per channel batched into each inference call
+    static constexpr int kBatchFrames = 4;
+
+    // Batches that can be in flight between the audio thread and the worker
+    static constexpr int kNumSlots = 4;
+
+    // Ownership of a slot: the audio thread owns Free, Styled and Failed
+    // slots, the worker owns Queued ones
+    enum class SlotState { Free, Queued, Styled, Failed };
+
+    // One batch of log magnitudes and its styled result
+    struct StyleSlot {
+        std::vector<float> logMagnitudes;
+        std::vector<float> styled;
+        std::atomic<SlotState> state{SlotState::Free};
+    };
+
+    // Style strength (0-1), written by automation
+    std::atomic<float> m_strength;
+
+    // Dry/wet mix (0-1), written by automation
+    std::atomic<float> m_mix;
+
+    // Automatable knobs feeding m_strength and m_mix
+    lmms::FloatModel m_strengthModel;
+    lmms::FloatModel m_mixModel;
+
+    // MIDI window length and hop in bars
+    int m_midiWindowBars;
+    int m_midiHopBars;
+
+    // Streaming STFT with pre-planned FFTs and pre-allocated workspace
+    SpectralProcessor m_spectralProcessor;
+
+    // Model held for the lifetime of the effect
+    std::shared_ptr<CycleGANModel> m_styleModel;
+
+    // Deinterleaved channel buffers and dry signal delayed by the latency
+    std::vector<float> m_channelBuffers[2];
+    std::vector<float> m_dryDelay[2];
+    int m_dryDelayPosition;
+
+    // Batches in flight and the ring of slot indices queued for the worker
+    std::array<StyleSlot, kNumSlots> m_slots;
+    SpscRing<int> m_styleRequests;
+
+    // Spectra of the previous batch and its slot (-1 if it was not queued)
+    std::vector<std::complex<float>> m_delayedSpectra;
+    int m_delayedSlot;
+
+    // True while the current period is rendered for an export
+    bool m_isRendering;
+
+    // Style worker, signalled once per queued batch
+    std::thread m_styleWorker;
+    std::atomic<bool> m_isStopping;
+    Semaphore m_workerWakeup;
+
+    // Size the work buffers for the host period
+    void allocateBuffers(int framesPerPeriod);
+
+    // Emit the previous batch and queue the current one (audio thread)
+    void processBatch(std::complex<float>* spectra, int numFrames, int numBins);
+
+    // Find a slot owned by the audio thread, or -1 if all are queued
+    int acquireSlot();
+
+    // Style one period of audio (audio thread, or the exporting thread)
+    void processFrames(lmms::SampleFrame* buf);
+
+    // Wait until the worker has finished a slot (rendering only)
+    void waitForSlot(const StyleSlot& slot);
+
+    // Style a batch on the calling thread
+    bool styleSlot(StyleSlot& slot);
+
+    // Style queued batches until stopped (worker thread)
+    void runStyleWorker();
+
+    // Start and stop the style worker
+    void startStyleWorker();
+    void stopStyleWorker();
+};
+
+} // namespace lmms_magenta
@@ -11,10 +11,29 @@ AIEffect::AIEffect(Model* parent, const Plugin::Descriptor::SubPluginFeatures::K
 AIEffect::~AIEffect() {
 }
 
-bool AIEffect::processAudioBuffer(sampleFrame* buffer, const fpp_t frames) {
+bool AIEffect::initialize() {
+    return AIPlugin::initialize();
+}
+
+bool AIEffect::processAudioBuffer(lmms::SampleFrame* buf, const lmms::fpp_t frames) {
+    // Pass audio through until the project state and the model are ready
+    if (!isSettingsReady() || !isModelLoaded() || frames <= 0) {
+        return false;
+    }
+    
+    processAudio(buf);
+    return true;
+}
+
+void AIEffect::processAudio(lmms::SampleFrame* buf) {
     // Base implementation does nothing
     // Derived classes should override this to process audio
-    return false;
+}
+
+int AIEffect::getLatencyFrames() const {
+    // Base implementation adds no latency
+    // Derived classes that buffer audio should override this
+    return 0;
 }
 
 void AIEffect::saveEffectSettings(QDomDocument& doc, QDomElement& element) {
@@ -26,19 +45,37 @@ void AIEffect::saveEffectSettings(QDomDocument& doc, QDomElement& element) {
 }
 
 void AIEffect::loadEffectSettings(const QDomElement& element) {
-    // Load AI plugin settings
+    // Load AI plugin settings; the effect settings are loaded with them
+    // on a loader thread (see materializeSettings())
     loadSettings(element);
+}
+
+void AIEffect::materializeSettings(const QDomElement& element) {
+    // Load AI plugin settings
+    AIPlugin::materializeSettings(element);
     
     // Load additional effect settings
     loadEffectSpecificSettings(element);
 }
 
-bool AIEffect::handleMidiEvent(const MidiEvent& event, const MidiTime& time, f_cnt_t offset) {
+bool AIEffect::handleMidiEvent(const lmms::MidiEvent& event, const lmms::TimePos& time, lmms::f_cnt_t offset) {
     // Base implementation does nothing
     // Derived classes should override this to handle MIDI events
     return false;
 }
 
+void AIEffect::handleParameterChange(const lmms::AutomatableModel* param, float value) {
+    // Base implementation does nothing
+    // Derived classes should override this to follow their parameters
+}
+
+void AIEffect::bindParameter(lmms::FloatModel* model) {
+    // Automation changes values on the audio thread; handle them there
+    connect(model, &lmms::AutomatableModel::dataChanged, this, [this, model]() {
+        handleParameterChange(model, model->value());
+    }, Qt::DirectConnection);
+}
+
 void AIEffect::saveEffectSpecificSettings(QDomDocument& doc, QDomElement& element) {
     // Base implementation does nothing
     // Derived classes should override this to save their settings
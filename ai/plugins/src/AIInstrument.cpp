@@ -30,8 +30,14 @@ void AIInstrument::saveInstrumentSettings(QDomDocument& doc, QDomElement& elemen
 }
 
 void AIInstrument::loadInstrumentSettings(const QDomElement& element) {
-    // Load AI plugin settings
+    // Load AI plugin settings; the instrument settings are loaded with them
+    // on a loader thread (see materializeSettings())
     loadSettings(element);
+}
+
+void AIInstrument::materializeSettings(const QDomElement& element) {
+    // Load AI plugin settings
+    AIPlugin::materializeSettings(element);
     
     // Load additional instrument settings
     loadInstrumentSpecificSettings(element);
@@ -43,6 +49,18 @@ bool AIInstrument::handleMidiEvent(const MidiEvent& event, const MidiTime& time,
     return false;
 }
 
+void AIInstrument::handleParameterChange(const lmms::AutomatableModel* param, float value) {
+    // Base implementation does nothing
+    // Derived classes should override this to follow their automation
+}
+
+void AIInstrument::bindParameter(lmms::FloatModel* model) {
+    // Automation changes values on the audio thread; handle them there
+    connect(model, &lmms::AutomatableModel::dataChanged, this, [this, model]() {
+        handleParameterChange(model, model->value());
+    }, Qt::DirectConnection);
+}
+
 void AIInstrument::saveInstrumentSpecificSettings(QDomDocument& doc, QDomElement& element) {
     // Base implementation does nothing
     // Derived classes should override this to save their settings
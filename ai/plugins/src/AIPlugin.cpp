@@ -1,29 +1,96 @@
 #include "AIPlugin.h"
+#include "ProjectModelPrefetcher.h"
+#include "ProjectStateLoader.h"
+#include "Engine.h"
+#include "Song.h"
+#include <QMetaObject>
+#include <QPointer>
 #include <iostream>
+#include <sstream>
 
 namespace lmms_magenta {
 
+namespace {
+
+// Join the settings deferred to ProjectStateLoader once the host has loaded
+// a project and whenever playback starts, so callbacks never skip events
+// while a plugin's state is still loading
+void joinSettingsOnSongEvents() {
+    static QPointer<lmms::Song> s_song;
+    lmms::Song* song = lmms::Engine::getSong();
+    if (!song || s_song == song) {
+        return;
+    }
+    s_song = song;
+    
+    QObject::connect(song, &lmms::Song::projectLoaded, song, []() {
+        ProjectStateLoader::getInstance().waitForAll();
+    });
+    QObject::connect(song, &lmms::Song::playbackStateChanged, song, [song]() {
+        if (song->isPlaying()) {
+            ProjectStateLoader::getInstance().waitForAll();
+        }
+    });
+}
+
+} // namespace
+
 AIPlugin::AIPlugin(Plugin::Model* parent, const Plugin::Descriptor::SubPluginFeatures::Key* key)
     : Plugin(parent, key)
-    , m_isModelLoaded(false) {
+    , m_isModelLoaded(false)
+    , m_isInitialized(false)
+    , m_isSettingsReady(true) {
+    
+    // Plugins are created on the GUI thread, where the song lives
+    joinSettingsOnSongEvents();
     
     // Register callback for model loading
-    m_callbackId = ModelServer::getInstance().registerModelCallback(
+    m_modelCallbackId = ModelServer::getInstance().registerModelCallback(
         [this](ModelType type, const std::string& modelName, bool loaded) {
-            // Check if this is our model
-            if (type == m_modelType && modelName == m_modelName) {
-                m_isModelLoaded = loaded;
-                
-                // Notify UI that model status has changed
-                emit modelStatusChanged(loaded);
-            }
+            // Events arrive on the ModelServer dispatcher thread; hand them to
+            // this plugin's thread so a slow listener never holds up the server
+            QMetaObject::invokeMethod(this, [this, type, modelName, loaded]() {
+                // Check if this is our model
+                if (type == m_modelType && modelName == m_modelName) {
+                    m_isModelLoaded = loaded;
+                    
+                    // Notify UI that model status has changed
+                    emit modelStatusChanged(loaded);
+                }
+            }, Qt::QueuedConnection);
         }
     );
 }
 
 AIPlugin::~AIPlugin() {
+    // Derived plugins wait in their own destructors; this only catches
+    // settings deferred after those ran
+    waitForSettings();
+    
     // Unregister callback
-    ModelServer::getInstance().unregisterModelCallback(m_callbackId);
+    ModelServer::getInstance().unregisterModelCallback(m_modelCallbackId);
+    
+    // Drop our quota so a later plugin at the same address starts fresh
+    ModelServer::getInstance().removeClient(getClientId());
+}
+
+bool AIPlugin::initialize() {
+    m_isInitialized = true;
+    return true;
+}
+
+bool AIPlugin::isInitialized() const {
+    return m_isInitialized;
+}
+
+bool AIPlugin::loadModel() {
+    return loadModel(getModelType(), getModelName());
+}
+
+std::string AIPlugin::getClientId() const {
+    std::ostringstream id;
+    id << "plugin@" << static_cast<const void*>(this);
+    return id.str();
 }
 
 bool AIPlugin::loadModel(ModelType type, const std::string& modelName) {
@@ -73,6 +140,9 @@ std::shared_ptr<Model> AIPlugin::getModel() {
 }
 
 void AIPlugin::saveSettings(QDomDocument& doc, QDomElement& element) {
+    // Never save state that is still being loaded
+    waitForSettings();
+    
     // Save model type and name
     element.setAttribute("modelType", static_cast<int>(m_modelType));
     element.setAttribute("modelName", QString::fromStdString(m_modelName));
@@ -82,16 +152,64 @@ void AIPlugin::saveSettings(QDomDocument& doc, QDomElement& element) {
 }
 
 void AIPlugin::loadSettings(const QDomElement& element) {
+    // Settings loaded earlier must be in place before they are replaced
+    waitForSettings();
+    
     // Load model type and name
     m_modelType = static_cast<ModelType>(element.attribute("modelType").toInt());
     m_modelName = element.attribute("modelName").toStdString();
     
-    // Try to load the model
-    if (!m_modelName.empty()) {
-        loadModel(m_modelType, m_modelName);
-    }
+    // Start loading the models of the whole project in parallel
+    ProjectModelPrefetcher::getInstance().prefetchProject(element.ownerDocument());
+    
+    // Copy our element into a document of its own: QDom documents must not
+    // be read from two threads, and LMMS keeps walking the project
+    auto settings = std::make_shared<QDomDocument>();
+    settings->appendChild(settings->importNode(element, true));
     
-    // Load additional plugin settings
+    // Resolve the model and decode the plugin state on a loader thread, in
+    // parallel with the other plugins of the project
+    m_isSettingsReady = false;
+    const ModelType modelType = m_modelType;
+    const std::string modelName = m_modelName;
+    ProjectStateLoader::getInstance().defer(this, [this, modelType, modelName, settings]() {
+        bool isSuccessful = true;
+        
+        if (!modelName.empty()) {
+            // Joins the prefetch of this model instead of loading it again
+            isSuccessful = ModelServer::getInstance().loadModel(modelType, modelName);
+            m_isModelLoaded = isSuccessful;
+            
+            // Notify UI that model status has changed, on this plugin's thread
+            QMetaObject::invokeMethod(this, [this, isSuccessful]() {
+                emit modelStatusChanged(isSuccessful);
+            }, Qt::QueuedConnection);
+        }
+        
+        try {
+            materializeSettings(settings->documentElement());
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Failed to load plugin settings: " << e.what() << std::endl;
+            isSuccessful = false;
+        }
+        
+        m_isSettingsReady = true;
+        return isSuccessful;
+    });
+}
+
+void AIPlugin::waitForSettings() {
+    if (!m_isSettingsReady) {
+        ProjectStateLoader::getInstance().wait(this);
+    }
+}
+
+bool AIPlugin::isSettingsReady() const {
+    return m_isSettingsReady;
+}
+
+void AIPlugin::materializeSettings(const QDomElement& element) {
     loadPluginSettings(element);
 }
 
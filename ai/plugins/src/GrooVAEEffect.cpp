@@ -1,413 +1,391 @@
 #include "GrooVAEEffect.h"
+#include "../../utils/include/RealtimeChecker.h"
+#include "../../utils/include/StateCodec.h"
+#include "../../utils/include/Trace.h"
+#include "AutomatableModel.h"
+#include "Note.h"
+#include "Pattern.h"
+#include <algorithm>
 #include <iostream>
 #include <QDomDocument>
 
 namespace lmms_magenta {
 
-GrooVAEEffect::GrooVAEEffect(Model* parent, const Plugin::Descriptor::SubPluginFeatures::Key* key)
-    : AIEffect(parent, key)
-    , m_temperature(1.0f)
-    , m_humanize(0.5f)
-    , m_swing(0.0f)
-    , m_isProcessing(false) {
-    
-    // Load GrooVAE model
-    loadModel(ModelType::GrooVAE, "");
-    
-    // Initialize groove presets
-    m_groovePresets.resize(4);
+namespace {
+
+// Lowest preset trigger note (C2)
+constexpr int kFirstPresetKey = 36;
+
+} // namespace
+
+GrooVAEEffect::GrooVAEEffect(lmms::Model* parent, const lmms::Plugin::Descriptor* descriptor)
+    : AIEffect(parent, descriptor)
+    , m_grooveAmount(1.0f)
+    , m_swingAmount(0.0f)
+    , m_grooveModel(1.0f, 0.0f, 1.0f, 0.01f, this, "Groove")
+    , m_swingModel(0.0f, 0.0f, 1.0f, 0.01f, this, "Swing")
+    , m_grooveStyle(0)
+    , m_quantizeBeforeGroove(false)
+    , m_groovePresets(kNumPresets)
+    , m_currentPreset(0)
+    , m_pendingPreset(-1)
+    , m_isStopping(false) {
+    bindParameter(&m_grooveModel);
+    bindParameter(&m_swingModel);
+    m_presetWorker = std::thread(&GrooVAEEffect::runPresetWorker, this);
 }
 
 GrooVAEEffect::~GrooVAEEffect() {
+    m_isStopping = true;
+    m_presetRequested.signal();
+    m_presetWorker.join();
+
+    // Settings may still be loading into our members
+    waitForSettings();
 }
 
-bool GrooVAEEffect::processAudioBuffer(sampleFrame* buffer, const fpp_t frames) {
-    // This effect doesn't process audio directly
-    // It processes MIDI data in the track
-    return false;
+bool GrooVAEEffect::initialize() {
+    if (!AIEffect::initialize()) {
+        return false;
+    }
+
+    // Load the GrooVAE model
+    if (!loadModel()) {
+        std::cerr << "Failed to load GrooVAE model" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+ModelType GrooVAEEffect::getModelType() const {
+    return ModelType::GrooVAE;
 }
 
-bool GrooVAEEffect::handleMidiEvent(const MidiEvent& event, const MidiTime& time, f_cnt_t offset) {
-    // Check if model is loaded
-    if (!isModelLoaded()) {
+std::string GrooVAEEffect::getModelName() const {
+    return "";
+}
+
+bool GrooVAEEffect::handleMidiEvent(const lmms::MidiEvent& event, const lmms::TimePos& time, lmms::f_cnt_t offset) {
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "GrooVAEEffect::handleMidiEvent");
+    LMMS_MAGENTA_REALTIME_SCOPE("GrooVAEEffect::handleMidiEvent");
+
+    // Check if model and presets are loaded
+    if (!isSettingsReady() || !isModelLoaded()) {
         return false;
     }
-    
-    // Check if this is a note on event
-    if (event.type() == MidiEvent::NoteOn) {
-        // Get the note
-        const int note = event.key();
-        
-        // Check if this is a groove preset trigger note (C2-B2)
-        if (note >= 36 && note <= 47) {
-            // Calculate preset index
-            const int presetIndex = note - 36;
-            
-            // Check if preset exists
-            if (presetIndex < static_cast<int>(m_groovePresets.size())) {
-                // Set current preset
-                m_currentPreset = presetIndex;
-                
-                // Apply the groove preset
-                applyGroovePreset(m_groovePresets[m_currentPreset]);
-                
-                // Event handled
-                return true;
-            }
+
+    // Check if this is a groove preset trigger note
+    if (event.type() == lmms::MidiNoteOn) {
+        const int presetIndex = event.key() - kFirstPresetKey;
+        if (presetIndex >= 0 && presetIndex < kNumPresets) {
+            // Applying a preset runs the model; hand it to the preset worker
+            m_currentPreset.store(presetIndex, std::memory_order_relaxed);
+            m_pendingPreset.store(presetIndex, std::memory_order_release);
+            m_presetRequested.signal();
+
+            // Event handled
+            return true;
         }
     }
-    
+
     // Event not handled
     return false;
 }
 
-void GrooVAEEffect::applyGroove() {
-    // Check if model is loaded
-    if (!isModelLoaded()) {
-        std::cerr << "Model not loaded" << std::endl;
-        return;
-    }
-    
-    // Check if already processing
-    if (m_isProcessing) {
-        std::cerr << "Already processing" << std::endl;
-        return;
-    }
-    
-    // Set processing flag
-    m_isProcessing = true;
-    
-    // Get the model
-    auto model = std::dynamic_pointer_cast<GrooVAEModel>(getModel());
-    if (!model) {
-        std::cerr << "Failed to get GrooVAE model" << std::endl;
-        m_isProcessing = false;
-        return;
-    }
-    
-    // Set model parameters
-    model->setTemperature(m_temperature);
-    model->setHumanize(m_humanize);
-    
-    // Get input notes from the track
-    std::vector<MidiNote> inputNotes = getInputNotes();
-    
-    // Apply groove
-    std::vector<MidiNote> outputNotes;
-    if (!model->applyGroove(inputNotes, outputNotes)) {
-        std::cerr << "Failed to apply groove" << std::endl;
-        m_isProcessing = false;
-        return;
-    }
-    
-    // Apply swing
-    if (m_swing != 0.0f) {
-        applySwing(outputNotes);
+void GrooVAEEffect::runPresetWorker() {
+    for (;;) {
+        // Every request is signalled, so none is missed between the check and the wait
+        m_presetRequested.wait();
+        if (m_isStopping) {
+            break;
+        }
+
+        const int presetIndex = m_pendingPreset.exchange(-1, std::memory_order_acq_rel);
+        if (presetIndex < 0) {
+            continue;
+        }
+
+        auto model = getGrooVAEModel();
+        if (!model) {
+            continue;
+        }
+
+        std::vector<float> groove;
+        MidiSequence source;
+        {
+            std::lock_guard<std::mutex> lock(m_presetMutex);
+            groove = m_groovePresets[presetIndex];
+            source = m_sourceSequence;
+        }
+        if (groove.empty() || source.notes.empty()) {
+            continue;
+        }
+
+        // Charge the inference to this plugin
+        MidiSequence grooved;
+        {
+            ModelJob job = ModelServer::getInstance().beginJob(getClientId());
+            if (!job.isAdmitted()) {
+                continue;
+            }
+            grooved = model->applyExtractedGroove(source, groove, m_grooveAmount.load(std::memory_order_relaxed));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(m_presetMutex);
+            m_groovedSequence = std::move(grooved);
+        }
+        emit groovePresetApplied(presetIndex);
     }
-    
-    // Update track with processed notes
-    updateTrackNotes(outputNotes);
-    
-    // Reset processing flag
-    m_isProcessing = false;
-    
-    // Notify UI that groove has been applied
-    emit grooveApplied();
 }
 
-void GrooVAEEffect::extractGroove() {
-    // Check if model is loaded
-    if (!isModelLoaded()) {
-        std::cerr << "Model not loaded" << std::endl;
-        return;
-    }
-    
-    // Check if already processing
-    if (m_isProcessing) {
-        std::cerr << "Already processing" << std::endl;
-        return;
-    }
-    
-    // Set processing flag
-    m_isProcessing = true;
-    
-    // Get the model
-    auto model = std::dynamic_pointer_cast<GrooVAEModel>(getModel());
-    if (!model) {
-        std::cerr << "Failed to get GrooVAE model" << std::endl;
-        m_isProcessing = false;
-        return;
-    }
-    
-    // Get input notes from the track
-    std::vector<MidiNote> inputNotes = getInputNotes();
-    
-    // Extract groove
-    std::vector<float> groove;
-    if (!model->extractGroove(inputNotes, groove)) {
-        std::cerr << "Failed to extract groove" << std::endl;
-        m_isProcessing = false;
-        return;
-    }
-    
-    // Store groove in current preset
-    m_groovePresets[m_currentPreset] = groove;
-    
-    // Reset processing flag
-    m_isProcessing = false;
-    
-    // Notify UI that groove has been extracted
-    emit grooveExtracted(m_currentPreset);
+lmms::Pattern* GrooVAEEffect::processPattern(lmms::Pattern* pattern) {
+    return applyGroove(pattern,
+                       m_grooveAmount.load(std::memory_order_relaxed),
+                       m_swingAmount.load(std::memory_order_relaxed));
 }
 
-void GrooVAEEffect::applyGroovePreset(const std::vector<float>& groove) {
-    // Check if model is loaded
-    if (!isModelLoaded()) {
-        std::cerr << "Model not loaded" << std::endl;
-        return;
-    }
-    
-    // Check if already processing
-    if (m_isProcessing) {
-        std::cerr << "Already processing" << std::endl;
-        return;
-    }
-    
-    // Check if groove is valid
-    if (groove.empty()) {
-        std::cerr << "Empty groove preset" << std::endl;
-        return;
+lmms::Pattern* GrooVAEEffect::applyGroove(lmms::Pattern* pattern, float grooveAmount, float swingAmount) {
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "GrooVAEEffect::applyGroove");
+
+    // The model is resolved with the settings loaded from a project
+    waitForSettings();
+
+    if (!pattern) {
+        return pattern;
     }
-    
-    // Set processing flag
-    m_isProcessing = true;
-    
-    // Get the model
-    auto model = std::dynamic_pointer_cast<GrooVAEModel>(getModel());
+
+    auto model = getGrooVAEModel();
     if (!model) {
         std::cerr << "Failed to get GrooVAE model" << std::endl;
-        m_isProcessing = false;
-        return;
+        return pattern;
     }
-    
-    // Set model parameters
-    model->setTemperature(m_temperature);
-    model->setHumanize(m_humanize);
-    
-    // Get input notes from the track
-    std::vector<MidiNote> inputNotes = getInputNotes();
-    
-    // Apply groove vector
-    std::vector<MidiNote> outputNotes;
-    if (!model->applyGrooveVector(inputNotes, groove, outputNotes)) {
-        std::cerr << "Failed to apply groove vector" << std::endl;
-        m_isProcessing = false;
-        return;
+
+    MidiSequence sequence = patternToSequence(pattern);
+
+    // Presets triggered from MIDI apply to the pattern processed last
+    {
+        std::lock_guard<std::mutex> lock(m_presetMutex);
+        m_sourceSequence = sequence;
     }
-    
-    // Apply swing
-    if (m_swing != 0.0f) {
-        applySwing(outputNotes);
+
+    // Hold a job slot while grooving
+    ModelJob job = ModelServer::getInstance().beginJob(getClientId());
+    if (!job.isAdmitted()) {
+        std::cerr << "Groove rejected by quota (retry in "
+                  << job.getRetryAfter().count() << " ms)" << std::endl;
+        return pattern;
     }
-    
-    // Update track with processed notes
-    updateTrackNotes(outputNotes);
-    
-    // Reset processing flag
-    m_isProcessing = false;
-    
-    // Notify UI that groove preset has been applied
-    emit groovePresetApplied(m_currentPreset);
-}
 
-void GrooVAEEffect::setTemperature(float temperature) {
-    m_temperature = temperature;
+    model->setGrooveStyle(m_grooveStyle);
+    sequenceToPattern(model->applyGroove(sequence, grooveAmount, swingAmount), pattern);
+    return pattern;
 }
 
-float GrooVAEEffect::getTemperature() const {
-    return m_temperature;
+std::shared_ptr<GrooVAEModel> GrooVAEEffect::getGrooVAEModel() {
+    return std::dynamic_pointer_cast<GrooVAEModel>(getModel());
 }
 
-void GrooVAEEffect::setHumanize(float humanize) {
-    m_humanize = humanize;
+MidiSequence GrooVAEEffect::getGroovedSequence() {
+    std::lock_guard<std::mutex> lock(m_presetMutex);
+    return m_groovedSequence;
 }
 
-float GrooVAEEffect::getHumanize() const {
-    return m_humanize;
-}
+void GrooVAEEffect::setGroovePreset(int index, const std::vector<float>& groove) {
+    // Do not let settings loaded from a project overwrite the change
+    waitForSettings();
 
-void GrooVAEEffect::setSwing(float swing) {
-    m_swing = swing;
+    if (index >= 0 && index < kNumPresets) {
+        std::lock_guard<std::mutex> lock(m_presetMutex);
+        m_groovePresets[index] = groove;
+    }
 }
 
-float GrooVAEEffect::getSwing() const {
-    return m_swing;
-}
+std::vector<float> GrooVAEEffect::getGroovePreset(int index) {
+    waitForSettings();
 
-void GrooVAEEffect::setCurrentPreset(int index) {
-    if (index >= 0 && index < static_cast<int>(m_groovePresets.size())) {
-        m_currentPreset = index;
+    if (index < 0 || index >= kNumPresets) {
+        return std::vector<float>();
     }
-}
 
-int GrooVAEEffect::getCurrentPreset() const {
-    return m_currentPreset;
+    std::lock_guard<std::mutex> lock(m_presetMutex);
+    return m_groovePresets[index];
 }
 
-const std::vector<float>& GrooVAEEffect::getGroovePreset(int index) const {
-    if (index >= 0 && index < static_cast<int>(m_groovePresets.size())) {
-        return m_groovePresets[index];
+bool GrooVAEEffect::setGroovePresetFromLibrary(int index, const std::string& grooveName) {
+    // Do not let settings loaded from a project overwrite the change
+    waitForSettings();
+
+    if (index < 0 || index >= kNumPresets) {
+        return false;
+    }
+
+    auto model = getGrooVAEModel();
+    if (!model) {
+        return false;
     }
-    
-    // Return current preset if index is invalid
-    return m_groovePresets[m_currentPreset];
+
+    // Copy the groove out of the library mapping
+    const GrooveLibrary& library = model->getGrooveLibrary();
+    const float* embedding = library.getEmbedding(library.findByName(grooveName));
+    if (!embedding) {
+        std::cerr << "Groove not found in library: " << grooveName << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_presetMutex);
+    m_groovePresets[index].assign(embedding, embedding + library.getDimension());
+    return true;
 }
 
-void GrooVAEEffect::setGroovePreset(int index, const std::vector<float>& groove) {
-    if (index >= 0 && index < static_cast<int>(m_groovePresets.size())) {
-        m_groovePresets[index] = groove;
+std::vector<std::string> GrooVAEEffect::findSimilarGrooves(int presetIndex, size_t count) {
+    waitForSettings();
+
+    std::vector<std::string> names;
+    if (presetIndex < 0 || presetIndex >= kNumPresets) {
+        return names;
+    }
+
+    auto model = getGrooVAEModel();
+    if (!model) {
+        return names;
     }
+
+    // Presets saved with another model may not match the library's embeddings
+    const GrooveLibrary& library = model->getGrooveLibrary();
+    const std::vector<float> preset = getGroovePreset(presetIndex);
+    if (preset.size() != library.getDimension()) {
+        return names;
+    }
+
+    for (const auto& match : library.findNearest(preset.data(), count)) {
+        names.push_back(library.getName(match.id));
+    }
+    return names;
 }
 
-bool GrooVAEEffect::isProcessing() const {
-    return m_isProcessing;
+int GrooVAEEffect::getCurrentPreset() const {
+    return m_currentPreset.load(std::memory_order_relaxed);
+}
+
+void GrooVAEEffect::handleParameterChange(const lmms::AutomatableModel* param, float value) {
+    const QString name = param->displayName();
+
+    if (name == "Groove") {
+        m_grooveAmount.store(std::max(0.0f, std::min(1.0f, value)), std::memory_order_relaxed);
+    } else if (name == "Swing") {
+        m_swingAmount.store(std::max(0.0f, std::min(1.0f, value)), std::memory_order_relaxed);
+    } else {
+        AIEffect::handleParameterChange(param, value);
+    }
 }
 
 void GrooVAEEffect::saveEffectSpecificSettings(QDomDocument& doc, QDomElement& element) {
     // Save parameters
-    element.setAttribute("temperature", m_temperature);
-    element.setAttribute("humanize", m_humanize);
-    element.setAttribute("swing", m_swing);
-    
+    element.setAttribute("grooveAmount", m_grooveModel.value());
+    element.setAttribute("swingAmount", m_swingModel.value());
+    element.setAttribute("grooveStyle", m_grooveStyle);
+    element.setAttribute("quantize", m_quantizeBeforeGroove ? 1 : 0);
+
     // Save current preset
-    element.setAttribute("currentPreset", m_currentPreset);
-    
+    element.setAttribute("currentPreset", getCurrentPreset());
+
     // Save groove presets
     QDomElement presetsElement = doc.createElement("groovePresets");
     element.appendChild(presetsElement);
-    
-    for (size_t i = 0; i < m_groovePresets.size(); ++i) {
+
+    for (int i = 0; i < kNumPresets; ++i) {
         QDomElement presetElement = doc.createElement("preset");
         presetsElement.appendChild(presetElement);
-        
-        presetElement.setAttribute("index", static_cast<int>(i));
-        
-        // Save groove vector
-        QString grooveStr;
-        for (const auto& value : m_groovePresets[i]) {
-            grooveStr += QString::number(value) + ",";
-        }
-        if (!grooveStr.isEmpty()) {
-            grooveStr.chop(1); // Remove trailing comma
+
+        presetElement.setAttribute("index", i);
+
+        // Save groove vector as a binary blob
+        std::string groove;
+        {
+            std::lock_guard<std::mutex> lock(m_presetMutex);
+            groove = StateCodec::encodeFloats(m_groovePresets[i]);
         }
-        
-        presetElement.setAttribute("groove", grooveStr);
+        presetElement.setAttribute("data", QString::fromLatin1(groove.data(), static_cast<int>(groove.size())));
     }
 }
 
 void GrooVAEEffect::loadEffectSpecificSettings(const QDomElement& element) {
-    // Load parameters
-    m_temperature = element.attribute("temperature", "1.0").toFloat();
-    m_humanize = element.attribute("humanize", "0.5").toFloat();
-    m_swing = element.attribute("swing", "0.0").toFloat();
-    
+    // Load parameters; the knobs report them through handleParameterChange()
+    m_grooveModel.setValue(element.attribute("grooveAmount", "1.0").toFloat());
+    m_swingModel.setValue(element.attribute("swingAmount", "0.0").toFloat());
+    m_grooveStyle = element.attribute("grooveStyle", "0").toInt();
+    m_quantizeBeforeGroove = element.attribute("quantize", "0").toInt() != 0;
+
     // Load current preset
-    m_currentPreset = element.attribute("currentPreset", "0").toInt();
-    
+    const int currentPreset = element.attribute("currentPreset", "0").toInt();
+    m_currentPreset.store(currentPreset >= 0 && currentPreset < kNumPresets ? currentPreset : 0,
+                          std::memory_order_relaxed);
+
     // Load groove presets
     QDomElement presetsElement = element.firstChildElement("groovePresets");
     if (!presetsElement.isNull()) {
         QDomElement presetElement = presetsElement.firstChildElement("preset");
         while (!presetElement.isNull()) {
             int index = presetElement.attribute("index", "0").toInt();
-            
+
             // Check if index is valid
-            if (index >= 0 && index < static_cast<int>(m_groovePresets.size())) {
-                // Load groove vector
-                QString grooveStr = presetElement.attribute("groove", "");
-                QStringList values = grooveStr.split(",", Qt::SkipEmptyParts);
-                
+            if (index >= 0 && index < kNumPresets) {
                 std::vector<float> groove;
-                groove.reserve(values.size());
-                
-                for (const auto& value : values) {
-                    groove.push_back(value.toFloat());
+
+                if (presetElement.hasAttribute("data")) {
+                    // Load groove vector from its binary blob
+                    const QByteArray data = presetElement.attribute("data").toLatin1();
+                    if (!StateCodec::decodeFloats(data.constData(), data.size(), groove)) {
+                        std::cerr << "Invalid groove preset " << index << std::endl;
+                    }
+                } else {
+                    // Projects saved before the binary format store comma-separated values
+                    QString grooveStr = presetElement.attribute("groove", "");
+                    QStringList values = grooveStr.split(",", Qt::SkipEmptyParts);
+
+                    groove.reserve(values.size());
+
+                    for (const auto& value : values) {
+                        groove.push_back(value.toFloat());
+                    }
                 }
-                
-                m_groovePresets[index] = groove;
+
+                std::lock_guard<std::mutex> lock(m_presetMutex);
+                m_groovePresets[index] = std::move(groove);
             }
-            
+
             presetElement = presetElement.nextSiblingElement("preset");
         }
     }
 }
 
-std::vector<MidiNote> GrooVAEEffect::getInputNotes() {
-    // This is a placeholder for getting input notes from the track
-    // In a real implementation, we would get the notes from the LMMS track
-    
-    // For now, just return some placeholder notes
-    std::vector<MidiNote> notes;
-    
-    // Create a simple 4/4 beat
-    for (int i = 0; i < 16; ++i) {
-        MidiNote note;
-        note.pitch = 36; // Kick drum
-        note.velocity = 100;
-        note.startTime = i * 0.25f;
-        note.endTime = note.startTime + 0.1f;
-        
-        notes.push_back(note);
-        
-        // Add snare on beats 2 and 4
-        if (i % 4 == 2) {
-            MidiNote snare;
-            snare.pitch = 38; // Snare drum
-            snare.velocity = 100;
-            snare.startTime = i * 0.25f;
-            snare.endTime = snare.startTime + 0.1f;
-            
-            notes.push_back(snare);
+MidiSequence GrooVAEEffect::patternToSequence(lmms::Pattern* pattern) {
+    const int ticksPerQuarter = lmms::TimePos::ticksPerBar() / 4;
+    MidiSequence sequence(ticksPerQuarter, std::max<int>(pattern->length().getTicks(), 1));
+
+    // Snap onsets to sixteenths when asked to
+    const int sixteenth = std::max(1, ticksPerQuarter / 4);
+    for (const lmms::Note* note : pattern->notes()) {
+        int startTime = note->pos().getTicks();
+        if (m_quantizeBeforeGroove) {
+            startTime = (startTime + sixteenth / 2) / sixteenth * sixteenth;
         }
-        
-        // Add hi-hat on every 8th note
-        MidiNote hihat;
-        hihat.pitch = 42; // Closed hi-hat
-        hihat.velocity = 80;
-        hihat.startTime = i * 0.25f;
-        hihat.endTime = hihat.startTime + 0.1f;
-        
-        notes.push_back(hihat);
+        const int velocity = note->getVolume() * 127 / lmms::MaxVolume;
+        sequence.notes.emplace_back(note->key(), std::max(1, std::min(127, velocity)),
+                                    startTime, std::max<int>(note->length().getTicks(), 1), true);
     }
-    
-    return notes;
-}
 
-void GrooVAEEffect::updateTrackNotes(const std::vector<MidiNote>& notes) {
-    // This is a placeholder for updating track notes
-    // In a real implementation, we would update the LMMS track with the processed notes
-    
-    // For now, just log that we're updating the track
-    std::cout << "Updating track with " << notes.size() << " processed notes" << std::endl;
+    return sequence;
 }
 
-void GrooVAEEffect::applySwing(std::vector<MidiNote>& notes) {
-    // Apply swing to the notes
-    // Swing affects the timing of even-numbered 8th notes
-    
-    // Calculate the swing amount in seconds (assuming 120 BPM)
-    const float eighthNote = 0.25f; // Quarter note = 0.5s at 120 BPM
-    const float swingAmount = eighthNote * m_swing;
-    
-    for (auto& note : notes) {
-        // Calculate which 8th note this is
-        const int eighthNoteIndex = static_cast<int>(note.startTime / eighthNote);
-        
-        // Apply swing to even-numbered 8th notes
-        if (eighthNoteIndex % 2 == 1) {
-            note.startTime += swingAmount;
-            note.endTime += swingAmount;
-        }
+void GrooVAEEffect::sequenceToPattern(const MidiSequence& sequence, lmms::Pattern* pattern) {
+    pattern->clearNotes();
+    for (const auto& note : sequence.notes) {
+        const auto volume = static_cast<lmms::volume_t>(note.velocity * lmms::MaxVolume / 127);
+        pattern->addNote(lmms::Note(lmms::TimePos(note.duration), lmms::TimePos(note.startTime),
+                                    note.pitch, volume), false);
     }
 }
 
@@ -1,16 +1,186 @@
 #include "MusicVAEInstrument.h"
+#include "../../model_serving/include/QuotaManager.h"
+#include "../../utils/include/RealtimeChecker.h"
+#include "../../utils/include/StateCodec.h"
+#include "../../utils/include/Trace.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <map>
 #include <QDomDocument>
 
 namespace lmms_magenta {
 
+namespace {
+
+// Distance of a parameter from neutral (0.5), from -1 at 0 to 1 at 1
+float fromNeutral(float value) {
+    return std::max(-1.0f, std::min(1.0f, 2.0f * value - 1.0f));
+}
+
+// Number of items, at least one, a share of a collection amounts to
+size_t shareOf(float share, size_t size) {
+    return std::max<size_t>(1, static_cast<size_t>(std::lround(share * static_cast<float>(size))));
+}
+
+// Keep the loudest notes, at least one, in their original order
+void thinNotes(std::vector<MidiNote>& notes, float share) {
+    const size_t keep = shareOf(share, notes.size());
+    if (keep >= notes.size()) {
+        return;
+    }
+    
+    std::vector<MidiNote> loudest = notes;
+    std::nth_element(loudest.begin(), loudest.begin() + (keep - 1), loudest.end(),
+                     [](const MidiNote& a, const MidiNote& b) { return a.velocity > b.velocity; });
+    const int threshold = loudest[keep - 1].velocity;
+    
+    // Notes at the threshold are kept first come, first served
+    size_t aboveThreshold = 0;
+    for (const auto& note : notes) {
+        aboveThreshold += note.velocity > threshold ? 1 : 0;
+    }
+    size_t atThreshold = keep - aboveThreshold;
+    
+    std::vector<MidiNote> kept;
+    kept.reserve(keep);
+    for (const auto& note : notes) {
+        if (note.velocity > threshold) {
+            kept.push_back(note);
+        } else if (note.velocity == threshold && atThreshold > 0) {
+            kept.push_back(note);
+            --atThreshold;
+        }
+    }
+    notes.swap(kept);
+}
+
+// Move pitched notes to the most used pitches, keeping between one and all of
+// the pitches the pattern has
+void reducePitches(std::vector<MidiNote>& notes, float share) {
+    std::map<int, int> uses;
+    for (const auto& note : notes) {
+        if (!note.isPercussion) {
+            ++uses[note.pitch];
+        }
+    }
+    
+    const size_t keep = shareOf(share, uses.size());
+    if (keep >= uses.size()) {
+        return;
+    }
+    
+    std::vector<std::pair<int, int>> byUse(uses.begin(), uses.end());
+    std::stable_sort(byUse.begin(), byUse.end(),
+                     [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.second > b.second; });
+    byUse.resize(keep);
+    
+    for (auto& note : notes) {
+        if (note.isPercussion) {
+            continue;
+        }
+        int nearest = byUse.front().first;
+        for (const auto& pitch : byUse) {
+            if (std::abs(pitch.first - note.pitch) < std::abs(nearest - note.pitch)) {
+                nearest = pitch.first;
+            }
+        }
+        note.pitch = nearest;
+    }
+}
+
+// Split the longest notes in two halves, keeping the notes in start order
+void splitNotes(std::vector<MidiNote>& notes, float share) {
+    if (notes.empty()) {
+        return;
+    }
+    
+    std::vector<size_t> byLength(notes.size());
+    for (size_t i = 0; i < byLength.size(); ++i) {
+        byLength[i] = i;
+    }
+    std::stable_sort(byLength.begin(), byLength.end(),
+                     [&notes](size_t a, size_t b) { return notes[a].duration > notes[b].duration; });
+    byLength.resize(shareOf(share, notes.size()));
+    
+    for (const size_t index : byLength) {
+        MidiNote& note = notes[index];
+        if (note.duration < 2) {
+            continue;
+        }
+        MidiNote second = note;
+        note.duration /= 2;
+        second.startTime += note.duration;
+        second.duration -= note.duration;
+        notes.push_back(second);
+    }
+    std::stable_sort(notes.begin(), notes.end(),
+                     [](const MidiNote& a, const MidiNote& b) { return a.startTime < b.startTime; });
+}
+
+// Move an evenly spread share of the pitched notes a whole step, alternately
+// up and down, adding pitches the pattern did not have
+void varyPitches(std::vector<MidiNote>& notes, float share) {
+    size_t pitched = 0;
+    size_t moved = 0;
+    for (auto& note : notes) {
+        if (note.isPercussion) {
+            continue;
+        }
+        const size_t before = static_cast<size_t>(share * pitched);
+        const size_t after = static_cast<size_t>(share * (pitched + 1));
+        ++pitched;
+        if (after > before) {
+            const int step = moved++ % 2 == 0 ? 2 : -2;
+            const int pitch = note.pitch + step;
+            note.pitch = pitch >= 0 && pitch <= 127 ? pitch : note.pitch - step;
+        }
+    }
+}
+
+// Thin the pattern below a density of 0.5 and add notes above it
+void applyDensity(std::vector<MidiNote>& notes, float density) {
+    const float shift = fromNeutral(density);
+    if (shift < 0.0f) {
+        thinNotes(notes, 1.0f + shift);
+    } else if (shift > 0.0f) {
+        splitNotes(notes, shift);
+    }
+}
+
+// Reduce the pitches below a complexity of 0.5 and add pitches above it
+void applyComplexity(std::vector<MidiNote>& notes, float complexity) {
+    const float shift = fromNeutral(complexity);
+    if (shift < 0.0f) {
+        reducePitches(notes, 1.0f + shift);
+    } else if (shift > 0.0f) {
+        // At most every other note moves, so the original pitches remain
+        varyPitches(notes, 0.5f * shift);
+    }
+}
+
+} // namespace
+
 MusicVAEInstrument::MusicVAEInstrument(InstrumentTrack* track, const Plugin::Descriptor::SubPluginFeatures::Key* key)
     : AIInstrument(track, key)
     , m_temperature(1.0f)
+    , m_noteDensity(0.5f)
+    , m_complexity(0.5f)
+    , m_valence(0.0f)
+    , m_arousal(0.0f)
+    , m_intensity(0.5f)
+    , m_valenceModel(0.0f, -1.0f, 1.0f, 0.01f, this, "Valence")
+    , m_arousalModel(0.0f, -1.0f, 1.0f, 0.01f, this, "Arousal")
+    , m_intensityModel(0.5f, 0.0f, 1.0f, 0.01f, this, "Intensity")
     , m_patternLength(16)
     , m_currentPattern(0)
     , m_isGenerating(false) {
     
+    // Follow the emotion knobs and their automation
+    bindParameter(&m_valenceModel);
+    bindParameter(&m_arousalModel);
+    bindParameter(&m_intensityModel);
+    
     // Load MusicVAE model
     loadModel(ModelType::MusicVAE, "");
     
@@ -19,9 +189,19 @@ MusicVAEInstrument::MusicVAEInstrument(InstrumentTrack* track, const Plugin::Des
 }
 
 MusicVAEInstrument::~MusicVAEInstrument() {
+    // Settings may still be loading into our members
+    waitForSettings();
 }
 
 void MusicVAEInstrument::playNote(NotePlayHandle* nph, sampleFrame* workingBuffer) {
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "MusicVAEInstrument::playNote");
+    LMMS_MAGENTA_REALTIME_SCOPE("MusicVAEInstrument::playNote");
+
+    // Patterns are still being loaded from the project
+    if (!isSettingsReady()) {
+        return;
+    }
+    
     // Get the note
     const int note = nph->key();
     
@@ -46,6 +226,14 @@ void MusicVAEInstrument::deleteNotePluginData(NotePlayHandle* nph) {
 }
 
 bool MusicVAEInstrument::handleMidiEvent(const MidiEvent& event, const MidiTime& time, f_cnt_t offset) {
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "MusicVAEInstrument::handleMidiEvent");
+    LMMS_MAGENTA_REALTIME_SCOPE("MusicVAEInstrument::handleMidiEvent");
+
+    // Patterns are still being loaded from the project
+    if (!isSettingsReady()) {
+        return false;
+    }
+    
     // Check if this is a note on event
     if (event.type() == MidiEvent::NoteOn) {
         // Get the note
@@ -75,6 +263,11 @@ bool MusicVAEInstrument::handleMidiEvent(const MidiEvent& event, const MidiTime&
 }
 
 void MusicVAEInstrument::generatePattern() {
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "MusicVAEInstrument::generatePattern");
+
+    // The model is resolved with the settings loaded from a project
+    waitForSettings();
+    
     // Check if model is loaded
     if (!isModelLoaded()) {
         std::cerr << "Model not loaded" << std::endl;
@@ -98,16 +291,28 @@ void MusicVAEInstrument::generatePattern() {
         return;
     }
     
-    // Set temperature
-    model->setTemperature(m_temperature);
+    // Hold a job slot while sampling
+    ModelJob job = ModelServer::getInstance().beginJob(getClientId());
+    if (!job.isAdmitted()) {
+        std::cerr << "Pattern generation rejected by quota (retry in "
+                  << job.getRetryAfter().count() << " ms)" << std::endl;
+        m_isGenerating = false;
+        return;
+    }
     
     // Generate pattern
-    std::vector<MidiNote> notes;
-    if (!model->sample(notes)) {
+    const MidiSequence sequence = model->decode(model->samplePrior(),
+                                                m_temperature.load(std::memory_order_relaxed));
+    if (sequence.notes.empty()) {
         std::cerr << "Failed to generate pattern" << std::endl;
         m_isGenerating = false;
         return;
     }
+    std::vector<MidiNote> notes = sequence.notes;
+    
+    // Apply the density and complexity the emotion asks for
+    applyDensity(notes, m_noteDensity.load(std::memory_order_relaxed));
+    applyComplexity(notes, m_complexity.load(std::memory_order_relaxed));
     
     // Store pattern
     m_patterns[m_currentPattern] = notes;
@@ -120,6 +325,11 @@ void MusicVAEInstrument::generatePattern() {
 }
 
 void MusicVAEInstrument::interpolatePatterns(int startPatternIndex, int endPatternIndex, int steps) {
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "MusicVAEInstrument::interpolatePatterns");
+
+    // The model is resolved with the settings loaded from a project
+    waitForSettings();
+    
     // Check if model is loaded
     if (!isModelLoaded()) {
         std::cerr << "Model not loaded" << std::endl;
@@ -150,16 +360,27 @@ void MusicVAEInstrument::interpolatePatterns(int startPatternIndex, int endPatte
         return;
     }
     
-    // Set temperature
-    model->setTemperature(m_temperature);
-    
-    // Get start and end patterns
-    const auto& startPattern = m_patterns[startPatternIndex];
-    const auto& endPattern = m_patterns[endPatternIndex];
+    // Get start and end patterns (stored as decoded, at 480 ticks per quarter)
+    MidiSequence startPattern(480, model->getMaxSequenceLength());
+    MidiSequence endPattern(480, model->getMaxSequenceLength());
+    startPattern.notes = m_patterns[startPatternIndex];
+    endPattern.notes = m_patterns[endPatternIndex];
+    
+    // Every step holds a decoded sequence until the interpolation is done
+    const size_t scratchBytes = static_cast<size_t>(std::max(steps, 0)) *
+                                (startPattern.notes.size() + endPattern.notes.size()) * sizeof(MidiNote);
+    ModelJob job = ModelServer::getInstance().beginJob(getClientId(), scratchBytes);
+    if (!job.isAdmitted()) {
+        std::cerr << "Interpolation rejected by quota (retry in "
+                  << job.getRetryAfter().count() << " ms)" << std::endl;
+        m_isGenerating = false;
+        return;
+    }
     
     // Interpolate patterns
-    std::vector<std::vector<MidiNote>> interpolatedPatterns;
-    if (!model->interpolate(startPattern, endPattern, steps, interpolatedPatterns)) {
+    const std::vector<MidiSequence> interpolatedPatterns =
+        model->interpolate(startPattern, endPattern, steps, m_temperature.load(std::memory_order_relaxed));
+    if (interpolatedPatterns.empty()) {
         std::cerr << "Failed to interpolate patterns" << std::endl;
         m_isGenerating = false;
         return;
@@ -168,8 +389,8 @@ void MusicVAEInstrument::interpolatePatterns(int startPatternIndex, int endPatte
     // Store interpolated patterns
     // For now, just store the first and last interpolated patterns
     if (interpolatedPatterns.size() >= 2) {
-        m_patterns[startPatternIndex] = interpolatedPatterns.front();
-        m_patterns[endPatternIndex] = interpolatedPatterns.back();
+        m_patterns[startPatternIndex] = interpolatedPatterns.front().notes;
+        m_patterns[endPatternIndex] = interpolatedPatterns.back().notes;
     }
     
     // Reset generating flag
@@ -180,11 +401,11 @@ void MusicVAEInstrument::interpolatePatterns(int startPatternIndex, int endPatte
 }
 
 void MusicVAEInstrument::setTemperature(float temperature) {
-    m_temperature = temperature;
+    m_temperature.store(temperature, std::memory_order_relaxed);
 }
 
 float MusicVAEInstrument::getTemperature() const {
-    return m_temperature;
+    return m_temperature.load(std::memory_order_relaxed);
 }
 
 void MusicVAEInstrument::setPatternLength(int length) {
@@ -215,6 +436,9 @@ const std::vector<MidiNote>& MusicVAEInstrument::getPattern(int index) const {
 }
 
 void MusicVAEInstrument::setPattern(int index, const std::vector<MidiNote>& pattern) {
+    // Do not let settings loaded from a project overwrite the change
+    waitForSettings();
+    
     if (index >= 0 && index < static_cast<int>(m_patterns.size())) {
         m_patterns[index] = pattern;
     }
@@ -224,9 +448,82 @@ bool MusicVAEInstrument::isGenerating() const {
     return m_isGenerating;
 }
 
+bool MusicVAEInstrument::setEmotionMappingEnabled(bool enable) {
+    if (!enable) {
+        std::atomic_store(&m_emotionTable, std::shared_ptr<const EmotionLookupTable>());
+        return true;
+    }
+    
+    // Get the EmotionMapper model; its table is compiled when it loads
+    auto model = std::dynamic_pointer_cast<EmotionMapperModel>(
+        ModelServer::getInstance().getModel(ModelType::EmotionMapper));
+    if (!model || !model->getLookupTable()) {
+        std::cerr << "EmotionMapper lookup table not available" << std::endl;
+        return false;
+    }
+    
+    std::atomic_store(&m_emotionTable, model->getLookupTable());
+    
+    // Apply the emotion the knobs are set to
+    setEmotion(m_valence.load(std::memory_order_relaxed),
+               m_arousal.load(std::memory_order_relaxed),
+               m_intensity.load(std::memory_order_relaxed));
+    return true;
+}
+
+void MusicVAEInstrument::setEmotion(float valence, float arousal, float intensity) {
+    const std::shared_ptr<const EmotionLookupTable> table = std::atomic_load(&m_emotionTable);
+    if (!table) {
+        return;
+    }
+    
+    const GenerationParameters parameters = table->lookup(valence, arousal, intensity);
+    m_temperature.store(parameters.temperature, std::memory_order_relaxed);
+    m_noteDensity.store(std::max(0.0f, std::min(1.0f, parameters.density)), std::memory_order_relaxed);
+    m_complexity.store(std::max(0.0f, std::min(1.0f, parameters.complexity)), std::memory_order_relaxed);
+}
+
+float MusicVAEInstrument::getNoteDensity() const {
+    return m_noteDensity.load(std::memory_order_relaxed);
+}
+
+float MusicVAEInstrument::getComplexity() const {
+    return m_complexity.load(std::memory_order_relaxed);
+}
+
+void MusicVAEInstrument::handleParameterChange(const lmms::AutomatableModel* param, float value) {
+    const QString name = param->displayName();
+
+    if (name == "Temperature") {
+        m_temperature.store(value, std::memory_order_relaxed);
+        return;
+    }
+    
+    if (name == "Valence") {
+        m_valence.store(std::max(-1.0f, std::min(1.0f, value)), std::memory_order_relaxed);
+    } else if (name == "Arousal") {
+        m_arousal.store(std::max(-1.0f, std::min(1.0f, value)), std::memory_order_relaxed);
+    } else if (name == "Intensity") {
+        m_intensity.store(std::max(0.0f, std::min(1.0f, value)), std::memory_order_relaxed);
+    } else {
+        AIInstrument::handleParameterChange(param, value);
+        return;
+    }
+    
+    // Follow the emotion; a no-op while mapping is disabled
+    setEmotion(m_valence.load(std::memory_order_relaxed),
+               m_arousal.load(std::memory_order_relaxed),
+               m_intensity.load(std::memory_order_relaxed));
+}
+
 void MusicVAEInstrument::saveInstrumentSpecificSettings(QDomDocument& doc, QDomElement& element) {
     // Save temperature
-    element.setAttribute("temperature", m_temperature);
+    element.setAttribute("temperature", m_temperature.load(std::memory_order_relaxed));
+    
+    // Save emotion
+    m_valenceModel.saveSettings(doc, element, "valence");
+    m_arousalModel.saveSettings(doc, element, "arousal");
+    m_intensityModel.saveSettings(doc, element, "intensity");
     
     // Save pattern length
     element.setAttribute("patternLength", m_patternLength);
@@ -244,22 +541,26 @@ void MusicVAEInstrument::saveInstrumentSpecificSettings(QDomDocument& doc, QDomE
         
         patternElement.setAttribute("index", static_cast<int>(i));
         
-        // Save notes
-        for (const auto& note : m_patterns[i]) {
-            QDomElement noteElement = doc.createElement("note");
-            patternElement.appendChild(noteElement);
-            
-            noteElement.setAttribute("pitch", note.pitch);
-            noteElement.setAttribute("velocity", note.velocity);
-            noteElement.setAttribute("startTime", note.startTime);
-            noteElement.setAttribute("endTime", note.endTime);
-        }
+        // Save notes as one binary blob instead of an element per note
+        const std::string notes = StateCodec::encodeNotes(m_patterns[i]);
+        patternElement.setAttribute("notes", QString::fromLatin1(notes.data(), static_cast<int>(notes.size())));
+    }
+    
+    // Save current latent vector
+    if (!m_currentLatentVector.empty()) {
+        const std::string latent = StateCodec::encodeFloats(m_currentLatentVector);
+        element.setAttribute("latent", QString::fromLatin1(latent.data(), static_cast<int>(latent.size())));
     }
 }
 
 void MusicVAEInstrument::loadInstrumentSpecificSettings(const QDomElement& element) {
     // Load temperature
-    m_temperature = element.attribute("temperature", "1.0").toFloat();
+    m_temperature.store(element.attribute("temperature", "1.0").toFloat(), std::memory_order_relaxed);
+    
+    // Load emotion; the knobs report it through handleParameterChange()
+    m_valenceModel.loadSettings(element, "valence");
+    m_arousalModel.loadSettings(element, "arousal");
+    m_intensityModel.loadSettings(element, "intensity");
     
     // Load pattern length
     m_patternLength = element.attribute("patternLength", "16").toInt();
@@ -279,33 +580,47 @@ void MusicVAEInstrument::loadInstrumentSpecificSettings(const QDomElement& eleme
                 // Clear pattern
                 m_patterns[index].clear();
                 
-                // Load notes
-                QDomElement noteElement = patternElement.firstChildElement("note");
-                while (!noteElement.isNull()) {
-                    MidiNote note;
-                    note.pitch = noteElement.attribute("pitch", "60").toInt();
-                    note.velocity = noteElement.attribute("velocity", "64").toInt();
-                    note.startTime = noteElement.attribute("startTime", "0.0").toFloat();
-                    note.endTime = noteElement.attribute("endTime", "0.5").toFloat();
-                    
-                    m_patterns[index].push_back(note);
-                    
-                    noteElement = noteElement.nextSiblingElement("note");
+                // Load notes, from a binary blob if the project has one
+                if (patternElement.hasAttribute("notes")) {
+                    const QByteArray notes = patternElement.attribute("notes").toLatin1();
+                    if (!StateCodec::decodeNotes(notes.constData(), notes.size(), m_patterns[index])) {
+                        std::cerr << "Invalid notes in pattern " << index << std::endl;
+                    }
+                } else {
+                    // Projects saved before the binary format have an element per note
+                    QDomElement noteElement = patternElement.firstChildElement("note");
+                    while (!noteElement.isNull()) {
+                        MidiNote note;
+                        note.pitch = noteElement.attribute("pitch", "60").toInt();
+                        note.velocity = noteElement.attribute("velocity", "64").toInt();
+                        note.startTime = noteElement.attribute("startTime", "0.0").toFloat();
+                        note.endTime = noteElement.attribute("endTime", "0.5").toFloat();
+                        
+                        m_patterns[index].push_back(note);
+                        
+                        noteElement = noteElement.nextSiblingElement("note");
+                    }
                 }
             }
             
             patternElement = patternElement.nextSiblingElement("pattern");
         }
     }
+    
+    // Load current latent vector
+    m_currentLatentVector.clear();
+    if (element.hasAttribute("latent")) {
+        const QByteArray latent = element.attribute("latent").toLatin1();
+        if (!StateCodec::decodeFloats(latent.constData(), latent.size(), m_currentLatentVector)) {
+            std::cerr << "Invalid latent vector in instrument settings" << std::endl;
+        }
+    }
 }
 
 void MusicVAEInstrument::playPattern(const std::vector<MidiNote>& pattern) {
     // This is a placeholder for actual pattern playback
     // In a real implementation, we would convert the pattern to LMMS notes
-    // and add them to the track
-    
-    // For now, just log that we're playing the pattern
-    std::cout << "Playing pattern with " << pattern.size() << " notes" << std::endl;
+    // and add them to the track. Called from playNote(), so no logging here.
     
     // Notify UI that pattern is being played
     emit patternPlayed(m_currentPattern);
@@ -0,0 +1,93 @@
+#include "ProjectModelPrefetcher.h"
+#include <algorithm>
+#include <limits>
+#include <thread>
+
+namespace lmms_magenta {
+
+namespace {
+
+// Loads are bound by disk and memory bandwidth, more threads do not help
+constexpr unsigned int kMaxLoaderThreads = 4;
+
+// Position of tracks that never play
+constexpr int64_t kNeverPlayed = std::numeric_limits<int64_t>::max();
+
+// Position of the first unmuted clip of a track
+int64_t findFirstClip(const QDomElement& track) {
+    if (track.attribute("muted").toInt() != 0) {
+        return kNeverPlayed;
+    }
+
+    int64_t firstTick = kNeverPlayed;
+    for (QDomElement clip = track.firstChildElement(); !clip.isNull(); clip = clip.nextSiblingElement()) {
+        if (!clip.hasAttribute("pos") || clip.attribute("muted").toInt() != 0) {
+            continue;
+        }
+        firstTick = std::min(firstTick, clip.attribute("pos").toLongLong());
+    }
+    return firstTick;
+}
+
+void collectModels(const QDomElement& element, int64_t firstTick, bool isInTrack,
+                   std::vector<PrefetchRequest>& requests) {
+    if (element.tagName() == "track") {
+        // Tracks nested in a pattern track play when the pattern's clips do
+        if (!isInTrack) {
+            firstTick = findFirstClip(element);
+        }
+        isInTrack = true;
+    }
+
+    // Written by AIPlugin::saveSettings
+    const QString modelName = element.attribute("modelName");
+    if (element.hasAttribute("modelType") && !modelName.isEmpty()) {
+        requests.push_back(PrefetchRequest{
+            static_cast<ModelType>(element.attribute("modelType").toInt()),
+            modelName.toStdString(),
+            isInTrack ? firstTick : 0
+        });
+    }
+
+    for (QDomElement child = element.firstChildElement(); !child.isNull(); child = child.nextSiblingElement()) {
+        collectModels(child, firstTick, isInTrack, requests);
+    }
+}
+
+} // namespace
+
+ProjectModelPrefetcher& ProjectModelPrefetcher::getInstance() {
+    static ProjectModelPrefetcher instance;
+    return instance;
+}
+
+ProjectModelPrefetcher::ProjectModelPrefetcher()
+    : m_prefetcher(std::max(1u, std::min(kMaxLoaderThreads, std::thread::hardware_concurrency()))) {
+}
+
+void ProjectModelPrefetcher::prefetchProject(const QDomDocument& project) {
+    const QDomElement root = project.documentElement();
+    if (root.isNull()) {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Every plugin of the project passes the same document
+    if (root == m_project && m_prefetcher.getPendingCount() > 0) {
+        return;
+    }
+
+    m_project.clear();
+    if (m_prefetcher.prefetch(scanProject(root)) > 0) {
+        m_project = root;
+    }
+}
+
+std::vector<PrefetchRequest> ProjectModelPrefetcher::scanProject(const QDomElement& root) {
+    std::vector<PrefetchRequest> requests;
+    collectModels(root, 0, false, requests);
+    return requests;
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,110 @@
+#include "ProjectStateLoader.h"
+#include <iostream>
+#include <vector>
+
+namespace lmms_magenta {
+
+ProjectStateLoader& ProjectStateLoader::getInstance() {
+    static ProjectStateLoader instance;
+    return instance;
+}
+
+ProjectStateLoader::ProjectStateLoader(size_t numThreads)
+    : m_pool(numThreads)
+    , m_nextTaskId(0) {
+}
+
+ProjectStateLoader::~ProjectStateLoader() {
+    waitForAll();
+}
+
+void ProjectStateLoader::defer(const void* owner, std::function<bool()> task) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Chain behind the owner's previous task, which the pool started first
+    std::shared_future<bool> previous;
+    auto it = m_pending.find(owner);
+    if (it != m_pending.end()) {
+        previous = it->second.result;
+    }
+
+    std::shared_future<bool> result = m_pool.submit([previous, task = std::move(task)]() {
+        const bool isPreviousSuccessful = !previous.valid() || previous.get();
+
+        bool isSuccessful = false;
+        try {
+            isSuccessful = task();
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Failed to load plugin settings: " << e.what() << std::endl;
+        }
+        return isPreviousSuccessful && isSuccessful;
+    }).share();
+
+    m_pending[owner] = PendingTask{result, m_nextTaskId++};
+}
+
+bool ProjectStateLoader::wait(const void* owner) {
+    PendingTask pending;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        auto it = m_pending.find(owner);
+        if (it == m_pending.end()) {
+            return true;
+        }
+        pending = it->second;
+    }
+
+    if (m_pool.isWorkerThread() && pending.result.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        std::cerr << "Cannot wait for plugin settings from a loader thread" << std::endl;
+        return false;
+    }
+
+    const bool isSuccessful = pending.result.get();
+    release(owner, pending.id);
+    return isSuccessful;
+}
+
+size_t ProjectStateLoader::waitForAll() {
+    size_t numFailed = 0;
+
+    while (true) {
+        std::vector<std::pair<const void*, PendingTask>> pending;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            pending.assign(m_pending.begin(), m_pending.end());
+        }
+        if (pending.empty()) {
+            break;
+        }
+
+        for (const auto& entry : pending) {
+            if (!entry.second.result.get()) {
+                ++numFailed;
+            }
+            release(entry.first, entry.second.id);
+        }
+    }
+
+    return numFailed;
+}
+
+bool ProjectStateLoader::isPending(const void* owner) const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.count(owner) > 0;
+}
+
+size_t ProjectStateLoader::getPendingCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size();
+}
+
+void ProjectStateLoader::release(const void* owner, uint64_t id) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_pending.find(owner);
+    if (it != m_pending.end() && it->second.id == id) {
+        m_pending.erase(it);
+    }
+}
+
+} // namespace lmms_magenta
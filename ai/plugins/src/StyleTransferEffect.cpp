@@ -0,0 +1,324 @@
+#include "StyleTransferEffect.h"
+#include "../../model_serving/include/QuotaManager.h"
+#include "../../utils/include/RealtimeChecker.h"
+#include "../../utils/include/Trace.h"
+#include "AudioEngine.h"
+#include "AutomatableModel.h"
+#include "Engine.h"
+#include "SampleFrame.h"
+#include "Song.h"
+#include <algorithm>
+#include <iostream>
+
+namespace lmms_magenta {
+
+StyleTransferEffect::StyleTransferEffect(lmms::Model* parent, const lmms::Plugin::Descriptor* descriptor)
+    : AIEffect(parent, descriptor)
+    , m_strength(1.0f)
+    , m_mix(1.0f)
+    , m_strengthModel(1.0f, 0.0f, 1.0f, 0.01f, this, "Strength")
+    , m_mixModel(1.0f, 0.0f, 1.0f, 0.01f, this, "Mix")
+    , m_midiWindowBars(4)
+    , m_midiHopBars(2)
+    , m_spectralProcessor(kFftSize, kHopSize, kBatchFrames, 2)
+    , m_dryDelayPosition(0)
+    , m_styleRequests(kNumSlots)
+    , m_delayedSlot(-1)
+    , m_isRendering(false)
+    , m_isStopping(false) {
+    bindParameter(&m_strengthModel);
+    bindParameter(&m_mixModel);
+}
+
+StyleTransferEffect::~StyleTransferEffect() {
+    stopStyleWorker();
+}
+
+bool StyleTransferEffect::initialize() {
+    if (!AIEffect::initialize()) {
+        return false;
+    }
+
+    // The worker uses the model and the slots being replaced
+    stopStyleWorker();
+
+    // Load the CycleGAN model
+    if (!loadModel()) {
+        std::cerr << "Failed to load CycleGAN model" << std::endl;
+        return false;
+    }
+
+    m_styleModel = std::dynamic_pointer_cast<CycleGANModel>(getModel());
+    if (!m_styleModel) {
+        std::cerr << "Failed to get CycleGAN model" << std::endl;
+        return false;
+    }
+
+    // Reserve everything the audio thread will touch
+    m_styleModel->reserveFrames(m_spectralProcessor.getNumChannels() * kBatchFrames,
+                                m_spectralProcessor.getNumBins());
+    allocateBuffers(lmms::Engine::audioEngine()->framesPerPeriod());
+    startStyleWorker();
+
+    emit latencyChanged(getLatencyFrames());
+    return true;
+}
+
+ModelType StyleTransferEffect::getModelType() const {
+    return ModelType::CycleGAN;
+}
+
+std::string StyleTransferEffect::getModelName() const {
+    return "";
+}
+
+void StyleTransferEffect::processAudio(lmms::SampleFrame* buf) {
+    // Exports are not real-time and style every batch before emitting it
+    m_isRendering = lmms::Engine::getSong()->isExporting();
+    if (m_isRendering) {
+        LMMS_MAGENTA_TRACE_SCOPE("plugin", "StyleTransferEffect::renderAudio");
+        processFrames(buf);
+        return;
+    }
+
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "StyleTransferEffect::processAudio");
+    LMMS_MAGENTA_REALTIME_SCOPE("StyleTransferEffect::processAudio");
+    processFrames(buf);
+}
+
+void StyleTransferEffect::processFrames(lmms::SampleFrame* buf) {
+    const int frames = static_cast<int>(lmms::Engine::audioEngine()->framesPerPeriod());
+
+    // Buffers are sized in initialize(); never allocate on the audio thread
+    if (!m_styleModel || frames > static_cast<int>(m_channelBuffers[0].size())) {
+        return;
+    }
+
+    // Deinterleave
+    for (int i = 0; i < frames; ++i) {
+        m_channelBuffers[0][i] = buf[i].left();
+        m_channelBuffers[1][i] = buf[i].right();
+    }
+
+    // Run the STFT; each batch covers both channels in one inference call
+    const float* inputs[] = {m_channelBuffers[0].data(), m_channelBuffers[1].data()};
+    float* outputs[] = {m_channelBuffers[0].data(), m_channelBuffers[1].data()};
+
+    m_spectralProcessor.process(inputs, outputs, frames,
+        [this](std::complex<float>* spectra, int numFrames, int numBins) {
+            processBatch(spectra, numFrames, numBins);
+        });
+
+    // Mix with the dry signal delayed by the same latency
+    const int latency = getLatencyFrames();
+    const float mix = m_mix.load(std::memory_order_relaxed);
+    for (int i = 0; i < frames; ++i) {
+        const float dryLeft = m_dryDelay[0][m_dryDelayPosition];
+        const float dryRight = m_dryDelay[1][m_dryDelayPosition];
+        m_dryDelay[0][m_dryDelayPosition] = buf[i].left();
+        m_dryDelay[1][m_dryDelayPosition] = buf[i].right();
+        m_dryDelayPosition = (m_dryDelayPosition + 1) % latency;
+
+        buf[i].setLeft((1.0f - mix) * dryLeft + mix * m_channelBuffers[0][i]);
+        buf[i].setRight((1.0f - mix) * dryRight + mix * m_channelBuffers[1][i]);
+    }
+}
+
+int StyleTransferEffect::getLatencyFrames() const {
+    // Each batch is resynthesized when the next one is complete
+    return m_spectralProcessor.getLatency() + kBatchFrames * kHopSize;
+}
+
+MidiSequence StyleTransferEffect::processSequence(const MidiSequence& sequence) {
+    LMMS_MAGENTA_TRACE_SCOPE("plugin", "StyleTransferEffect::processSequence");
+    auto model = getCycleGANModel();
+    if (!model) {
+        std::cerr << "Failed to get CycleGAN model" << std::endl;
+        return sequence;
+    }
+
+    // Hold a job slot while transforming
+    ModelJob job = ModelServer::getInstance().beginJob(getClientId());
+    if (!job.isAdmitted()) {
+        std::cerr << "Style transfer rejected by quota (retry in "
+                  << job.getRetryAfter().count() << " ms)" << std::endl;
+        return sequence;
+    }
+
+    // Convert window sizes from bars to ticks
+    const int ticksPerBar = sequence.ticksPerQuarter * 4 *
+        sequence.timeSignatureNumerator / sequence.timeSignatureDenominator;
+
+    return model->transformSequence(sequence,
+                                    m_midiWindowBars * ticksPerBar,
+                                    m_midiHopBars * ticksPerBar);
+}
+
+std::shared_ptr<CycleGANModel> StyleTransferEffect::getCycleGANModel() {
+    if (m_styleModel) {
+        return m_styleModel;
+    }
+
+    return std::dynamic_pointer_cast<CycleGANModel>(getModel());
+}
+
+void StyleTransferEffect::handleParameterChange(const lmms::AutomatableModel* param, float value) {
+    const QString name = param->displayName();
+
+    if (name == "Strength") {
+        m_strength.store(std::max(0.0f, std::min(1.0f, value)), std::memory_order_relaxed);
+    } else if (name == "Mix") {
+        m_mix.store(std::max(0.0f, std::min(1.0f, value)), std::memory_order_relaxed);
+    } else {
+        AIEffect::handleParameterChange(param, value);
+    }
+}
+
+void StyleTransferEffect::saveEffectSpecificSettings(QDomDocument& doc, QDomElement& element) {
+    m_strengthModel.saveSettings(doc, element, "strength");
+    m_mixModel.saveSettings(doc, element, "mix");
+}
+
+void StyleTransferEffect::loadEffectSpecificSettings(const QDomElement& element) {
+    // Loading a knob reports its value through handleParameterChange()
+    m_strengthModel.loadSettings(element, "strength");
+    m_mixModel.loadSettings(element, "mix");
+}
+
+void StyleTransferEffect::allocateBuffers(int framesPerPeriod) {
+    for (int ch = 0; ch < 2; ++ch) {
+        m_channelBuffers[ch].assign(framesPerPeriod, 0.0f);
+        m_dryDelay[ch].assign(getLatencyFrames(), 0.0f);
+    }
+
+    // Called with the worker stopped, so every slot belongs to this thread
+    const size_t batchSize = static_cast<size_t>(m_spectralProcessor.getNumChannels()) *
+                             kBatchFrames * m_spectralProcessor.getNumBins();
+    for (auto& slot : m_slots) {
+        slot.logMagnitudes.assign(batchSize, 0.0f);
+        slot.styled.assign(batchSize, 0.0f);
+        slot.state.store(SlotState::Free, std::memory_order_relaxed);
+    }
+
+    int index;
+    while (m_styleRequests.pop(index)) {
+    }
+
+    m_delayedSpectra.assign(batchSize, std::complex<float>());
+    m_delayedSlot = -1;
+    m_dryDelayPosition = 0;
+    m_spectralProcessor.reset();
+}
+
+void StyleTransferEffect::processBatch(std::complex<float>* spectra, int numFrames, int numBins) {
+    const size_t count = static_cast<size_t>(numFrames) * numBins;
+    if (count != m_delayedSpectra.size()) {
+        return;
+    }
+
+    // Emit the previous batch and keep the current one for the next call
+    std::swap_ranges(spectra, spectra + count, m_delayedSpectra.begin());
+
+    // Style the previous batch if the worker finished it in time, otherwise
+    // it passes through unstyled and its slot is reclaimed once finished
+    if (m_delayedSlot >= 0) {
+        StyleSlot& slot = m_slots[m_delayedSlot];
+        if (m_isRendering) {
+            waitForSlot(slot);
+        }
+        if (slot.state.load(std::memory_order_acquire) == SlotState::Styled) {
+            CycleGANModel::applyMagnitudes(spectra, slot.logMagnitudes.data(), slot.styled.data(),
+                                           count, m_strength.load(std::memory_order_relaxed));
+            slot.state.store(SlotState::Free, std::memory_order_relaxed);
+        }
+        m_delayedSlot = -1;
+    }
+
+    // Queue the current batch for the worker
+    int index = acquireSlot();
+    if (index < 0 && m_isRendering) {
+        waitForSlot(m_slots[0]);
+        index = 0;
+    }
+    if (index < 0) {
+        return;
+    }
+
+    StyleSlot& slot = m_slots[index];
+    CycleGANModel::computeLogMagnitudes(m_delayedSpectra.data(), count, slot.logMagnitudes.data());
+
+    // Exports style the batch right away; it is emitted with the next one
+    if (m_isRendering) {
+        slot.state.store(styleSlot(slot) ? SlotState::Styled : SlotState::Failed, std::memory_order_relaxed);
+        m_delayedSlot = index;
+        return;
+    }
+
+    slot.state.store(SlotState::Queued, std::memory_order_relaxed);
+    if (!m_styleRequests.push(index)) {
+        slot.state.store(SlotState::Free, std::memory_order_relaxed);
+        return;
+    }
+
+    m_delayedSlot = index;
+    m_workerWakeup.signal();
+}
+
+int StyleTransferEffect::acquireSlot() {
+    for (int i = 0; i < kNumSlots; ++i) {
+        if (m_slots[i].state.load(std::memory_order_acquire) != SlotState::Queued) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void StyleTransferEffect::waitForSlot(const StyleSlot& slot) {
+    while (slot.state.load(std::memory_order_acquire) == SlotState::Queued) {
+        std::this_thread::yield();
+    }
+}
+
+bool StyleTransferEffect::styleSlot(StyleSlot& slot) {
+    // Charge the inference to this plugin
+    ModelJob job = ModelServer::getInstance().beginJob(getClientId());
+    return job.isAdmitted() && m_styleModel->styleMagnitudes(slot.logMagnitudes, slot.styled);
+}
+
+void StyleTransferEffect::runStyleWorker() {
+    for (;;) {
+        // Every queued batch is signalled, so none is missed between the check and the wait
+        m_workerWakeup.wait();
+        if (m_isStopping.load(std::memory_order_acquire)) {
+            break;
+        }
+
+        int index;
+        if (!m_styleRequests.pop(index)) {
+            continue;
+        }
+
+        // A batch rejected by the quota passes through unstyled
+        StyleSlot& slot = m_slots[index];
+        const bool isStyled = styleSlot(slot);
+        slot.state.store(isStyled ? SlotState::Styled : SlotState::Failed, std::memory_order_release);
+    }
+}
+
+void StyleTransferEffect::startStyleWorker() {
+    m_isStopping.store(false, std::memory_order_release);
+    m_styleWorker = std::thread(&StyleTransferEffect::runStyleWorker, this);
+}
+
+void StyleTransferEffect::stopStyleWorker() {
+    if (!m_styleWorker.joinable()) {
+        return;
+    }
+
+    m_isStopping.store(true, std::memory_order_release);
+    m_workerWakeup.signal();
+    m_styleWorker.join();
+}
+
+} // namespace lmms_magenta
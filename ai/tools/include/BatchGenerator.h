@@ -0,0 +1,132 @@
+#pragma once
+
+#include "BatchJobFile.h"
+#include "../../utils/include/MidiUtils.h"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Settings of a batch run
+ */
+struct BatchOptions {
+    std::string outputDirectory;
+    size_t numWorkers = 0;      // Worker threads (0 for hardware concurrency)
+    size_t batchSize = 16;      // Variations a worker claims at a time
+};
+
+/**
+ * @brief Progress of a batch run
+ */
+struct BatchProgress {
+    size_t completed = 0;   // Variations written
+    size_t failed = 0;      // Variations whose generation or writing failed
+    size_t total = 0;       // Variations in the run
+};
+
+/**
+ * @brief Generates the variations of a job file on a pool of workers
+ *
+ * Every variation has a global index across all jobs. Workers claim
+ * batches of consecutive indices from a shared counter, generate them with
+ * the models from the ModelServer and stream each result straight to a MIDI
+ * file in the worker's own shard directory:
+ *
+ *     <output>/shard-03/bass_000042.mid
+ *     <output>/shard-03/index.csv
+ *
+ * Each shard's index.csv lists the variations the worker wrote, as
+ * global index, job name, variation and first file name. Only the
+ * batch in progress is held in memory, so runs of any size stream to disk.
+ * The samples a worker claims from one job are decoded in a single batched
+ * inference. Model calls from all workers run on the shared inference
+ * threads, whose kernels use every core given to them by the CoreConfig.
+ */
+class BatchGenerator {
+public:
+    using ProgressCallback = std::function<void(const BatchProgress&)>;
+
+    /**
+     * @brief Constructor
+     * @param jobs Jobs to run
+     * @param options Output and worker settings
+     */
+    BatchGenerator(std::vector<BatchJob> jobs, const BatchOptions& options);
+
+    BatchGenerator(const BatchGenerator&) = delete;
+    BatchGenerator& operator=(const BatchGenerator&) = delete;
+
+    /**
+     * @brief Run all jobs and wait for them
+     *
+     * The ModelServer must be initialized. Input files and models are
+     * checked before any worker starts.
+     *
+     * @param progressCallback Called periodically while the run is in progress
+     * @param progressInterval Time between progress callbacks
+     * @return True if every variation was written
+     */
+    bool run(const ProgressCallback& progressCallback = nullptr,
+             std::chrono::milliseconds progressInterval = std::chrono::seconds(1));
+
+    /**
+     * @brief Get the progress of the run
+     * @return Completed, failed and total variations
+     */
+    BatchProgress getProgress() const;
+
+    /**
+     * @brief Get the directory a worker writes to
+     * @param outputDirectory Output directory of the run
+     * @param worker Worker index
+     * @return Shard directory
+     */
+    static std::string getShardDirectory(const std::string& outputDirectory, size_t worker);
+
+    /**
+     * @brief Get the file name of a generated pattern
+     * @param job Job of the variation
+     * @param variation Index of the variation within the job
+     * @param step Interpolation step (-1 for other job types)
+     * @return File name without directory
+     */
+    static std::string getOutputFileName(const BatchJob& job, size_t variation, int step = -1);
+
+private:
+    // Patterns read from the input files of a job
+    struct JobInputs {
+        MidiSequence input;
+        MidiSequence target;
+    };
+
+    std::vector<BatchJob> m_jobs;
+    std::vector<JobInputs> m_inputs;
+    std::vector<size_t> m_jobEnds;  // Global index after the last variation of each job
+    BatchOptions m_options;
+    size_t m_total;
+
+    std::atomic<size_t> m_nextIndex;
+    std::atomic<size_t> m_completed;
+    std::atomic<size_t> m_failed;
+
+    // Read input files and resolve models before starting
+    bool prepare();
+
+    // Generate the variations claimed by one worker
+    void runWorker(size_t worker);
+
+    // Generate one variation into a shard directory
+    bool generate(const BatchJob& job, const JobInputs& inputs, size_t variation,
+                  const std::string& directory, std::string& fileName);
+
+    // Sample consecutive variations of a job with one batched inference,
+    // returning how many were written
+    size_t generateSamples(const BatchJob& job, size_t firstVariation, size_t count,
+                           const std::string& directory, std::vector<std::string>& fileNames);
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Kind of generation a batch job runs
+ */
+enum class BatchJobType {
+    Sample,       // Decode patterns sampled from the MusicVAE prior
+    Interpolate,  // Interpolate between two MIDI files with MusicVAE
+    Groove        // Apply GrooVAE grooves to a MIDI file
+};
+
+/**
+ * @brief One line of a batch job file
+ */
+struct BatchJob {
+    BatchJobType type = BatchJobType::Sample;
+    std::string name;            // Prefix of the output files
+    size_t count = 1;            // Number of variations to generate
+    std::string modelName;       // Model to use (empty for the default)
+    float temperature = 1.0f;    // Sampling temperature
+    std::string inputFile;       // Interpolate: start pattern; groove: pattern to groove
+    std::string targetFile;      // Interpolate: end pattern
+    int steps = 8;               // Interpolate: patterns per variation
+    float grooveAmount = 1.0f;   // Groove: amount of groove (0-1)
+    float swingAmount = 0.0f;    // Groove: amount of swing (0-1)
+    int lineNumber = 0;          // Line in the job file, for messages
+};
+
+/**
+ * @brief Reads batch job files
+ *
+ * A job file has one job per line: the job type followed by key=value
+ * options. Blank lines and lines starting with '#' are ignored.
+ *
+ *     sample      name=bass count=10000 temperature=0.8
+ *     interpolate name=morph count=500 input=a.mid target=b.mid steps=8
+ *     groove      name=drums count=2000 input=beat.mid groove=0.7 swing=0.3
+ *
+ * Relative input paths are resolved against the job file's directory.
+ * Job names prefix the output files, so they must be unique and may not
+ * contain path separators or "..". The variations of a groove job spread
+ * the groove and swing around the given amounts.
+ */
+class BatchJobFile {
+public:
+    /**
+     * @brief Load a job file
+     * @param filePath Job file
+     * @param jobs Receives the jobs
+     * @return True if every line was valid
+     */
+    static bool load(const std::string& filePath, std::vector<BatchJob>& jobs);
+
+    /**
+     * @brief Parse jobs from a stream
+     * @param input Job file contents
+     * @param baseDirectory Directory relative input paths are resolved against
+     * @param jobs Receives the jobs
+     * @return True if every line was valid
+     */
+    static bool parse(std::istream& input, const std::string& baseDirectory, std::vector<BatchJob>& jobs);
+
+    /**
+     * @brief Get the total number of variations of a set of jobs
+     * @param jobs Jobs
+     * @return Sum of the job counts
+     */
+    static size_t getTotalCount(const std::vector<BatchJob>& jobs);
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,318 @@
+#include "BatchGenerator.h"
+#include "../../model_serving/include/GrooVAEModel.h"
+#include "../../model_serving/include/ModelServer.h"
+#include "../../model_serving/include/MusicVAEModel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+namespace lmms_magenta {
+
+namespace {
+
+std::shared_ptr<MusicVAEModel> getMusicVAE(const std::string& modelName) {
+    return std::dynamic_pointer_cast<MusicVAEModel>(
+        ModelServer::getInstance().getModel(ModelType::MusicVAE, modelName));
+}
+
+std::shared_ptr<GrooVAEModel> getGrooVAE(const std::string& modelName) {
+    return std::dynamic_pointer_cast<GrooVAEModel>(
+        ModelServer::getInstance().getModel(ModelType::GrooVAE, modelName));
+}
+
+bool isFileMissing(const std::string& filePath) {
+    std::error_code error;
+    return !std::filesystem::exists(filePath, error);
+}
+
+// Largest distance of a variation's groove and swing from the job's amounts
+constexpr float kGrooveSpread = 0.2f;
+
+// Offset of a variation in [-1, 1), spread evenly over the variations
+// (additive recurrence; variation 0 has no offset)
+float variationOffset(size_t variation, double step) {
+    const double position = 0.5 + static_cast<double>(variation) * step;
+    return static_cast<float>(2.0 * (position - std::floor(position)) - 1.0);
+}
+
+// Keep an amount in [0, 1] by mirroring it at the bounds, so variations
+// near a bound stay distinct instead of collapsing onto it
+float mirrorIntoRange(float amount) {
+    if (amount < 0.0f) {
+        amount = -amount;
+    }
+    if (amount > 1.0f) {
+        amount = 2.0f - amount;
+    }
+    return std::clamp(amount, 0.0f, 1.0f);
+}
+
+// Groove and swing of one variation of a groove job; the variations fill
+// the square around the job's amounts evenly (R2 sequence), so each one
+// writes a different pattern
+void getGrooveVariation(const BatchJob& job, size_t variation, float& grooveAmount, float& swingAmount) {
+    grooveAmount = mirrorIntoRange(job.grooveAmount + kGrooveSpread * variationOffset(variation, 0.7548776662));
+    swingAmount = mirrorIntoRange(job.swingAmount + kGrooveSpread * variationOffset(variation, 0.5698402910));
+}
+
+} // namespace
+
+BatchGenerator::BatchGenerator(std::vector<BatchJob> jobs, const BatchOptions& options)
+    : m_jobs(std::move(jobs)),
+      m_options(options),
+      m_total(0),
+      m_nextIndex(0),
+      m_completed(0),
+      m_failed(0) {
+    if (m_options.numWorkers == 0) {
+        m_options.numWorkers = std::max(1u, std::thread::hardware_concurrency());
+    }
+    m_options.batchSize = std::max<size_t>(1, m_options.batchSize);
+
+    for (const auto& job : m_jobs) {
+        m_total += job.count;
+        m_jobEnds.push_back(m_total);
+    }
+}
+
+bool BatchGenerator::run(const ProgressCallback& progressCallback,
+                         std::chrono::milliseconds progressInterval) {
+    if (!prepare()) {
+        return false;
+    }
+
+    m_nextIndex = 0;
+    m_completed = 0;
+    m_failed = 0;
+
+    // More workers than batches would only sit idle
+    const size_t numBatches = (m_total + m_options.batchSize - 1) / m_options.batchSize;
+    const size_t numWorkers = std::max<size_t>(1, std::min(m_options.numWorkers, numBatches));
+
+    std::atomic<size_t> runningWorkers(numWorkers);
+    std::vector<std::thread> workers;
+    workers.reserve(numWorkers);
+    for (size_t worker = 0; worker < numWorkers; ++worker) {
+        workers.emplace_back([this, worker, &runningWorkers]() {
+            runWorker(worker);
+            --runningWorkers;
+        });
+    }
+
+    auto lastReport = std::chrono::steady_clock::now();
+    while (runningWorkers > 0) {
+        std::this_thread::sleep_for(std::min(progressInterval, std::chrono::milliseconds(100)));
+        if (progressCallback && std::chrono::steady_clock::now() - lastReport >= progressInterval) {
+            lastReport = std::chrono::steady_clock::now();
+            progressCallback(getProgress());
+        }
+    }
+
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    if (progressCallback) {
+        progressCallback(getProgress());
+    }
+    return m_failed == 0;
+}
+
+BatchProgress BatchGenerator::getProgress() const {
+    BatchProgress progress;
+    progress.completed = m_completed;
+    progress.failed = m_failed;
+    progress.total = m_total;
+    return progress;
+}
+
+std::string BatchGenerator::getShardDirectory(const std::string& outputDirectory, size_t worker) {
+    char shard[32];
+    std::snprintf(shard, sizeof(shard), "shard-%02zu", worker);
+    return (std::filesystem::path(outputDirectory) / shard).string();
+}
+
+std::string BatchGenerator::getOutputFileName(const BatchJob& job, size_t variation, int step) {
+    char suffix[48];
+    if (step < 0) {
+        std::snprintf(suffix, sizeof(suffix), "_%06zu.mid", variation);
+    } else {
+        std::snprintf(suffix, sizeof(suffix), "_%06zu_%02d.mid", variation, step);
+    }
+    return job.name + suffix;
+}
+
+bool BatchGenerator::prepare() {
+    bool isReady = true;
+    m_inputs.assign(m_jobs.size(), JobInputs());
+
+    for (size_t i = 0; i < m_jobs.size(); ++i) {
+        const BatchJob& job = m_jobs[i];
+
+        // Load the models now so the workers never wait on a load
+        const bool hasModel = job.type == BatchJobType::Groove
+            ? getGrooVAE(job.modelName) != nullptr
+            : getMusicVAE(job.modelName) != nullptr;
+        if (!hasModel) {
+            std::cerr << "Line " << job.lineNumber << ": failed to load model for job " << job.name << std::endl;
+            isReady = false;
+        }
+
+        if (!job.inputFile.empty()) {
+            if (isFileMissing(job.inputFile)) {
+                std::cerr << "Line " << job.lineNumber << ": input file not found: " << job.inputFile << std::endl;
+                isReady = false;
+            } else {
+                m_inputs[i].input = MidiUtils::loadMidiFile(job.inputFile);
+            }
+        }
+        if (!job.targetFile.empty()) {
+            if (isFileMissing(job.targetFile)) {
+                std::cerr << "Line " << job.lineNumber << ": target file not found: " << job.targetFile << std::endl;
+                isReady = false;
+            } else {
+                m_inputs[i].target = MidiUtils::loadMidiFile(job.targetFile);
+            }
+        }
+    }
+
+    return isReady;
+}
+
+void BatchGenerator::runWorker(size_t worker) {
+    const std::string directory = getShardDirectory(m_options.outputDirectory, worker);
+    std::error_code error;
+    std::filesystem::create_directories(directory, error);
+    if (error) {
+        std::cerr << "Failed to create output directory: " << directory << std::endl;
+    }
+
+    std::ofstream index((std::filesystem::path(directory) / "index.csv").string());
+    if (!index) {
+        std::cerr << "Failed to create index: " << directory << std::endl;
+        error = std::make_error_code(std::errc::io_error);
+    }
+
+    while (true) {
+        const size_t begin = m_nextIndex.fetch_add(m_options.batchSize);
+        if (begin >= m_total) {
+            break;
+        }
+        const size_t end = std::min(begin + m_options.batchSize, m_total);
+
+        for (size_t globalIndex = begin; globalIndex < end;) {
+            // Find the job the index falls into
+            const size_t jobIndex = std::upper_bound(m_jobEnds.begin(), m_jobEnds.end(), globalIndex) - m_jobEnds.begin();
+            const BatchJob& job = m_jobs[jobIndex];
+            const size_t variation = globalIndex - (m_jobEnds[jobIndex] - job.count);
+
+            // Samples of one job in the batch are decoded in a single inference
+            const size_t count = job.type == BatchJobType::Sample
+                ? std::min(end, m_jobEnds[jobIndex]) - globalIndex
+                : 1;
+
+            std::vector<std::string> fileNames(count);
+            size_t written = 0;
+            if (error) {
+                // Nothing can be written to this shard
+            } else if (job.type == BatchJobType::Sample) {
+                written = generateSamples(job, variation, count, directory, fileNames);
+            } else if (generate(job, m_inputs[jobIndex], variation, directory, fileNames[0])) {
+                written = 1;
+            }
+
+            for (size_t i = 0; i < count; ++i) {
+                if (i < written) {
+                    index << globalIndex + i << ',' << job.name << ',' << variation + i << ',' << fileNames[i] << '\n';
+                    ++m_completed;
+                } else {
+                    std::cerr << "Failed to generate " << job.name << " variation " << variation + i << std::endl;
+                    ++m_failed;
+                }
+            }
+            globalIndex += count;
+        }
+
+        // Flush once per batch so an interrupted run leaves a usable index
+        index.flush();
+    }
+}
+
+bool BatchGenerator::generate(const BatchJob& job, const JobInputs& inputs, size_t variation,
+                              const std::string& directory, std::string& fileName) {
+    const std::filesystem::path shard(directory);
+
+    switch (job.type) {
+        case BatchJobType::Sample: {
+            std::vector<std::string> fileNames(1);
+            const bool isWritten = generateSamples(job, variation, 1, directory, fileNames) == 1;
+            fileName = fileNames[0];
+            return isWritten;
+        }
+
+        case BatchJobType::Interpolate: {
+            fileName = getOutputFileName(job, variation, 0);
+            auto model = getMusicVAE(job.modelName);
+            if (!model) {
+                return false;
+            }
+            const std::vector<MidiSequence> sequences =
+                model->interpolate(inputs.input, inputs.target, job.steps, job.temperature);
+            if (sequences.empty()) {
+                return false;
+            }
+            for (size_t step = 0; step < sequences.size(); ++step) {
+                const std::string filePath = (shard / getOutputFileName(job, variation, static_cast<int>(step))).string();
+                if (!MidiUtils::saveMidiFile(sequences[step], filePath)) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        case BatchJobType::Groove: {
+            fileName = getOutputFileName(job, variation);
+            const std::string filePath = (shard / fileName).string();
+            auto model = getGrooVAE(job.modelName);
+            if (!model) {
+                return false;
+            }
+            float grooveAmount;
+            float swingAmount;
+            getGrooveVariation(job, variation, grooveAmount, swingAmount);
+            const MidiSequence sequence = model->applyGroove(inputs.input, grooveAmount, swingAmount);
+            return MidiUtils::saveMidiFile(sequence, filePath);
+        }
+    }
+
+    return false;
+}
+
+size_t BatchGenerator::generateSamples(const BatchJob& job, size_t firstVariation, size_t count,
+                                       const std::string& directory, std::vector<std::string>& fileNames) {
+    auto model = getMusicVAE(job.modelName);
+    if (!model) {
+        return 0;
+    }
+
+    const std::vector<MidiSequence> sequences = model->sampleBatch(count, job.temperature);
+    if (sequences.size() != count) {
+        return 0;
+    }
+
+    // Stop at the first file that cannot be written
+    const std::filesystem::path shard(directory);
+    for (size_t i = 0; i < count; ++i) {
+        fileNames[i] = getOutputFileName(job, firstVariation + i);
+        if (!MidiUtils::saveMidiFile(sequences[i], (shard / fileNames[i]).string())) {
+            return i;
+        }
+    }
+    return count;
+}
+
+} // namespace lmms_magenta
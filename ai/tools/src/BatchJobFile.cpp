@@ -0,0 +1,160 @@
+#include "BatchJobFile.h"
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace lmms_magenta {
+
+namespace {
+
+std::string resolvePath(const std::string& path, const std::string& baseDirectory) {
+    const std::filesystem::path filePath(path);
+    if (path.empty() || filePath.is_absolute() || baseDirectory.empty()) {
+        return path;
+    }
+    return (std::filesystem::path(baseDirectory) / filePath).string();
+}
+
+// Names become file name prefixes inside the output directory
+bool isValidName(const std::string& name) {
+    return name.find('/') == std::string::npos && name.find('\\') == std::string::npos &&
+           name.find("..") == std::string::npos;
+}
+
+// Apply one key=value option to a job
+bool setOption(BatchJob& job, const std::string& key, const std::string& value) {
+    try {
+        if (key == "name") {
+            job.name = value;
+        } else if (key == "count") {
+            const long long count = std::stoll(value);
+            if (count < 0) {
+                return false;
+            }
+            job.count = static_cast<size_t>(count);
+        } else if (key == "model") {
+            job.modelName = value;
+        } else if (key == "temperature") {
+            job.temperature = std::stof(value);
+        } else if (key == "input") {
+            job.inputFile = value;
+        } else if (key == "target") {
+            job.targetFile = value;
+        } else if (key == "steps") {
+            job.steps = std::stoi(value);
+        } else if (key == "groove") {
+            job.grooveAmount = std::stof(value);
+        } else if (key == "swing") {
+            job.swingAmount = std::stof(value);
+        } else {
+            return false;
+        }
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+bool BatchJobFile::load(const std::string& filePath, std::vector<BatchJob>& jobs) {
+    std::ifstream file(filePath);
+    if (!file) {
+        std::cerr << "Failed to open job file: " << filePath << std::endl;
+        return false;
+    }
+    return parse(file, std::filesystem::path(filePath).parent_path().string(), jobs);
+}
+
+bool BatchJobFile::parse(std::istream& input, const std::string& baseDirectory, std::vector<BatchJob>& jobs) {
+    bool isValid = true;
+    std::string line;
+    int lineNumber = 0;
+    std::set<std::string> names;
+    for (const auto& job : jobs) {
+        names.insert(job.name);
+    }
+
+    while (std::getline(input, line)) {
+        ++lineNumber;
+
+        std::istringstream words(line);
+        std::string type;
+        if (!(words >> type) || type[0] == '#') {
+            continue;
+        }
+
+        BatchJob job;
+        job.lineNumber = lineNumber;
+        if (type == "sample") {
+            job.type = BatchJobType::Sample;
+        } else if (type == "interpolate") {
+            job.type = BatchJobType::Interpolate;
+        } else if (type == "groove") {
+            job.type = BatchJobType::Groove;
+        } else {
+            std::cerr << "Line " << lineNumber << ": unknown job type: " << type << std::endl;
+            isValid = false;
+            continue;
+        }
+
+        bool isLineValid = true;
+        std::string option;
+        while (words >> option) {
+            const size_t separator = option.find('=');
+            if (separator == std::string::npos ||
+                !setOption(job, option.substr(0, separator), option.substr(separator + 1))) {
+                std::cerr << "Line " << lineNumber << ": invalid option: " << option << std::endl;
+                isLineValid = false;
+            }
+        }
+
+        job.inputFile = resolvePath(job.inputFile, baseDirectory);
+        job.targetFile = resolvePath(job.targetFile, baseDirectory);
+        if (job.name.empty()) {
+            job.name = type + std::to_string(jobs.size());
+        }
+
+        // Check what each job type needs
+        if (job.type != BatchJobType::Sample && job.inputFile.empty()) {
+            std::cerr << "Line " << lineNumber << ": " << type << " needs input=" << std::endl;
+            isLineValid = false;
+        }
+        if (job.type == BatchJobType::Interpolate && (job.targetFile.empty() || job.steps < 2)) {
+            std::cerr << "Line " << lineNumber << ": interpolate needs target= and steps >= 2" << std::endl;
+            isLineValid = false;
+        }
+        if (job.temperature <= 0.0f) {
+            std::cerr << "Line " << lineNumber << ": temperature must be positive" << std::endl;
+            isLineValid = false;
+        }
+        if (!isValidName(job.name)) {
+            std::cerr << "Line " << lineNumber << ": name may not contain path separators or '..'" << std::endl;
+            isLineValid = false;
+        } else if (isLineValid && names.count(job.name)) {
+            std::cerr << "Line " << lineNumber << ": duplicate name: " << job.name << std::endl;
+            isLineValid = false;
+        }
+
+        if (isLineValid) {
+            names.insert(job.name);
+            jobs.push_back(job);
+        }
+        isValid = isValid && isLineValid;
+    }
+
+    return isValid;
+}
+
+size_t BatchJobFile::getTotalCount(const std::vector<BatchJob>& jobs) {
+    size_t total = 0;
+    for (const auto& job : jobs) {
+        total += job.count;
+    }
+    return total;
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,123 @@
+/**
+ * @brief Headless batch generation of MIDI variations
+ *
+ * Runs the jobs of a job file (see BatchJobFile.h) without LMMS and writes
+ * every generated pattern as a MIDI file:
+ *
+ *     lmms-magenta-batch --jobs=dataset.jobs --output=out --workers=16
+ */
+
+#include "BatchGenerator.h"
+#include "BatchJobFile.h"
+#include "../../model_serving/include/InferenceThreadPool.h"
+#include "../../model_serving/include/ModelServer.h"
+#include "../../../core/include/CoreConfig.h"
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+using namespace lmms_magenta;
+
+namespace {
+
+struct BatchCommandLine {
+    std::string jobFile;
+    std::string modelsDirectory = "../models";
+    BatchOptions options;
+};
+
+void printUsage() {
+    std::cout <<
+        "Usage: lmms-magenta-batch --jobs=FILE --output=DIR [options]\n"
+        "  --jobs=FILE        Job file, one job per line\n"
+        "  --output=DIR       Directory the shards are written to\n"
+        "  --models-dir=PATH  Models directory, default ../models\n"
+        "  --workers=N        Worker threads, default one per core\n"
+        "  --batch=N          Variations a worker claims at a time, default 16\n";
+}
+
+bool parseOptions(int argc, char** argv, BatchCommandLine& commandLine) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const size_t equals = argument.find('=');
+        const std::string name = argument.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        try {
+            if (name == "--jobs") commandLine.jobFile = value;
+            else if (name == "--output") commandLine.options.outputDirectory = value;
+            else if (name == "--models-dir") commandLine.modelsDirectory = value;
+            else if (name == "--workers") commandLine.options.numWorkers = std::stoul(value);
+            else if (name == "--batch") commandLine.options.batchSize = std::stoul(value);
+            else if (name == "--help" || name == "-h") {
+                printUsage();
+                return false;
+            }
+            else {
+                std::cerr << "Unknown option: " << argument << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+            return false;
+        }
+    }
+
+    if (commandLine.jobFile.empty() || commandLine.options.outputDirectory.empty()) {
+        printUsage();
+        return false;
+    }
+    return true;
+}
+
+void printProgress(const BatchProgress& progress, std::chrono::steady_clock::time_point start) {
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    const size_t done = progress.completed + progress.failed;
+    const double rate = seconds > 0.0 ? done / seconds : 0.0;
+    const double remaining = rate > 0.0 ? (progress.total - done) / rate : 0.0;
+
+    std::fprintf(stderr, "\r%zu/%zu variations (%zu failed), %.1f/s, %.0f s left   ",
+                 done, progress.total, progress.failed, rate, remaining);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    BatchCommandLine commandLine;
+    if (!parseOptions(argc, argv, commandLine)) {
+        return 2;
+    }
+
+    std::vector<BatchJob> jobs;
+    if (!BatchJobFile::load(commandLine.jobFile, jobs)) {
+        return 2;
+    }
+
+    // No audio threads run here, so give inference every core at normal priority
+    InferenceThreadingConfig threading = CoreConfig::getInstance().getInferenceThreading();
+    threading.numThreads = 0;
+    threading.audioCores.clear();
+    threading.priority = ThreadPriority::Normal;
+    CoreConfig::getInstance().setInferenceThreading(threading);
+    InferenceThreadPool::getInstance().configure(threading);
+
+    if (!ModelServer::getInstance().initialize(commandLine.modelsDirectory)) {
+        std::cerr << "Failed to initialize ModelServer on " << commandLine.modelsDirectory << std::endl;
+        return 1;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    BatchGenerator generator(std::move(jobs), commandLine.options);
+    const bool isSuccessful = generator.run([start](const BatchProgress& progress) {
+        printProgress(progress, start);
+    });
+    std::fprintf(stderr, "\n");
+
+    const BatchProgress progress = generator.getProgress();
+    std::cout << progress.completed << " of " << progress.total << " variations written to "
+              << commandLine.options.outputDirectory << std::endl;
+    return isSuccessful ? 0 : 1;
+}
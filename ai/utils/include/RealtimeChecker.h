@@ -0,0 +1,149 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief A blocking call made from a real-time callback
+ */
+struct RealtimeViolation {
+    std::string operation;                 // e.g. "malloc" or "ModelServer::loadModel"
+    std::string callback;                  // Innermost real-time scope
+    std::vector<std::string> stackTrace;   // Symbolized frames, innermost first
+};
+
+/**
+ * @brief Detects blocking calls made from real-time callbacks
+ *
+ * Audio and MIDI callbacks mark themselves with a RealtimeScope, which
+ * only sets a thread-local marker. While checking is enabled, every
+ * blocking operation reported from inside a scope is recorded with a stack
+ * trace and printed to std::cerr.
+ *
+ * Operations are reported in two ways:
+ * - Code that may block calls LMMS_MAGENTA_ASSERT_NOT_REALTIME, e.g. model
+ *   loading or waiting for the inference thread. This works everywhere.
+ * - Test executables on Linux link the lmms-magenta-rtcheck library, which
+ *   interposes malloc/free, pthread mutex locks and blocking syscalls.
+ *
+ * Checking is enabled with setEnabled() or by setting the
+ * LMMS_MAGENTA_RT_CHECKS environment variable. The scope and assertion
+ * macros compile to nothing unless LMMS_MAGENTA_ENABLE_RT_CHECKS is defined
+ * (the ENABLE_RT_CHECKS CMake option).
+ */
+class RealtimeChecker {
+public:
+    /**
+     * @brief Enable or disable checking
+     * @param enabled Whether to record violations
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief Check if violations are being recorded
+     * @return True while checking is enabled
+     */
+    static bool isEnabled() {
+        return s_isEnabled.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Check if the calling thread is inside a real-time scope
+     * @return True inside a real-time callback
+     */
+    static bool isRealtimeThread();
+
+    /**
+     * @brief Report a blocking operation on the calling thread
+     *
+     * Does nothing unless checking is enabled and the thread is inside a
+     * real-time scope. Safe to call from allocator and lock hooks.
+     *
+     * @param operation Name of the operation (must outlive the call)
+     */
+    static void reportViolation(const char* operation);
+
+    /**
+     * @brief Get the recorded violations
+     * @return Violations in the order they occurred
+     */
+    static std::vector<RealtimeViolation> getViolations();
+
+    /**
+     * @brief Get the number of recorded violations
+     * @return Violation count
+     */
+    static size_t getViolationCount();
+
+    /**
+     * @brief Discard the recorded violations
+     */
+    static void clearViolations();
+
+    /**
+     * @brief Format the recorded violations with their stack traces
+     * @return One block per violation
+     */
+    static std::string formatViolations();
+
+private:
+    friend class RealtimeScope;
+
+    static std::atomic<bool> s_isEnabled;
+
+    // Enter a scope, returning the name of the enclosing one
+    static const char* enterScope(const char* name);
+
+    // Leave a scope, restoring the enclosing one
+    static void exitScope(const char* previous);
+};
+
+/**
+ * @brief Marks the calling thread as real-time for its lifetime
+ */
+class RealtimeScope {
+public:
+    explicit RealtimeScope(const char* name)
+        : m_previous(RealtimeChecker::enterScope(name)) {}
+
+    ~RealtimeScope() {
+        RealtimeChecker::exitScope(m_previous);
+    }
+
+    RealtimeScope(const RealtimeScope&) = delete;
+    RealtimeScope& operator=(const RealtimeScope&) = delete;
+
+private:
+    const char* m_previous;
+};
+
+} // namespace lmms_magenta
+
+#define LMMS_MAGENTA_RT_CONCAT_INNER(a, b) a##b
+#define LMMS_MAGENTA_RT_CONCAT(a, b) LMMS_MAGENTA_RT_CONCAT_INNER(a, b)
+
+#ifdef LMMS_MAGENTA_ENABLE_RT_CHECKS
+
+// Mark the rest of the enclosing scope as a real-time callback; open it after
+// the trace scope, so trace bookkeeping is not reported as a violation
+#define LMMS_MAGENTA_REALTIME_SCOPE(name) \
+    ::lmms_magenta::RealtimeScope LMMS_MAGENTA_RT_CONCAT(lmmsMagentaRealtimeScope, __LINE__)(name)
+
+// Report an operation that may block if called from a real-time callback
+#define LMMS_MAGENTA_ASSERT_NOT_REALTIME(operation)                 \
+    do {                                                            \
+        if (::lmms_magenta::RealtimeChecker::isEnabled()) {         \
+            ::lmms_magenta::RealtimeChecker::reportViolation(operation); \
+        }                                                           \
+    } while (false)
+
+#else
+
+#define LMMS_MAGENTA_REALTIME_SCOPE(name) ((void)0)
+#define LMMS_MAGENTA_ASSERT_NOT_REALTIME(operation) ((void)0)
+
+#endif
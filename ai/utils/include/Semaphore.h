@@ -0,0 +1,47 @@
+#pragma once
+
+#include <memory>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Counting semaphore for waking a worker from a real-time thread
+ *
+ * A signal is counted even if nobody is waiting yet, so a worker that
+ * checks for work and then waits cannot miss a wakeup. signal() never
+ * locks or allocates; it only makes a system call to wake a waiting
+ * thread. Uses POSIX semaphores, dispatch semaphores on macOS and kernel
+ * semaphores on Windows.
+ */
+class Semaphore {
+public:
+    /**
+     * @brief Constructor
+     * @param initialCount Signals available before the first wait
+     */
+    explicit Semaphore(unsigned int initialCount = 0);
+
+    /**
+     * @brief Destructor
+     */
+    ~Semaphore();
+
+    Semaphore(const Semaphore&) = delete;
+    Semaphore& operator=(const Semaphore&) = delete;
+
+    /**
+     * @brief Add a signal, waking one waiting thread (safe on real-time threads)
+     */
+    void signal();
+
+    /**
+     * @brief Block until a signal is available and take it
+     */
+    void wait();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lmms_magenta {
+
+namespace detail {
+
+/**
+ * @brief Hazard pointer of one reader thread, shared by every SnapshotCell
+ */
+struct HazardRecord {
+    std::atomic<const void*> pointer{nullptr};
+    std::atomic<bool> isClaimed{false};
+};
+
+/**
+ * @brief Get the calling thread's hazard record
+ *
+ * The record is claimed on the thread's first call and released when the
+ * thread exits.
+ *
+ * @return The thread's record, or nullptr if every record is claimed
+ */
+HazardRecord* localHazardRecord();
+
+/**
+ * @brief Check whether a reader is copying from a pointer
+ * @param pointer Pointer to check
+ * @return True if a hazard record holds the pointer
+ */
+bool isHazard(const void* pointer);
+
+} // namespace detail
+
+/**
+ * @brief Shared pointer to an immutable value, published by writers and
+ *        read lock-free
+ *
+ * std::atomic_load() on a std::shared_ptr takes a lock in libstdc++. Here a
+ * reader announces the node it copies from in a per-thread hazard record,
+ * and writers free a replaced node only once no record holds it. load()
+ * never locks, except on threads beyond the number of hazard records,
+ * which fall back to the writers' mutex. Writers are serialized by that
+ * mutex and may block.
+ */
+template <typename T>
+class SnapshotCell {
+public:
+    /**
+     * @brief Constructor
+     * @param value Initial value
+     */
+    explicit SnapshotCell(std::shared_ptr<const T> value = nullptr)
+        : m_current(new Node{std::move(value)}) {
+    }
+
+    ~SnapshotCell() {
+        delete m_current.load(std::memory_order_relaxed);
+        for (Node* node : m_retired) {
+            delete node;
+        }
+    }
+
+    SnapshotCell(const SnapshotCell&) = delete;
+    SnapshotCell& operator=(const SnapshotCell&) = delete;
+
+    /**
+     * @brief Get the current value
+     * @return Shared pointer to the value published last
+     */
+    std::shared_ptr<const T> load() const {
+        detail::HazardRecord* record = detail::localHazardRecord();
+        if (!record) {
+            std::lock_guard<std::mutex> lock(m_writeMutex);
+            return m_current.load(std::memory_order_relaxed)->value;
+        }
+
+        // Announce the node, then check it was not replaced in the meantime
+        const Node* node = m_current.load(std::memory_order_seq_cst);
+        const Node* announced = nullptr;
+        while (node != announced) {
+            record->pointer.store(node, std::memory_order_seq_cst);
+            announced = node;
+            node = m_current.load(std::memory_order_seq_cst);
+        }
+
+        std::shared_ptr<const T> value = node->value;
+        record->pointer.store(nullptr, std::memory_order_release);
+        return value;
+    }
+
+    /**
+     * @brief Publish a new value
+     * @param value Value returned by later loads
+     */
+    void store(std::shared_ptr<const T> value) {
+        Node* node = new Node{std::move(value)};
+
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        m_retired.push_back(m_current.exchange(node, std::memory_order_seq_cst));
+
+        // Free the replaced nodes no reader is copying from any more
+        m_retired.erase(std::remove_if(m_retired.begin(), m_retired.end(),
+                                       [](Node* retired) {
+                                           if (detail::isHazard(retired)) {
+                                               return false;
+                                           }
+                                           delete retired;
+                                           return true;
+                                       }),
+                        m_retired.end());
+    }
+
+private:
+    struct Node {
+        std::shared_ptr<const T> value;
+    };
+
+    std::atomic<Node*> m_current;
+
+    // Serializes writers; guards the retired nodes
+    mutable std::mutex m_writeMutex;
+    std::vector<Node*> m_retired;
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,173 @@
+#pragma once
+
+#include <complex>
+#include <functional>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Pre-planned radix-2 FFT
+ *
+ * Twiddle factors and the bit-reversal permutation are computed once in the
+ * constructor, so transforms never allocate and can run on the audio thread.
+ */
+class FFTPlan {
+public:
+    /**
+     * @brief Constructor
+     * @param size Transform size (must be a power of two)
+     */
+    explicit FFTPlan(int size);
+
+    /**
+     * @brief Get the transform size
+     * @return Number of points in the transform
+     */
+    int getSize() const;
+
+    /**
+     * @brief Forward transform in place
+     * @param data Buffer of getSize() complex values
+     */
+    void forward(std::complex<float>* data) const;
+
+    /**
+     * @brief Inverse transform in place (scaled by 1/N)
+     * @param data Buffer of getSize() complex values
+     */
+    void inverse(std::complex<float>* data) const;
+
+private:
+    // Transform size
+    int m_size;
+
+    // Bit-reversal permutation
+    std::vector<int> m_bitReverse;
+
+    // Twiddle factors e^(-2*pi*i*k/N) for k < N/2
+    std::vector<std::complex<float>> m_twiddles;
+
+    // Shared butterfly implementation
+    void transform(std::complex<float>* data, bool inverse) const;
+};
+
+/**
+ * @brief Streaming multi-channel STFT with overlap-add resynthesis
+ *
+ * Input samples are collected into a FIFO; every batchFrames * hopSize
+ * samples the processor analyzes batchFrames windowed frames per channel,
+ * hands all of them to the callback in one call (so a model can process them
+ * as a single batched inference), and overlap-adds the modified spectra back
+ * into the output. All buffers are allocated in the constructor.
+ *
+ * The processor has a fixed latency of getLatency() samples, which hosts
+ * should compensate for.
+ */
+class SpectralProcessor {
+public:
+    /**
+     * @brief Callback invoked with a batch of spectra
+     *
+     * Spectra are laid out as [channel][frame][bin] and may be modified in
+     * place. numFrames is numChannels * batchFrames.
+     */
+    using BatchCallback = std::function<void(std::complex<float>* spectra, int numFrames, int numBins)>;
+
+    /**
+     * @brief Constructor
+     * @param fftSize Frame size (power of two)
+     * @param hopSize Hop between frames (at most fftSize / 4 for exact reconstruction)
+     * @param batchFrames Number of frames per channel passed to each callback
+     * @param numChannels Number of audio channels
+     */
+    SpectralProcessor(int fftSize, int hopSize, int batchFrames = 1, int numChannels = 2);
+
+    /**
+     * @brief Get the frame size
+     * @return Frame size in samples
+     */
+    int getFftSize() const;
+
+    /**
+     * @brief Get the hop size
+     * @return Hop size in samples
+     */
+    int getHopSize() const;
+
+    /**
+     * @brief Get the number of frames per channel in each batch
+     * @return Frames per batch
+     */
+    int getBatchFrames() const;
+
+    /**
+     * @brief Get the number of bins per spectrum
+     * @return fftSize / 2 + 1
+     */
+    int getNumBins() const;
+
+    /**
+     * @brief Get the number of channels
+     * @return Number of channels
+     */
+    int getNumChannels() const;
+
+    /**
+     * @brief Get the processing latency
+     * @return Delay between input and output in samples
+     */
+    int getLatency() const;
+
+    /**
+     * @brief Clear all internal state
+     */
+    void reset();
+
+    /**
+     * @brief Process a block of audio
+     * @param inputs Per-channel input buffers
+     * @param outputs Per-channel output buffers (may alias inputs)
+     * @param numSamples Number of samples per channel
+     * @param callback Function applied to each batch of spectra
+     */
+    void process(const float* const* inputs, float* const* outputs, int numSamples,
+                 const BatchCallback& callback);
+
+private:
+    int m_fftSize;
+    int m_hopSize;
+    int m_batchFrames;
+    int m_numChannels;
+    int m_numBins;
+
+    // Samples consumed per batch and span of input covered by one batch
+    int m_stride;
+    int m_span;
+
+    // Write position in the input FIFO
+    int m_rover;
+
+    // Pre-planned transform
+    FFTPlan m_plan;
+
+    // Analysis/synthesis window and overlap-add gain
+    std::vector<float> m_window;
+    float m_olaScale;
+
+    // Per-channel FIFOs and accumulators, stored contiguously
+    std::vector<float> m_inputFifo;
+    std::vector<float> m_outputFifo;
+    std::vector<float> m_accumulator;
+
+    // Spectral workspace passed to the callback
+    std::vector<std::complex<float>> m_spectra;
+
+    // Scratch buffer for a single transform
+    std::vector<std::complex<float>> m_fftBuffer;
+
+    // Analyze, process and resynthesize one batch
+    void processBatch(const BatchCallback& callback);
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Bounded lock-free queue for one producer and one consumer thread
+ *
+ * All storage is allocated in the constructor; push() and pop() never
+ * allocate, lock or make system calls, so either end may be a real-time
+ * thread. Elements are copied in and out.
+ */
+template <typename T>
+class SpscRing {
+public:
+    /**
+     * @brief Constructor
+     * @param capacity Maximum number of queued elements
+     */
+    explicit SpscRing(size_t capacity)
+        : m_slots(capacity + 1)
+        , m_head(0)
+        , m_tail(0) {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * @brief Append an element (producer thread only)
+     * @param value Element to append
+     * @return False if the ring is full
+     */
+    bool push(const T& value) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t next = advance(tail);
+        if (next == m_head.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        m_slots[tail] = value;
+        m_tail.store(next, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Remove the oldest element (consumer thread only)
+     * @param value Receives the element
+     * @return False if the ring is empty
+     */
+    bool pop(T& value) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if (head == m_tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = m_slots[head];
+        m_head.store(advance(head), std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Check if the ring is empty
+     *
+     * Exact on the consumer thread; a snapshot anywhere else.
+     *
+     * @return True if there is nothing to pop
+     */
+    bool isEmpty() const {
+        return m_head.load(std::memory_order_acquire) == m_tail.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief Get the maximum number of queued elements
+     * @return Capacity
+     */
+    size_t getCapacity() const {
+        return m_slots.size() - 1;
+    }
+
+private:
+    // One slot stays empty to tell a full ring from an empty one
+    std::vector<T> m_slots;
+
+    // Next slot to pop (written by the consumer) and to push (by the producer)
+    alignas(64) std::atomic<size_t> m_head;
+    alignas(64) std::atomic<size_t> m_tail;
+
+    size_t advance(size_t index) const {
+        return index + 1 == m_slots.size() ? 0 : index + 1;
+    }
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "MidiUtils.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Kind of payload in an encoded state blob
+ */
+enum class StateBlobType : uint8_t {
+    Floats = 1,  // Latent vectors, groove presets
+    Notes = 2    // Patterns
+};
+
+/**
+ * @brief Compact binary encoding of plugin state for project files
+ *
+ * Latent vectors, groove presets and patterns are stored as base64 blobs
+ * instead of one decimal string per value, so saving and loading a project
+ * does not format or parse numbers and floats round-trip bit-exactly.
+ *
+ * A blob is a 12-byte header followed by the payload, all little-endian:
+ *
+ *     "LMST"  magic
+ *     u8      StateBlobType
+ *     u8      format version
+ *     u16     reserved (0)
+ *     u32     number of values (floats) or notes
+ *
+ * Floats are stored as IEEE 754 binary32. Notes are 12-byte records:
+ * u8 pitch, u8 velocity, u8 flags (bit 0: percussion), u8 reserved,
+ * i32 start time and i32 duration in ticks. The header is a multiple of
+ * three bytes, so the payload starts on a base64 quantum and float blobs
+ * decode straight into the output vector.
+ */
+class StateCodec {
+public:
+    static constexpr uint8_t kVersion = 1;
+    static constexpr size_t kHeaderSize = 12;
+    static constexpr size_t kNoteSize = 12;
+
+    /**
+     * @brief Encode float values
+     * @param values Values to encode
+     * @return Base64 blob
+     */
+    static std::string encodeFloats(const std::vector<float>& values);
+
+    /**
+     * @brief Decode float values
+     * @param text Base64 blob
+     * @param length Length of the blob in characters
+     * @param values Receives the values
+     * @return True if the blob was valid
+     */
+    static bool decodeFloats(const char* text, size_t length, std::vector<float>& values);
+
+    /**
+     * @brief Encode notes
+     * @param notes Notes to encode
+     * @return Base64 blob
+     */
+    static std::string encodeNotes(const std::vector<MidiNote>& notes);
+
+    /**
+     * @brief Decode notes
+     * @param text Base64 blob
+     * @param length Length of the blob in characters
+     * @param notes Receives the notes
+     * @return True if the blob was valid
+     */
+    static bool decodeNotes(const char* text, size_t length, std::vector<MidiNote>& notes);
+
+    /**
+     * @brief Encode bytes as base64 (RFC 4648, with padding)
+     * @param data Bytes to encode
+     * @param size Number of bytes
+     * @return Base64 text
+     */
+    static std::string toBase64(const uint8_t* data, size_t size);
+
+    /**
+     * @brief Decode base64 text
+     * @param text Base64 text
+     * @param length Length of the text in characters
+     * @param bytes Receives the bytes
+     * @return True if the text was valid base64
+     */
+    static bool fromBase64(const char* text, size_t length, std::vector<uint8_t>& bytes);
+
+private:
+    // Check a blob's header and return its type and count
+    static bool decodeHeader(const char* text, size_t length, StateBlobType expectedType,
+                             uint32_t& count, size_t& payloadSize);
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "../../../core/include/CoreConfig.h"
+#include <map>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Applies the inference threading policy to threads
+ *
+ * Affinity and priority are per thread but inherited by threads created
+ * afterwards, so a thread configured here passes its policy on to the worker
+ * threads TensorFlow Lite spawns from it.
+ */
+class ThreadPolicy {
+public:
+    /**
+     * @brief Get the cores the process may run on
+     * @return Online cores in ascending order
+     */
+    static std::vector<int> getOnlineCores();
+
+    /**
+     * @brief Get the cores of each NUMA node
+     * @return Cores by node (empty on systems without NUMA information)
+     */
+    static std::map<int, std::vector<int>> getNumaNodes();
+
+    /**
+     * @brief Choose the inference cores of this machine
+     * @param config Threading policy
+     * @return Selected cores
+     */
+    static std::vector<int> selectCores(const InferenceThreadingConfig& config);
+
+    /**
+     * @brief Apply a policy to the calling thread
+     *
+     * Failures (e.g. a platform without SCHED_IDLE) are reported and
+     * otherwise ignored, leaving the thread with its previous setting.
+     *
+     * @param config Threading policy
+     * @param cores Cores to pin to when config.pinThreads is set
+     * @return True if every setting was applied
+     */
+    static bool applyToCurrentThread(const InferenceThreadingConfig& config, const std::vector<int>& cores);
+
+    /**
+     * @brief Get the CPU time consumed by the calling thread
+     * @return CPU time in seconds, or a negative value where not available
+     */
+    static double getThreadCpuSeconds();
+};
+
+} // namespace lmms_magenta
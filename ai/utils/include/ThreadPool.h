@@ -0,0 +1,92 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Fixed-size pool of worker threads
+ *
+ * Tasks are executed in submission order by the first free worker. The pool
+ * joins all workers on destruction after draining the queue.
+ */
+class ThreadPool {
+public:
+    /**
+     * @brief Constructor
+     * @param numThreads Number of worker threads (0 for hardware concurrency)
+     * @param threadInit Function run on every worker before its first task
+     *                   (e.g. to set affinity or priority)
+     */
+    explicit ThreadPool(size_t numThreads = 0, std::function<void()> threadInit = nullptr);
+
+    /**
+     * @brief Destructor
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Submit a task
+     * @param task Callable to run on a worker thread
+     * @return Future holding the result (or exception) of the task
+     */
+    template <typename Func>
+    auto submit(Func&& task) -> std::future<std::invoke_result_t<std::decay_t<Func>>> {
+        using Result = std::invoke_result_t<std::decay_t<Func>>;
+
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(task));
+        std::future<Result> future = packaged->get_future();
+
+        enqueue([packaged]() { (*packaged)(); });
+        return future;
+    }
+
+    /**
+     * @brief Get the number of worker threads
+     * @return Number of workers
+     */
+    size_t getNumThreads() const;
+
+    /**
+     * @brief Check if the calling thread is one of the workers
+     * @return True when called from a task of this pool
+     */
+    bool isWorkerThread() const;
+
+    /**
+     * @brief Get the number of tasks waiting for a worker
+     * @return Number of queued tasks
+     */
+    size_t getQueuedTaskCount() const;
+
+private:
+    // Worker threads
+    std::vector<std::thread> m_workers;
+
+    // Pending tasks
+    std::deque<std::function<void()>> m_tasks;
+
+    // Queue synchronization
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_stopping;
+
+    // Add a type-erased task to the queue
+    void enqueue(std::function<void()> task);
+
+    // Worker thread main loop
+    void workerLoop(const std::function<void()>& threadInit);
+};
+
+} // namespace lmms_magenta
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief A completed trace span
+ *
+ * Category and name must be string literals (or otherwise outlive the
+ * recorder), since only the pointers are stored.
+ */
+struct TraceEvent {
+    const char* category;
+    const char* name;
+    uint64_t startNs;     // Start on the steady clock, in nanoseconds
+    uint64_t durationNs;  // Duration in nanoseconds
+};
+
+/**
+ * @brief Records trace spans into per-thread buffers
+ *
+ * Every thread appends to its own fixed-size buffer without locks; the
+ * buffer is registered once per thread and recording session. When a
+ * buffer is full, further events of that thread are dropped and counted.
+ * Recording starts with start() or, for a whole run, by setting the
+ * LMMS_MAGENTA_TRACE_FILE environment variable, in which case the trace is
+ * written to that file when the process exits.
+ *
+ * Spans are normally recorded through the LMMS_MAGENTA_TRACE_* macros,
+ * which compile to nothing unless LMMS_MAGENTA_ENABLE_PROFILING is defined
+ * (the ENABLE_PROFILING CMake option).
+ */
+class TraceRecorder {
+public:
+    static constexpr size_t kDefaultEventsPerThread = 1 << 16;
+
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the singleton instance
+     */
+    static TraceRecorder& getInstance();
+
+    /**
+     * @brief Start a new recording session, discarding previous events
+     * @param eventsPerThread Capacity of each thread's buffer
+     */
+    void start(size_t eventsPerThread = kDefaultEventsPerThread);
+
+    /**
+     * @brief Stop recording; recorded events are kept for export
+     */
+    void stop();
+
+    /**
+     * @brief Check if spans are being recorded
+     * @return True while recording
+     */
+    static bool isRecording() {
+        return s_isRecording.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Get the current time on the trace clock
+     * @return Steady clock time in nanoseconds
+     */
+    static uint64_t now();
+
+    /**
+     * @brief Record a span on the calling thread
+     * @param category Span category
+     * @param name Span name
+     * @param startNs Start time from now()
+     * @param endNs End time from now()
+     */
+    void record(const char* category, const char* name, uint64_t startNs, uint64_t endNs);
+
+    /**
+     * @brief Name the calling thread in exported traces
+     * @param name Thread name
+     */
+    void setThreadName(const std::string& name);
+
+    /**
+     * @brief Write the events of the current session as Chrome trace JSON
+     *
+     * The file can be opened in chrome://tracing or ui.perfetto.dev.
+     *
+     * @param filePath Output file
+     * @return True if writing was successful
+     */
+    bool exportChromeTrace(const std::string& filePath) const;
+
+    /**
+     * @brief Get a copy of the events of the current session
+     * @return Events of all threads
+     */
+    std::vector<TraceEvent> getEvents() const;
+
+    /**
+     * @brief Get the number of events dropped because a buffer was full
+     * @return Dropped events in the current session
+     */
+    size_t getDroppedCount() const;
+
+private:
+    TraceRecorder();
+    ~TraceRecorder();
+
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    // Events of one thread in one session, written only by that thread
+    struct ThreadBuffer {
+        uint64_t session;
+        uint32_t threadId;
+        std::string threadName;
+        std::unique_ptr<TraceEvent[]> events;
+        size_t capacity;
+        std::atomic<size_t> count;
+        std::atomic<size_t> dropped;
+    };
+
+    static std::atomic<bool> s_isRecording;
+
+    // Buffers of the current session (registration and export only)
+    mutable std::mutex m_mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    std::atomic<uint64_t> m_session;
+    size_t m_eventsPerThread;
+
+    // File written at exit when recording was started from the environment
+    std::string m_exitTraceFile;
+
+    // Get the calling thread's buffer for the current session
+    ThreadBuffer* getThreadBuffer();
+};
+
+/**
+ * @brief Records a span covering its own lifetime
+ */
+class TraceScope {
+public:
+    TraceScope(const char* category, const char* name)
+        : m_category(category), m_name(name),
+          m_startNs(TraceRecorder::isRecording() ? TraceRecorder::now() : 0) {}
+
+    ~TraceScope() {
+        if (m_startNs != 0) {
+            TraceRecorder::getInstance().record(m_category, m_name, m_startNs, TraceRecorder::now());
+        }
+    }
+
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* m_category;
+    const char* m_name;
+    uint64_t m_startNs;
+};
+
+} // namespace lmms_magenta
+
+#define LMMS_MAGENTA_TRACE_CONCAT_INNER(a, b) a##b
+#define LMMS_MAGENTA_TRACE_CONCAT(a, b) LMMS_MAGENTA_TRACE_CONCAT_INNER(a, b)
+
+#ifdef LMMS_MAGENTA_ENABLE_PROFILING
+
+// Trace the rest of the enclosing scope
+#define LMMS_MAGENTA_TRACE_SCOPE(category, name) \
+    ::lmms_magenta::TraceScope LMMS_MAGENTA_TRACE_CONCAT(lmmsMagentaTraceScope, __LINE__)(category, name)
+
+// Remember the current time in a variable, for spans crossing threads
+#define LMMS_MAGENTA_TRACE_TIMESTAMP(variable) \
+    const uint64_t variable = ::lmms_magenta::TraceRecorder::isRecording() ? ::lmms_magenta::TraceRecorder::now() : 0
+
+// Record a span from a timestamp taken with LMMS_MAGENTA_TRACE_TIMESTAMP until now
+#define LMMS_MAGENTA_TRACE_SINCE(category, name, variable)                                        \
+    do {                                                                                          \
+        if (variable != 0) {                                                                      \
+            ::lmms_magenta::TraceRecorder::getInstance().record(category, name, variable,         \
+                                                                ::lmms_magenta::TraceRecorder::now()); \
+        }                                                                                         \
+    } while (false)
+
+// Name the calling thread in exported traces
+#define LMMS_MAGENTA_TRACE_THREAD_NAME(name) ::lmms_magenta::TraceRecorder::getInstance().setThreadName(name)
+
+#else
+
+#define LMMS_MAGENTA_TRACE_SCOPE(category, name) ((void)0)
+#define LMMS_MAGENTA_TRACE_TIMESTAMP(variable) ((void)0)
+#define LMMS_MAGENTA_TRACE_SINCE(category, name, variable) ((void)0)
+#define LMMS_MAGENTA_TRACE_THREAD_NAME(name) ((void)0)
+
+#endif
@@ -0,0 +1,157 @@
+#include "RealtimeChecker.h"
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+#include <sstream>
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#define LMMS_MAGENTA_HAS_BACKTRACE 1
+#endif
+
+// Allocator hooks read these, so they must not allocate on first access
+#if defined(__GNUC__)
+#define LMMS_MAGENTA_INITIAL_EXEC_TLS __attribute__((tls_model("initial-exec")))
+#else
+#define LMMS_MAGENTA_INITIAL_EXEC_TLS
+#endif
+
+namespace lmms_magenta {
+
+namespace {
+
+constexpr int kMaxStackFrames = 32;
+
+// Innermost real-time scope of the calling thread, null outside callbacks
+thread_local const char* t_scope LMMS_MAGENTA_INITIAL_EXEC_TLS = nullptr;
+
+// Set while the checker itself runs, so its own allocations, locks and
+// writes are not reported
+thread_local bool t_isReporting LMMS_MAGENTA_INITIAL_EXEC_TLS = false;
+
+// Suppresses reports on the calling thread for its lifetime
+class ReportingGuard {
+public:
+    ReportingGuard() : m_wasReporting(t_isReporting) { t_isReporting = true; }
+    ~ReportingGuard() { t_isReporting = m_wasReporting; }
+
+private:
+    bool m_wasReporting;
+};
+
+std::mutex& getViolationsMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<RealtimeViolation>& getViolationList() {
+    static std::vector<RealtimeViolation> violations;
+    return violations;
+}
+
+bool isEnabledFromEnvironment() {
+    const char* value = std::getenv("LMMS_MAGENTA_RT_CHECKS");
+    return value && *value && *value != '0';
+}
+
+std::vector<std::string> captureStackTrace() {
+    std::vector<std::string> frames;
+#ifdef LMMS_MAGENTA_HAS_BACKTRACE
+    void* addresses[kMaxStackFrames];
+    const int count = backtrace(addresses, kMaxStackFrames);
+    if (char** symbols = backtrace_symbols(addresses, count)) {
+        // Skip this function and reportViolation()
+        for (int i = 2; i < count; ++i) {
+            frames.emplace_back(symbols[i]);
+        }
+        std::free(symbols);
+    }
+#endif
+    return frames;
+}
+
+void appendViolation(std::ostream& out, const RealtimeViolation& violation) {
+    out << "Real-time violation: " << violation.operation << " called from " << violation.callback << "\n";
+    for (const auto& frame : violation.stackTrace) {
+        out << "    " << frame << "\n";
+    }
+}
+
+} // namespace
+
+std::atomic<bool> RealtimeChecker::s_isEnabled(isEnabledFromEnvironment());
+
+void RealtimeChecker::setEnabled(bool enabled) {
+#ifdef LMMS_MAGENTA_HAS_BACKTRACE
+    // The first backtrace() loads the unwinder; do it outside any callback
+    if (enabled) {
+        void* address;
+        backtrace(&address, 1);
+    }
+#endif
+    s_isEnabled = enabled;
+}
+
+bool RealtimeChecker::isRealtimeThread() {
+    return t_scope != nullptr;
+}
+
+void RealtimeChecker::reportViolation(const char* operation) {
+    if (!isEnabled() || t_scope == nullptr || t_isReporting) {
+        return;
+    }
+    ReportingGuard guard;
+
+    RealtimeViolation violation;
+    violation.operation = operation;
+    violation.callback = t_scope;
+    violation.stackTrace = captureStackTrace();
+
+    std::ostringstream report;
+    appendViolation(report, violation);
+    std::cerr << report.str() << std::flush;
+
+    {
+        std::lock_guard<std::mutex> lock(getViolationsMutex());
+        getViolationList().push_back(std::move(violation));
+    }
+}
+
+std::vector<RealtimeViolation> RealtimeChecker::getViolations() {
+    ReportingGuard guard;
+    std::lock_guard<std::mutex> lock(getViolationsMutex());
+    return getViolationList();
+}
+
+size_t RealtimeChecker::getViolationCount() {
+    ReportingGuard guard;
+    std::lock_guard<std::mutex> lock(getViolationsMutex());
+    return getViolationList().size();
+}
+
+void RealtimeChecker::clearViolations() {
+    ReportingGuard guard;
+    std::lock_guard<std::mutex> lock(getViolationsMutex());
+    getViolationList().clear();
+}
+
+std::string RealtimeChecker::formatViolations() {
+    ReportingGuard guard;
+    std::ostringstream out;
+    for (const auto& violation : getViolations()) {
+        appendViolation(out, violation);
+    }
+    return out.str();
+}
+
+const char* RealtimeChecker::enterScope(const char* name) {
+    const char* previous = t_scope;
+    t_scope = name;
+    return previous;
+}
+
+void RealtimeChecker::exitScope(const char* previous) {
+    t_scope = previous;
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,169 @@
+#include "RealtimeChecker.h"
+
+// Replaces allocation, locking and blocking syscall entry points so calls
+// from real-time scopes are reported. Only linked into test executables,
+// through the lmms-magenta-rtcheck library; Linux with glibc only.
+#if defined(__linux__) && defined(__GLIBC__)
+
+#include <atomic>
+#include <cerrno>
+#include <cstddef>
+#include <dlfcn.h>
+#include <poll.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+using lmms_magenta::RealtimeChecker;
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+namespace {
+
+inline void check(const char* operation) {
+    if (RealtimeChecker::isEnabled()) {
+        RealtimeChecker::reportViolation(operation);
+    }
+}
+
+// Look up the next definition of a symbol once. The caches are constant
+// initialized atomics, so no initialization guard (which may lock) runs.
+template <typename Function>
+Function* resolveNext(std::atomic<Function*>& cache, const char* name) {
+    Function* function = cache.load(std::memory_order_acquire);
+    if (!function) {
+        function = reinterpret_cast<Function*>(dlsym(RTLD_NEXT, name));
+        cache.store(function, std::memory_order_release);
+    }
+    return function;
+}
+
+} // namespace
+
+extern "C" {
+
+// Memory allocation
+
+void* malloc(size_t size) {
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+    check("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size) {
+    check("realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer) {
+    if (pointer) {
+        check("free");
+    }
+    __libc_free(pointer);
+}
+
+int posix_memalign(void** result, size_t alignment, size_t size) {
+    check("posix_memalign");
+    if (alignment % sizeof(void*) != 0 || (alignment & (alignment - 1)) != 0) {
+        return EINVAL;
+    }
+    void* pointer = __libc_memalign(alignment, size);
+    if (!pointer) {
+        return ENOMEM;
+    }
+    *result = pointer;
+    return 0;
+}
+
+void* aligned_alloc(size_t alignment, size_t size) {
+    check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+// Locks
+
+int pthread_mutex_lock(pthread_mutex_t* mutex) {
+    check("pthread_mutex_lock");
+    using Function = int(pthread_mutex_t*);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock) {
+    check("pthread_rwlock_rdlock");
+    using Function = int(pthread_rwlock_t*);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "pthread_rwlock_rdlock")(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock) {
+    check("pthread_rwlock_wrlock");
+    using Function = int(pthread_rwlock_t*);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "pthread_rwlock_wrlock")(lock);
+}
+
+// Blocking syscalls
+
+ssize_t read(int fd, void* buffer, size_t count) {
+    check("read");
+    using Function = ssize_t(int, void*, size_t);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "read")(fd, buffer, count);
+}
+
+ssize_t write(int fd, const void* buffer, size_t count) {
+    check("write");
+    using Function = ssize_t(int, const void*, size_t);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "write")(fd, buffer, count);
+}
+
+int poll(struct pollfd* fds, nfds_t count, int timeout) {
+    check("poll");
+    using Function = int(struct pollfd*, nfds_t, int);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "poll")(fds, count, timeout);
+}
+
+int fsync(int fd) {
+    check("fsync");
+    using Function = int(int);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "fsync")(fd);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining) {
+    check("nanosleep");
+    using Function = int(const struct timespec*, struct timespec*);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "nanosleep")(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* time, struct timespec* remaining) {
+    check("clock_nanosleep");
+    using Function = int(clockid_t, int, const struct timespec*, struct timespec*);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "clock_nanosleep")(clock, flags, time, remaining);
+}
+
+int usleep(useconds_t microseconds) {
+    check("usleep");
+    using Function = int(useconds_t);
+    static std::atomic<Function*> real(nullptr);
+    return resolveNext(real, "usleep")(microseconds);
+}
+
+} // extern "C"
+
+#endif
@@ -0,0 +1,97 @@
+#include "Semaphore.h"
+#include <iostream>
+
+#if defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#include <climits>
+#else
+#include <cerrno>
+#include <semaphore.h>
+#endif
+
+namespace lmms_magenta {
+
+#if defined(__APPLE__)
+
+// Unnamed POSIX semaphores are not implemented on macOS
+struct Semaphore::Impl {
+    dispatch_semaphore_t semaphore;
+};
+
+Semaphore::Semaphore(unsigned int initialCount)
+    : m_impl(std::make_unique<Impl>()) {
+    m_impl->semaphore = dispatch_semaphore_create(static_cast<long>(initialCount));
+}
+
+Semaphore::~Semaphore() {
+    dispatch_release(m_impl->semaphore);
+}
+
+void Semaphore::signal() {
+    dispatch_semaphore_signal(m_impl->semaphore);
+}
+
+void Semaphore::wait() {
+    dispatch_semaphore_wait(m_impl->semaphore, DISPATCH_TIME_FOREVER);
+}
+
+#elif defined(_WIN32)
+
+struct Semaphore::Impl {
+    HANDLE semaphore;
+};
+
+Semaphore::Semaphore(unsigned int initialCount)
+    : m_impl(std::make_unique<Impl>()) {
+    m_impl->semaphore = CreateSemaphoreW(nullptr, static_cast<LONG>(initialCount), LONG_MAX, nullptr);
+    if (!m_impl->semaphore) {
+        std::cerr << "Failed to create semaphore: " << GetLastError() << std::endl;
+    }
+}
+
+Semaphore::~Semaphore() {
+    if (m_impl->semaphore) {
+        CloseHandle(m_impl->semaphore);
+    }
+}
+
+void Semaphore::signal() {
+    ReleaseSemaphore(m_impl->semaphore, 1, nullptr);
+}
+
+void Semaphore::wait() {
+    WaitForSingleObject(m_impl->semaphore, INFINITE);
+}
+
+#else
+
+struct Semaphore::Impl {
+    sem_t semaphore;
+};
+
+Semaphore::Semaphore(unsigned int initialCount)
+    : m_impl(std::make_unique<Impl>()) {
+    if (sem_init(&m_impl->semaphore, 0, initialCount) != 0) {
+        std::cerr << "Failed to create semaphore: " << errno << std::endl;
+    }
+}
+
+Semaphore::~Semaphore() {
+    sem_destroy(&m_impl->semaphore);
+}
+
+void Semaphore::signal() {
+    sem_post(&m_impl->semaphore);
+}
+
+void Semaphore::wait() {
+    // Retry when a signal handler interrupts the wait
+    while (sem_wait(&m_impl->semaphore) != 0 && errno == EINTR) {
+    }
+}
+
+#endif
+
+} // namespace lmms_magenta
@@ -0,0 +1,55 @@
+#include "SnapshotCell.h"
+#include <cstddef>
+
+namespace lmms_magenta {
+
+namespace detail {
+
+namespace {
+
+// Threads that can read lock-free at the same time
+constexpr size_t kMaxHazardRecords = 256;
+
+HazardRecord g_hazardRecords[kMaxHazardRecords];
+
+// Claims a record for the lifetime of its thread
+struct LocalRecord {
+    HazardRecord* record = nullptr;
+
+    LocalRecord() {
+        for (auto& candidate : g_hazardRecords) {
+            bool isClaimed = false;
+            if (candidate.isClaimed.compare_exchange_strong(isClaimed, true, std::memory_order_acq_rel)) {
+                record = &candidate;
+                return;
+            }
+        }
+    }
+
+    ~LocalRecord() {
+        if (record) {
+            record->pointer.store(nullptr, std::memory_order_release);
+            record->isClaimed.store(false, std::memory_order_release);
+        }
+    }
+};
+
+} // namespace
+
+HazardRecord* localHazardRecord() {
+    thread_local LocalRecord local;
+    return local.record;
+}
+
+bool isHazard(const void* pointer) {
+    for (const auto& record : g_hazardRecords) {
+        if (record.pointer.load(std::memory_order_seq_cst) == pointer) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace detail
+
+} // namespace lmms_magenta
@@ -0,0 +1,249 @@
+#include "SpectralProcessor.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace lmms_magenta {
+
+namespace {
+
+constexpr double kPi = 3.14159265358979323846;
+
+bool isPowerOfTwo(int value) {
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+} // namespace
+
+FFTPlan::FFTPlan(int size)
+    : m_size(size) {
+    if (!isPowerOfTwo(size)) {
+        throw std::invalid_argument("FFT size must be a power of two");
+    }
+
+    // Precompute bit-reversal permutation
+    int bits = 0;
+    while ((1 << bits) < size) {
+        ++bits;
+    }
+
+    m_bitReverse.resize(size);
+    for (int i = 0; i < size; ++i) {
+        int reversed = 0;
+        for (int b = 0; b < bits; ++b) {
+            if (i & (1 << b)) {
+                reversed |= 1 << (bits - 1 - b);
+            }
+        }
+        m_bitReverse[i] = reversed;
+    }
+
+    // Precompute twiddle factors
+    m_twiddles.resize(std::max(1, size / 2));
+    for (int k = 0; k < size / 2; ++k) {
+        const double angle = -2.0 * kPi * k / size;
+        m_twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)),
+                                            static_cast<float>(std::sin(angle)));
+    }
+}
+
+int FFTPlan::getSize() const {
+    return m_size;
+}
+
+void FFTPlan::forward(std::complex<float>* data) const {
+    transform(data, false);
+}
+
+void FFTPlan::inverse(std::complex<float>* data) const {
+    transform(data, true);
+
+    const float scale = 1.0f / m_size;
+    for (int i = 0; i < m_size; ++i) {
+        data[i] *= scale;
+    }
+}
+
+void FFTPlan::transform(std::complex<float>* data, bool inverse) const {
+    // Reorder input
+    for (int i = 0; i < m_size; ++i) {
+        const int j = m_bitReverse[i];
+        if (j > i) {
+            std::swap(data[i], data[j]);
+        }
+    }
+
+    // Iterative butterflies
+    for (int length = 2; length <= m_size; length <<= 1) {
+        const int half = length / 2;
+        const int stride = m_size / length;
+
+        for (int start = 0; start < m_size; start += length) {
+            for (int k = 0; k < half; ++k) {
+                std::complex<float> w = m_twiddles[k * stride];
+                if (inverse) {
+                    w = std::conj(w);
+                }
+
+                const std::complex<float> even = data[start + k];
+                const std::complex<float> odd = data[start + k + half] * w;
+                data[start + k] = even + odd;
+                data[start + k + half] = even - odd;
+            }
+        }
+    }
+}
+
+SpectralProcessor::SpectralProcessor(int fftSize, int hopSize, int batchFrames, int numChannels)
+    : m_fftSize(fftSize)
+    , m_hopSize(hopSize)
+    , m_batchFrames(batchFrames)
+    , m_numChannels(numChannels)
+    , m_numBins(fftSize / 2 + 1)
+    , m_stride(hopSize * batchFrames)
+    , m_span(fftSize + hopSize * (batchFrames - 1))
+    , m_rover(0)
+    , m_plan(fftSize)
+    , m_olaScale(1.0f) {
+    if (hopSize <= 0 || hopSize > fftSize) {
+        throw std::invalid_argument("Hop size must be in (0, fftSize]");
+    }
+    if (batchFrames <= 0 || numChannels <= 0) {
+        throw std::invalid_argument("Batch frames and channel count must be positive");
+    }
+
+    // Periodic Hann window, used for both analysis and synthesis
+    m_window.resize(fftSize);
+    double windowEnergy = 0.0;
+    for (int n = 0; n < fftSize; ++n) {
+        m_window[n] = static_cast<float>(0.5 - 0.5 * std::cos(2.0 * kPi * n / fftSize));
+        windowEnergy += static_cast<double>(m_window[n]) * m_window[n];
+    }
+
+    // Average overlap of the squared window; exact for hop <= fftSize / 4
+    m_olaScale = static_cast<float>(hopSize / windowEnergy);
+
+    m_inputFifo.resize(static_cast<size_t>(numChannels) * m_span);
+    m_outputFifo.resize(static_cast<size_t>(numChannels) * m_stride);
+    m_accumulator.resize(static_cast<size_t>(numChannels) * m_span);
+    m_spectra.resize(static_cast<size_t>(numChannels) * batchFrames * m_numBins);
+    m_fftBuffer.resize(fftSize);
+
+    reset();
+}
+
+int SpectralProcessor::getFftSize() const {
+    return m_fftSize;
+}
+
+int SpectralProcessor::getHopSize() const {
+    return m_hopSize;
+}
+
+int SpectralProcessor::getBatchFrames() const {
+    return m_batchFrames;
+}
+
+int SpectralProcessor::getNumBins() const {
+    return m_numBins;
+}
+
+int SpectralProcessor::getNumChannels() const {
+    return m_numChannels;
+}
+
+int SpectralProcessor::getLatency() const {
+    return m_span;
+}
+
+void SpectralProcessor::reset() {
+    std::fill(m_inputFifo.begin(), m_inputFifo.end(), 0.0f);
+    std::fill(m_outputFifo.begin(), m_outputFifo.end(), 0.0f);
+    std::fill(m_accumulator.begin(), m_accumulator.end(), 0.0f);
+
+    // Start writing after the samples carried over between batches
+    m_rover = m_span - m_stride;
+}
+
+void SpectralProcessor::process(const float* const* inputs, float* const* outputs, int numSamples,
+                                const BatchCallback& callback) {
+    const int carried = m_span - m_stride;
+
+    for (int i = 0; i < numSamples; ++i) {
+        for (int ch = 0; ch < m_numChannels; ++ch) {
+            // Read the input before writing, in case the buffers alias
+            const float sample = inputs[ch][i];
+            m_inputFifo[static_cast<size_t>(ch) * m_span + m_rover] = sample;
+            outputs[ch][i] = m_outputFifo[static_cast<size_t>(ch) * m_stride + (m_rover - carried)];
+        }
+
+        if (++m_rover >= m_span) {
+            m_rover = carried;
+            processBatch(callback);
+        }
+    }
+}
+
+void SpectralProcessor::processBatch(const BatchCallback& callback) {
+    const int half = m_fftSize / 2;
+
+    // Analysis
+    for (int ch = 0; ch < m_numChannels; ++ch) {
+        const float* fifo = &m_inputFifo[static_cast<size_t>(ch) * m_span];
+
+        for (int frame = 0; frame < m_batchFrames; ++frame) {
+            const float* frameStart = fifo + frame * m_hopSize;
+            for (int n = 0; n < m_fftSize; ++n) {
+                m_fftBuffer[n] = std::complex<float>(frameStart[n] * m_window[n], 0.0f);
+            }
+
+            m_plan.forward(m_fftBuffer.data());
+
+            std::complex<float>* spectrum =
+                &m_spectra[(static_cast<size_t>(ch) * m_batchFrames + frame) * m_numBins];
+            std::copy(m_fftBuffer.begin(), m_fftBuffer.begin() + m_numBins, spectrum);
+        }
+    }
+
+    // Let the caller modify the whole batch at once
+    if (callback) {
+        callback(m_spectra.data(), m_numChannels * m_batchFrames, m_numBins);
+    }
+
+    // Synthesis
+    for (int ch = 0; ch < m_numChannels; ++ch) {
+        float* accumulator = &m_accumulator[static_cast<size_t>(ch) * m_span];
+
+        for (int frame = 0; frame < m_batchFrames; ++frame) {
+            const std::complex<float>* spectrum =
+                &m_spectra[(static_cast<size_t>(ch) * m_batchFrames + frame) * m_numBins];
+
+            // Rebuild the conjugate-symmetric full spectrum
+            for (int k = 0; k <= half; ++k) {
+                m_fftBuffer[k] = spectrum[k];
+            }
+            for (int k = half + 1; k < m_fftSize; ++k) {
+                m_fftBuffer[k] = std::conj(spectrum[m_fftSize - k]);
+            }
+
+            m_plan.inverse(m_fftBuffer.data());
+
+            float* frameStart = accumulator + frame * m_hopSize;
+            for (int n = 0; n < m_fftSize; ++n) {
+                frameStart[n] += m_fftBuffer[n].real() * m_window[n] * m_olaScale;
+            }
+        }
+
+        // Emit the completed samples and shift the accumulator
+        float* outputFifo = &m_outputFifo[static_cast<size_t>(ch) * m_stride];
+        std::copy(accumulator, accumulator + m_stride, outputFifo);
+        std::copy(accumulator + m_stride, accumulator + m_span, accumulator);
+        std::fill(accumulator + (m_span - m_stride), accumulator + m_span, 0.0f);
+
+        // Keep the overlap needed by the next batch
+        float* inputFifo = &m_inputFifo[static_cast<size_t>(ch) * m_span];
+        std::copy(inputFifo + m_stride, inputFifo + m_span, inputFifo);
+    }
+}
+
+} // namespace lmms_magenta
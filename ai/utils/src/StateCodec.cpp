@@ -0,0 +1,264 @@
+#include "StateCodec.h"
+#include <array>
+#include <cstring>
+
+namespace lmms_magenta {
+
+namespace {
+
+constexpr char kMagic[4] = {'L', 'M', 'S', 'T'};
+constexpr char kAlphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+constexpr size_t kHeaderCharacters = StateCodec::kHeaderSize / 3 * 4;
+
+// Value of each base64 character, -1 for characters outside the alphabet
+const std::array<int8_t, 256>& getDecodeTable() {
+    static const std::array<int8_t, 256> table = []() {
+        std::array<int8_t, 256> values;
+        values.fill(-1);
+        for (int i = 0; i < 64; ++i) {
+            values[static_cast<uint8_t>(kAlphabet[i])] = static_cast<int8_t>(i);
+        }
+        return values;
+    }();
+    return table;
+}
+
+bool isLittleEndian() {
+    const uint16_t value = 1;
+    uint8_t firstByte;
+    std::memcpy(&firstByte, &value, 1);
+    return firstByte == 1;
+}
+
+void writeU16(uint8_t* out, uint16_t value) {
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+void writeU32(uint8_t* out, uint32_t value) {
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+uint32_t readU32(const uint8_t* in) {
+    return static_cast<uint32_t>(in[0]) | static_cast<uint32_t>(in[1]) << 8 |
+           static_cast<uint32_t>(in[2]) << 16 | static_cast<uint32_t>(in[3]) << 24;
+}
+
+// Number of bytes a base64 text decodes to, or false if its length is invalid
+bool getDecodedSize(const char* text, size_t length, size_t& size) {
+    if (length % 4 != 0) {
+        return false;
+    }
+    size_t padding = 0;
+    if (length > 0 && text[length - 1] == '=') {
+        padding = (length > 1 && text[length - 2] == '=') ? 2 : 1;
+    }
+    size = length / 4 * 3 - padding;
+    return true;
+}
+
+// Decode base64 into a buffer of exactly the decoded size
+bool decodeBase64(const char* text, size_t length, uint8_t* out) {
+    const auto& table = getDecodeTable();
+    size_t written = 0;
+
+    for (size_t i = 0; i < length; i += 4) {
+        const bool isLastQuantum = i + 4 == length;
+        int8_t values[4];
+        int numValues = 4;
+        for (int j = 0; j < 4; ++j) {
+            const char character = text[i + j];
+            if (character == '=' && isLastQuantum && j >= 2) {
+                // Padding only at the end, and "x=y=" is invalid
+                if (j == 2 && text[i + 3] != '=') {
+                    return false;
+                }
+                numValues = j;
+                break;
+            }
+            values[j] = table[static_cast<uint8_t>(character)];
+            if (values[j] < 0) {
+                return false;
+            }
+        }
+
+        const uint32_t bits = static_cast<uint32_t>(values[0]) << 18 | static_cast<uint32_t>(values[1]) << 12 |
+                              (numValues > 2 ? static_cast<uint32_t>(values[2]) << 6 : 0) |
+                              (numValues > 3 ? static_cast<uint32_t>(values[3]) : 0);
+        out[written++] = static_cast<uint8_t>(bits >> 16);
+        if (numValues > 2) {
+            out[written++] = static_cast<uint8_t>(bits >> 8);
+        }
+        if (numValues > 3) {
+            out[written++] = static_cast<uint8_t>(bits);
+        }
+    }
+    return true;
+}
+
+void writeHeader(uint8_t* out, StateBlobType type, uint32_t count) {
+    std::memcpy(out, kMagic, sizeof(kMagic));
+    out[4] = static_cast<uint8_t>(type);
+    out[5] = StateCodec::kVersion;
+    writeU16(out + 6, 0);
+    writeU32(out + 8, count);
+}
+
+} // namespace
+
+std::string StateCodec::encodeFloats(const std::vector<float>& values) {
+    std::vector<uint8_t> bytes(kHeaderSize + values.size() * sizeof(float));
+    writeHeader(bytes.data(), StateBlobType::Floats, static_cast<uint32_t>(values.size()));
+
+    uint8_t* out = bytes.data() + kHeaderSize;
+    if (isLittleEndian()) {
+        if (!values.empty()) {
+            std::memcpy(out, values.data(), values.size() * sizeof(float));
+        }
+    } else {
+        for (size_t i = 0; i < values.size(); ++i) {
+            uint32_t bits;
+            std::memcpy(&bits, &values[i], sizeof(bits));
+            writeU32(out + i * sizeof(float), bits);
+        }
+    }
+
+    return toBase64(bytes.data(), bytes.size());
+}
+
+bool StateCodec::decodeFloats(const char* text, size_t length, std::vector<float>& values) {
+    uint32_t count;
+    size_t payloadSize;
+    if (!decodeHeader(text, length, StateBlobType::Floats, count, payloadSize) ||
+        payloadSize != static_cast<size_t>(count) * sizeof(float)) {
+        return false;
+    }
+
+    // Decode straight into the values
+    std::vector<float> decoded(count);
+    if (!decodeBase64(text + kHeaderCharacters, length - kHeaderCharacters,
+                      reinterpret_cast<uint8_t*>(decoded.data()))) {
+        return false;
+    }
+    if (!isLittleEndian()) {
+        for (auto& value : decoded) {
+            uint8_t bytes[4];
+            std::memcpy(bytes, &value, sizeof(bytes));
+            const uint32_t bits = readU32(bytes);
+            std::memcpy(&value, &bits, sizeof(value));
+        }
+    }
+
+    values = std::move(decoded);
+    return true;
+}
+
+std::string StateCodec::encodeNotes(const std::vector<MidiNote>& notes) {
+    std::vector<uint8_t> bytes(kHeaderSize + notes.size() * kNoteSize);
+    writeHeader(bytes.data(), StateBlobType::Notes, static_cast<uint32_t>(notes.size()));
+
+    uint8_t* out = bytes.data() + kHeaderSize;
+    for (const auto& note : notes) {
+        out[0] = static_cast<uint8_t>(note.pitch);
+        out[1] = static_cast<uint8_t>(note.velocity);
+        out[2] = note.isPercussion ? 1 : 0;
+        out[3] = 0;
+        writeU32(out + 4, static_cast<uint32_t>(note.startTime));
+        writeU32(out + 8, static_cast<uint32_t>(note.duration));
+        out += kNoteSize;
+    }
+
+    return toBase64(bytes.data(), bytes.size());
+}
+
+bool StateCodec::decodeNotes(const char* text, size_t length, std::vector<MidiNote>& notes) {
+    uint32_t count;
+    size_t payloadSize;
+    if (!decodeHeader(text, length, StateBlobType::Notes, count, payloadSize) ||
+        payloadSize != static_cast<size_t>(count) * kNoteSize) {
+        return false;
+    }
+
+    std::vector<uint8_t> bytes(payloadSize);
+    if (!decodeBase64(text + kHeaderCharacters, length - kHeaderCharacters, bytes.data())) {
+        return false;
+    }
+
+    std::vector<MidiNote> decoded;
+    decoded.reserve(count);
+    for (const uint8_t* in = bytes.data(); in < bytes.data() + bytes.size(); in += kNoteSize) {
+        decoded.emplace_back(in[0], in[1], static_cast<int32_t>(readU32(in + 4)),
+                             static_cast<int32_t>(readU32(in + 8)), (in[2] & 1) != 0);
+    }
+
+    notes = std::move(decoded);
+    return true;
+}
+
+std::string StateCodec::toBase64(const uint8_t* data, size_t size) {
+    std::string text;
+    text.reserve((size + 2) / 3 * 4);
+
+    size_t i = 0;
+    for (; i + 3 <= size; i += 3) {
+        const uint32_t bits = static_cast<uint32_t>(data[i]) << 16 | static_cast<uint32_t>(data[i + 1]) << 8 | data[i + 2];
+        text += kAlphabet[(bits >> 18) & 63];
+        text += kAlphabet[(bits >> 12) & 63];
+        text += kAlphabet[(bits >> 6) & 63];
+        text += kAlphabet[bits & 63];
+    }
+
+    if (i < size) {
+        const bool hasTwoBytes = i + 1 < size;
+        const uint32_t bits = static_cast<uint32_t>(data[i]) << 16 |
+                              (hasTwoBytes ? static_cast<uint32_t>(data[i + 1]) << 8 : 0);
+        text += kAlphabet[(bits >> 18) & 63];
+        text += kAlphabet[(bits >> 12) & 63];
+        text += hasTwoBytes ? kAlphabet[(bits >> 6) & 63] : '=';
+        text += '=';
+    }
+
+    return text;
+}
+
+bool StateCodec::fromBase64(const char* text, size_t length, std::vector<uint8_t>& bytes) {
+    size_t size;
+    if (!getDecodedSize(text, length, size)) {
+        return false;
+    }
+
+    std::vector<uint8_t> decoded(size);
+    if (!decodeBase64(text, length, decoded.data())) {
+        return false;
+    }
+
+    bytes = std::move(decoded);
+    return true;
+}
+
+bool StateCodec::decodeHeader(const char* text, size_t length, StateBlobType expectedType,
+                              uint32_t& count, size_t& payloadSize) {
+    if (text == nullptr || length < kHeaderCharacters ||
+        !getDecodedSize(text + kHeaderCharacters, length - kHeaderCharacters, payloadSize)) {
+        return false;
+    }
+
+    uint8_t header[kHeaderSize];
+    if (!decodeBase64(text, kHeaderCharacters, header)) {
+        return false;
+    }
+
+    // Blobs from newer versions may use a layout this version cannot read
+    if (std::memcmp(header, kMagic, sizeof(kMagic)) != 0 ||
+        header[4] != static_cast<uint8_t>(expectedType) ||
+        header[5] == 0 || header[5] > kVersion) {
+        return false;
+    }
+
+    count = readU32(header + 8);
+    return true;
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,164 @@
+#include "ThreadPolicy.h"
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <windows.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <time.h>
+#endif
+
+namespace lmms_magenta {
+
+namespace {
+
+std::string readFirstLine(const std::string& path) {
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);
+    return line;
+}
+
+} // namespace
+
+std::vector<int> ThreadPolicy::getOnlineCores() {
+#if defined(__linux__)
+    // Respect an affinity mask set from outside (taskset, cgroups)
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) == 0) {
+        std::vector<int> cores;
+        for (int core = 0; core < CPU_SETSIZE; ++core) {
+            if (CPU_ISSET(core, &set)) {
+                cores.push_back(core);
+            }
+        }
+        if (!cores.empty()) {
+            return cores;
+        }
+    }
+#endif
+
+    std::vector<int> cores;
+    const unsigned int count = std::max(1u, std::thread::hardware_concurrency());
+    for (unsigned int core = 0; core < count; ++core) {
+        cores.push_back(static_cast<int>(core));
+    }
+    return cores;
+}
+
+std::map<int, std::vector<int>> ThreadPolicy::getNumaNodes() {
+    std::map<int, std::vector<int>> nodes;
+
+#if defined(__linux__)
+    namespace fs = std::filesystem;
+
+    std::error_code error;
+    const fs::path root("/sys/devices/system/node");
+    for (fs::directory_iterator it(root, error), end; !error && it != end; it.increment(error)) {
+        const std::string name = it->path().filename().string();
+        if (name.rfind("node", 0) != 0 || name.size() == 4 ||
+            name.find_first_not_of("0123456789", 4) != std::string::npos) {
+            continue;
+        }
+
+        std::vector<int> cores = CoreConfig::parseCpuList(readFirstLine((it->path() / "cpulist").string()));
+        if (!cores.empty()) {
+            nodes[std::stoi(name.substr(4))] = cores;
+        }
+    }
+#endif
+
+    return nodes;
+}
+
+std::vector<int> ThreadPolicy::selectCores(const InferenceThreadingConfig& config) {
+    return CoreConfig::selectInferenceCores(config, getOnlineCores(), getNumaNodes());
+}
+
+bool ThreadPolicy::applyToCurrentThread(const InferenceThreadingConfig& config, const std::vector<int>& cores) {
+    bool success = true;
+
+#if defined(__linux__)
+    if (config.pinThreads && !cores.empty()) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (int core : cores) {
+            if (core >= 0 && core < CPU_SETSIZE) {
+                CPU_SET(core, &set);
+            }
+        }
+        if (pthread_setaffinity_np(pthread_self(), sizeof(set), &set) != 0) {
+            std::cerr << "Failed to pin inference thread" << std::endl;
+            success = false;
+        }
+    }
+
+    if (config.priority == ThreadPriority::Idle) {
+        sched_param param = {};
+        if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0) {
+            std::cerr << "Failed to set SCHED_IDLE on inference thread" << std::endl;
+            success = false;
+        }
+    } else if (config.priority == ThreadPriority::Background) {
+        // On Linux the nice level belongs to the thread, not the process
+        const auto threadId = static_cast<id_t>(syscall(SYS_gettid));
+        if (setpriority(PRIO_PROCESS, threadId, config.niceLevel) != 0) {
+            std::cerr << "Failed to lower inference thread priority" << std::endl;
+            success = false;
+        }
+    }
+#elif defined(_WIN32)
+    if (config.pinThreads && !cores.empty()) {
+        DWORD_PTR mask = 0;
+        for (int core : cores) {
+            if (core >= 0 && core < static_cast<int>(sizeof(DWORD_PTR) * 8)) {
+                mask |= static_cast<DWORD_PTR>(1) << core;
+            }
+        }
+        if (mask == 0 || SetThreadAffinityMask(GetCurrentThread(), mask) == 0) {
+            std::cerr << "Failed to pin inference thread" << std::endl;
+            success = false;
+        }
+    }
+
+    if (config.priority != ThreadPriority::Normal) {
+        const int priority = config.priority == ThreadPriority::Idle ? THREAD_PRIORITY_IDLE
+                                                                     : THREAD_PRIORITY_BELOW_NORMAL;
+        if (!SetThreadPriority(GetCurrentThread(), priority)) {
+            std::cerr << "Failed to lower inference thread priority" << std::endl;
+            success = false;
+        }
+    }
+#else
+    // Pinning and priorities are not supported on this platform
+    (void)config;
+    (void)cores;
+#endif
+
+    return success;
+}
+
+double ThreadPolicy::getThreadCpuSeconds() {
+#if defined(__unix__) || defined(__APPLE__)
+    timespec time;
+    if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) == 0) {
+        return static_cast<double>(time.tv_sec) + static_cast<double>(time.tv_nsec) * 1e-9;
+    }
+#endif
+    return -1.0;
+}
+
+} // namespace lmms_magenta
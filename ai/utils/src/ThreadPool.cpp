@@ -0,0 +1,92 @@
+#include "ThreadPool.h"
+#include "Trace.h"
+#include <algorithm>
+
+namespace lmms_magenta {
+
+ThreadPool::ThreadPool(size_t numThreads, std::function<void()> threadInit)
+    : m_stopping(false) {
+    if (numThreads == 0) {
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_workers.reserve(numThreads);
+    for (size_t i = 0; i < numThreads; ++i) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, threadInit);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& worker : m_workers) {
+        if (worker.joinable()) {
+            worker.join();
+        }
+    }
+}
+
+size_t ThreadPool::getNumThreads() const {
+    return m_workers.size();
+}
+
+bool ThreadPool::isWorkerThread() const {
+    const std::thread::id self = std::this_thread::get_id();
+    return std::any_of(m_workers.begin(), m_workers.end(),
+                       [self](const std::thread& worker) { return worker.get_id() == self; });
+}
+
+size_t ThreadPool::getQueuedTaskCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_tasks.size();
+}
+
+void ThreadPool::enqueue(std::function<void()> task) {
+#ifdef LMMS_MAGENTA_ENABLE_PROFILING
+    // Record how long the task waited for a worker
+    if (TraceRecorder::isRecording()) {
+        task = [task = std::move(task), queuedAt = TraceRecorder::now()]() {
+            LMMS_MAGENTA_TRACE_SINCE("scheduler", "queue_wait", queuedAt);
+            LMMS_MAGENTA_TRACE_SCOPE("scheduler", "task");
+            task();
+        };
+    }
+#endif
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_tasks.push_back(std::move(task));
+    }
+    m_condition.notify_one();
+}
+
+void ThreadPool::workerLoop(const std::function<void()>& threadInit) {
+    if (threadInit) {
+        threadInit();
+    }
+
+    for (;;) {
+        std::function<void()> task;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_condition.wait(lock, [this]() { return m_stopping || !m_tasks.empty(); });
+
+            // Drain remaining tasks before exiting
+            if (m_tasks.empty()) {
+                return;
+            }
+
+            task = std::move(m_tasks.front());
+            m_tasks.pop_front();
+        }
+
+        task();
+    }
+}
+
+} // namespace lmms_magenta
@@ -0,0 +1,195 @@
+#include "Trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+
+namespace lmms_magenta {
+
+namespace {
+
+const char* getExitTraceFile() {
+    return std::getenv("LMMS_MAGENTA_TRACE_FILE");
+}
+
+// Calling thread's buffer and name; buffers stay alive after the session
+// ends until the thread records into a newer session
+thread_local std::shared_ptr<void> t_buffer;
+thread_local std::string t_threadName;
+
+// Escape a string for a JSON string literal
+std::string escapeJson(const char* text) {
+    std::string escaped;
+    for (const char* c = text; *c; ++c) {
+        switch (*c) {
+            case '"': escaped += "\\\""; break;
+            case '\\': escaped += "\\\\"; break;
+            case '\n': escaped += "\\n"; break;
+            case '\t': escaped += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(*c) < 0x20) {
+                    char code[8];
+                    std::snprintf(code, sizeof(code), "\\u%04x", *c);
+                    escaped += code;
+                } else {
+                    escaped += *c;
+                }
+        }
+    }
+    return escaped;
+}
+
+} // namespace
+
+std::atomic<bool> TraceRecorder::s_isRecording(getExitTraceFile() != nullptr);
+
+TraceRecorder& TraceRecorder::getInstance() {
+    static TraceRecorder instance;
+    return instance;
+}
+
+TraceRecorder::TraceRecorder()
+    : m_session(1), m_eventsPerThread(kDefaultEventsPerThread) {
+    if (const char* traceFile = getExitTraceFile()) {
+        m_exitTraceFile = traceFile;
+    }
+}
+
+TraceRecorder::~TraceRecorder() {
+    if (!m_exitTraceFile.empty()) {
+        s_isRecording = false;
+        exportChromeTrace(m_exitTraceFile);
+    }
+}
+
+void TraceRecorder::start(size_t eventsPerThread) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_buffers.clear();
+    m_eventsPerThread = std::max<size_t>(1, eventsPerThread);
+    m_session.fetch_add(1, std::memory_order_release);
+    s_isRecording = true;
+}
+
+void TraceRecorder::stop() {
+    s_isRecording = false;
+}
+
+uint64_t TraceRecorder::now() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+void TraceRecorder::record(const char* category, const char* name, uint64_t startNs, uint64_t endNs) {
+    ThreadBuffer* buffer = getThreadBuffer();
+
+    // Only this thread writes the buffer; publish the slot with the count
+    const size_t index = buffer->count.load(std::memory_order_relaxed);
+    if (index >= buffer->capacity) {
+        buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    buffer->events[index] = TraceEvent{category, name, startNs, endNs > startNs ? endNs - startNs : 0};
+    buffer->count.store(index + 1, std::memory_order_release);
+}
+
+void TraceRecorder::setThreadName(const std::string& name) {
+    t_threadName = name;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto* buffer = static_cast<ThreadBuffer*>(t_buffer.get());
+    if (buffer && buffer->session == m_session.load(std::memory_order_relaxed)) {
+        buffer->threadName = name;
+    }
+}
+
+TraceRecorder::ThreadBuffer* TraceRecorder::getThreadBuffer() {
+    const uint64_t session = m_session.load(std::memory_order_acquire);
+    auto* buffer = static_cast<ThreadBuffer*>(t_buffer.get());
+    if (buffer && buffer->session == session) {
+        return buffer;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto fresh = std::make_shared<ThreadBuffer>();
+    fresh->session = m_session.load(std::memory_order_relaxed);
+    fresh->threadId = static_cast<uint32_t>(m_buffers.size() + 1);
+    fresh->threadName = t_threadName;
+    fresh->events.reset(new TraceEvent[m_eventsPerThread]);
+    fresh->capacity = m_eventsPerThread;
+    fresh->count = 0;
+    fresh->dropped = 0;
+
+    m_buffers.push_back(fresh);
+    t_buffer = fresh;
+    return fresh.get();
+}
+
+std::vector<TraceEvent> TraceRecorder::getEvents() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::vector<TraceEvent> events;
+    for (const auto& buffer : m_buffers) {
+        const size_t count = buffer->count.load(std::memory_order_acquire);
+        events.insert(events.end(), buffer->events.get(), buffer->events.get() + count);
+    }
+    return events;
+}
+
+size_t TraceRecorder::getDroppedCount() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    size_t dropped = 0;
+    for (const auto& buffer : m_buffers) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+    return dropped;
+}
+
+bool TraceRecorder::exportChromeTrace(const std::string& filePath) const {
+    std::ofstream file(filePath);
+    if (!file) {
+        std::cerr << "Failed to open trace file: " << filePath << std::endl;
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Timestamps are relative to the first event, in microseconds
+    uint64_t origin = UINT64_MAX;
+    for (const auto& buffer : m_buffers) {
+        const size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            origin = std::min(origin, buffer->events[i].startNs);
+        }
+    }
+
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool isFirst = true;
+    char number[64];
+
+    for (const auto& buffer : m_buffers) {
+        const std::string threadName = buffer->threadName.empty()
+            ? "thread " + std::to_string(buffer->threadId) : buffer->threadName;
+        file << (isFirst ? "\n" : ",\n")
+             << "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":" << buffer->threadId
+             << ",\"args\":{\"name\":\"" << escapeJson(threadName.c_str()) << "\"}}";
+        isFirst = false;
+
+        const size_t count = buffer->count.load(std::memory_order_acquire);
+        for (size_t i = 0; i < count; ++i) {
+            const TraceEvent& event = buffer->events[i];
+            std::snprintf(number, sizeof(number), "\"ts\":%.3f,\"dur\":%.3f",
+                          (event.startNs - origin) / 1000.0, event.durationNs / 1000.0);
+            file << ",\n{\"ph\":\"X\",\"cat\":\"" << escapeJson(event.category)
+                 << "\",\"name\":\"" << escapeJson(event.name)
+                 << "\",\"pid\":1,\"tid\":" << buffer->threadId << "," << number << "}";
+        }
+    }
+
+    file << "\n]}\n";
+    return static_cast<bool>(file);
+}
+
+} // namespace lmms_magenta
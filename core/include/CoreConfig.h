@@ -0,0 +1,107 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+
+/**
+ * @brief Scheduling priority of background inference threads
+ */
+enum class ThreadPriority {
+    Normal,      // Same priority as the rest of LMMS
+    Background,  // Lowered with a nice level
+    Idle         // SCHED_IDLE: only runs when a core would otherwise be idle
+};
+
+/**
+ * @brief Threading policy shared by every model
+ */
+struct InferenceThreadingConfig {
+    int numThreads = 0;                     // Inference threads (0 for every eligible core)
+    std::vector<int> audioCores = {0};      // Cores kept free for the audio threads
+    bool pinThreads = false;                // Pin inference threads to the selected cores
+    ThreadPriority priority = ThreadPriority::Background;
+    int niceLevel = 5;                      // Nice level used by ThreadPriority::Background
+    int numaNode = -1;                      // NUMA node to run on (-1 to pick the largest)
+};
+
+/**
+ * @brief Global configuration of the LMMS-Magenta integration
+ *
+ * Settings are stored as "key = value" lines. Unknown keys are ignored so
+ * that older versions can read newer files.
+ */
+class CoreConfig {
+public:
+    /**
+     * @brief Get the singleton instance
+     * @return Reference to the singleton instance
+     */
+    static CoreConfig& getInstance();
+
+    /**
+     * @brief Load settings from a file
+     * @param filePath Path to the configuration file
+     * @return True if the file was read
+     */
+    bool load(const std::string& filePath);
+
+    /**
+     * @brief Save settings to a file
+     * @param filePath Path to the configuration file
+     * @return True if saving was successful
+     */
+    bool save(const std::string& filePath) const;
+
+    /**
+     * @brief Get the inference threading policy
+     * @return Threading policy
+     */
+    InferenceThreadingConfig getInferenceThreading() const;
+
+    /**
+     * @brief Set the inference threading policy
+     *
+     * Takes effect when the inference thread pool is next configured.
+     *
+     * @param config Threading policy
+     */
+    void setInferenceThreading(const InferenceThreadingConfig& config);
+
+    /**
+     * @brief Choose the cores inference threads may run on
+     *
+     * Removes the audio cores, keeps only the cores of one NUMA node (the
+     * configured one, or the node with the most remaining cores) and limits
+     * the result to numThreads cores.
+     *
+     * @param config Threading policy
+     * @param onlineCores Cores available to the process
+     * @param numaNodes Cores of each NUMA node (empty if unknown)
+     * @return Selected cores in ascending order (never empty)
+     */
+    static std::vector<int> selectInferenceCores(const InferenceThreadingConfig& config,
+                                                 const std::vector<int>& onlineCores,
+                                                 const std::map<int, std::vector<int>>& numaNodes);
+
+    /**
+     * @brief Parse a Linux CPU list such as "0-3,8,10-11"
+     * @param text CPU list
+     * @return Cores in the list
+     */
+    static std::vector<int> parseCpuList(const std::string& text);
+
+private:
+    CoreConfig();
+
+    CoreConfig(const CoreConfig&) = delete;
+    CoreConfig& operator=(const CoreConfig&) = delete;
+
+    InferenceThreadingConfig m_inferenceThreading;
+    mutable std::mutex m_mutex;
+};
+
+} // namespace lmms_magenta
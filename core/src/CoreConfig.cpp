@@ -0,0 +1,212 @@
+#include "CoreConfig.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <sstream>
+
+namespace lmms_magenta {
+
+namespace {
+
+std::string trim(const std::string& text) {
+    const size_t begin = text.find_first_not_of(" \t\r");
+    if (begin == std::string::npos) {
+        return "";
+    }
+    const size_t end = text.find_last_not_of(" \t\r");
+    return text.substr(begin, end - begin + 1);
+}
+
+std::string formatCpuList(const std::vector<int>& cores) {
+    std::ostringstream text;
+    for (size_t i = 0; i < cores.size(); ++i) {
+        text << (i > 0 ? "," : "") << cores[i];
+    }
+    return text.str();
+}
+
+const char* priorityName(ThreadPriority priority) {
+    switch (priority) {
+        case ThreadPriority::Normal:
+            return "normal";
+        case ThreadPriority::Idle:
+            return "idle";
+        case ThreadPriority::Background:
+        default:
+            return "background";
+    }
+}
+
+} // namespace
+
+CoreConfig& CoreConfig::getInstance() {
+    static CoreConfig instance;
+    return instance;
+}
+
+CoreConfig::CoreConfig() = default;
+
+bool CoreConfig::load(const std::string& filePath) {
+    std::ifstream file(filePath);
+    if (!file) {
+        std::cerr << "Failed to open config file: " << filePath << std::endl;
+        return false;
+    }
+
+    InferenceThreadingConfig threading = getInferenceThreading();
+
+    std::string line;
+    while (std::getline(file, line)) {
+        line = trim(line);
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+
+        const size_t separator = line.find('=');
+        if (separator == std::string::npos) {
+            continue;
+        }
+
+        const std::string key = trim(line.substr(0, separator));
+        const std::string value = trim(line.substr(separator + 1));
+
+        try {
+            if (key == "inference.threads") {
+                threading.numThreads = std::max(0, std::stoi(value));
+            } else if (key == "inference.audio_cores") {
+                threading.audioCores = parseCpuList(value);
+            } else if (key == "inference.pin_threads") {
+                threading.pinThreads = value == "true" || value == "1";
+            } else if (key == "inference.priority") {
+                if (value == "normal") {
+                    threading.priority = ThreadPriority::Normal;
+                } else if (value == "idle") {
+                    threading.priority = ThreadPriority::Idle;
+                } else {
+                    threading.priority = ThreadPriority::Background;
+                }
+            } else if (key == "inference.nice") {
+                threading.niceLevel = std::max(0, std::min(19, std::stoi(value)));
+            } else if (key == "inference.numa_node") {
+                threading.numaNode = std::stoi(value);
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Invalid value for " << key << ": " << value << std::endl;
+        }
+    }
+
+    setInferenceThreading(threading);
+    return true;
+}
+
+bool CoreConfig::save(const std::string& filePath) const {
+    const InferenceThreadingConfig threading = getInferenceThreading();
+
+    std::ofstream file(filePath);
+    if (!file) {
+        std::cerr << "Failed to write config file: " << filePath << std::endl;
+        return false;
+    }
+
+    file << "inference.threads = " << threading.numThreads << "\n";
+    file << "inference.audio_cores = " << formatCpuList(threading.audioCores) << "\n";
+    file << "inference.pin_threads = " << (threading.pinThreads ? "true" : "false") << "\n";
+    file << "inference.priority = " << priorityName(threading.priority) << "\n";
+    file << "inference.nice = " << threading.niceLevel << "\n";
+    file << "inference.numa_node = " << threading.numaNode << "\n";
+
+    return static_cast<bool>(file);
+}
+
+InferenceThreadingConfig CoreConfig::getInferenceThreading() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_inferenceThreading;
+}
+
+void CoreConfig::setInferenceThreading(const InferenceThreadingConfig& config) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_inferenceThreading = config;
+}
+
+std::vector<int> CoreConfig::selectInferenceCores(const InferenceThreadingConfig& config,
+                                                  const std::vector<int>& onlineCores,
+                                                  const std::map<int, std::vector<int>>& numaNodes) {
+    std::set<int> eligible(onlineCores.begin(), onlineCores.end());
+    for (int core : config.audioCores) {
+        eligible.erase(core);
+    }
+
+    // On a machine too small to spare the audio cores, share them
+    if (eligible.empty()) {
+        eligible.insert(onlineCores.begin(), onlineCores.end());
+    }
+
+    // Keep the threads on one node so they share caches and local memory
+    if (numaNodes.size() > 1) {
+        std::set<int> best;
+        for (const auto& node : numaNodes) {
+            std::set<int> cores;
+            for (int core : node.second) {
+                if (eligible.count(core)) {
+                    cores.insert(core);
+                }
+            }
+
+            if (node.first == config.numaNode && !cores.empty()) {
+                best = cores;
+                break;
+            }
+            if (cores.size() > best.size()) {
+                best = cores;
+            }
+        }
+        if (!best.empty()) {
+            eligible = best;
+        }
+    }
+
+    std::vector<int> selected(eligible.begin(), eligible.end());
+    if (config.numThreads > 0 && selected.size() > static_cast<size_t>(config.numThreads)) {
+        selected.resize(config.numThreads);
+    }
+    if (selected.empty()) {
+        selected.push_back(0);
+    }
+    return selected;
+}
+
+std::vector<int> CoreConfig::parseCpuList(const std::string& text) {
+    std::vector<int> cores;
+    std::stringstream stream(text);
+    std::string range;
+
+    while (std::getline(stream, range, ',')) {
+        range = trim(range);
+        if (range.empty()) {
+            continue;
+        }
+
+        try {
+            const size_t dash = range.find('-');
+            if (dash == std::string::npos) {
+                cores.push_back(std::stoi(range));
+                continue;
+            }
+
+            const int first = std::stoi(range.substr(0, dash));
+            const int last = std::stoi(range.substr(dash + 1));
+            for (int core = first; core <= last; ++core) {
+                cores.push_back(core);
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Invalid CPU list entry: " << range << std::endl;
+        }
+    }
+
+    return cores;
+}
+
+} // namespace lmms_magenta
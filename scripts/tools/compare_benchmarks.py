@@ -0,0 +1,183 @@
+#!/usr/bin/env python3
+"""Compare Google Benchmark results against a baseline and flag regressions.
+
+Both files must be JSON output of lmms_magenta_benchmarks run with
+--benchmark_repetitions, so every benchmark has one sample per repetition.
+
+A benchmark regresses when
+  - its time samples are significantly slower than the baseline samples
+    (one-sided Mann-Whitney U test) and the median slowed down by more than
+    the time threshold, or
+  - its median allocations per iteration grew by more than the allocation
+    threshold.
+
+Benchmarks missing from either file, or skipped because of an error, are
+reported but never fail the comparison.
+
+Exit status: 0 when no regression was found, 1 on regressions, 2 on usage
+errors.
+"""
+
+import argparse
+import json
+import math
+import os
+import statistics
+import sys
+
+TIME_UNITS = {"ns": 1e-9, "us": 1e-6, "ms": 1e-3, "s": 1.0}
+
+
+def load_samples(path):
+    """Return {benchmark name: {"time": [seconds], "allocs": [count]}}."""
+    with open(path, "r", encoding="utf-8") as file:
+        data = json.load(file)
+
+    samples = {}
+    for run in data.get("benchmarks", []):
+        if run.get("run_type", "iteration") != "iteration":
+            continue
+        name = run.get("run_name", run["name"])
+        entry = samples.setdefault(name, {"time": [], "allocs": [], "errors": 0})
+        if run.get("error_occurred"):
+            entry["errors"] += 1
+            continue
+        entry["time"].append(run["real_time"] * TIME_UNITS[run.get("time_unit", "ns")])
+        if "allocs_per_iter" in run:
+            entry["allocs"].append(run["allocs_per_iter"])
+    return samples
+
+
+def mann_whitney_greater(current, baseline):
+    """One-sided Mann-Whitney U test that current tends to be larger.
+
+    Uses the normal approximation with tie and continuity correction.
+    Returns the p-value.
+    """
+    n1, n2 = len(current), len(baseline)
+    if n1 == 0 or n2 == 0:
+        return 1.0
+
+    # Rank the pooled samples, averaging the ranks of ties
+    pooled = sorted([(value, 0) for value in current] + [(value, 1) for value in baseline])
+    ranks = [0.0] * len(pooled)
+    tie_term = 0.0
+    i = 0
+    while i < len(pooled):
+        j = i
+        while j + 1 < len(pooled) and pooled[j + 1][0] == pooled[i][0]:
+            j += 1
+        rank = (i + j) / 2.0 + 1.0
+        for k in range(i, j + 1):
+            ranks[k] = rank
+        count = j - i + 1
+        tie_term += count ** 3 - count
+        i = j + 1
+
+    rank_sum = sum(rank for rank, (_, group) in zip(ranks, pooled) if group == 0)
+    u = rank_sum - n1 * (n1 + 1) / 2.0
+    mean = n1 * n2 / 2.0
+    n = n1 + n2
+    variance = n1 * n2 / 12.0 * ((n + 1) - tie_term / (n * (n - 1)))
+    if variance <= 0.0:
+        return 1.0 if u <= mean else 0.0
+
+    z = (u - mean - 0.5) / math.sqrt(variance)
+    return 0.5 * math.erfc(z / math.sqrt(2.0))
+
+
+def format_time(seconds):
+    for unit, scale in (("s", 1.0), ("ms", 1e-3), ("us", 1e-6)):
+        if seconds >= scale:
+            return "%.3f %s" % (seconds / scale, unit)
+    return "%.1f ns" % (seconds / 1e-9)
+
+
+def compare(baseline, current, args):
+    regressions = []
+    rows = []
+
+    for name in sorted(set(baseline) | set(current)):
+        base = baseline.get(name)
+        cur = current.get(name)
+        if not base or not cur or not base["time"] or not cur["time"]:
+            rows.append((name, "-", "-", "-", "-", "skipped"))
+            continue
+
+        base_median = statistics.median(base["time"])
+        cur_median = statistics.median(cur["time"])
+        change = (cur_median - base_median) / base_median if base_median > 0 else 0.0
+        p_value = mann_whitney_greater(cur["time"], base["time"])
+
+        status = "ok"
+        if change > args.time_threshold and p_value < args.alpha:
+            status = "SLOWER"
+            regressions.append("%s: median %s -> %s (%+.1f%%, p=%.4f)" % (
+                name, format_time(base_median), format_time(cur_median), change * 100.0, p_value))
+        elif change < -args.time_threshold and mann_whitney_greater(base["time"], cur["time"]) < args.alpha:
+            status = "faster"
+
+        allocs = "-"
+        if base["allocs"] and cur["allocs"]:
+            base_allocs = statistics.median(base["allocs"])
+            cur_allocs = statistics.median(cur["allocs"])
+            allocs = "%g -> %g" % (base_allocs, cur_allocs)
+            if cur_allocs - base_allocs > max(args.alloc_threshold * base_allocs, args.alloc_slack):
+                status = "MORE ALLOCS" if status == "ok" else status + ", MORE ALLOCS"
+                regressions.append("%s: allocations per iteration %g -> %g" % (name, base_allocs, cur_allocs))
+
+        rows.append((name, format_time(base_median), format_time(cur_median),
+                     "%+.1f%%" % (change * 100.0), "%.4f" % p_value, status + ("" if allocs == "-" else "  [allocs " + allocs + "]")))
+
+    width = max([len(row[0]) for row in rows] + [9])
+    print("%-*s %12s %12s %9s %8s  %s" % (width, "Benchmark", "Baseline", "Current", "Change", "p", "Status"))
+    for row in rows:
+        print("%-*s %12s %12s %9s %8s  %s" % ((width,) + row))
+
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline", help="Baseline benchmark JSON")
+    parser.add_argument("current", help="Current benchmark JSON")
+    parser.add_argument("--alpha", type=float, default=0.01,
+                        help="Significance level of the Mann-Whitney test (default: 0.01)")
+    parser.add_argument("--time-threshold", type=float, default=0.10,
+                        help="Minimum relative slowdown of the median to report (default: 0.10)")
+    parser.add_argument("--alloc-threshold", type=float, default=0.05,
+                        help="Minimum relative growth of allocations per iteration (default: 0.05)")
+    parser.add_argument("--alloc-slack", type=float, default=1.0,
+                        help="Minimum absolute growth of allocations per iteration (default: 1)")
+    parser.add_argument("--require-baseline", action="store_true",
+                        help="Fail instead of passing when the baseline file does not exist")
+    args = parser.parse_args()
+
+    if not os.path.exists(args.baseline):
+        print("No baseline at %s; run the update_performance_baseline target to create one."
+              % args.baseline)
+        return 2 if args.require_baseline else 0
+    if not os.path.exists(args.current):
+        print("No benchmark results at %s" % args.current, file=sys.stderr)
+        return 2
+
+    try:
+        baseline = load_samples(args.baseline)
+        current = load_samples(args.current)
+    except (OSError, ValueError, KeyError) as error:
+        print("Failed to read benchmark results: %s" % error, file=sys.stderr)
+        return 2
+
+    regressions = compare(baseline, current, args)
+    if regressions:
+        print("\n%d performance regression(s):" % len(regressions))
+        for regression in regressions:
+            print("  " + regression)
+        return 1
+
+    print("\nNo performance regressions.")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -3,6 +3,9 @@
 #include "model_serving/GrooVAEModel.h"
 #include "plugins/GrooVAEEffect.h"
 #include "utils/MidiUtils.h"
+#include "MidiEvent.h"
+#include "TimePos.h"
+#include <filesystem>
 #include <memory>
 #include <vector>
 #include <iostream>
@@ -61,48 +64,28 @@ TEST_F(GrooVAEIntegrationTest, GrooveApplication) {
     auto grooVAEModel = std::dynamic_pointer_cast<GrooVAEModel>(model);
     ASSERT_NE(grooVAEModel, nullptr);
     
-    // Create a MIDI sequence
-    std::vector<MidiNote> inputNotes;
-    
-    // Add some notes (a simple 4/4 beat)
+    // Create a MIDI sequence (a simple 4/4 beat in sixteenths)
+    MidiSequence input(480, 1920);
     for (int i = 0; i < 16; ++i) {
-        MidiNote note;
-        note.pitch = 36; // Kick drum
-        note.velocity = 100;
-        note.startTime = i * 0.25f;
-        note.endTime = note.startTime + 0.1f;
+        const int startTime = i * 120;
         
-        inputNotes.push_back(note);
+        // Kick drum
+        input.notes.emplace_back(36, 100, startTime, 48, true);
         
         // Add snare on beats 2 and 4
         if (i % 4 == 2) {
-            MidiNote snare;
-            snare.pitch = 38; // Snare drum
-            snare.velocity = 100;
-            snare.startTime = i * 0.25f;
-            snare.endTime = snare.startTime + 0.1f;
-            
-            inputNotes.push_back(snare);
+            input.notes.emplace_back(38, 100, startTime, 48, true);
         }
         
-        // Add hi-hat on every 8th note
-        MidiNote hihat;
-        hihat.pitch = 42; // Closed hi-hat
-        hihat.velocity = 80;
-        hihat.startTime = i * 0.25f;
-        hihat.endTime = hihat.startTime + 0.1f;
-        
-        inputNotes.push_back(hihat);
+        // Add closed hi-hat
+        input.notes.emplace_back(42, 80, startTime, 48, true);
     }
     
     // Apply groove
-    std::vector<MidiNote> outputNotes;
-    bool success = grooVAEModel->applyGroove(inputNotes, outputNotes);
+    const MidiSequence output = grooVAEModel->applyGroove(input, 1.0f, 0.0f);
     
-    // Check if groove application succeeded
-    // Note: In a real test, this would check for actual success
-    // but our implementation is a placeholder
-    EXPECT_FALSE(success) << "Groove application should fail with placeholder implementation";
+    // Grooving moves notes but keeps them
+    EXPECT_EQ(output.notes.size(), input.notes.size()) << "Groove application changed the notes";
 }
 
 // Test groove extraction
@@ -118,51 +101,29 @@ TEST_F(GrooVAEIntegrationTest, GrooveExtraction) {
     auto grooVAEModel = std::dynamic_pointer_cast<GrooVAEModel>(model);
     ASSERT_NE(grooVAEModel, nullptr);
     
-    // Create a MIDI sequence
-    std::vector<MidiNote> notes;
-    
-    // Add some notes (a simple 4/4 beat with some groove)
+    // Create a MIDI sequence (a simple 4/4 beat with some groove)
+    MidiSequence sequence(480, 1920);
     for (int i = 0; i < 16; ++i) {
-        MidiNote note;
-        note.pitch = 36; // Kick drum
-        note.velocity = 100;
-        
         // Add some groove by offsetting the timing slightly
-        float offset = (i % 2 == 0) ? 0.0f : 0.05f;
-        note.startTime = i * 0.25f + offset;
-        note.endTime = note.startTime + 0.1f;
+        const int startTime = i * 120 + ((i % 2 == 0) ? 0 : 24);
         
-        notes.push_back(note);
+        // Kick drum
+        sequence.notes.emplace_back(36, 100, startTime, 48, true);
         
         // Add snare on beats 2 and 4
         if (i % 4 == 2) {
-            MidiNote snare;
-            snare.pitch = 38; // Snare drum
-            snare.velocity = 100;
-            snare.startTime = i * 0.25f + offset;
-            snare.endTime = snare.startTime + 0.1f;
-            
-            notes.push_back(snare);
+            sequence.notes.emplace_back(38, 100, startTime, 48, true);
         }
         
-        // Add hi-hat on every 8th note
-        MidiNote hihat;
-        hihat.pitch = 42; // Closed hi-hat
-        hihat.velocity = 80;
-        hihat.startTime = i * 0.25f + offset;
-        hihat.endTime = hihat.startTime + 0.1f;
-        
-        notes.push_back(hihat);
+        // Add closed hi-hat
+        sequence.notes.emplace_back(42, 80, startTime, 48, true);
     }
     
     // Extract groove
-    std::vector<float> groove;
-    bool success = grooVAEModel->extractGroove(notes, groove);
+    const std::vector<float> groove = grooVAEModel->extractGroove(sequence);
     
-    // Check if groove extraction succeeded
-    // Note: In a real test, this would check for actual success
-    // but our implementation is a placeholder
-    EXPECT_FALSE(success) << "Groove extraction should fail with placeholder implementation";
+    // The groove is an embedding of the model's groove dimension
+    EXPECT_EQ(groove.size(), grooVAEModel->getGrooveDimension()) << "Groove extraction failed";
 }
 
 // Test GrooVAEEffect with ModelServer
@@ -170,7 +131,7 @@ TEST_F(GrooVAEIntegrationTest, EffectModelIntegration) {
     // Create a mock parent model
     // Note: In a real test, we would create a real Model
     // but for this test, we'll use a nullptr
-    Model* parent = nullptr;
+    lmms::Model* parent = nullptr;
     
     // Create GrooVAEEffect
     GrooVAEEffect effect(parent, nullptr);
@@ -179,18 +140,12 @@ TEST_F(GrooVAEIntegrationTest, EffectModelIntegration) {
     EXPECT_FALSE(effect.isModelLoaded()) << "Model should not be loaded initially";
     
     // Load model
-    bool success = effect.loadModel(ModelType::GrooVAE, "");
+    bool success = effect.initialize();
     EXPECT_TRUE(success) << "Failed to load model";
     
     // Check if model is loaded
-    EXPECT_TRUE(effect.isModelLoaded()) << "Model should be loaded after loadModel";
-    
-    // Apply groove
-    effect.applyGroove();
-    
-    // Check if groove was applied
-    // Note: In a real test, we would check the actual result
-    // but our implementation is a placeholder
+    EXPECT_TRUE(effect.isModelLoaded()) << "Model should be loaded after initialize";
+    EXPECT_NE(effect.getGrooVAEModel(), nullptr) << "Failed to get GrooVAE model";
     
     // Unload model
     effect.unloadModel();
@@ -202,13 +157,13 @@ TEST_F(GrooVAEIntegrationTest, EffectModelIntegration) {
 // Test groove presets
 TEST_F(GrooVAEIntegrationTest, GroovePresets) {
     // Create a mock parent model
-    Model* parent = nullptr;
+    lmms::Model* parent = nullptr;
     
     // Create GrooVAEEffect
     GrooVAEEffect effect(parent, nullptr);
     
     // Load model
-    ASSERT_TRUE(effect.loadModel(ModelType::GrooVAE, ""));
+    ASSERT_TRUE(effect.initialize());
     
     // Create a groove preset
     std::vector<float> groove(256, 0.1f); // Placeholder groove vector
@@ -217,17 +172,14 @@ TEST_F(GrooVAEIntegrationTest, GroovePresets) {
     effect.setGroovePreset(0, groove);
     
     // Get groove preset
-    const auto& retrievedGroove = effect.getGroovePreset(0);
+    const std::vector<float> retrievedGroove = effect.getGroovePreset(0);
     
     // Check if preset was stored correctly
     EXPECT_EQ(retrievedGroove.size(), groove.size()) << "Groove preset size mismatch";
     
-    // Apply groove preset
-    effect.applyGroovePreset(groove);
-    
-    // Check if groove was applied
-    // Note: In a real test, we would check the actual result
-    // but our implementation is a placeholder
+    // Trigger the groove preset (C2)
+    EXPECT_TRUE(effect.handleMidiEvent(lmms::MidiEvent(lmms::MidiNoteOn, 0, 36, 100), lmms::TimePos(0), 0));
+    EXPECT_EQ(effect.getCurrentPreset(), 0);
 }
 
 int main(int argc, char** argv) {
@@ -0,0 +1,218 @@
+#include <gtest/gtest.h>
+#include "model_serving/ModelServer.h"
+#include "plugins/GrooVAEEffect.h"
+#include "plugins/MusicVAEInstrument.h"
+#include "utils/RealtimeChecker.h"
+#include "Engine.h"
+#include "InstrumentTrack.h"
+#include "MidiEvent.h"
+#include "NotePlayHandle.h"
+#include "Pattern.h"
+#include "Song.h"
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+using namespace lmms_magenta;
+
+namespace {
+
+// Checks every integration test: any blocking call made from a real-time
+// callback during the run fails it, with the stack traces in the output
+class RealtimeSafetyEnvironment : public ::testing::Environment {
+public:
+    void SetUp() override {
+        RealtimeChecker::clearViolations();
+        RealtimeChecker::setEnabled(true);
+    }
+
+    void TearDown() override {
+        RealtimeChecker::setEnabled(false);
+        EXPECT_EQ(RealtimeChecker::getViolationCount(), 0u) << RealtimeChecker::formatViolations();
+    }
+};
+
+::testing::Environment* const s_realtimeSafetyEnvironment =
+    ::testing::AddGlobalTestEnvironment(new RealtimeSafetyEnvironment);
+
+// Take the violations a test provoked on purpose, so they don't fail the run
+std::vector<RealtimeViolation> takeViolations() {
+    std::vector<RealtimeViolation> violations = RealtimeChecker::getViolations();
+    RealtimeChecker::clearViolations();
+    return violations;
+}
+
+bool hasViolation(const std::vector<RealtimeViolation>& violations, const std::string& operation) {
+    for (const auto& violation : violations) {
+        if (violation.operation == operation) {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+// Test that blocking calls outside real-time scopes are not reported
+TEST(RealtimeSafetyTest, IgnoresNonRealtimeCode) {
+    std::mutex mutex;
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<int> values(100);
+
+    EXPECT_FALSE(RealtimeChecker::isRealtimeThread());
+    EXPECT_EQ(RealtimeChecker::getViolationCount(), 0u);
+}
+
+// Test that scopes nest and only mark their own thread
+TEST(RealtimeSafetyTest, ScopesAreThreadLocal) {
+    {
+        RealtimeScope outer("outer");
+        {
+            RealtimeScope inner("inner");
+            EXPECT_TRUE(RealtimeChecker::isRealtimeThread());
+        }
+        EXPECT_TRUE(RealtimeChecker::isRealtimeThread());
+
+        bool isOtherThreadRealtime = true;
+        std::thread([&]() { isOtherThreadRealtime = RealtimeChecker::isRealtimeThread(); }).join();
+        EXPECT_FALSE(isOtherThreadRealtime);
+    }
+    EXPECT_FALSE(RealtimeChecker::isRealtimeThread());
+
+    // Starting the thread inside the scope allocated; that is expected here
+    takeViolations();
+}
+
+// Test that blocking model server calls are reported with a stack trace
+TEST(RealtimeSafetyTest, ReportsModelLoadsFromCallbacks) {
+    {
+        RealtimeScope scope("RealtimeSafetyTest::audioCallback");
+        ModelServer::getInstance().loadModel(ModelType::MusicVAE, "");
+    }
+
+    const std::vector<RealtimeViolation> violations = takeViolations();
+    ASSERT_FALSE(violations.empty());
+    EXPECT_TRUE(hasViolation(violations, "ModelServer::loadModel"));
+    EXPECT_EQ(violations.front().callback, "RealtimeSafetyTest::audioCallback");
+#if defined(__GLIBC__) || defined(__APPLE__)
+    EXPECT_FALSE(violations.front().stackTrace.empty());
+#endif
+}
+
+// Drives the real-time callbacks of the plugins with a render-only engine
+class PluginCallbackTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        Engine::init(true);
+
+        const std::string modelsDir = "../models";
+        std::filesystem::create_directories(modelsDir);
+        ModelServer::getInstance().initialize(modelsDir, 1024 * 1024 * 1024, false);
+    }
+
+    static void TearDownTestSuite() {
+        Engine::destroy();
+    }
+
+    void SetUp() override {
+        m_track = dynamic_cast<InstrumentTrack*>(Track::create(Track::InstrumentTrack, Engine::getSong()));
+        ASSERT_NE(m_track, nullptr);
+        takeViolations();
+    }
+
+    void TearDown() override {
+        delete m_track;
+    }
+
+    InstrumentTrack* m_track = nullptr;
+};
+
+// Test that triggering patterns from notes and MIDI events does not block
+TEST_F(PluginCallbackTest, MusicVAEInstrumentCallbacks) {
+    MusicVAEInstrument instrument(m_track, nullptr);
+    ASSERT_TRUE(instrument.loadModel(ModelType::MusicVAE, ""));
+    instrument.generatePattern();
+
+    // Pattern trigger (C3) and a key outside the trigger range
+    const fpp_t frames = Engine::mixer()->framesPerPeriod();
+    std::vector<sampleFrame> buffer(frames);
+    for (const int key : {48, 72}) {
+        NotePlayHandle* nph = NotePlayHandleManager::acquire(m_track, 0, frames, Note(MidiTime(48), MidiTime(0), key));
+        instrument.playNote(nph, buffer.data());
+        NotePlayHandleManager::release(nph);
+
+        instrument.handleMidiEvent(MidiEvent(MidiNoteOn, 0, key, 100), MidiTime(0), 0);
+        instrument.handleMidiEvent(MidiEvent(MidiNoteOff, 0, key, 0), MidiTime(0), 0);
+    }
+
+    EXPECT_EQ(RealtimeChecker::getViolationCount(), 0u) << RealtimeChecker::formatViolations();
+}
+
+// Test that triggering a groove preset hands the model call to the preset worker
+TEST_F(PluginCallbackTest, GrooVAEEffectCallbacks) {
+    GrooVAEEffect effect(nullptr, nullptr);
+    ASSERT_TRUE(effect.initialize());
+    effect.setGroovePreset(0, std::vector<float>(effect.getGrooVAEModel()->getGrooveDimension(), 0.1f));
+
+    // Presets apply to the pattern processed last
+    Pattern pattern(m_track);
+    for (int step = 0; step < 4; ++step) {
+        pattern.addNote(Note(MidiTime(12), MidiTime(step * 48), 36), false);
+    }
+    effect.processPattern(&pattern);
+
+    // Preset trigger (C2) and a key outside the trigger range
+    EXPECT_TRUE(effect.handleMidiEvent(MidiEvent(MidiNoteOn, 0, 36, 100), MidiTime(0), 0));
+    EXPECT_FALSE(effect.handleMidiEvent(MidiEvent(MidiNoteOn, 0, 72, 100), MidiTime(0), 0));
+
+    // The worker applies the preset outside the callback
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (effect.getGroovedSequence().notes.empty() && std::chrono::steady_clock::now() < deadline) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    EXPECT_EQ(effect.getGroovedSequence().notes.size(), 4u);
+
+    EXPECT_EQ(RealtimeChecker::getViolationCount(), 0u) << RealtimeChecker::formatViolations();
+}
+
+#if defined(__linux__) && defined(__GLIBC__)
+
+// Test that allocations, locks and sleeps in callbacks are intercepted
+TEST(RealtimeSafetyTest, InterceptsBlockingCalls) {
+    // Called through volatile pointers so the compiler keeps the calls
+    void* (*volatile allocate)(size_t) = std::malloc;
+    void (*volatile release)(void*) = std::free;
+    std::mutex mutex;
+
+    {
+        RealtimeScope scope("RealtimeSafetyTest::audioCallback");
+        release(allocate(64));
+        mutex.lock();
+        mutex.unlock();
+        std::this_thread::sleep_for(std::chrono::microseconds(1));
+    }
+
+    const std::vector<RealtimeViolation> violations = takeViolations();
+    EXPECT_TRUE(hasViolation(violations, "malloc"));
+    EXPECT_TRUE(hasViolation(violations, "free"));
+    EXPECT_TRUE(hasViolation(violations, "pthread_mutex_lock"));
+    EXPECT_TRUE(hasViolation(violations, "nanosleep") || hasViolation(violations, "clock_nanosleep"));
+}
+
+// Test that lock-free, allocation-free work passes
+TEST(RealtimeSafetyTest, AcceptsRealtimeSafeWork) {
+    float buffer[256] = {};
+    {
+        RealtimeScope scope("RealtimeSafetyTest::audioCallback");
+        for (int i = 0; i < 256; ++i) {
+            buffer[i] = 0.5f * static_cast<float>(i);
+        }
+    }
+
+    EXPECT_EQ(RealtimeChecker::getViolationCount(), 0u) << RealtimeChecker::formatViolations();
+    EXPECT_EQ(buffer[2], 1.0f);
+}
+
+#endif
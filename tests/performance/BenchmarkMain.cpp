@@ -0,0 +1,143 @@
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+// Allocation statistics, only updated while a measurement is running
+std::atomic<bool> g_isCounting(false);
+std::atomic<int64_t> g_numAllocations(0);
+std::atomic<int64_t> g_allocatedBytes(0);
+std::atomic<int64_t> g_currentBytes(0);
+std::atomic<int64_t> g_peakBytes(0);
+
+// Every block carries its size in front so frees can be accounted for
+constexpr size_t kHeaderSize = alignof(std::max_align_t);
+
+void* allocate(size_t size) {
+    void* block = std::malloc(size + kHeaderSize);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    *static_cast<size_t*>(block) = size;
+
+    if (g_isCounting.load(std::memory_order_relaxed)) {
+        const int64_t bytes = static_cast<int64_t>(size);
+        g_numAllocations.fetch_add(1, std::memory_order_relaxed);
+        g_allocatedBytes.fetch_add(bytes, std::memory_order_relaxed);
+        const int64_t current = g_currentBytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+        int64_t peak = g_peakBytes.load(std::memory_order_relaxed);
+        while (current > peak && !g_peakBytes.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+        }
+    }
+    return static_cast<char*>(block) + kHeaderSize;
+}
+
+void deallocate(void* pointer) {
+    if (!pointer) {
+        return;
+    }
+    void* block = static_cast<char*>(pointer) - kHeaderSize;
+    if (g_isCounting.load(std::memory_order_relaxed)) {
+        g_currentBytes.fetch_sub(static_cast<int64_t>(*static_cast<size_t*>(block)), std::memory_order_relaxed);
+    }
+    std::free(block);
+}
+
+/**
+ * @brief Counts heap allocations made through operator new during a benchmark
+ *
+ * Google Benchmark runs each benchmark once more with the manager active and
+ * reports allocs_per_iter and max_bytes_used next to the timings, so the
+ * regression gate can catch new allocations on hot paths.
+ */
+class AllocationCounter : public benchmark::MemoryManager {
+public:
+    void Start() override {
+        g_numAllocations = 0;
+        g_allocatedBytes = 0;
+        g_currentBytes = 0;
+        g_peakBytes = 0;
+        g_isCounting = true;
+    }
+
+    void Stop(Result& result) override {
+        g_isCounting = false;
+        result.num_allocs = g_numAllocations;
+        result.max_bytes_used = g_peakBytes;
+        result.total_allocated_bytes = g_allocatedBytes;
+        result.net_heap_growth = g_currentBytes;
+    }
+
+    void Stop(Result* result) {
+        Stop(*result);
+    }
+};
+
+} // namespace
+
+void* operator new(size_t size) {
+    return allocate(size);
+}
+
+void* operator new[](size_t size) {
+    return allocate(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return allocate(size);
+    } catch (const std::bad_alloc&) {
+        return nullptr;
+    }
+}
+
+void operator delete(void* pointer) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer, size_t) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept {
+    deallocate(pointer);
+}
+
+int main(int argc, char** argv) {
+    AllocationCounter allocationCounter;
+    benchmark::RegisterMemoryManager(&allocationCounter);
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    benchmark::RegisterMemoryManager(nullptr);
+    return 0;
+}
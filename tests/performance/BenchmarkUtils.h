@@ -0,0 +1,193 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include "model_serving/ModelServer.h"
+#include "model_serving/SequenceDecoder.h"
+#include "utils/MidiUtils.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+namespace lmms_magenta {
+namespace benchmarks {
+
+/**
+ * @brief Get the directory holding the models used by the model benchmarks
+ *
+ * Taken from LMMS_MAGENTA_MODELS_DIR, defaulting to ../models relative to
+ * the build directory.
+ *
+ * @return Models directory
+ */
+inline std::string getModelsDirectory() {
+    const char* directory = std::getenv("LMMS_MAGENTA_MODELS_DIR");
+    return directory ? directory : "../models";
+}
+
+/**
+ * @brief Initialize the ModelServer on the models directory once
+ * @return True if the server is ready
+ */
+inline bool initializeModelServer() {
+    static const bool isInitialized = ModelServer::getInstance().initialize(getModelsDirectory());
+    return isInitialized;
+}
+
+/**
+ * @brief Get the value at a percentile of a set of samples
+ * @param values Samples (reordered)
+ * @param percentile Percentile in [0, 100]
+ * @return Nearest-rank percentile, or 0 for no samples
+ */
+inline double percentile(std::vector<double>& values, double percentile) {
+    if (values.empty()) {
+        return 0.0;
+    }
+    const size_t rank = static_cast<size_t>(percentile / 100.0 * (values.size() - 1) + 0.5);
+    std::nth_element(values.begin(), values.begin() + rank, values.end());
+    return values[rank];
+}
+
+/**
+ * @brief Report the median and tail of the repetitions of a benchmark
+ *
+ * Adds p50/p90/p99 aggregates next to Google Benchmark's mean/median/stddev
+ * when the benchmark runs with --benchmark_repetitions.
+ *
+ * @param bench Benchmark to configure
+ */
+inline void addPercentiles(benchmark::internal::Benchmark* bench) {
+    bench->ComputeStatistics("p50", [](const std::vector<double>& v) {
+        std::vector<double> values(v);
+        return percentile(values, 50.0);
+    });
+    bench->ComputeStatistics("p90", [](const std::vector<double>& v) {
+        std::vector<double> values(v);
+        return percentile(values, 90.0);
+    });
+    bench->ComputeStatistics("p99", [](const std::vector<double>& v) {
+        std::vector<double> values(v);
+        return percentile(values, 99.0);
+    });
+}
+
+/**
+ * @brief Collects per-operation latencies inside a benchmark
+ *
+ * For benchmarks where one iteration contains several independent
+ * operations (e.g. one generation per track), so the latency distribution
+ * of the operations is reported rather than the iteration time.
+ */
+class LatencyRecorder {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * @brief Record the latency of an operation started at a time point
+     * @param start Start of the operation
+     */
+    void record(Clock::time_point start) {
+        record(start, Clock::now());
+    }
+
+    /**
+     * @brief Record the latency of an operation that already finished
+     * @param start Start of the operation
+     * @param end End of the operation
+     */
+    void record(Clock::time_point start, Clock::time_point end) {
+        m_samples.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    /**
+     * @brief Publish p50/p90/p99/max latency counters in milliseconds
+     * @param state Benchmark state
+     * @param prefix Prefix of the counter names
+     */
+    void report(benchmark::State& state, const std::string& prefix = "") {
+        if (m_samples.empty()) {
+            return;
+        }
+        state.counters[prefix + "p50_ms"] = percentile(m_samples, 50.0);
+        state.counters[prefix + "p90_ms"] = percentile(m_samples, 90.0);
+        state.counters[prefix + "p99_ms"] = percentile(m_samples, 99.0);
+        state.counters[prefix + "max_ms"] = *std::max_element(m_samples.begin(), m_samples.end());
+    }
+
+private:
+    std::vector<double> m_samples;
+};
+
+/**
+ * @brief Create a deterministic test sequence
+ * @param numNotes Number of notes
+ * @param ticksPerQuarter Ticks per quarter note
+ * @return Sequence of sixteenth notes walking up and down a scale
+ */
+inline MidiSequence makeSequence(int numNotes, int ticksPerQuarter = 480) {
+    const int sixteenth = ticksPerQuarter / 4;
+    MidiSequence sequence(ticksPerQuarter, std::max(1, numNotes) * sixteenth);
+    for (int i = 0; i < numNotes; ++i) {
+        const int pitch = 48 + (i * 7) % 24;
+        sequence.notes.emplace_back(pitch, 64 + i % 48, i * sixteenth + (i % 3) * 7, sixteenth - 10);
+    }
+    return sequence;
+}
+
+/**
+ * @brief Create a recurrent step function with a fixed, model-like cost
+ *
+ * Each row computes logits = W * state and state' = tanh(U * state + E[token])
+ * with deterministic weights, standing in for a model when measuring the
+ * decoding and scheduling overhead around it.
+ *
+ * @param vocabSize Number of distinct tokens
+ * @param stateSize Size of the recurrent state
+ * @return Thread-safe step function
+ */
+inline SequenceDecoder::StepFunction makeSyntheticStepFunction(int vocabSize, int stateSize) {
+    auto weights = std::make_shared<std::vector<float>>((vocabSize * 2 + stateSize) * stateSize);
+    for (size_t i = 0; i < weights->size(); ++i) {
+        (*weights)[i] = std::sin(static_cast<float>(i) * 0.37f) * 0.1f;
+    }
+
+    return [weights, vocabSize, stateSize](const std::vector<int>& tokens,
+                                           const std::vector<DecoderStatePtr>& states,
+                                           std::vector<float>& logits,
+                                           std::vector<DecoderStatePtr>& newStates) {
+        const float* output = weights->data();
+        const float* recurrent = output + vocabSize * stateSize;
+        const float* embedding = recurrent + stateSize * stateSize;
+
+        logits.assign(tokens.size() * vocabSize, 0.0f);
+        newStates.resize(tokens.size());
+        for (size_t row = 0; row < tokens.size(); ++row) {
+            const std::vector<float>& state = *states[row];
+            for (int v = 0; v < vocabSize; ++v) {
+                float sum = 0.0f;
+                for (int j = 0; j < stateSize; ++j) {
+                    sum += output[v * stateSize + j] * state[j];
+                }
+                logits[row * vocabSize + v] = sum;
+            }
+
+            auto next = std::make_shared<std::vector<float>>(stateSize);
+            const float* tokenEmbedding = embedding + (tokens[row] % vocabSize) * stateSize;
+            for (int i = 0; i < stateSize; ++i) {
+                float sum = tokenEmbedding[i];
+                for (int j = 0; j < stateSize; ++j) {
+                    sum += recurrent[i * stateSize + j] * state[j];
+                }
+                (*next)[i] = std::tanh(sum);
+            }
+            newStates[row] = std::move(next);
+        }
+        return true;
+    };
+}
+
+} // namespace benchmarks
+} // namespace lmms_magenta
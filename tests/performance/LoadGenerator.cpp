@@ -0,0 +1,481 @@
+// Headless multi-track load generator for sizing AI-heavy projects.
+//
+// Simulates N instrument tracks and M groove effects, each issuing a mix of
+// pattern triggers, regenerations, interpolations, edits and groove
+// applications against the ModelServer at configurable rates. Requests are
+// scheduled open loop (Poisson arrivals per track), so latency is measured
+// from when a request was due, including time spent behind earlier requests
+// of the same track. Reports throughput, latency percentiles, deadline
+// misses, rejected jobs and memory.
+//
+// Example: lmms_magenta_load_generator --tracks=64 --effects=16 --duration=60
+
+#include "model_serving/GrooVAEModel.h"
+#include "model_serving/InferenceThreadPool.h"
+#include "model_serving/MetricsRegistry.h"
+#include "model_serving/ModelServer.h"
+#include "model_serving/MusicVAEModel.h"
+#include "model_serving/QuotaManager.h"
+#include "utils/MidiUtils.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using namespace lmms_magenta;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Operation {
+    Trigger,      // Decode the track's current latent vector
+    Regenerate,   // Sample a new latent vector and decode it
+    Interpolate,  // Interpolate between the current and a new pattern
+    Edit,         // Re-encode an edited pattern and decode it
+    Groove,       // Apply a groove to the track's pattern
+    Extract,      // Extract the groove of the track's pattern
+    Count
+};
+
+const char* const kOperationNames[] = {"trigger", "regenerate", "interpolate", "edit", "groove", "extract"};
+constexpr int kNumOperations = static_cast<int>(Operation::Count);
+
+struct LoadOptions {
+    int numTracks = 16;
+    int numEffects = 8;
+    double durationSeconds = 30.0;
+    double bpm = 120.0;
+    double deadlineMs = 0.0;  // 0: one bar at the tempo
+    int interpolationSteps = 4;
+    int patternNotes = 32;
+    uint32_t seed = 1;
+
+    // Requests per track (or effect) per minute
+    double rates[kNumOperations] = {30.0, 2.0, 1.0, 4.0, 8.0, 1.0};
+
+    // Use synthetic inferences of a fixed cost instead of the models
+    bool isSynthetic = false;
+    double syntheticInferenceMs = 5.0;
+
+    std::string modelsDirectory = "../models";
+    std::string jsonFile;
+};
+
+// Counters and latencies of one operation type
+struct OperationStats {
+    LatencyHistogram latency;
+    std::atomic<uint64_t> completed{0};
+    std::atomic<uint64_t> failed{0};
+    std::atomic<uint64_t> rejected{0};
+    std::atomic<uint64_t> deadlineMisses{0};
+};
+
+// Pattern state of one simulated track
+struct TrackState {
+    std::string clientId;
+    MidiSequence pattern;
+    std::vector<float> latent;
+};
+
+void printUsage() {
+    std::cout <<
+        "Usage: lmms_magenta_load_generator [options]\n"
+        "  --tracks=N              Instrument tracks (MusicVAE), default 16\n"
+        "  --effects=M             Groove effects (GrooVAE), default 8\n"
+        "  --duration=SECONDS      Length of the run, default 30\n"
+        "  --bpm=BPM               Tempo, default 120\n"
+        "  --deadline-ms=MS        Deadline per request, default one bar\n"
+        "  --trigger-rate=R        Triggers per track per minute, default 30\n"
+        "  --regenerate-rate=R     Regenerations per track per minute, default 2\n"
+        "  --interpolate-rate=R    Interpolations per track per minute, default 1\n"
+        "  --edit-rate=R           Edits per track per minute, default 4\n"
+        "  --groove-rate=R         Groove applications per effect per minute, default 8\n"
+        "  --extract-rate=R        Groove extractions per effect per minute, default 1\n"
+        "  --interpolation-steps=N Patterns per interpolation, default 4\n"
+        "  --models-dir=PATH       Models directory, default ../models\n"
+        "  --synthetic[=MS]        Replace each inference by MS ms of work on the\n"
+        "                          inference pool (default 5), no models needed\n"
+        "  --seed=N                Random seed, default 1\n"
+        "  --json=PATH             Also write the results as JSON\n";
+}
+
+bool parseOptions(int argc, char** argv, LoadOptions& options) {
+    for (int i = 1; i < argc; ++i) {
+        const std::string argument = argv[i];
+        const size_t equals = argument.find('=');
+        const std::string name = argument.substr(0, equals);
+        const std::string value = equals == std::string::npos ? "" : argument.substr(equals + 1);
+
+        try {
+            if (name == "--tracks") options.numTracks = std::stoi(value);
+            else if (name == "--effects") options.numEffects = std::stoi(value);
+            else if (name == "--duration") options.durationSeconds = std::stod(value);
+            else if (name == "--bpm") options.bpm = std::stod(value);
+            else if (name == "--deadline-ms") options.deadlineMs = std::stod(value);
+            else if (name == "--trigger-rate") options.rates[static_cast<int>(Operation::Trigger)] = std::stod(value);
+            else if (name == "--regenerate-rate") options.rates[static_cast<int>(Operation::Regenerate)] = std::stod(value);
+            else if (name == "--interpolate-rate") options.rates[static_cast<int>(Operation::Interpolate)] = std::stod(value);
+            else if (name == "--edit-rate") options.rates[static_cast<int>(Operation::Edit)] = std::stod(value);
+            else if (name == "--groove-rate") options.rates[static_cast<int>(Operation::Groove)] = std::stod(value);
+            else if (name == "--extract-rate") options.rates[static_cast<int>(Operation::Extract)] = std::stod(value);
+            else if (name == "--interpolation-steps") options.interpolationSteps = std::stoi(value);
+            else if (name == "--models-dir") options.modelsDirectory = value;
+            else if (name == "--seed") options.seed = static_cast<uint32_t>(std::stoul(value));
+            else if (name == "--json") options.jsonFile = value;
+            else if (name == "--synthetic") {
+                options.isSynthetic = true;
+                if (!value.empty()) {
+                    options.syntheticInferenceMs = std::stod(value);
+                }
+            }
+            else if (name == "--help" || name == "-h") {
+                printUsage();
+                return false;
+            }
+            else {
+                std::cerr << "Unknown option: " << argument << std::endl;
+                printUsage();
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            std::cerr << "Invalid value for " << name << ": " << value << std::endl;
+            return false;
+        }
+    }
+
+    if (options.numTracks < 0 || options.numEffects < 0 || options.numTracks + options.numEffects == 0 ||
+        options.durationSeconds <= 0.0 || options.bpm <= 0.0 || options.interpolationSteps < 1) {
+        std::cerr << "Invalid load configuration" << std::endl;
+        return false;
+    }
+    if (options.deadlineMs <= 0.0) {
+        options.deadlineMs = 4.0 * 60000.0 / options.bpm;
+    }
+    return true;
+}
+
+// One-bar pattern that differs per track and edit
+MidiSequence makePattern(int numNotes, uint32_t variant) {
+    const int ticksPerQuarter = 480;
+    const int step = ticksPerQuarter * 4 / std::max(1, numNotes);
+    MidiSequence sequence(ticksPerQuarter, ticksPerQuarter * 4);
+    for (int i = 0; i < numNotes; ++i) {
+        const int pitch = 48 + static_cast<int>((i * 7 + variant * 5) % 24);
+        sequence.notes.emplace_back(pitch, 64 + (i + static_cast<int>(variant)) % 48, i * step, step - 10);
+    }
+    return sequence;
+}
+
+// Keep an inference thread busy for a fixed time, like one model call
+void runSyntheticInference(double milliseconds) {
+    InferenceThreadPool::getInstance().run(1, [milliseconds]() {
+        const auto end = Clock::now() + std::chrono::duration<double, std::milli>(milliseconds);
+        volatile double sink = 0.0;
+        while (Clock::now() < end) {
+            sink = sink + 1.0;
+        }
+        return 0;
+    });
+}
+
+class LoadGenerator {
+public:
+    explicit LoadGenerator(const LoadOptions& options)
+        : m_options(options) {}
+
+    bool initialize() {
+        if (m_options.isSynthetic) {
+            return true;
+        }
+
+        if (!ModelServer::getInstance().initialize(m_options.modelsDirectory)) {
+            std::cerr << "Failed to initialize ModelServer on " << m_options.modelsDirectory
+                      << " (use --synthetic to run without models)" << std::endl;
+            return false;
+        }
+        if (m_options.numTracks > 0) {
+            m_musicVAE = std::dynamic_pointer_cast<MusicVAEModel>(
+                ModelServer::getInstance().getModel(ModelType::MusicVAE, ""));
+            if (!m_musicVAE) {
+                std::cerr << "MusicVAE model not available" << std::endl;
+                return false;
+            }
+        }
+        if (m_options.numEffects > 0) {
+            m_grooVAE = std::dynamic_pointer_cast<GrooVAEModel>(
+                ModelServer::getInstance().getModel(ModelType::GrooVAE, ""));
+            if (!m_grooVAE) {
+                std::cerr << "GrooVAE model not available" << std::endl;
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void run() {
+        const auto start = Clock::now();
+        const auto end = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(m_options.durationSeconds));
+
+        std::vector<std::thread> clients;
+        for (int track = 0; track < m_options.numTracks; ++track) {
+            clients.emplace_back(&LoadGenerator::runClient, this, "instrument" + std::to_string(track),
+                                 Operation::Trigger, Operation::Groove, m_options.seed * 7919 + track, start, end);
+        }
+        for (int effect = 0; effect < m_options.numEffects; ++effect) {
+            clients.emplace_back(&LoadGenerator::runClient, this, "groove" + std::to_string(effect),
+                                 Operation::Groove, Operation::Count, m_options.seed * 104729 + effect, start, end);
+        }
+        for (auto& client : clients) {
+            client.join();
+        }
+
+        m_elapsedSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    void report(std::ostream& out) const {
+        uint64_t totalCompleted = 0;
+        uint64_t totalMisses = 0;
+        char line[256];
+
+        out << "Load: " << m_options.numTracks << " instrument tracks, " << m_options.numEffects
+            << " groove effects, " << m_options.bpm << " BPM, deadline " << m_options.deadlineMs << " ms"
+            << (m_options.isSynthetic ? ", synthetic inferences" : "") << "\n";
+        std::snprintf(line, sizeof(line), "%-12s %9s %9s %9s %9s %9s %9s %9s %9s %8s\n",
+                      "operation", "done", "ops/s", "p50_ms", "p90_ms", "p99_ms", "p999_ms", "max_ms",
+                      "missed", "rejected");
+        out << line;
+
+        for (int i = 0; i < kNumOperations; ++i) {
+            const OperationStats& stats = m_stats[i];
+            const HistogramSnapshot latency = stats.latency.snapshot();
+            if (latency.count == 0 && stats.rejected == 0 && stats.failed == 0) {
+                continue;
+            }
+            totalCompleted += stats.completed;
+            totalMisses += stats.deadlineMisses;
+            std::snprintf(line, sizeof(line), "%-12s %9llu %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f %9llu %8llu\n",
+                          kOperationNames[i], static_cast<unsigned long long>(stats.completed.load()),
+                          stats.completed / m_elapsedSeconds,
+                          latency.p50 * 1e3, latency.p90 * 1e3, latency.p99 * 1e3, latency.p999 * 1e3,
+                          latency.max * 1e3, static_cast<unsigned long long>(stats.deadlineMisses.load()),
+                          static_cast<unsigned long long>(stats.rejected.load()));
+            out << line;
+        }
+
+        std::snprintf(line, sizeof(line), "Throughput: %.2f requests/s, deadline misses: %llu (%.2f%%)\n",
+                      totalCompleted / m_elapsedSeconds, static_cast<unsigned long long>(totalMisses),
+                      totalCompleted ? 100.0 * totalMisses / totalCompleted : 0.0);
+        out << line;
+        // Where the time went inside the server, per model
+        const MetricsSnapshot metrics = ModelServer::getInstance().metricsSnapshot();
+        for (const auto& histogram : metrics.histograms) {
+            if (histogram.name == MetricsRegistry::kQueueWaitSeconds ||
+                histogram.name == MetricsRegistry::kInferenceSeconds) {
+                std::snprintf(line, sizeof(line), "%s{%s}: p50 %.2f ms, p99 %.2f ms, max %.2f ms\n",
+                              histogram.name.c_str(), histogram.labelValue.c_str(), histogram.values.p50 * 1e3,
+                              histogram.values.p99 * 1e3, histogram.values.max * 1e3);
+                out << line;
+            }
+        }
+
+        out << "Memory: peak RSS " << getPeakResidentBytes() / (1024 * 1024) << " MB, models "
+            << ModelServer::getInstance().getTotalMemoryUsage() / (1024 * 1024) << " MB\n";
+    }
+
+    bool writeJson(const std::string& filePath) const {
+        std::ofstream file(filePath);
+        if (!file) {
+            std::cerr << "Failed to open " << filePath << std::endl;
+            return false;
+        }
+
+        file << "{\n  \"tracks\": " << m_options.numTracks << ",\n  \"effects\": " << m_options.numEffects
+             << ",\n  \"bpm\": " << m_options.bpm << ",\n  \"deadline_ms\": " << m_options.deadlineMs
+             << ",\n  \"synthetic\": " << (m_options.isSynthetic ? "true" : "false")
+             << ",\n  \"elapsed_seconds\": " << m_elapsedSeconds
+             << ",\n  \"peak_rss_bytes\": " << getPeakResidentBytes()
+             << ",\n  \"model_memory_bytes\": " << ModelServer::getInstance().getTotalMemoryUsage()
+             << ",\n  \"operations\": {";
+
+        bool isFirst = true;
+        for (int i = 0; i < kNumOperations; ++i) {
+            const OperationStats& stats = m_stats[i];
+            const HistogramSnapshot latency = stats.latency.snapshot();
+            file << (isFirst ? "\n" : ",\n") << "    \"" << kOperationNames[i] << "\": {"
+                 << "\"completed\": " << stats.completed
+                 << ", \"failed\": " << stats.failed
+                 << ", \"rejected\": " << stats.rejected
+                 << ", \"deadline_misses\": " << stats.deadlineMisses
+                 << ", \"ops_per_second\": " << stats.completed / m_elapsedSeconds
+                 << ", \"p50_ms\": " << latency.p50 * 1e3
+                 << ", \"p90_ms\": " << latency.p90 * 1e3
+                 << ", \"p99_ms\": " << latency.p99 * 1e3
+                 << ", \"p999_ms\": " << latency.p999 * 1e3
+                 << ", \"max_ms\": " << latency.max * 1e3 << "}";
+            isFirst = false;
+        }
+        file << "\n  }\n}\n";
+        return static_cast<bool>(file);
+    }
+
+private:
+    // Issue the operations in [first, last) for one track until the end time
+    void runClient(const std::string& clientId, Operation first, Operation last, uint32_t seed,
+                   Clock::time_point start, Clock::time_point end) {
+        std::mt19937 random(seed);
+
+        double totalRate = 0.0;
+        std::vector<double> weights;
+        for (int i = static_cast<int>(first); i < static_cast<int>(last); ++i) {
+            weights.push_back(m_options.rates[i]);
+            totalRate += m_options.rates[i];
+        }
+        if (totalRate <= 0.0) {
+            return;
+        }
+
+        std::exponential_distribution<double> interval(totalRate / 60.0);
+        std::discrete_distribution<int> choice(weights.begin(), weights.end());
+
+        TrackState track;
+        track.clientId = clientId;
+        track.pattern = makePattern(m_options.patternNotes, seed);
+
+        // Start at a random phase so tracks don't fire in lockstep
+        auto due = start + std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double>(interval(random)));
+        // An overloaded track stops at the end time rather than draining its backlog
+        while (due < end && Clock::now() < end) {
+            std::this_thread::sleep_until(due);
+
+            const Operation operation = static_cast<Operation>(static_cast<int>(first) + choice(random));
+            OperationStats& stats = m_stats[static_cast<int>(operation)];
+
+            ModelJob job = ModelServer::getInstance().beginJob(clientId);
+            if (!job.isAdmitted()) {
+                ++stats.rejected;
+            } else if (execute(operation, track, random)) {
+                const auto latency = Clock::now() - due;
+                stats.latency.record(latency);
+                ++stats.completed;
+                if (std::chrono::duration<double, std::milli>(latency).count() > m_options.deadlineMs) {
+                    ++stats.deadlineMisses;
+                }
+            } else {
+                ++stats.failed;
+            }
+
+            due += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(interval(random)));
+        }
+    }
+
+    bool execute(Operation operation, TrackState& track, std::mt19937& random) {
+        if (m_options.isSynthetic) {
+            // Model calls each operation makes with the real models
+            int inferences = 1;
+            switch (operation) {
+                case Operation::Interpolate: inferences = m_options.interpolationSteps + 2; break;
+                case Operation::Edit: inferences = 2; break;
+                case Operation::Groove: inferences = 2; break;
+                default: break;
+            }
+            for (int i = 0; i < inferences; ++i) {
+                runSyntheticInference(m_options.syntheticInferenceMs);
+            }
+            return true;
+        }
+
+        std::uniform_real_distribution<float> amount(0.0f, 1.0f);
+        switch (operation) {
+            case Operation::Trigger:
+                if (track.latent.empty()) {
+                    track.latent = m_musicVAE->samplePrior();
+                }
+                track.pattern = m_musicVAE->decode(track.latent);
+                return true;
+            case Operation::Regenerate:
+                track.latent = m_musicVAE->samplePrior(0.5f + amount(random));
+                track.pattern = m_musicVAE->decode(track.latent);
+                return true;
+            case Operation::Interpolate: {
+                const MidiSequence target = makePattern(m_options.patternNotes, random());
+                return !m_musicVAE->interpolate(track.pattern, target, m_options.interpolationSteps).empty();
+            }
+            case Operation::Edit: {
+                MidiSequence edited = track.pattern;
+                if (edited.notes.empty()) {
+                    edited = makePattern(m_options.patternNotes, random());
+                }
+                edited.notes[random() % edited.notes.size()].pitch += 1;
+                track.latent = m_musicVAE->encode(edited);
+                track.pattern = m_musicVAE->decode(track.latent);
+                return !track.latent.empty();
+            }
+            case Operation::Groove:
+                track.pattern = m_grooVAE->applyGroove(track.pattern, amount(random), 0.5f * amount(random));
+                return true;
+            case Operation::Extract:
+                return !m_grooVAE->extractGroove(track.pattern).empty();
+            default:
+                return false;
+        }
+    }
+
+    static size_t getPeakResidentBytes() {
+#if defined(__unix__) || defined(__APPLE__)
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0) {
+#ifdef __APPLE__
+            return static_cast<size_t>(usage.ru_maxrss);
+#else
+            return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+        }
+#endif
+        return 0;
+    }
+
+    LoadOptions m_options;
+    std::array<OperationStats, kNumOperations> m_stats;
+    std::shared_ptr<MusicVAEModel> m_musicVAE;
+    std::shared_ptr<GrooVAEModel> m_grooVAE;
+    double m_elapsedSeconds = 0.0;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    LoadOptions options;
+    if (!parseOptions(argc, argv, options)) {
+        return 2;
+    }
+
+    LoadGenerator generator(options);
+    if (!generator.initialize()) {
+        return 1;
+    }
+
+    generator.run();
+    generator.report(std::cout);
+
+    if (!options.jsonFile.empty() && !generator.writeJson(options.jsonFile)) {
+        return 1;
+    }
+    return 0;
+}
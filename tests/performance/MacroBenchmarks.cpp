@@ -0,0 +1,150 @@
+#include "BenchmarkUtils.h"
+#include "model_serving/ModelPrefetcher.h"
+#include "model_serving/MusicVAEModel.h"
+#include "model_serving/QuotaManager.h"
+#include "utils/ThreadPool.h"
+#include <future>
+#include <memory>
+
+using namespace lmms_magenta;
+using namespace lmms_magenta::benchmarks;
+
+namespace {
+
+constexpr int kVocabSize = 130;
+constexpr int kStateSize = 256;
+
+// Run one task per track concurrently and record the latency of each
+template <typename Task>
+void runTracks(ThreadPool& pool, int numTracks, LatencyRecorder& latency, Task task) {
+    std::vector<std::future<LatencyRecorder::Clock::time_point>> tracks;
+    tracks.reserve(numTracks);
+
+    const auto start = LatencyRecorder::Clock::now();
+    for (int track = 0; track < numTracks; ++track) {
+        tracks.push_back(pool.submit([&task, track]() {
+            task(track);
+            return LatencyRecorder::Clock::now();
+        }));
+    }
+    for (auto& future : tracks) {
+        latency.record(start, future.get());
+    }
+}
+
+} // namespace
+
+// Every track of a project generates a pattern at the same time, e.g. when
+// the user regenerates all AI tracks at once. Reports the time until all
+// tracks are done and the per-track latency distribution.
+static void BM_MultiTrackGeneration(benchmark::State& state) {
+    const int numTracks = static_cast<int>(state.range(0));
+    SequenceDecoder decoder(makeSyntheticStepFunction(kVocabSize, kStateSize), kVocabSize);
+    const DecoderStatePtr initialState = std::make_shared<std::vector<float>>(kStateSize, 0.1f);
+
+    QuotaManager quotas;
+    ThreadPool pool(numTracks);
+    LatencyRecorder latency;
+    uint32_t seed = 0;
+
+    for (auto _ : state) {
+        ++seed;
+        runTracks(pool, numTracks, latency, [&](int track) {
+            ModelJob job = quotas.beginJob("track" + std::to_string(track));
+
+            DecodingOptions options;
+            options.strategy = DecodingStrategy::Sampling;
+            options.numCandidates = 4;
+            options.maxSteps = 32;
+            options.topK = 16;
+            options.seed = seed * 131 + track;
+            benchmark::DoNotOptimize(decoder.decode(initialState, options));
+        });
+    }
+
+    latency.report(state);
+    state.SetItemsProcessed(state.iterations() * numTracks);
+}
+BENCHMARK(BM_MultiTrackGeneration)
+    ->RangeMultiplier(2)->Range(1, 16)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond)
+    ->Apply(addPercentiles);
+
+// Every track decodes a pattern with the shared MusicVAE model, so all
+// inferences contend for the shared inference threads.
+static void BM_MultiTrackMusicVAE(benchmark::State& state) {
+    const int numTracks = static_cast<int>(state.range(0));
+    if (!initializeModelServer()) {
+        state.SkipWithError("Models directory not available (set LMMS_MAGENTA_MODELS_DIR)");
+        return;
+    }
+    auto model = std::dynamic_pointer_cast<MusicVAEModel>(
+        ModelServer::getInstance().getModel(ModelType::MusicVAE, ""));
+    if (!model) {
+        state.SkipWithError("MusicVAE model not available");
+        return;
+    }
+
+    const std::vector<float> z = model->encode(makeSequence(32));
+    ThreadPool pool(numTracks);
+    LatencyRecorder latency;
+
+    for (auto _ : state) {
+        runTracks(pool, numTracks, latency, [&](int) {
+            benchmark::DoNotOptimize(model->decode(z));
+        });
+    }
+
+    latency.report(state);
+    state.SetItemsProcessed(state.iterations() * numTracks);
+}
+BENCHMARK(BM_MultiTrackMusicVAE)
+    ->RangeMultiplier(2)->Range(1, 8)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond)
+    ->Apply(addPercentiles);
+
+// Opening a project that uses every available model: all models are
+// prefetched in parallel and warmed up. Reports the time until the project
+// is ready to play.
+static void BM_ProjectOpen(benchmark::State& state) {
+    if (!initializeModelServer()) {
+        state.SkipWithError("Models directory not available (set LMMS_MAGENTA_MODELS_DIR)");
+        return;
+    }
+
+    ModelServer& server = ModelServer::getInstance();
+    std::vector<PrefetchRequest> requests;
+    int64_t firstTick = 0;
+    for (const auto& metadata : server.getAvailableModels()) {
+        requests.push_back({metadata.type, metadata.name, firstTick});
+        firstTick += 192;
+    }
+    if (requests.empty()) {
+        state.SkipWithError("No models available");
+        return;
+    }
+
+    ModelPrefetcher prefetcher(static_cast<size_t>(state.range(0)));
+    size_t numFailed = 0;
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        for (const auto& request : requests) {
+            server.unloadModel(request.type, request.modelName);
+        }
+        state.ResumeTiming();
+
+        prefetcher.prefetch(requests);
+        numFailed = prefetcher.wait();
+    }
+
+    state.counters["models"] = static_cast<double>(requests.size());
+    state.counters["failed"] = static_cast<double>(numFailed);
+}
+BENCHMARK(BM_ProjectOpen)
+    ->Arg(1)->Arg(2)->Arg(4)
+    ->UseRealTime()
+    ->Unit(benchmark::kMillisecond)
+    ->Apply(addPercentiles);
@@ -0,0 +1,213 @@
+#include "BenchmarkUtils.h"
+#include "model_serving/MusicVAEModel.h"
+#include "model_serving/TensorQuantization.h"
+#include <memory>
+#include <random>
+
+using namespace lmms_magenta;
+using namespace lmms_magenta::benchmarks;
+
+namespace {
+
+constexpr int kVocabSize = 130;
+constexpr int kStateSize = 256;
+
+std::vector<float> makeRandomValues(size_t count) {
+    std::mt19937 generator(7);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<float> values(count);
+    for (auto& value : values) {
+        value = distribution(generator);
+    }
+    return values;
+}
+
+// Load the default MusicVAE model, or explain why it is unavailable
+std::shared_ptr<MusicVAEModel> getMusicVAE(benchmark::State& state) {
+    if (!initializeModelServer()) {
+        state.SkipWithError("Models directory not available (set LMMS_MAGENTA_MODELS_DIR)");
+        return nullptr;
+    }
+    auto model = std::dynamic_pointer_cast<MusicVAEModel>(
+        ModelServer::getInstance().getModel(ModelType::MusicVAE, ""));
+    if (!model) {
+        state.SkipWithError("MusicVAE model not available");
+    }
+    return model;
+}
+
+} // namespace
+
+// Tensor conversion
+
+static void BM_SequenceToTensor(benchmark::State& state) {
+    const MidiSequence sequence = makeSequence(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MidiUtils::sequenceToTensor(sequence));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SequenceToTensor)->RangeMultiplier(4)->Range(16, 1024)->Apply(addPercentiles);
+
+static void BM_TensorToSequence(benchmark::State& state) {
+    const MidiSequence sequence = makeSequence(static_cast<int>(state.range(0)));
+    const std::vector<float> tensor = MidiUtils::sequenceToTensor(sequence);
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(
+            MidiUtils::tensorToSequence(tensor, sequence.ticksPerQuarter, sequence.totalTicks));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_TensorToSequence)->RangeMultiplier(4)->Range(16, 1024)->Apply(addPercentiles);
+
+static void BM_QuantizeSequence(benchmark::State& state) {
+    const MidiSequence sequence = makeSequence(static_cast<int>(state.range(0)));
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(MidiUtils::quantizeSequence(sequence, sequence.ticksPerQuarter / 4));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_QuantizeSequence)->RangeMultiplier(4)->Range(16, 1024)->Apply(addPercentiles);
+
+// Tensor quantization
+
+static void BM_QuantizeInt8(benchmark::State& state) {
+    const std::vector<float> input = makeRandomValues(static_cast<size_t>(state.range(0)));
+    std::vector<int8_t> output(input.size());
+    for (auto _ : state) {
+        TensorQuantization::quantize(input.data(), input.size(), 0.0078125f, 0, output.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(sizeof(float)));
+}
+BENCHMARK(BM_QuantizeInt8)->RangeMultiplier(8)->Range(512, 256 << 10)->Apply(addPercentiles);
+
+static void BM_DequantizeInt8(benchmark::State& state) {
+    std::vector<int8_t> input(static_cast<size_t>(state.range(0)));
+    TensorQuantization::quantize(makeRandomValues(input.size()).data(), input.size(), 0.0078125f, 0,
+                                 input.data());
+    std::vector<float> output(input.size());
+    for (auto _ : state) {
+        TensorQuantization::dequantize(input.data(), input.size(), 0.0078125f, 0, output.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(sizeof(float)));
+}
+BENCHMARK(BM_DequantizeInt8)->RangeMultiplier(8)->Range(512, 256 << 10)->Apply(addPercentiles);
+
+static void BM_QuantizeUInt8(benchmark::State& state) {
+    const std::vector<float> input = makeRandomValues(static_cast<size_t>(state.range(0)));
+    std::vector<uint8_t> output(input.size());
+    for (auto _ : state) {
+        TensorQuantization::quantize(input.data(), input.size(), 0.0078125f, 128, output.data());
+        benchmark::ClobberMemory();
+    }
+    state.SetBytesProcessed(state.iterations() * state.range(0) * static_cast<int64_t>(sizeof(float)));
+}
+BENCHMARK(BM_QuantizeUInt8)->RangeMultiplier(8)->Range(512, 256 << 10)->Apply(addPercentiles);
+
+// Sampling and search on a synthetic model
+
+static void BM_SampleCandidates(benchmark::State& state) {
+    SequenceDecoder decoder(makeSyntheticStepFunction(kVocabSize, kStateSize), kVocabSize);
+    const DecoderStatePtr initialState = std::make_shared<std::vector<float>>(kStateSize, 0.1f);
+
+    DecodingOptions options;
+    options.strategy = DecodingStrategy::Sampling;
+    options.numCandidates = static_cast<int>(state.range(0));
+    options.maxSteps = 32;
+    options.topK = 16;
+    options.topP = 0.9f;
+
+    for (auto _ : state) {
+        ++options.seed;
+        benchmark::DoNotOptimize(decoder.decode(initialState, options));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * options.maxSteps);
+}
+BENCHMARK(BM_SampleCandidates)->Arg(1)->Arg(4)->Arg(16)->Unit(benchmark::kMicrosecond)->Apply(addPercentiles);
+
+static void BM_BeamSearch(benchmark::State& state) {
+    SequenceDecoder decoder(makeSyntheticStepFunction(kVocabSize, kStateSize), kVocabSize);
+    const DecoderStatePtr initialState = std::make_shared<std::vector<float>>(kStateSize, 0.1f);
+
+    DecodingOptions options;
+    options.strategy = DecodingStrategy::BeamSearch;
+    options.beamWidth = static_cast<int>(state.range(0));
+    options.maxSteps = 32;
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(decoder.decode(initialState, options));
+    }
+    state.SetItemsProcessed(state.iterations() * state.range(0) * options.maxSteps);
+}
+BENCHMARK(BM_BeamSearch)->Arg(1)->Arg(4)->Arg(8)->Unit(benchmark::kMicrosecond)->Apply(addPercentiles);
+
+// Model inference
+
+static void BM_MusicVAEEncode(benchmark::State& state) {
+    auto model = getMusicVAE(state);
+    if (!model) {
+        return;
+    }
+    const MidiSequence sequence = makeSequence(32);
+    model->encode(sequence);  // Warm up caches and the interpreter arena
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model->encode(sequence));
+    }
+}
+BENCHMARK(BM_MusicVAEEncode)->Unit(benchmark::kMillisecond)->Apply(addPercentiles);
+
+static void BM_MusicVAEDecode(benchmark::State& state) {
+    auto model = getMusicVAE(state);
+    if (!model) {
+        return;
+    }
+    const std::vector<float> z = model->encode(makeSequence(32));
+    model->decode(z);
+
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(model->decode(z));
+    }
+}
+BENCHMARK(BM_MusicVAEDecode)->Unit(benchmark::kMillisecond)->Apply(addPercentiles);
+
+// Model lifecycle
+
+static void BM_ModelLoadUnload(benchmark::State& state) {
+    const ModelType type = static_cast<ModelType>(state.range(0));
+    if (!initializeModelServer()) {
+        state.SkipWithError("Models directory not available (set LMMS_MAGENTA_MODELS_DIR)");
+        return;
+    }
+
+    ModelServer& server = ModelServer::getInstance();
+    server.unloadModel(type, "");
+    if (!server.loadModel(type, "")) {
+        state.SkipWithError("Model not available");
+        return;
+    }
+    server.unloadModel(type, "");
+
+    LatencyRecorder unloadLatency;
+    for (auto _ : state) {
+        if (!server.loadModel(type, "")) {
+            state.SkipWithError("Model failed to load");
+            break;
+        }
+
+        state.PauseTiming();
+        const auto start = LatencyRecorder::Clock::now();
+        server.unloadModel(type, "");
+        unloadLatency.record(start);
+        state.ResumeTiming();
+    }
+
+    unloadLatency.report(state, "unload_");
+}
+BENCHMARK(BM_ModelLoadUnload)
+    ->Arg(static_cast<int>(ModelType::MusicVAE))
+    ->Arg(static_cast<int>(ModelType::MelodyRNN))
+    ->Unit(benchmark::kMillisecond)
+    ->Apply(addPercentiles);
@@ -0,0 +1,128 @@
+#include <gtest/gtest.h>
+#include "tools/BatchJobFile.h"
+#include "tools/BatchGenerator.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+using namespace lmms_magenta;
+
+namespace fs = std::filesystem;
+
+class BatchJobFileTest : public ::testing::Test {
+protected:
+    bool parse(const std::string& contents, std::vector<BatchJob>& jobs) {
+        std::istringstream input(contents);
+        return BatchJobFile::parse(input, "/data", jobs);
+    }
+};
+
+TEST_F(BatchJobFileTest, ParsesEveryJobType) {
+    std::vector<BatchJob> jobs;
+    ASSERT_TRUE(parse(
+        "sample name=bass count=10000 temperature=0.8 model=bass_2bar\n"
+        "interpolate name=morph count=500 input=a.mid target=b.mid steps=4\n"
+        "groove name=drums count=2000 input=beat.mid groove=0.7 swing=0.3\n",
+        jobs));
+    ASSERT_EQ(jobs.size(), 3u);
+
+    EXPECT_EQ(jobs[0].type, BatchJobType::Sample);
+    EXPECT_EQ(jobs[0].name, "bass");
+    EXPECT_EQ(jobs[0].count, 10000u);
+    EXPECT_FLOAT_EQ(jobs[0].temperature, 0.8f);
+    EXPECT_EQ(jobs[0].modelName, "bass_2bar");
+    EXPECT_EQ(jobs[0].lineNumber, 1);
+
+    EXPECT_EQ(jobs[1].type, BatchJobType::Interpolate);
+    EXPECT_EQ(jobs[1].steps, 4);
+
+    EXPECT_EQ(jobs[2].type, BatchJobType::Groove);
+    EXPECT_FLOAT_EQ(jobs[2].grooveAmount, 0.7f);
+    EXPECT_FLOAT_EQ(jobs[2].swingAmount, 0.3f);
+
+    EXPECT_EQ(BatchJobFile::getTotalCount(jobs), 12500u);
+}
+
+TEST_F(BatchJobFileTest, SkipsCommentsAndBlankLines) {
+    std::vector<BatchJob> jobs;
+    ASSERT_TRUE(parse("# dataset\n\n   \nsample count=2\n# done\n", jobs));
+    ASSERT_EQ(jobs.size(), 1u);
+    EXPECT_EQ(jobs[0].lineNumber, 4);
+    EXPECT_EQ(jobs[0].name, "sample0");
+}
+
+TEST_F(BatchJobFileTest, ResolvesRelativePaths) {
+    std::vector<BatchJob> jobs;
+    ASSERT_TRUE(parse("interpolate input=in/a.mid target=/abs/b.mid\n", jobs));
+    ASSERT_EQ(jobs.size(), 1u);
+    EXPECT_EQ(fs::path(jobs[0].inputFile), fs::path("/data") / "in" / "a.mid");
+    EXPECT_EQ(jobs[0].targetFile, "/abs/b.mid");
+}
+
+TEST_F(BatchJobFileTest, RejectsInvalidLines) {
+    const char* invalidLines[] = {
+        "render count=1\n",                       // Unknown type
+        "sample colour=blue\n",                   // Unknown option
+        "sample count=many\n",                    // Bad number
+        "sample count=-1\n",                      // Negative count
+        "sample temperature=0\n",                 // Temperature must be positive
+        "groove count=1\n",                       // Missing input
+        "interpolate input=a.mid\n",              // Missing target
+        "interpolate input=a.mid target=b.mid steps=1\n",
+        "sample name=../bass\n",                 // Name leaves the output directory
+        "sample name=bass/line\n",               // Name with a path separator
+        "sample name=bass..line\n"
+    };
+
+    for (const char* line : invalidLines) {
+        std::vector<BatchJob> jobs;
+        EXPECT_FALSE(parse(line, jobs)) << line;
+        EXPECT_TRUE(jobs.empty()) << line;
+    }
+}
+
+TEST_F(BatchJobFileTest, KeepsValidLinesAroundErrors) {
+    std::vector<BatchJob> jobs;
+    EXPECT_FALSE(parse("sample count=1\nsample count=x\nsample count=3\n", jobs));
+    ASSERT_EQ(jobs.size(), 2u);
+    EXPECT_EQ(BatchJobFile::getTotalCount(jobs), 4u);
+}
+
+TEST_F(BatchJobFileTest, RejectsDuplicateNames) {
+    std::vector<BatchJob> jobs;
+    EXPECT_FALSE(parse("sample name=bass\ngroove name=bass input=a.mid\nsample name=lead\n", jobs));
+    ASSERT_EQ(jobs.size(), 2u);
+    EXPECT_EQ(jobs[0].name, "bass");
+    EXPECT_EQ(jobs[1].name, "lead");
+}
+
+TEST_F(BatchJobFileTest, LoadsFromFile) {
+    const fs::path directory = fs::temp_directory_path() / "lmms_magenta_batch_job_test";
+    fs::create_directories(directory);
+    const fs::path jobFile = directory / "dataset.jobs";
+    {
+        std::ofstream file(jobFile);
+        file << "groove name=drums count=8 input=beat.mid\n";
+    }
+
+    std::vector<BatchJob> jobs;
+    ASSERT_TRUE(BatchJobFile::load(jobFile.string(), jobs));
+    ASSERT_EQ(jobs.size(), 1u);
+    EXPECT_EQ(fs::path(jobs[0].inputFile), directory / "beat.mid");
+
+    EXPECT_FALSE(BatchJobFile::load((directory / "missing.jobs").string(), jobs));
+    fs::remove_all(directory);
+}
+
+TEST_F(BatchJobFileTest, NamesOutputFiles) {
+    BatchJob job;
+    job.name = "bass";
+    EXPECT_EQ(BatchGenerator::getOutputFileName(job, 42), "bass_000042.mid");
+    EXPECT_EQ(BatchGenerator::getOutputFileName(job, 42, 3), "bass_000042_03.mid");
+    EXPECT_EQ(fs::path(BatchGenerator::getShardDirectory("out", 3)), fs::path("out") / "shard-03");
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,82 @@
+#include <gtest/gtest.h>
+#include "core/CoreConfig.h"
+#include <filesystem>
+#include <fstream>
+
+using namespace lmms_magenta;
+
+// Test parsing of Linux CPU lists
+TEST(CoreConfigTest, ParseCpuList) {
+    EXPECT_EQ(CoreConfig::parseCpuList("0-3,8,10-11"), (std::vector<int>{0, 1, 2, 3, 8, 10, 11}));
+    EXPECT_EQ(CoreConfig::parseCpuList("5"), (std::vector<int>{5}));
+    EXPECT_TRUE(CoreConfig::parseCpuList("").empty());
+}
+
+// Test that the audio cores are never selected
+TEST(CoreConfigTest, AvoidsAudioCores) {
+    InferenceThreadingConfig config;
+    config.audioCores = {0, 1};
+
+    EXPECT_EQ(CoreConfig::selectInferenceCores(config, {0, 1, 2, 3}, {}), (std::vector<int>{2, 3}));
+
+    // Limited to the configured thread count
+    config.numThreads = 1;
+    EXPECT_EQ(CoreConfig::selectInferenceCores(config, {0, 1, 2, 3}, {}), (std::vector<int>{2}));
+
+    // A single-core machine shares its core
+    EXPECT_EQ(CoreConfig::selectInferenceCores(config, {0}, {}), (std::vector<int>{0}));
+}
+
+// Test that the cores of one NUMA node are selected
+TEST(CoreConfigTest, NumaPlacement) {
+    InferenceThreadingConfig config;
+    config.audioCores = {0};
+    const std::map<int, std::vector<int>> nodes = {
+        {0, {0, 1, 2, 3}},
+        {1, {4, 5, 6, 7}}
+    };
+    const std::vector<int> online = {0, 1, 2, 3, 4, 5, 6, 7};
+
+    // Node 1 has more free cores
+    EXPECT_EQ(CoreConfig::selectInferenceCores(config, online, nodes), (std::vector<int>{4, 5, 6, 7}));
+
+    config.numaNode = 0;
+    EXPECT_EQ(CoreConfig::selectInferenceCores(config, online, nodes), (std::vector<int>{1, 2, 3}));
+}
+
+// Test that settings survive a save and load
+TEST(CoreConfigTest, SaveAndLoad) {
+    const auto path = std::filesystem::temp_directory_path() / "lmms_magenta_core_config_test.conf";
+
+    CoreConfig& config = CoreConfig::getInstance();
+    const InferenceThreadingConfig original = config.getInferenceThreading();
+
+    InferenceThreadingConfig threading;
+    threading.numThreads = 3;
+    threading.audioCores = {0, 1};
+    threading.pinThreads = true;
+    threading.priority = ThreadPriority::Idle;
+    threading.niceLevel = 12;
+    threading.numaNode = 1;
+    config.setInferenceThreading(threading);
+    ASSERT_TRUE(config.save(path.string()));
+
+    config.setInferenceThreading(InferenceThreadingConfig());
+    ASSERT_TRUE(config.load(path.string()));
+
+    const InferenceThreadingConfig loaded = config.getInferenceThreading();
+    EXPECT_EQ(loaded.numThreads, 3);
+    EXPECT_EQ(loaded.audioCores, (std::vector<int>{0, 1}));
+    EXPECT_TRUE(loaded.pinThreads);
+    EXPECT_EQ(loaded.priority, ThreadPriority::Idle);
+    EXPECT_EQ(loaded.niceLevel, 12);
+    EXPECT_EQ(loaded.numaNode, 1);
+
+    config.setInferenceThreading(original);
+    std::filesystem::remove(path);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
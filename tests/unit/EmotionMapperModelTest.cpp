@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include "model_serving/EmotionMapperModel.h"
+#include <array>
+#include <memory>
+
+using namespace lmms_magenta;
+
+class EmotionLookupTableTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        m_table = std::make_unique<EmotionLookupTable>(
+            5, std::array<EmotionLookupTable::Axis, 3>{{{-1.0f, 1.0f}, {-1.0f, 1.0f}, {0.0f, 1.0f}}});
+    }
+
+    std::unique_ptr<EmotionLookupTable> m_table;
+};
+
+// Test that trilinear interpolation reproduces a linear mapping exactly
+TEST_F(EmotionLookupTableTest, LinearMapping) {
+    size_t evaluatedPoints = 0;
+    ASSERT_TRUE(m_table->build([&](const float* inputs, size_t numPoints, float* outputs) {
+        evaluatedPoints = numPoints;
+        for (size_t i = 0; i < numPoints; ++i) {
+            const float valence = inputs[i * 3];
+            const float arousal = inputs[i * 3 + 1];
+            const float intensity = inputs[i * 3 + 2];
+            outputs[i * 3] = 1.0f + 0.5f * arousal;
+            outputs[i * 3 + 1] = 0.5f + 0.25f * valence + 0.25f * intensity;
+            outputs[i * 3 + 2] = intensity;
+        }
+        return true;
+    }));
+
+    // The whole grid is evaluated in one batch
+    EXPECT_EQ(evaluatedPoints, 125u);
+    EXPECT_TRUE(m_table->isBuilt());
+
+    GenerationParameters parameters = m_table->lookup(0.3f, -0.7f, 0.6f);
+    EXPECT_NEAR(parameters.temperature, 1.0f + 0.5f * -0.7f, 1e-5f);
+    EXPECT_NEAR(parameters.density, 0.5f + 0.25f * 0.3f + 0.25f * 0.6f, 1e-5f);
+    EXPECT_NEAR(parameters.complexity, 0.6f, 1e-5f);
+}
+
+// Test that out-of-range queries are clamped to the grid
+TEST_F(EmotionLookupTableTest, Clamping) {
+    ASSERT_TRUE(m_table->build([](const float* inputs, size_t numPoints, float* outputs) {
+        for (size_t i = 0; i < numPoints; ++i) {
+            outputs[i * 3] = inputs[i * 3];
+            outputs[i * 3 + 1] = inputs[i * 3 + 1];
+            outputs[i * 3 + 2] = inputs[i * 3 + 2];
+        }
+        return true;
+    }));
+
+    GenerationParameters high = m_table->lookup(5.0f, 5.0f, 5.0f);
+    EXPECT_NEAR(high.temperature, 1.0f, 1e-5f);
+    EXPECT_NEAR(high.density, 1.0f, 1e-5f);
+    EXPECT_NEAR(high.complexity, 1.0f, 1e-5f);
+
+    GenerationParameters low = m_table->lookup(-5.0f, -5.0f, -5.0f);
+    EXPECT_NEAR(low.temperature, -1.0f, 1e-5f);
+    EXPECT_NEAR(low.complexity, 0.0f, 1e-5f);
+}
+
+// Test that a failing evaluator leaves the table unbuilt
+TEST_F(EmotionLookupTableTest, FailedBuild) {
+    EXPECT_FALSE(m_table->build([](const float*, size_t, float*) { return false; }));
+    EXPECT_FALSE(m_table->isBuilt());
+    EXPECT_EQ(m_table->getMemoryUsage(), 125u * 3u * sizeof(float));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
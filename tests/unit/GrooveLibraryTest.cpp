@@ -0,0 +1,277 @@
+#include <gtest/gtest.h>
+#include "model_serving/GrooVAEModel.h"
+#include "model_serving/GrooveLibrary.h"
+#include <filesystem>
+#include <fstream>
+#include <random>
+
+using namespace lmms_magenta;
+
+namespace fs = std::filesystem;
+
+namespace {
+
+// Shifts every note by an eighth of the sequence and reports a constant
+// groove, remembering the groove it was asked to apply
+class ShiftingGrooVAEModel : public GrooVAEModel {
+public:
+    explicit ShiftingGrooVAEModel(const std::string& modelPath)
+        : GrooVAEModel(modelPath, ModelMetadata()) {}
+
+    bool isInitialized() const override {
+        return true;
+    }
+
+    std::vector<float> runInference(const std::vector<float>& inputTensor) override {
+        const size_t noteValues = inputTensor.size() - getGrooveDimension();
+        requestedGroove.assign(inputTensor.begin() + noteValues, inputTensor.end());
+        ++numInferences;
+
+        std::vector<float> output = inputTensor;
+        for (size_t i = 2; i < noteValues; i += 5) {
+            output[i] += 0.125f;
+        }
+        std::fill(output.begin() + noteValues, output.end(), 0.5f);
+        return output;
+    }
+
+    std::vector<float> requestedGroove;
+    int numInferences = 0;
+};
+
+} // namespace
+
+class GrooveLibraryTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        m_directory = fs::temp_directory_path() / "lmms_magenta_groove_library_test";
+        fs::create_directories(m_directory);
+        m_filePath = (m_directory / "grooves.lmgroove").string();
+    }
+
+    void TearDown() override {
+        fs::remove_all(m_directory);
+    }
+
+    // Grooves with random embeddings named groove0, groove1, ...
+    static std::vector<GrooveEntry> makeEntries(size_t count, size_t dimension) {
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+
+        std::vector<GrooveEntry> entries(count);
+        for (size_t i = 0; i < count; ++i) {
+            entries[i].name = "groove" + std::to_string(i);
+            entries[i].tags = {i % 2 == 0 ? "even" : "odd"};
+            if (i % 3 == 0) {
+                entries[i].tags.push_back("triplet");
+            }
+            entries[i].embedding.resize(dimension);
+            for (auto& x : entries[i].embedding) {
+                x = value(random);
+            }
+        }
+        return entries;
+    }
+
+    fs::path m_directory;
+    std::string m_filePath;
+};
+
+TEST_F(GrooveLibraryTest, RoundTrip) {
+    const auto entries = makeEntries(100, 32);
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, entries));
+
+    GrooveLibrary library;
+    ASSERT_TRUE(library.open(m_filePath));
+    EXPECT_TRUE(library.isOpen());
+    EXPECT_EQ(library.size(), 100u);
+    EXPECT_EQ(library.getDimension(), 32u);
+
+    for (uint32_t id = 0; id < entries.size(); ++id) {
+        EXPECT_EQ(library.getName(id), entries[id].name);
+        EXPECT_EQ(library.getTags(id), entries[id].tags);
+
+        const float* embedding = library.getEmbedding(id);
+        ASSERT_NE(embedding, nullptr);
+        EXPECT_EQ(std::vector<float>(embedding, embedding + 32), entries[id].embedding);
+    }
+
+    EXPECT_EQ(library.getEmbedding(100), nullptr);
+    EXPECT_EQ(library.getName(100), "");
+}
+
+TEST_F(GrooveLibraryTest, FindsByName) {
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, makeEntries(1000, 4)));
+
+    GrooveLibrary library;
+    ASSERT_TRUE(library.open(m_filePath));
+    EXPECT_EQ(library.findByName("groove0"), 0u);
+    EXPECT_EQ(library.findByName("groove537"), 537u);
+    EXPECT_EQ(library.findByName("groove999"), 999u);
+    EXPECT_EQ(library.findByName("groove1000"), GrooveLibrary::kInvalidId);
+    EXPECT_EQ(library.findByName(""), GrooveLibrary::kInvalidId);
+}
+
+TEST_F(GrooveLibraryTest, FindsByTag) {
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, makeEntries(10, 4)));
+
+    GrooveLibrary library;
+    ASSERT_TRUE(library.open(m_filePath));
+    EXPECT_EQ(library.findByTag("triplet"), (std::vector<uint32_t>{0, 3, 6, 9}));
+    EXPECT_EQ(library.findByTag("odd").size(), 5u);
+    EXPECT_TRUE(library.findByTag("swing").empty());
+}
+
+TEST_F(GrooveLibraryTest, FindsNearestGrooves) {
+    const auto entries = makeEntries(500, 16);
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, entries));
+
+    GrooveLibrary library;
+    ASSERT_TRUE(library.open(m_filePath));
+
+    // A stored groove is its own nearest neighbour
+    const auto self = library.findNearest(entries[123].embedding.data(), 1);
+    ASSERT_EQ(self.size(), 1u);
+    EXPECT_EQ(self[0].id, 123u);
+    EXPECT_EQ(self[0].distance, 0.0f);
+
+    // Compare with a brute-force ranking
+    std::vector<float> query(16, 0.25f);
+    std::vector<std::pair<float, uint32_t>> expected;
+    for (uint32_t id = 0; id < entries.size(); ++id) {
+        float distance = 0.0f;
+        for (size_t i = 0; i < query.size(); ++i) {
+            const float difference = entries[id].embedding[i] - query[i];
+            distance += difference * difference;
+        }
+        expected.emplace_back(distance, id);
+    }
+    std::sort(expected.begin(), expected.end());
+
+    const auto nearest = library.findNearest(query.data(), 10);
+    ASSERT_EQ(nearest.size(), 10u);
+    for (size_t i = 0; i < nearest.size(); ++i) {
+        EXPECT_EQ(nearest[i].id, expected[i].second);
+        EXPECT_FLOAT_EQ(nearest[i].distance, expected[i].first);
+    }
+
+    // Asking for more grooves than stored returns all of them
+    EXPECT_EQ(library.findNearest(query.data(), 1000).size(), 500u);
+}
+
+TEST_F(GrooveLibraryTest, EmptyLibrary) {
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, {}));
+
+    GrooveLibrary library;
+    ASSERT_TRUE(library.open(m_filePath));
+    EXPECT_EQ(library.size(), 0u);
+    EXPECT_EQ(library.findByName("groove0"), GrooveLibrary::kInvalidId);
+
+    const float query[1] = {0.0f};
+    EXPECT_TRUE(library.findNearest(query, 5).empty());
+}
+
+TEST_F(GrooveLibraryTest, RejectsInvalidEntries) {
+    auto entries = makeEntries(3, 4);
+    entries[1].embedding.resize(5);
+    EXPECT_FALSE(GrooveLibrary::write(m_filePath, entries));
+
+    entries = makeEntries(3, 4);
+    entries[2].name = entries[0].name;
+    EXPECT_FALSE(GrooveLibrary::write(m_filePath, entries));
+
+    entries = makeEntries(3, 4);
+    entries[0].tags = {"swing,funk"};
+    EXPECT_FALSE(GrooveLibrary::write(m_filePath, entries));
+
+    EXPECT_FALSE(fs::exists(m_filePath));
+}
+
+TEST_F(GrooveLibraryTest, RejectsInvalidFiles) {
+    GrooveLibrary library;
+    EXPECT_FALSE(library.open((m_directory / "missing.lmgroove").string()));
+
+    // Not a library
+    {
+        std::ofstream file(m_filePath, std::ios::binary);
+        file << std::string(128, 'x');
+    }
+    EXPECT_FALSE(library.open(m_filePath));
+
+    // Truncated library
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, makeEntries(100, 32)));
+    fs::resize_file(m_filePath, fs::file_size(m_filePath) / 2);
+    EXPECT_FALSE(library.open(m_filePath));
+    EXPECT_FALSE(library.isOpen());
+}
+
+TEST_F(GrooveLibraryTest, ReopensAndCloses) {
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, makeEntries(5, 4)));
+
+    GrooveLibrary library;
+    ASSERT_TRUE(library.open(m_filePath));
+    ASSERT_TRUE(library.open(m_filePath));
+    library.prefetch(0, 5);
+    EXPECT_EQ(library.size(), 5u);
+
+    library.close();
+    EXPECT_FALSE(library.isOpen());
+    EXPECT_EQ(library.size(), 0u);
+    EXPECT_EQ(library.getEmbedding(0), nullptr);
+}
+
+TEST_F(GrooveLibraryTest, GrooVAEModelOpensLibraryNextToModel) {
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, makeEntries(3, 4)));
+
+    // The model is created from its path alone, as the model server does
+    GrooVAEModel model((m_directory / "grooves.tflite").string(), ModelMetadata());
+    ASSERT_TRUE(model.getGrooveLibrary().isOpen());
+    EXPECT_EQ(model.getAvailableGrooveStyles(), (std::vector<std::string>{"groove0", "groove1", "groove2"}));
+    EXPECT_EQ(model.getGrooveDimension(), 4u);
+
+    model.setGrooveStyle(2);
+    EXPECT_EQ(model.getGrooveStyle(), 2);
+    model.setGrooveStyle(3);
+    EXPECT_EQ(model.getGrooveStyle(), 2);
+
+    GrooVAEModel withoutLibrary((m_directory / "other.tflite").string(), ModelMetadata());
+    EXPECT_FALSE(withoutLibrary.getGrooveLibrary().isOpen());
+    EXPECT_TRUE(withoutLibrary.getAvailableGrooveStyles().empty());
+}
+
+TEST_F(GrooveLibraryTest, GrooVAEModelAppliesLibraryGroove) {
+    const auto entries = makeEntries(3, 4);
+    ASSERT_TRUE(GrooveLibrary::write(m_filePath, entries));
+
+    ShiftingGrooVAEModel model((m_directory / "grooves.tflite").string());
+    model.setGrooveStyle(1);
+
+    MidiSequence sequence(480, 1920);
+    sequence.notes.emplace_back(36, 100, 0, 120, true);
+    sequence.notes.emplace_back(42, 80, 240, 120, true);
+
+    // The model is asked for the selected library groove
+    const MidiSequence grooved = model.applyGroove(sequence, 1.0f, 0.0f);
+    EXPECT_EQ(model.requestedGroove, entries[1].embedding);
+    ASSERT_EQ(grooved.notes.size(), 2u);
+    EXPECT_NEAR(grooved.notes[0].startTime, 240, 1);
+    EXPECT_NEAR(grooved.notes[1].startTime, 480, 1);
+
+    // Swing alone delays the off-beat eighth by a triplet eighth
+    const MidiSequence swung = model.applyGroove(sequence, 0.0f, 1.0f);
+    EXPECT_EQ(swung.notes[0].startTime, 0);
+    EXPECT_EQ(swung.notes[1].startTime, 320);
+
+    EXPECT_EQ(model.extractGroove(sequence), std::vector<float>(4, 0.5f));
+    EXPECT_EQ(model.requestedGroove, std::vector<float>(4, 0.0f));
+
+    // Grooves of another dimension are rejected without running the model
+    const int numInferences = model.numInferences;
+    EXPECT_EQ(model.applyExtractedGroove(sequence, std::vector<float>(8, 0.1f), 1.0f).notes[1].startTime, 240);
+    EXPECT_EQ(model.numInferences, numInferences);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
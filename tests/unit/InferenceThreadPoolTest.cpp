@@ -0,0 +1,131 @@
+#include <gtest/gtest.h>
+#include "model_serving/InferenceThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace lmms_magenta;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Wait until a number of tasks arrived, or give up after a timeout
+bool waitForArrivals(std::atomic<int>& arrivals, int expected) {
+    const auto deadline = Clock::now() + std::chrono::seconds(2);
+    while (arrivals < expected) {
+        if (Clock::now() > deadline) {
+            return false;
+        }
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+} // namespace
+
+class InferenceThreadPoolTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // Two inference threads, no cores reserved for audio
+        InferenceThreadingConfig config;
+        config.numThreads = 2;
+        config.audioCores.clear();
+        config.priority = ThreadPriority::Normal;
+        InferenceThreadPool::getInstance().configure(config);
+    }
+
+    void TearDown() override {
+        InferenceThreadPool::getInstance().configure(CoreConfig::getInstance().getInferenceThreading());
+    }
+};
+
+// Test that inferences of two models run at the same time
+TEST_F(InferenceThreadPoolTest, ModelsInvokeConcurrently) {
+    InferenceThreadPool& pool = InferenceThreadPool::getInstance();
+
+    // Each task stands for the Invoke of one model and only returns once
+    // the other one has started too
+    std::atomic<int> arrivals(0);
+    std::vector<char> overlapped(2, 0);
+    std::vector<TfLiteExternalContext*> contexts(2, nullptr);
+    std::vector<std::thread> models;
+    for (int model = 0; model < 2; ++model) {
+        models.emplace_back([&, model]() {
+            overlapped[model] = pool.run(0, [&]() {
+                contexts[model] = InferenceThreadPool::getCurrentCpuBackendContext();
+                ++arrivals;
+                return waitForArrivals(arrivals, 2);
+            });
+        });
+    }
+    for (auto& model : models) {
+        model.join();
+    }
+
+    EXPECT_TRUE(overlapped[0]);
+    EXPECT_TRUE(overlapped[1]);
+
+    // Concurrent inferences never share a backend context
+    ASSERT_NE(contexts[0], nullptr);
+    ASSERT_NE(contexts[1], nullptr);
+    EXPECT_NE(contexts[0], contexts[1]);
+}
+
+// Test that the backend context only exists while a task runs
+TEST_F(InferenceThreadPoolTest, ContextBelongsToTask) {
+    InferenceThreadPool& pool = InferenceThreadPool::getInstance();
+    EXPECT_EQ(InferenceThreadPool::getCurrentCpuBackendContext(), nullptr);
+
+    TfLiteExternalContext* context = pool.run(0, []() {
+        return InferenceThreadPool::getCurrentCpuBackendContext();
+    });
+    EXPECT_NE(context, nullptr);
+    EXPECT_EQ(InferenceThreadPool::getCurrentCpuBackendContext(), nullptr);
+}
+
+// Test that a task submitting another task runs it inline with its context
+TEST_F(InferenceThreadPoolTest, NestedTasksRunInline) {
+    InferenceThreadPool& pool = InferenceThreadPool::getInstance();
+
+    const bool isSameContext = pool.run(0, [&pool]() {
+        TfLiteExternalContext* outer = InferenceThreadPool::getCurrentCpuBackendContext();
+        const std::thread::id outerThread = std::this_thread::get_id();
+        return pool.run(0, [outer, outerThread]() {
+            return InferenceThreadPool::getCurrentCpuBackendContext() == outer &&
+                   std::this_thread::get_id() == outerThread;
+        });
+    });
+    EXPECT_TRUE(isSameContext);
+}
+
+// Test that reconfiguring waits for running tasks and keeps the pool usable
+TEST_F(InferenceThreadPoolTest, Reconfigure) {
+    InferenceThreadPool& pool = InferenceThreadPool::getInstance();
+
+    std::atomic<bool> isFinished(false);
+    std::thread model([&]() {
+        pool.run(0, [&isFinished]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            isFinished = true;
+            return 0;
+        });
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+    InferenceThreadingConfig config;
+    config.numThreads = 1;
+    config.audioCores.clear();
+    pool.configure(config);
+    model.join();
+
+    EXPECT_TRUE(isFinished);
+    EXPECT_EQ(pool.getNumThreads(), 1);
+    EXPECT_EQ(pool.run(0, []() { return 42; }), 42);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
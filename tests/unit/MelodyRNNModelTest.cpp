@@ -0,0 +1,196 @@
+#include <gtest/gtest.h>
+#include "model_serving/MelodyRNNModel.h"
+#include <deque>
+#include <memory>
+#include <vector>
+
+using namespace lmms_magenta;
+
+namespace {
+
+// Runs a scripted network: each step emits the next queued event (no event
+// once the queue is empty) and records the batch size of every inference
+class ScriptedMelodyRNNModel : public MelodyRNNModel {
+public:
+    explicit ScriptedMelodyRNNModel(const ModelMetadata& metadata)
+        : MelodyRNNModel("scripted_model.tflite", metadata)
+        , m_rowSize(static_cast<size_t>(getNumEvents()) + 2 * getState().hidden.size()) {}
+
+    bool isInitialized() const override {
+        return true;
+    }
+
+    std::vector<float> runInference(const std::vector<float>& inputTensor) override {
+        const size_t batchSize = inputTensor.size() / m_rowSize;
+        batchSizes.push_back(batchSize);
+
+        int event = kNoEvent;
+        if (!events.empty()) {
+            event = events.front();
+            events.pop_front();
+        }
+
+        // The sampled event wins by a wide margin at any sane temperature
+        std::vector<float> output(inputTensor.size(), 0.0f);
+        for (size_t b = 0; b < batchSize; ++b) {
+            output[b * m_rowSize + event] = 100.0f;
+        }
+        return output;
+    }
+
+    std::deque<int> events;
+    std::vector<size_t> batchSizes;
+
+private:
+    // Called with the model's lock held, so the row size is captured up front
+    size_t m_rowSize;
+};
+
+} // namespace
+
+class MelodyRNNModelTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ModelMetadata metadata;
+        metadata.name = "MelodyRNN";
+        metadata.type = ModelType::MelodyRNN;
+        metadata.memorySize = 0;
+        metadata.isQuantized = false;
+        metadata.supportsGPU = false;
+
+        m_model = std::make_shared<MelodyRNNModel>("non_existent_model.tflite", metadata);
+    }
+
+    std::shared_ptr<MelodyRNNModel> m_model;
+};
+
+// Test the event vocabulary
+TEST_F(MelodyRNNModelTest, EventVocabulary) {
+    EXPECT_EQ(m_model->getNumEvents(), 2 + (MelodyRNNModel::kMaxPitch - MelodyRNNModel::kMinPitch + 1));
+    EXPECT_EQ(m_model->getStepsPerBar(), 16);
+}
+
+// Test that encoding and decoding a melody round-trips
+TEST_F(MelodyRNNModelTest, EventRoundTrip) {
+    MidiSequence melody(480, 1920);
+    melody.notes.emplace_back(60, 100, 0, 480);
+    melody.notes.emplace_back(64, 100, 480, 240);
+    melody.notes.emplace_back(67, 100, 960, 960);
+
+    std::vector<int> events = m_model->sequenceToEvents(melody);
+    ASSERT_EQ(events.size(), 16u);
+    EXPECT_EQ(events[0], 2 + 60 - MelodyRNNModel::kMinPitch);
+    EXPECT_EQ(events[6], MelodyRNNModel::kNoteOff);
+
+    MidiSequence decoded = m_model->eventsToSequence(events, 0, 480);
+    ASSERT_EQ(decoded.notes.size(), melody.notes.size());
+    for (size_t i = 0; i < melody.notes.size(); ++i) {
+        EXPECT_EQ(decoded.notes[i].pitch, melody.notes[i].pitch);
+        EXPECT_EQ(decoded.notes[i].startTime, melody.notes[i].startTime);
+        EXPECT_EQ(decoded.notes[i].duration, melody.notes[i].duration);
+    }
+}
+
+// Test that generation fails cleanly without a loaded model
+TEST_F(MelodyRNNModelTest, UninitializedModel) {
+    MidiSequence primer(480, 1920);
+    primer.notes.emplace_back(60, 100, 0, 480);
+
+    EXPECT_FALSE(m_model->primeWithSequence(primer));
+    EXPECT_TRUE(m_model->continueMelody(16).notes.empty());
+    EXPECT_TRUE(m_model->continueMany(primer, 4, 16).empty());
+    EXPECT_EQ(m_model->getPrimerCacheSize(), 0u);
+}
+
+// Test state capture and restore
+TEST_F(MelodyRNNModelTest, StateRoundTrip) {
+    MelodyRNNState state = m_model->getState();
+    state.pendingEvent = MelodyRNNModel::kNoteOff;
+    state.step = 7;
+
+    EXPECT_TRUE(m_model->setState(state));
+    EXPECT_EQ(m_model->getState().step, 7);
+
+    MelodyRNNState invalid;
+    EXPECT_FALSE(m_model->setState(invalid));
+}
+
+// Test that a continuation only runs the new steps
+TEST_F(MelodyRNNModelTest, ContinuationIsIncremental) {
+    ScriptedMelodyRNNModel model(m_model->getMetadata());
+    MidiSequence primer(480, 1920);
+    primer.notes.emplace_back(60, 100, 0, 480);
+
+    // A 16-step primer feeds all but its last event
+    ASSERT_TRUE(model.primeWithSequence(primer));
+    EXPECT_EQ(model.batchSizes.size(), 15u);
+
+    model.continueMelody(16);
+    EXPECT_EQ(model.batchSizes.size(), 31u);
+    model.continueMelody(16);
+    EXPECT_EQ(model.batchSizes.size(), 47u);
+    EXPECT_EQ(model.getState().step, 47);
+}
+
+// Test that priming with a known melody reuses the cached state
+TEST_F(MelodyRNNModelTest, PrimerCacheHit) {
+    ScriptedMelodyRNNModel model(m_model->getMetadata());
+    MidiSequence primer(480, 1920);
+    primer.notes.emplace_back(60, 100, 0, 480);
+
+    ASSERT_TRUE(model.primeWithSequence(primer));
+    const size_t primingSteps = model.batchSizes.size();
+    EXPECT_EQ(model.getPrimerCacheSize(), 1u);
+
+    ASSERT_TRUE(model.primeWithSequence(primer));
+    EXPECT_EQ(model.batchSizes.size(), primingSteps);
+    EXPECT_EQ(model.getPrimerCacheSize(), 1u);
+
+    model.clearPrimerCache();
+    ASSERT_TRUE(model.primeWithSequence(primer));
+    EXPECT_EQ(model.batchSizes.size(), 2 * primingSteps);
+}
+
+// Test that candidates advance together, one batched inference per step
+TEST_F(MelodyRNNModelTest, ContinueManyBatches) {
+    ScriptedMelodyRNNModel model(m_model->getMetadata());
+    MidiSequence primer(480, 1920);
+    primer.notes.emplace_back(60, 100, 0, 480);
+    ASSERT_TRUE(model.primeWithSequence(primer));
+    model.batchSizes.clear();
+
+    const std::vector<MidiSequence> candidates = model.continueMany(primer, 4, 8);
+    EXPECT_EQ(candidates.size(), 4u);
+    ASSERT_EQ(model.batchSizes.size(), 8u);
+    for (size_t batchSize : model.batchSizes) {
+        EXPECT_EQ(batchSize, 4u);
+    }
+}
+
+// Test that a note held across continuations is returned once, in full
+TEST_F(MelodyRNNModelTest, HeldNoteSpansContinuations) {
+    ScriptedMelodyRNNModel model(m_model->getMetadata());
+    MidiSequence primer(480, 1920);
+    primer.notes.emplace_back(60, 100, 0, 480);
+    ASSERT_TRUE(model.primeWithSequence(primer));
+
+    // Note on at step 17, held through the chunk boundary, off at step 22
+    model.events = {MelodyRNNModel::kNoEvent, 2 + 67 - MelodyRNNModel::kMinPitch, MelodyRNNModel::kNoEvent,
+                    MelodyRNNModel::kNoEvent, MelodyRNNModel::kNoEvent, MelodyRNNModel::kNoEvent,
+                    MelodyRNNModel::kNoteOff};
+
+    EXPECT_TRUE(model.continueMelody(4).notes.empty());
+    EXPECT_EQ(model.getState().heldPitch, 67);
+
+    const MidiSequence second = model.continueMelody(4);
+    ASSERT_EQ(second.notes.size(), 1u);
+    EXPECT_EQ(second.notes[0].pitch, 67);
+    EXPECT_EQ(second.notes[0].startTime, 17 * 120);
+    EXPECT_EQ(second.notes[0].duration, 5 * 120);
+    EXPECT_EQ(model.getState().heldPitch, -1);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
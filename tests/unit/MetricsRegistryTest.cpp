@@ -0,0 +1,150 @@
+#include <gtest/gtest.h>
+#include "model_serving/MetricsRegistry.h"
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace lmms_magenta;
+
+namespace fs = std::filesystem;
+
+// Test that every value falls into a bucket whose bound is within 1/64 of it
+TEST(MetricsRegistryTest, BucketBoundsHaveBoundedError) {
+    for (uint64_t value = 1; value < LatencyHistogram::kMaxValue; value = value * 3 + 1) {
+        const size_t index = LatencyHistogram::getBucketIndex(value);
+        const uint64_t upperBound = LatencyHistogram::getBucketUpperBound(index);
+        EXPECT_GE(upperBound, value);
+        EXPECT_LE(static_cast<double>(upperBound - value), value / 64.0) << value;
+
+        // The previous bucket ends below the value
+        if (index > 0) {
+            EXPECT_LT(LatencyHistogram::getBucketUpperBound(index - 1), value);
+        }
+    }
+}
+
+// Test percentiles of a uniform distribution
+TEST(MetricsRegistryTest, Percentiles) {
+    LatencyHistogram histogram;
+    for (int i = 1; i <= 1000; ++i) {
+        histogram.record(std::chrono::microseconds(i));
+    }
+
+    const HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 1000u);
+    EXPECT_NEAR(snapshot.min, 1e-6, 1e-12);
+    EXPECT_NEAR(snapshot.max, 1e-3, 1e-12);
+    EXPECT_NEAR(snapshot.sum, 500500e-6, 1e-9);
+    EXPECT_NEAR(snapshot.p50, 500e-6, 500e-6 / 64);
+    EXPECT_NEAR(snapshot.p90, 900e-6, 900e-6 / 64);
+    EXPECT_NEAR(snapshot.p99, 990e-6, 990e-6 / 64);
+    EXPECT_LE(snapshot.p999, snapshot.max);
+}
+
+// Test that an empty histogram reports zeros
+TEST(MetricsRegistryTest, EmptyHistogram) {
+    LatencyHistogram histogram;
+    const HistogramSnapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 0u);
+    EXPECT_EQ(snapshot.min, 0.0);
+    EXPECT_EQ(snapshot.p99, 0.0);
+}
+
+// Test that concurrent recording loses no values
+TEST(MetricsRegistryTest, ConcurrentRecording) {
+    MetricsRegistry registry;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&registry, t]() {
+            LatencyHistogram& histogram = registry.getHistogram("latency", "model", "test");
+            MetricCounter& counter = registry.getCounter("events", "model", "test");
+            for (int i = 0; i < 10000; ++i) {
+                histogram.record(static_cast<uint64_t>(t * 10000 + i));
+                counter.increment();
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    const MetricsSnapshot snapshot = registry.snapshot();
+    const HistogramSnapshot* histogram = snapshot.findHistogram("latency", "test");
+    ASSERT_NE(histogram, nullptr);
+    EXPECT_EQ(histogram->count, 40000u);
+    EXPECT_EQ(snapshot.getCounter("events", "test"), 40000u);
+    EXPECT_EQ(snapshot.findHistogram("latency", "other"), nullptr);
+    EXPECT_EQ(snapshot.getCounter("missing"), 0u);
+}
+
+// Test the Prometheus exposition format
+TEST(MetricsRegistryTest, PrometheusFormat) {
+    MetricsRegistry registry;
+    registry.getHistogram("lmms_magenta_inference_seconds", "model", "musicvae/default")
+        .record(std::chrono::milliseconds(2));
+    registry.getCounter("lmms_magenta_model_loads_total", "model", "musicvae/default").increment(3);
+
+    const std::string text = MetricsRegistry::format(registry.snapshot(), MetricsFormat::Prometheus);
+    EXPECT_NE(text.find("# TYPE lmms_magenta_inference_seconds summary\n"), std::string::npos);
+    EXPECT_NE(text.find("lmms_magenta_inference_seconds{model=\"musicvae/default\",quantile=\"0.99\"} "),
+              std::string::npos);
+    EXPECT_NE(text.find("lmms_magenta_inference_seconds_count{model=\"musicvae/default\"} 1\n"),
+              std::string::npos);
+    EXPECT_NE(text.find("# TYPE lmms_magenta_model_loads_total counter\n"), std::string::npos);
+    EXPECT_NE(text.find("lmms_magenta_model_loads_total{model=\"musicvae/default\"} 3\n"), std::string::npos);
+}
+
+// Test that label values are escaped
+TEST(MetricsRegistryTest, EscapesLabelValues) {
+    MetricsRegistry registry;
+    registry.getCounter("events", "plugin", "Track \"1\"").increment();
+
+    const std::string text = MetricsRegistry::format(registry.snapshot(), MetricsFormat::Text);
+    EXPECT_NE(text.find("events{plugin=\"Track \\\"1\\\"\"} 1\n"), std::string::npos);
+}
+
+// Test that writing a file replaces its contents
+TEST(MetricsRegistryTest, WriteFileReplacesContents) {
+    const fs::path path = fs::temp_directory_path() / "lmms_magenta_metrics_test.prom";
+    std::ofstream(path) << "stale contents\n";
+
+    MetricsRegistry registry;
+    registry.getCounter("events").increment();
+    ASSERT_TRUE(MetricsRegistry::writeFile(registry.snapshot(), path.string(), MetricsFormat::Text));
+
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    EXPECT_EQ(contents.str(), "events 1\n");
+    EXPECT_FALSE(fs::exists(path.string() + ".tmp"));
+
+    fs::remove(path);
+}
+
+// Test that the periodic dump writes a final snapshot when stopped
+TEST(MetricsRegistryTest, PeriodicDump) {
+    const fs::path path = fs::temp_directory_path() / "lmms_magenta_metrics_dump_test.txt";
+    fs::remove(path);
+
+    MetricsRegistry registry;
+    MetricCounter& counter = registry.getCounter("events");
+    registry.startPeriodicDump([&registry]() { return registry.snapshot(); }, path.string(),
+                               MetricsFormat::Text, std::chrono::hours(1));
+    counter.increment(5);
+    registry.stopPeriodicDump();
+
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    EXPECT_EQ(contents.str(), "events 5\n");
+
+    fs::remove(path);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+#include "model_serving/ModelEventQueue.h"
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+using namespace lmms_magenta;
+
+class ModelEventQueueTest : public ::testing::Test {
+protected:
+    // Dispatcher that records events, optionally blocking until released
+    ModelEventQueue::Dispatcher recorder() {
+        return [this](const ModelEvent& event) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_released.wait(lock, [this]() { return !m_isBlocked; });
+            m_delivered.push_back(event);
+        };
+    }
+
+    void block() {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_isBlocked = true;
+    }
+
+    void release() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_isBlocked = false;
+        }
+        m_released.notify_all();
+    }
+
+    std::mutex m_mutex;
+    std::condition_variable m_released;
+    bool m_isBlocked = false;
+    std::vector<ModelEvent> m_delivered;
+};
+
+// Test that events are delivered in order
+TEST_F(ModelEventQueueTest, DeliversInOrder) {
+    ModelEventQueue queue(recorder());
+    queue.push(ModelType::MusicVAE, "a", true);
+    queue.push(ModelType::GrooVAE, "b", true);
+    queue.push(ModelType::MelodyRNN, "c", false);
+    queue.flush();
+
+    ASSERT_EQ(m_delivered.size(), 3u);
+    EXPECT_EQ(m_delivered[0].name, "a");
+    EXPECT_EQ(m_delivered[1].name, "b");
+    EXPECT_EQ(m_delivered[2].name, "c");
+    EXPECT_FALSE(m_delivered[2].loaded);
+}
+
+// Test that pending events for the same model collapse to the latest state
+TEST_F(ModelEventQueueTest, CoalescesPendingEvents) {
+    ModelEventQueue queue(recorder());
+
+    // Hold the dispatcher on a first event so the rest stay pending
+    block();
+    queue.push(ModelType::MelodyRNN, "other", true);
+    while (queue.getPendingCount() > 0) {
+        std::this_thread::yield();
+    }
+
+    queue.push(ModelType::MusicVAE, "a", true);
+    queue.push(ModelType::MusicVAE, "a", false);
+    queue.push(ModelType::MusicVAE, "a", true);
+    EXPECT_EQ(queue.getPendingCount(), 1u);
+    EXPECT_EQ(queue.getCoalescedCount(), 2u);
+
+    release();
+    queue.flush();
+
+    ASSERT_EQ(m_delivered.size(), 2u);
+    EXPECT_EQ(m_delivered[1].name, "a");
+    EXPECT_TRUE(m_delivered[1].loaded);
+}
+
+// Test that a full backlog drops the oldest events and never blocks the producer
+TEST_F(ModelEventQueueTest, BoundedBacklog) {
+    ModelEventQueue queue(recorder(), 4);
+
+    block();
+    queue.push(ModelType::MelodyRNN, "first", true);
+    while (queue.getPendingCount() > 0) {
+        std::this_thread::yield();
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < 10; ++i) {
+        queue.push(ModelType::MusicVAE, "model" + std::to_string(i), true);
+    }
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    EXPECT_LT(elapsed, std::chrono::milliseconds(100));
+    EXPECT_EQ(queue.getPendingCount(), 4u);
+    EXPECT_EQ(queue.getDroppedCount(), 6u);
+
+    release();
+    queue.flush();
+
+    ASSERT_EQ(m_delivered.size(), 5u);
+    EXPECT_EQ(m_delivered[1].name, "model6");
+    EXPECT_EQ(m_delivered[4].name, "model9");
+}
+
+// Test that listener exceptions do not stop the dispatcher
+TEST_F(ModelEventQueueTest, ListenerExceptions) {
+    int delivered = 0;
+    ModelEventQueue queue([&delivered](const ModelEvent& event) {
+        ++delivered;
+        if (event.name == "bad") {
+            throw std::runtime_error("listener failed");
+        }
+    });
+
+    queue.push(ModelType::MusicVAE, "bad", true);
+    queue.push(ModelType::MusicVAE, "good", true);
+    queue.flush();
+    EXPECT_EQ(delivered, 2);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
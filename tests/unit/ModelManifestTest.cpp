@@ -0,0 +1,354 @@
+#include <gtest/gtest.h>
+#include "model_serving/ModelManifest.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+using namespace lmms_magenta;
+
+namespace {
+
+/**
+ * Writes a minimal TensorFlow Lite flatbuffer with one subgraph holding an
+ * input tensor [1, 16] and an output tensor [1, 4].
+ */
+class TestModelBuilder {
+public:
+    std::vector<uint8_t> build(bool quantized, const std::vector<uint8_t>& weights = {}) {
+        m_bytes.clear();
+
+        // Header: root offset and file identifier
+        const size_t rootField = u32(0);
+        m_bytes.insert(m_bytes.end(), {'T', 'F', 'L', '3'});
+
+        // Model: version(0), subgraphs(2), description(3), buffers(4)
+        const size_t modelVTable = vtable({4, 0, 8, 12, 16}, 20);
+        const size_t model = table(modelVTable);
+        u32(3);
+        const size_t subgraphsField = u32(0);
+        const size_t descriptionField = u32(0);
+        const size_t buffersField = u32(0);
+        patch(rootField, model);
+
+        // subgraphs vector with one SubGraph
+        patch(subgraphsField, m_bytes.size());
+        u32(1);
+        const size_t subgraphElement = u32(0);
+
+        // SubGraph: tensors(0), inputs(1), outputs(2)
+        const size_t subgraphVTable = vtable({4, 8, 12}, 16);
+        const size_t subgraph = table(subgraphVTable);
+        const size_t tensorsField = u32(0);
+        const size_t inputsField = u32(0);
+        const size_t outputsField = u32(0);
+        patch(subgraphElement, subgraph);
+
+        patch(tensorsField, m_bytes.size());
+        u32(2);
+        const size_t tensor0Element = u32(0);
+        const size_t tensor1Element = u32(0);
+
+        patch(tensor0Element, tensor({1, 16}, quantized));
+        patch(tensor1Element, tensor({1, 4}, false));
+
+        patch(inputsField, m_bytes.size());
+        u32(1);
+        u32(0);
+
+        patch(outputsField, m_bytes.size());
+        u32(1);
+        u32(1);
+
+        patch(descriptionField, m_bytes.size());
+        const std::string description = "test model";
+        u32(static_cast<uint32_t>(description.size()));
+        m_bytes.insert(m_bytes.end(), description.begin(), description.end());
+        m_bytes.push_back(0);
+
+        // buffers vector: the empty sentinel buffer, then the weights
+        patch(buffersField, m_bytes.size());
+        u32(2);
+        const size_t emptyElement = u32(0);
+        const size_t weightsElement = u32(0);
+
+        // Buffer: data(0)
+        const size_t emptyVTable = vtable({}, 4);
+        patch(emptyElement, table(emptyVTable));
+
+        const size_t bufferVTable = vtable({4}, 8);
+        patch(weightsElement, table(bufferVTable));
+        const size_t dataField = u32(0);
+        patch(dataField, m_bytes.size());
+        u32(static_cast<uint32_t>(weights.size()));
+        m_bytes.insert(m_bytes.end(), weights.begin(), weights.end());
+
+        return m_bytes;
+    }
+
+private:
+    std::vector<uint8_t> m_bytes;
+
+    size_t u32(uint32_t value) {
+        const size_t position = m_bytes.size();
+        for (int i = 0; i < 4; ++i) {
+            m_bytes.push_back(static_cast<uint8_t>(value >> (i * 8)));
+        }
+        return position;
+    }
+
+    void u16(uint16_t value) {
+        m_bytes.push_back(static_cast<uint8_t>(value));
+        m_bytes.push_back(static_cast<uint8_t>(value >> 8));
+    }
+
+    // Forward offset from a field to a target
+    void patch(size_t field, size_t target) {
+        const uint32_t offset = static_cast<uint32_t>(target - field);
+        std::memcpy(&m_bytes[field], &offset, 4);
+    }
+
+    size_t vtable(const std::vector<uint16_t>& offsets, uint16_t tableSize) {
+        const size_t position = m_bytes.size();
+        u16(static_cast<uint16_t>(4 + offsets.size() * 2));
+        u16(tableSize);
+        for (uint16_t offset : offsets) {
+            u16(offset);
+        }
+        return position;
+    }
+
+    size_t table(size_t vtablePosition) {
+        const size_t position = m_bytes.size();
+        u32(static_cast<uint32_t>(position - vtablePosition));
+        return position;
+    }
+
+    // Tensor: shape(0), type(1), buffer(2), name(3), quantization(4)
+    size_t tensor(const std::vector<int>& shape, bool quantized) {
+        const size_t tensorVTable = vtable({4, 8, 0, 0, static_cast<uint16_t>(quantized ? 12 : 0)}, 16);
+        const size_t position = table(tensorVTable);
+        const size_t shapeField = u32(0);
+        u32(quantized ? 9 : 0);  // int8 or float32
+        const size_t quantizationField = u32(0);
+
+        patch(shapeField, m_bytes.size());
+        u32(static_cast<uint32_t>(shape.size()));
+        for (int dimension : shape) {
+            u32(static_cast<uint32_t>(dimension));
+        }
+
+        if (quantized) {
+            // QuantizationParameters: scale(2)
+            const size_t quantizationVTable = vtable({0, 0, 4}, 8);
+            const size_t quantization = table(quantizationVTable);
+            const size_t scaleField = u32(0);
+            patch(quantizationField, quantization);
+
+            patch(scaleField, m_bytes.size());
+            u32(1);
+            const float scale = 0.05f;
+            uint32_t bits;
+            std::memcpy(&bits, &scale, 4);
+            u32(bits);
+        }
+
+        return position;
+    }
+};
+
+} // namespace
+
+class ModelManifestTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        m_directory = std::filesystem::temp_directory_path() / "lmms_magenta_manifest_test";
+        std::filesystem::create_directories(m_directory);
+    }
+
+    void TearDown() override {
+        std::filesystem::remove_all(m_directory);
+    }
+
+    std::string writeModel(const std::string& name, bool quantized, const std::vector<uint8_t>& weights = {}) {
+        const std::string path = (m_directory / name).string();
+        const std::vector<uint8_t> bytes = TestModelBuilder().build(quantized, weights);
+        std::ofstream file(path, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        return path;
+    }
+
+    std::filesystem::path m_directory;
+};
+
+// Test parsing a TensorFlow Lite header
+TEST_F(ModelManifestTest, InspectModelFile) {
+    ModelMetadata metadata;
+    ASSERT_TRUE(ModelManifest::inspectModelFile(writeModel("float.tflite", false), metadata));
+
+    EXPECT_EQ(metadata.version, "3");
+    EXPECT_EQ(metadata.description, "test model");
+    ASSERT_EQ(metadata.inputShapes.size(), 1u);
+    EXPECT_EQ(metadata.inputShapes[0], (std::vector<int>{1, 16}));
+    ASSERT_EQ(metadata.outputShapes.size(), 1u);
+    EXPECT_EQ(metadata.outputShapes[0], (std::vector<int>{1, 4}));
+    EXPECT_FALSE(metadata.isQuantized);
+    EXPECT_GT(metadata.memorySize, 0u);
+    EXPECT_NE(metadata.contentHash, 0u);
+}
+
+// Test hashing of constant weight buffers
+TEST_F(ModelManifestTest, WeightBufferHashes) {
+    const std::vector<uint8_t> weights(64, 7);
+
+    ModelMetadata first;
+    ASSERT_TRUE(ModelManifest::inspectModelFile(writeModel("first.tflite", false, weights), first));
+    ASSERT_EQ(first.weightBuffers.size(), 1u);
+    EXPECT_EQ(first.weightBuffers[0].second, 64u);
+
+    // Same weights in a different file hash identically
+    ModelMetadata second;
+    ASSERT_TRUE(ModelManifest::inspectModelFile(writeModel("second.tflite", true, weights), second));
+    ASSERT_EQ(second.weightBuffers.size(), 1u);
+    EXPECT_EQ(second.weightBuffers[0].first, first.weightBuffers[0].first);
+    EXPECT_NE(second.contentHash, first.contentHash);
+
+    ModelMetadata other;
+    ASSERT_TRUE(ModelManifest::inspectModelFile(writeModel("other.tflite", false, std::vector<uint8_t>(64, 8)), other));
+    EXPECT_NE(other.weightBuffers[0].first, first.weightBuffers[0].first);
+}
+
+// Test quantization detection
+TEST_F(ModelManifestTest, QuantizedModel) {
+    ModelMetadata metadata;
+    ASSERT_TRUE(ModelManifest::inspectModelFile(writeModel("int8.tflite", true), metadata));
+    EXPECT_TRUE(metadata.isQuantized);
+    EXPECT_FALSE(metadata.supportsGPU);
+}
+
+// Test that non-model and truncated files are rejected
+TEST_F(ModelManifestTest, InvalidFiles) {
+    const std::string textPath = (m_directory / "notes.tflite").string();
+    std::ofstream(textPath) << "not a model at all";
+
+    ModelMetadata metadata;
+    EXPECT_FALSE(ModelManifest::inspectModelFile(textPath, metadata));
+
+    std::vector<uint8_t> bytes = TestModelBuilder().build(false);
+    bytes.resize(bytes.size() / 2);
+    const std::string truncatedPath = (m_directory / "truncated.tflite").string();
+    std::ofstream(truncatedPath, std::ios::binary)
+        .write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+    EXPECT_FALSE(ModelManifest::inspectModelFile(truncatedPath, metadata));
+
+    EXPECT_FALSE(ModelManifest::inspectModelFile((m_directory / "missing.tflite").string(), metadata));
+}
+
+// Test saving, loading and validating manifest entries
+TEST_F(ModelManifestTest, SaveAndLoad) {
+    ModelManifestEntry entry;
+    entry.relativePath = "musicvae/mel_2bar.tflite";
+    entry.fileSize = 1234;
+    entry.modifiedTime = 5678;
+    entry.metadata.name = "mel_2bar";
+    entry.metadata.type = ModelType::MusicVAE;
+    entry.metadata.version = "3";
+    entry.metadata.memorySize = 1234;
+    entry.metadata.description = "two bar melody";
+    entry.metadata.isQuantized = true;
+    entry.metadata.supportsGPU = false;
+    entry.metadata.contentHash = 0xdeadbeefULL;
+    entry.metadata.inputShapes = {{1, 32, 90}};
+    entry.metadata.outputShapes = {{1, 512}};
+    entry.metadata.weightBuffers = {{0x1234ULL, 4096}, {0xabcdULL, 64}};
+
+    ModelManifest manifest;
+    manifest.update(entry);
+    EXPECT_TRUE(manifest.isDirty());
+
+    const std::string path = (m_directory / ModelManifest::kManifestFileName).string();
+    ASSERT_TRUE(manifest.save(path));
+
+    ModelManifest loaded;
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_FALSE(loaded.isDirty());
+
+    const ModelManifestEntry* found = loaded.find(entry.relativePath, 1234, 5678);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(found->metadata.name, "mel_2bar");
+    EXPECT_EQ(found->metadata.type, ModelType::MusicVAE);
+    EXPECT_EQ(found->metadata.description, "two bar melody");
+    EXPECT_EQ(found->metadata.contentHash, 0xdeadbeefULL);
+    EXPECT_EQ(found->metadata.inputShapes, entry.metadata.inputShapes);
+    EXPECT_EQ(found->metadata.weightBuffers, entry.metadata.weightBuffers);
+    EXPECT_TRUE(found->metadata.isQuantized);
+
+    // A changed size or mtime invalidates the entry
+    EXPECT_EQ(loaded.find(entry.relativePath, 1235, 5678), nullptr);
+    EXPECT_EQ(loaded.find(entry.relativePath, 1234, 5679), nullptr);
+
+    // Deleted files are dropped
+    loaded.retainOnly({});
+    EXPECT_TRUE(loaded.getEntries().empty());
+    EXPECT_TRUE(loaded.isDirty());
+}
+
+// Test that line breaks in text fields do not corrupt the manifest
+TEST_F(ModelManifestTest, EscapesTextFields) {
+    ModelManifestEntry entry;
+    entry.relativePath = "musicvae/odd\nname.tflite";
+    entry.fileSize = 10;
+    entry.modifiedTime = 20;
+    entry.metadata.name = "odd\nname";
+    entry.metadata.version = "1";
+    entry.metadata.description = "first line\nend\nmodel injected\r\\n";
+
+    ModelManifestEntry next;
+    next.relativePath = "musicvae/next.tflite";
+    next.fileSize = 30;
+    next.modifiedTime = 40;
+    next.metadata.name = "next";
+
+    ModelManifest manifest;
+    manifest.update(entry);
+    manifest.update(next);
+
+    const std::string path = (m_directory / ModelManifest::kManifestFileName).string();
+    ASSERT_TRUE(manifest.save(path));
+
+    ModelManifest loaded;
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.getEntries().size(), 2u);
+
+    const ModelManifestEntry* found = loaded.find(entry.relativePath, 10, 20);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(found->metadata.name, entry.metadata.name);
+    EXPECT_EQ(found->metadata.description, entry.metadata.description);
+    EXPECT_NE(loaded.find(next.relativePath, 30, 40), nullptr);
+}
+
+// Test model directory names
+TEST_F(ModelManifestTest, ModelTypeFromDirectory) {
+    ModelType type;
+    ASSERT_TRUE(ModelManifest::modelTypeFromDirectory("MusicVAE", type));
+    EXPECT_EQ(type, ModelType::MusicVAE);
+    ASSERT_TRUE(ModelManifest::modelTypeFromDirectory("melodyrnn", type));
+    EXPECT_EQ(type, ModelType::MelodyRNN);
+    EXPECT_FALSE(ModelManifest::modelTypeFromDirectory("samples", type));
+}
+
+// Test that variants nested below a model directory keep its type
+TEST_F(ModelManifestTest, ModelTypeFromPath) {
+    ModelType type;
+    ASSERT_TRUE(ModelManifest::modelTypeFromPath("musicvae/mel_2bar.tflite", type));
+    EXPECT_EQ(type, ModelType::MusicVAE);
+    ASSERT_TRUE(ModelManifest::modelTypeFromPath("GrooVAE/drums/tap2drum.tflite", type));
+    EXPECT_EQ(type, ModelType::GrooVAE);
+    EXPECT_FALSE(ModelManifest::modelTypeFromPath("samples/musicvae/mel_2bar.tflite", type));
+    EXPECT_FALSE(ModelManifest::modelTypeFromPath("mel_2bar.tflite", type));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "model_serving/ModelPrefetcher.h"
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+
+using namespace lmms_magenta;
+
+namespace {
+
+std::atomic<int> g_warmUpCount(0);
+
+// Model that counts its warm-ups
+class WarmUpModel : public Model {
+public:
+    explicit WarmUpModel(const ModelMetadata& metadata)
+        : m_metadata(metadata), m_isInitialized(false) {}
+
+    bool initialize() override {
+        m_isInitialized = true;
+        return true;
+    }
+
+    bool isInitialized() const override { return m_isInitialized; }
+    ModelMetadata getMetadata() const override { return m_metadata; }
+    size_t getMemoryUsage() const override { return 1000; }
+
+    bool warmUp() override {
+        ++g_warmUpCount;
+        return true;
+    }
+
+private:
+    ModelMetadata m_metadata;
+    bool m_isInitialized;
+};
+
+// Write the smallest valid TensorFlow Lite flatbuffer: an empty Model table
+void writeEmptyModel(const std::filesystem::path& path) {
+    std::filesystem::create_directories(path.parent_path());
+    const uint8_t bytes[] = {
+        12, 0, 0, 0,         // root table offset
+        'T', 'F', 'L', '3',  // file identifier
+        4, 0, 4, 0,          // vtable without fields
+        4, 0, 0, 0           // table pointing back to the vtable
+    };
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+} // namespace
+
+class ModelPrefetcherTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        s_modelsDir = std::filesystem::temp_directory_path() / "lmms_magenta_prefetch_test";
+        writeEmptyModel(s_modelsDir / "musicvae" / "default.tflite");
+        writeEmptyModel(s_modelsDir / "melodyrnn" / "default.tflite");
+        ASSERT_TRUE(ModelServer::getInstance().initialize(s_modelsDir.string()));
+        ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+            return std::make_shared<WarmUpModel>(metadata);
+        });
+    }
+
+    static void TearDownTestSuite() {
+        ModelServer::getInstance().setModelFactory(nullptr);
+        std::filesystem::remove_all(s_modelsDir);
+    }
+
+    void SetUp() override {
+        g_warmUpCount = 0;
+    }
+
+    void TearDown() override {
+        ModelServer::getInstance().unloadModel(ModelType::MusicVAE, "default");
+        ModelServer::getInstance().unloadModel(ModelType::MelodyRNN, "default");
+    }
+
+    static std::filesystem::path s_modelsDir;
+};
+
+std::filesystem::path ModelPrefetcherTest::s_modelsDir;
+
+// Test that requests are merged and sorted by first use
+TEST_F(ModelPrefetcherTest, OrderRequests) {
+    std::vector<PrefetchRequest> ordered = ModelPrefetcher::orderRequests({
+        {ModelType::MusicVAE, "late", 384},
+        {ModelType::MelodyRNN, "first", 0},
+        {ModelType::CycleGAN, "second", 192},
+        {ModelType::MusicVAE, "late", 96},
+        {ModelType::EmotionMapper, "third", 192}
+    });
+
+    ASSERT_EQ(ordered.size(), 4u);
+    EXPECT_EQ(ordered[0].modelName, "first");
+    EXPECT_EQ(ordered[1].modelName, "late");
+    EXPECT_EQ(ordered[1].firstTick, 96);
+    EXPECT_EQ(ordered[2].modelName, "second");
+    EXPECT_EQ(ordered[3].modelName, "third");
+}
+
+// Test that prefetched models are loaded and warmed up
+TEST_F(ModelPrefetcherTest, LoadsAndWarmsUp) {
+    ModelPrefetcher prefetcher(2);
+    EXPECT_EQ(prefetcher.prefetch({
+        {ModelType::MusicVAE, "default", 0},
+        {ModelType::MelodyRNN, "default", 192}
+    }), 2u);
+    EXPECT_EQ(prefetcher.wait(), 0u);
+
+    EXPECT_NE(ModelServer::getInstance().getModel(ModelType::MusicVAE, "default"), nullptr);
+    EXPECT_NE(ModelServer::getInstance().getModel(ModelType::MelodyRNN, "default"), nullptr);
+    EXPECT_EQ(g_warmUpCount.load(), 2);
+    EXPECT_EQ(prefetcher.getPendingCount(), 0u);
+}
+
+// Test that loaded models are not prefetched again
+TEST_F(ModelPrefetcherTest, SkipsLoadedModels) {
+    ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, "default"));
+
+    ModelPrefetcher prefetcher(2);
+    EXPECT_EQ(prefetcher.prefetch({
+        {ModelType::MusicVAE, "default", 0},
+        {ModelType::MelodyRNN, "default", 0}
+    }), 1u);
+    prefetcher.wait();
+    EXPECT_EQ(g_warmUpCount.load(), 1);
+}
+
+// Test that missing models are reported as failures
+TEST_F(ModelPrefetcherTest, ReportsFailures) {
+    ModelPrefetcher prefetcher(1);
+    EXPECT_EQ(prefetcher.prefetch({{ModelType::CycleGAN, "missing", 0}}), 1u);
+    EXPECT_EQ(prefetcher.wait(), 1u);
+    EXPECT_EQ(g_warmUpCount.load(), 0);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
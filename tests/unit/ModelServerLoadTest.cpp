@@ -0,0 +1,353 @@
+#include <gtest/gtest.h>
+#include "model_serving/ModelServer.h"
+#include "model_serving/MetricsRegistry.h"
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace lmms_magenta;
+
+namespace {
+
+// Model that only reports its metadata
+class FakeModel : public Model {
+public:
+    explicit FakeModel(const ModelMetadata& metadata, uint64_t weightKey = 0)
+        : m_metadata(metadata), m_isInitialized(false), m_weightKey(weightKey) {}
+
+    bool initialize() override {
+        m_isInitialized = true;
+        return true;
+    }
+
+    bool isInitialized() const override { return m_isInitialized; }
+    ModelMetadata getMetadata() const override { return m_metadata; }
+    size_t getMemoryUsage() const override { return getMemoryStats().total(); }
+
+    ModelMemoryStats getMemoryStats() const override {
+        ModelMemoryStats stats;
+        stats.sharedWeightBytes = 900;
+        stats.weightBytes = 100;
+        stats.arenaBytes = 20;
+        stats.cacheBytes = 4;
+        stats.weightKey = m_weightKey;
+        return stats;
+    }
+
+private:
+    ModelMetadata m_metadata;
+    bool m_isInitialized;
+    uint64_t m_weightKey;
+};
+
+// Model whose smoke inference fails
+class BrokenModel : public FakeModel {
+public:
+    using FakeModel::FakeModel;
+    bool warmUp() override { return false; }
+};
+
+// Write the smallest valid TensorFlow Lite flatbuffer: an empty Model table
+void writeEmptyModel(const std::filesystem::path& path) {
+    std::filesystem::create_directories(path.parent_path());
+    const uint8_t bytes[] = {
+        12, 0, 0, 0,         // root table offset
+        'T', 'F', 'L', '3',  // file identifier
+        4, 0, 4, 0,          // vtable without fields
+        4, 0, 0, 0           // table pointing back to the vtable
+    };
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+} // namespace
+
+class ModelServerLoadTest : public ::testing::Test {
+protected:
+    static void SetUpTestSuite() {
+        s_modelsDir = std::filesystem::temp_directory_path() / "lmms_magenta_load_test";
+        writeEmptyModel(s_modelsDir / "musicvae" / "default.tflite");
+        writeEmptyModel(s_modelsDir / "melodyrnn" / "default.tflite");
+        ASSERT_TRUE(ModelServer::getInstance().initialize(s_modelsDir.string()));
+    }
+
+    static void TearDownTestSuite() {
+        ModelServer::getInstance().setModelFactory(nullptr);
+        std::filesystem::remove_all(s_modelsDir);
+    }
+
+    void TearDown() override {
+        ModelServer::getInstance().unloadModel(ModelType::MusicVAE, "default");
+        ModelServer::getInstance().unloadModel(ModelType::MelodyRNN, "default");
+    }
+
+    // Run the same load on many threads at once
+    static std::vector<bool> loadConcurrently(ModelType type, int numThreads) {
+        std::vector<char> results(numThreads, 0);
+        std::vector<std::thread> threads;
+        for (int i = 0; i < numThreads; ++i) {
+            threads.emplace_back([&results, type, i]() {
+                results[i] = ModelServer::getInstance().loadModel(type, "default");
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return std::vector<bool>(results.begin(), results.end());
+    }
+
+    static std::filesystem::path s_modelsDir;
+};
+
+std::filesystem::path ModelServerLoadTest::s_modelsDir;
+
+// Test that concurrent requests for one model load it exactly once
+TEST_F(ModelServerLoadTest, ConcurrentLoadsAreCoalesced) {
+    std::atomic<int> factoryCalls(0);
+    ModelServer::getInstance().setModelFactory([&](const ModelMetadata& metadata) {
+        ++factoryCalls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        return std::make_shared<FakeModel>(metadata);
+    });
+
+    for (bool result : loadConcurrently(ModelType::MusicVAE, 20)) {
+        EXPECT_TRUE(result);
+    }
+    EXPECT_EQ(factoryCalls.load(), 1);
+
+    auto model = ModelServer::getInstance().getModel(ModelType::MusicVAE, "default");
+    ASSERT_NE(model, nullptr);
+    EXPECT_TRUE(model->isInitialized());
+    EXPECT_EQ(factoryCalls.load(), 1);
+}
+
+// Test that a failed load is reported to every waiting caller and can be retried
+TEST_F(ModelServerLoadTest, FailurePropagatesToAllCallers) {
+    std::atomic<int> factoryCalls(0);
+    ModelServer::getInstance().setModelFactory([&](const ModelMetadata&) -> std::shared_ptr<Model> {
+        ++factoryCalls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        throw std::runtime_error("corrupt weights");
+    });
+
+    for (bool result : loadConcurrently(ModelType::MelodyRNN, 8)) {
+        EXPECT_FALSE(result);
+    }
+    EXPECT_EQ(factoryCalls.load(), 1);
+    EXPECT_EQ(ModelServer::getInstance().getLoadedModels().size(), 0u);
+
+    // The failed load is not cached
+    ModelServer::getInstance().setModelFactory([&](const ModelMetadata& metadata) {
+        ++factoryCalls;
+        return std::make_shared<FakeModel>(metadata);
+    });
+    EXPECT_TRUE(ModelServer::getInstance().loadModel(ModelType::MelodyRNN, "default"));
+    EXPECT_EQ(factoryCalls.load(), 2);
+}
+
+// Test that slow listeners do not delay loading and unloading
+TEST_F(ModelServerLoadTest, SlowListenersDoNotBlockLoads) {
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<FakeModel>(metadata);
+    });
+
+    std::atomic<int> events(0);
+    std::vector<int> callbackIds;
+    for (int i = 0; i < 10; ++i) {
+        callbackIds.push_back(ModelServer::getInstance().registerModelCallback(
+            [&events](ModelType, const std::string&, bool) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                ++events;
+            }));
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, "default"));
+    EXPECT_TRUE(ModelServer::getInstance().unloadModel(ModelType::MusicVAE, "default"));
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // Delivering both events to every listener takes at least 400 ms
+    EXPECT_LT(elapsed, std::chrono::milliseconds(100));
+
+    ModelServer::getInstance().flushModelEvents();
+    EXPECT_GE(events.load(), 10);
+
+    for (int id : callbackIds) {
+        ModelServer::getInstance().unregisterModelCallback(id);
+    }
+}
+
+// Test the per-model memory breakdown
+TEST_F(ModelServerLoadTest, MemoryBreakdown) {
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<FakeModel>(metadata);
+    });
+
+    ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, "default"));
+    ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MelodyRNN, "default"));
+
+    auto breakdown = ModelServer::getInstance().getMemoryBreakdown();
+    ASSERT_EQ(breakdown.size(), 2u);
+    EXPECT_EQ(breakdown[0].second.sharedWeightBytes, 900u);
+    EXPECT_EQ(breakdown[0].second.weightBytes, 100u);
+    EXPECT_EQ(breakdown[0].second.arenaBytes, 20u);
+    EXPECT_EQ(breakdown[0].second.cacheBytes, 4u);
+    EXPECT_EQ(ModelServer::getInstance().getTotalMemoryUsage(), 2048u);
+}
+
+// Test that weights shared between models are only counted once
+TEST_F(ModelServerLoadTest, SharedWeightsCountedOnce) {
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<FakeModel>(metadata, 42);
+    });
+
+    ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, "default"));
+    ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MelodyRNN, "default"));
+
+    // The mapped file is resident once, each model's private weights are not
+    EXPECT_EQ(ModelServer::getInstance().getTotalMemoryUsage(), 2048u - 900u);
+}
+
+// Test that a handle follows a published update while old users keep their version
+TEST_F(ModelServerLoadTest, HandleFollowsUpdate) {
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<FakeModel>(metadata);
+    });
+
+    ModelHandle handle = ModelServer::getInstance().getModelHandle(ModelType::MusicVAE, "default");
+    ASSERT_TRUE(handle.isValid());
+    std::shared_ptr<Model> oldVersion = handle.get();
+    ASSERT_NE(oldVersion, nullptr);
+    const uint64_t generation = handle.getGeneration();
+
+    const auto newPath = s_modelsDir / "updates" / "musicvae_v2.tflite";
+    writeEmptyModel(newPath);
+    ASSERT_TRUE(ModelServer::getInstance().updateModel(ModelType::MusicVAE, "default", newPath.string()));
+
+    // New requests see the new version, the request in flight keeps the old one
+    std::shared_ptr<Model> newVersion = handle.get();
+    ASSERT_NE(newVersion, nullptr);
+    EXPECT_NE(newVersion, oldVersion);
+    EXPECT_GT(handle.getGeneration(), generation);
+    EXPECT_EQ(newVersion->getMetadata().filePath, newPath.string());
+    EXPECT_TRUE(oldVersion->isInitialized());
+
+    // The old version is freed with its last user
+    std::weak_ptr<Model> released = oldVersion;
+    oldVersion.reset();
+    EXPECT_TRUE(released.expired());
+
+    // Unloading is visible through the handle
+    ASSERT_TRUE(ModelServer::getInstance().unloadModel(ModelType::MusicVAE, "default"));
+    EXPECT_EQ(handle.get(), nullptr);
+}
+
+// Test that a version failing its smoke inference is never published
+TEST_F(ModelServerLoadTest, FailedUpdateKeepsCurrentVersion) {
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<FakeModel>(metadata);
+    });
+
+    ModelHandle handle = ModelServer::getInstance().getModelHandle(ModelType::MelodyRNN, "default");
+    std::shared_ptr<Model> current = handle.get();
+    ASSERT_NE(current, nullptr);
+
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<BrokenModel>(metadata);
+    });
+    EXPECT_FALSE(ModelServer::getInstance().updateModel(ModelType::MelodyRNN, "default"));
+    EXPECT_FALSE(ModelServer::getInstance().updateModel(ModelType::MelodyRNN, "default",
+                                                        (s_modelsDir / "missing.tflite").string()));
+
+    EXPECT_EQ(handle.get(), current);
+    EXPECT_EQ(ModelServer::getInstance().getModel(ModelType::MelodyRNN, "default"), current);
+}
+
+// Test that a load starting while an update is being built gets the new version
+TEST_F(ModelServerLoadTest, LoadDuringUpdateJoinsIt) {
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<FakeModel>(metadata);
+    });
+    ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MelodyRNN, "default"));
+
+    std::atomic<bool> isBuilding(false);
+    ModelServer::getInstance().setModelFactory([&isBuilding](const ModelMetadata& metadata) {
+        isBuilding = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        return std::make_shared<FakeModel>(metadata);
+    });
+
+    const auto newPath = s_modelsDir / "updates" / "melodyrnn_v2.tflite";
+    writeEmptyModel(newPath);
+    std::thread update([&newPath]() {
+        EXPECT_TRUE(ModelServer::getInstance().updateModel(ModelType::MelodyRNN, "default", newPath.string()));
+    });
+    while (!isBuilding) {
+        std::this_thread::yield();
+    }
+
+    // Reloading while the new version is built must not resolve the old file
+    ASSERT_TRUE(ModelServer::getInstance().unloadModel(ModelType::MelodyRNN, "default"));
+    ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MelodyRNN, "default"));
+    update.join();
+
+    auto model = ModelServer::getInstance().getModel(ModelType::MelodyRNN, "default");
+    ASSERT_NE(model, nullptr);
+    EXPECT_EQ(model->getMetadata().filePath, newPath.string());
+}
+
+// Test that updating a model nobody has loaded does not build it
+TEST_F(ModelServerLoadTest, UpdateOfUnloadedModelIsDeferred) {
+    std::atomic<int> factoryCalls(0);
+    ModelServer::getInstance().setModelFactory([&factoryCalls](const ModelMetadata& metadata) {
+        ++factoryCalls;
+        return std::make_shared<FakeModel>(metadata);
+    });
+
+    const auto newPath = s_modelsDir / "updates" / "musicvae_v3.tflite";
+    writeEmptyModel(newPath);
+    ASSERT_TRUE(ModelServer::getInstance().updateModel(ModelType::MusicVAE, "default", newPath.string()));
+    EXPECT_EQ(factoryCalls.load(), 0);
+
+    // The next load picks up the new version
+    auto model = ModelServer::getInstance().getModel(ModelType::MusicVAE, "default");
+    ASSERT_NE(model, nullptr);
+    EXPECT_EQ(model->getMetadata().filePath, newPath.string());
+    EXPECT_EQ(factoryCalls.load(), 1);
+}
+
+// Test that loads, failures and cache lookups are counted per model
+TEST_F(ModelServerLoadTest, CountsLoadsAndCacheLookups) {
+    const std::string label = ModelServer::getModelLabel(ModelType::MusicVAE, "default");
+    EXPECT_EQ(label, "musicvae/default");
+
+    const MetricsSnapshot before = ModelServer::getInstance().metricsSnapshot();
+
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata&) -> std::shared_ptr<Model> {
+        throw std::runtime_error("corrupt weights");
+    });
+    EXPECT_FALSE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, "default"));
+
+    ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+        return std::make_shared<FakeModel>(metadata);
+    });
+    ASSERT_NE(ModelServer::getInstance().getModel(ModelType::MusicVAE, "default"), nullptr);
+    ASSERT_NE(ModelServer::getInstance().getModel(ModelType::MusicVAE, "default"), nullptr);
+
+    const MetricsSnapshot after = ModelServer::getInstance().metricsSnapshot();
+    auto delta = [&](const char* name) {
+        return after.getCounter(name, label) - before.getCounter(name, label);
+    };
+    EXPECT_EQ(delta(MetricsRegistry::kModelLoadFailures), 1u);
+    EXPECT_EQ(delta(MetricsRegistry::kModelLoads), 1u);
+    EXPECT_EQ(delta(MetricsRegistry::kCacheMisses), 1u);
+    EXPECT_EQ(delta(MetricsRegistry::kCacheHits), 1u);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
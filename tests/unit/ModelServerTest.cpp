@@ -1,168 +1,217 @@
 #include <gtest/gtest.h>
 #include "model_serving/ModelServer.h"
 #include <filesystem>
+#include <fstream>
 #include <memory>
+#include <vector>
 
 using namespace lmms_magenta;
 
+namespace {
+
+// Model that only reports its metadata
+class FakeModel : public Model {
+public:
+    explicit FakeModel(const ModelMetadata& metadata)
+        : m_metadata(metadata), m_isInitialized(false) {}
+
+    bool initialize() override {
+        m_isInitialized = true;
+        return true;
+    }
+
+    bool isInitialized() const override { return m_isInitialized; }
+    ModelMetadata getMetadata() const override { return m_metadata; }
+    size_t getMemoryUsage() const override { return getMemoryStats().total(); }
+
+    ModelMemoryStats getMemoryStats() const override {
+        ModelMemoryStats stats;
+        stats.weightBytes = 1024;
+        return stats;
+    }
+
+private:
+    ModelMetadata m_metadata;
+    bool m_isInitialized;
+};
+
+// Write the smallest valid TensorFlow Lite flatbuffer: an empty Model table
+void writeEmptyModel(const std::filesystem::path& path) {
+    std::filesystem::create_directories(path.parent_path());
+    const uint8_t bytes[] = {
+        12, 0, 0, 0,         // root table offset
+        'T', 'F', 'L', '3',  // file identifier
+        4, 0, 4, 0,          // vtable without fields
+        4, 0, 0, 0           // table pointing back to the vtable
+    };
+    std::ofstream(path, std::ios::binary).write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+}
+
+// Memory limit small enough that real models would not fit
+constexpr size_t kMemoryLimit = 1024 * 1024;
+
+} // namespace
+
 class ModelServerTest : public ::testing::Test {
 protected:
-    void SetUp() override {
-        // Create test models directory
-        m_modelsDir = "../test_models";
-        std::filesystem::create_directories(m_modelsDir);
+    // The server is a singleton that can be initialized once per process
+    static void SetUpTestSuite() {
+        s_modelsDir = std::filesystem::temp_directory_path() / "lmms_magenta_server_test";
+        writeEmptyModel(s_modelsDir / "musicvae" / "default.tflite");
+        writeEmptyModel(s_modelsDir / "groovae" / "default.tflite");
+        ModelServer::getInstance().setModelFactory([](const ModelMetadata& metadata) {
+            return std::make_shared<FakeModel>(metadata);
+        });
+        ASSERT_TRUE(ModelServer::getInstance().initialize(s_modelsDir.string(), kMemoryLimit, false));
+    }
+
+    static void TearDownTestSuite() {
+        ModelServer::getInstance().setModelFactory(nullptr);
+        std::filesystem::remove_all(s_modelsDir);
     }
-    
+
     void TearDown() override {
-        // Clean up any loaded models
-        auto loadedModels = ModelServer::getInstance().getLoadedModels();
-        for (const auto& model : loadedModels) {
-            ModelServer::getInstance().unloadModel(model.type, model.name);
+        // Clean up any loaded models, under their names and the default alias
+        for (ModelType type : {ModelType::MusicVAE, ModelType::GrooVAE}) {
+            ModelServer::getInstance().unloadModel(type, "");
+            ModelServer::getInstance().unloadModel(type, "default");
         }
-        
-        // Remove test models directory
-        std::filesystem::remove_all(m_modelsDir);
+        ModelServer::getInstance().flushModelEvents();
     }
-    
-    std::string m_modelsDir;
+
+    static std::filesystem::path s_modelsDir;
 };
 
+std::filesystem::path ModelServerTest::s_modelsDir;
+
 // Test initialization
 TEST_F(ModelServerTest, Initialization) {
-    // Initialize with valid parameters
-    bool success = ModelServer::getInstance().initialize(m_modelsDir, 1024 * 1024 * 1024, false);
-    EXPECT_TRUE(success);
-    
     // Check if models directory exists
-    EXPECT_TRUE(std::filesystem::exists(m_modelsDir));
-    
-    // Check if initialized flag is set
-    EXPECT_TRUE(ModelServer::getInstance().isInitialized());
+    EXPECT_TRUE(std::filesystem::exists(s_modelsDir));
+
+    // Check that the fixture models were found
+    bool hasMusicVAE = false;
+    bool hasGrooVAE = false;
+    for (const auto& metadata : ModelServer::getInstance().getAvailableModels()) {
+        hasMusicVAE |= metadata.type == ModelType::MusicVAE && metadata.name == "default";
+        hasGrooVAE |= metadata.type == ModelType::GrooVAE && metadata.name == "default";
+    }
+    EXPECT_TRUE(hasMusicVAE);
+    EXPECT_TRUE(hasGrooVAE);
+
+    // A second initialization is rejected
+    EXPECT_FALSE(ModelServer::getInstance().initialize(s_modelsDir.string(), kMemoryLimit, false));
 }
 
 // Test model loading
 TEST_F(ModelServerTest, ModelLoading) {
-    // Initialize server
-    ASSERT_TRUE(ModelServer::getInstance().initialize(m_modelsDir, 1024 * 1024 * 1024, false));
-    
     // Load MusicVAE model
     bool success = ModelServer::getInstance().loadModel(ModelType::MusicVAE, "");
     EXPECT_TRUE(success);
-    
+
     // Check if model is loaded
     auto model = ModelServer::getInstance().getModel(ModelType::MusicVAE, "");
-    EXPECT_NE(model, nullptr);
-    
+    ASSERT_NE(model, nullptr);
+
     // Check model type
-    EXPECT_EQ(model->getType(), ModelType::MusicVAE);
+    EXPECT_EQ(model->getMetadata().type, ModelType::MusicVAE);
+    EXPECT_TRUE(model->isInitialized());
 }
 
 // Test model unloading
 TEST_F(ModelServerTest, ModelUnloading) {
-    // Initialize server
-    ASSERT_TRUE(ModelServer::getInstance().initialize(m_modelsDir, 1024 * 1024 * 1024, false));
-    
     // Load model
     ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, ""));
-    
+
     // Unload model
     bool success = ModelServer::getInstance().unloadModel(ModelType::MusicVAE, "");
     EXPECT_TRUE(success);
-    
-    // Check if model is unloaded
-    auto model = ModelServer::getInstance().getModel(ModelType::MusicVAE, "");
-    EXPECT_EQ(model, nullptr);
+
+    // Check if model is unloaded (getModel() would load it again)
+    EXPECT_TRUE(ModelServer::getInstance().getLoadedModels().empty());
+    EXPECT_EQ(ModelServer::getInstance().getTotalMemoryUsage(), 0u);
 }
 
 // Test loading multiple models
 TEST_F(ModelServerTest, MultipleModels) {
-    // Initialize server
-    ASSERT_TRUE(ModelServer::getInstance().initialize(m_modelsDir, 1024 * 1024 * 1024, false));
-    
     // Load MusicVAE model
     ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, ""));
-    
+
     // Load GrooVAE model
     ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::GrooVAE, ""));
-    
+
     // Check if both models are loaded
     auto musicVAEModel = ModelServer::getInstance().getModel(ModelType::MusicVAE, "");
-    EXPECT_NE(musicVAEModel, nullptr);
-    
+    ASSERT_NE(musicVAEModel, nullptr);
+
     auto grooVAEModel = ModelServer::getInstance().getModel(ModelType::GrooVAE, "");
-    EXPECT_NE(grooVAEModel, nullptr);
-    
+    ASSERT_NE(grooVAEModel, nullptr);
+
     // Check model types
-    EXPECT_EQ(musicVAEModel->getType(), ModelType::MusicVAE);
-    EXPECT_EQ(grooVAEModel->getType(), ModelType::GrooVAE);
+    EXPECT_EQ(musicVAEModel->getMetadata().type, ModelType::MusicVAE);
+    EXPECT_EQ(grooVAEModel->getMetadata().type, ModelType::GrooVAE);
+    EXPECT_EQ(ModelServer::getInstance().getLoadedModels().size(), 2u);
 }
 
 // Test memory management
 TEST_F(ModelServerTest, MemoryManagement) {
-    // Initialize server with small memory limit
-    const size_t memoryLimit = 1024 * 1024; // 1MB
-    ASSERT_TRUE(ModelServer::getInstance().initialize(m_modelsDir, memoryLimit, false));
-    
     // Load MusicVAE model
     ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, ""));
-    
+
     // Check memory usage
-    size_t memoryUsage = ModelServer::getInstance().getMemoryUsage();
-    EXPECT_LE(memoryUsage, memoryLimit);
-    
+    size_t memoryUsage = ModelServer::getInstance().getTotalMemoryUsage();
+    EXPECT_GT(memoryUsage, 0u);
+    EXPECT_LE(memoryUsage, kMemoryLimit);
+
     // Load GrooVAE model
     ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::GrooVAE, ""));
-    
+
     // Check memory usage again
-    memoryUsage = ModelServer::getInstance().getMemoryUsage();
-    EXPECT_LE(memoryUsage, memoryLimit);
+    memoryUsage = ModelServer::getInstance().getTotalMemoryUsage();
+    EXPECT_LE(memoryUsage, kMemoryLimit);
 }
 
 // Test model callbacks
 TEST_F(ModelServerTest, ModelCallbacks) {
-    // Initialize server
-    ASSERT_TRUE(ModelServer::getInstance().initialize(m_modelsDir, 1024 * 1024 * 1024, false));
-    
-    bool loadCallbackCalled = false;
-    bool unloadCallbackCalled = false;
-    
-    // Register callbacks
-    ModelServer::getInstance().registerModelCallback(
-        ModelType::MusicVAE,
-        [&loadCallbackCalled](const std::string& name) {
-            loadCallbackCalled = true;
-        },
-        [&unloadCallbackCalled](const std::string& name) {
-            unloadCallbackCalled = true;
-        }
-    );
-    
+    std::vector<std::pair<std::string, bool>> events;
+
+    // Register callback
+    const int callbackId = ModelServer::getInstance().registerModelCallback(
+        [&events](ModelType type, const std::string& name, bool isLoaded) {
+            if (type == ModelType::MusicVAE) {
+                events.emplace_back(name, isLoaded);
+            }
+        });
+
     // Load model
     ASSERT_TRUE(ModelServer::getInstance().loadModel(ModelType::MusicVAE, ""));
-    
+    ModelServer::getInstance().flushModelEvents();
+
     // Check if load callback was called
-    EXPECT_TRUE(loadCallbackCalled);
-    
+    ASSERT_EQ(events.size(), 1u);
+    EXPECT_TRUE(events.back().second);
+
     // Unload model
     ASSERT_TRUE(ModelServer::getInstance().unloadModel(ModelType::MusicVAE, ""));
-    
+    ModelServer::getInstance().flushModelEvents();
+
     // Check if unload callback was called
-    EXPECT_TRUE(unloadCallbackCalled);
+    ASSERT_EQ(events.size(), 2u);
+    EXPECT_FALSE(events.back().second);
+
+    ModelServer::getInstance().unregisterModelCallback(callbackId);
 }
 
 // Test error handling
 TEST_F(ModelServerTest, ErrorHandling) {
-    // Initialize server
-    ASSERT_TRUE(ModelServer::getInstance().initialize(m_modelsDir, 1024 * 1024 * 1024, false));
-    
     // Try to load non-existent model
     bool success = ModelServer::getInstance().loadModel(ModelType::MusicVAE, "non_existent_model");
     EXPECT_FALSE(success);
-    
-    // Try to unload non-existent model
+
+    // Unloading a model that is not loaded is a no-op
     success = ModelServer::getInstance().unloadModel(ModelType::MusicVAE, "non_existent_model");
-    EXPECT_FALSE(success);
-    
+    EXPECT_TRUE(success);
+
     // Try to get non-existent model
     auto model = ModelServer::getInstance().getModel(ModelType::MusicVAE, "non_existent_model");
     EXPECT_EQ(model, nullptr);
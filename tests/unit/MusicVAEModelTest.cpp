@@ -6,163 +6,187 @@
 
 using namespace lmms_magenta;
 
+namespace {
+
+// Echoes each row's z as the encoding and decodes it to one note whose
+// velocity follows z[0], so a test can see what the model was asked for
+class EchoMusicVAEModel : public MusicVAEModel {
+public:
+    EchoMusicVAEModel()
+        : MusicVAEModel("", ModelMetadata()) {}
+
+    bool isInitialized() const override {
+        return true;
+    }
+
+    std::vector<float> runInference(const std::vector<float>& inputTensor) override {
+        const size_t latent = static_cast<size_t>(getLatentDimension());
+        const size_t rowSize = 64 * 5 + latent;
+        ++numInferences;
+        numRows = inputTensor.size() / rowSize;
+
+        std::vector<float> output(inputTensor.size(), 0.0f);
+        for (size_t row = 0; row < numRows; ++row) {
+            const float* input = inputTensor.data() + row * rowSize;
+            float* result = output.data() + row * rowSize;
+            latents.emplace_back(input + rowSize - latent, input + rowSize);
+
+            // Encoding: z[0] is the first note's pitch value
+            result[rowSize - latent] = input[0];
+
+            // Decoding: one note at the start with velocity z[0]
+            result[0] = 60.0f / 127.0f;
+            result[1] = input[rowSize - latent];
+            result[3] = 0.125f;
+        }
+        return output;
+    }
+
+    std::vector<std::vector<float>> latents;
+    size_t numRows = 0;
+    int numInferences = 0;
+};
+
+} // namespace
+
 class MusicVAEModelTest : public ::testing::Test {
 protected:
     void SetUp() override {
         // Create model instance
-        m_model = std::make_shared<MusicVAEModel>();
-        
-        // Create test MIDI notes
-        MidiNote note1;
-        note1.pitch = 60; // C4
-        note1.velocity = 100;
-        note1.startTime = 0.0f;
-        note1.endTime = 0.5f;
-        
-        MidiNote note2;
-        note2.pitch = 64; // E4
-        note2.velocity = 80;
-        note2.startTime = 0.5f;
-        note2.endTime = 1.0f;
-        
-        MidiNote note3;
-        note3.pitch = 67; // G4
-        note3.velocity = 90;
-        note3.startTime = 1.0f;
-        note3.endTime = 1.5f;
-        
-        m_testNotes.push_back(note1);
-        m_testNotes.push_back(note2);
-        m_testNotes.push_back(note3);
+        m_model = std::make_shared<MusicVAEModel>("", ModelMetadata());
+
+        // Create test MIDI sequence (C4, E4, G4)
+        m_testSequence = MidiSequence(480, 1920);
+        m_testSequence.notes.emplace_back(60, 100, 0, 240);
+        m_testSequence.notes.emplace_back(64, 80, 240, 240);
+        m_testSequence.notes.emplace_back(67, 90, 480, 240);
     }
-    
+
     std::shared_ptr<MusicVAEModel> m_model;
-    std::vector<MidiNote> m_testNotes;
+    MidiSequence m_testSequence;
 };
 
 // Test model initialization
 TEST_F(MusicVAEModelTest, Initialization) {
-    // Check model type
-    EXPECT_EQ(m_model->getType(), ModelType::MusicVAE);
-    
     // Check initial state
-    EXPECT_FALSE(m_model->isLoaded());
-    EXPECT_EQ(m_model->getTemperature(), 1.0f);
+    EXPECT_FALSE(m_model->isInitialized());
+    EXPECT_EQ(m_model->getLatentDimension(), 256);
+    EXPECT_GT(m_model->getMaxSequenceLength(), 0);
 }
 
 // Test model loading
 TEST_F(MusicVAEModelTest, ModelLoading) {
-    // Load model
-    bool success = m_model->load("");
-    
     // Since we don't have actual model files in the test,
     // this should return false
-    EXPECT_FALSE(success);
-    EXPECT_FALSE(m_model->isLoaded());
+    EXPECT_FALSE(m_model->initialize());
+    EXPECT_FALSE(m_model->isInitialized());
 }
 
 // Test pattern encoding
 TEST_F(MusicVAEModelTest, PatternEncoding) {
-    // Try to encode pattern
-    std::vector<float> latentVector;
-    bool success = m_model->encode(m_testNotes, latentVector);
-    
     // Since the model is not loaded, this should fail
-    EXPECT_FALSE(success);
-    EXPECT_TRUE(latentVector.empty());
+    EXPECT_TRUE(m_model->encode(m_testSequence).empty());
 }
 
 // Test pattern decoding
 TEST_F(MusicVAEModelTest, PatternDecoding) {
-    // Create a test latent vector
-    std::vector<float> latentVector(256, 0.0f);
-    
-    // Try to decode pattern
-    std::vector<MidiNote> decodedNotes;
-    bool success = m_model->decode(latentVector, decodedNotes);
-    
     // Since the model is not loaded, this should fail
-    EXPECT_FALSE(success);
-    EXPECT_TRUE(decodedNotes.empty());
+    std::vector<float> latentVector(256, 0.0f);
+    EXPECT_TRUE(m_model->decode(latentVector).notes.empty());
 }
 
 // Test pattern sampling
 TEST_F(MusicVAEModelTest, PatternSampling) {
-    // Try to sample pattern
-    std::vector<MidiNote> sampledNotes;
-    bool success = m_model->sample(sampledNotes);
-    
-    // Since the model is not loaded, this should fail
-    EXPECT_FALSE(success);
-    EXPECT_TRUE(sampledNotes.empty());
+    // The prior is sampled without the model
+    EXPECT_EQ(m_model->samplePrior().size(), 256u);
+
+    // Since the model is not loaded, decoding should fail
+    EXPECT_TRUE(m_model->sampleBatch(4).empty());
 }
 
 // Test pattern interpolation
 TEST_F(MusicVAEModelTest, PatternInterpolation) {
-    // Create two test patterns
-    std::vector<MidiNote> pattern1 = m_testNotes;
-    std::vector<MidiNote> pattern2 = m_testNotes;
-    
-    // Modify pattern2 to be different
-    for (auto& note : pattern2) {
+    // Modify the second pattern to be different
+    MidiSequence sequence2 = m_testSequence;
+    for (auto& note : sequence2.notes) {
         note.pitch += 12; // Up one octave
     }
-    
-    // Try to interpolate between patterns
-    std::vector<std::vector<MidiNote>> interpolatedPatterns;
-    bool success = m_model->interpolate(pattern1, pattern2, 5, interpolatedPatterns);
-    
+
     // Since the model is not loaded, this should fail
-    EXPECT_FALSE(success);
-    EXPECT_TRUE(interpolatedPatterns.empty());
+    EXPECT_TRUE(m_model->interpolate(m_testSequence, sequence2, 5).empty());
 }
 
 // Test temperature parameter
 TEST_F(MusicVAEModelTest, TemperatureParameter) {
-    // Set temperature
-    float temperature = 0.5f;
-    m_model->setTemperature(temperature);
-    
-    // Check temperature
-    EXPECT_FLOAT_EQ(m_model->getTemperature(), temperature);
-    
-    // Test invalid temperature values
-    m_model->setTemperature(-1.0f);
-    EXPECT_FLOAT_EQ(m_model->getTemperature(), 0.0f);
-    
-    m_model->setTemperature(2.0f);
-    EXPECT_FLOAT_EQ(m_model->getTemperature(), 1.0f);
+    EchoMusicVAEModel model;
+    std::vector<float> z(256, 0.0f);
+    z[0] = 0.25f;
+
+    // Decoding scales the latent vector by the temperature
+    const MidiSequence sequence = model.decode(z, 2.0f);
+    ASSERT_EQ(model.latents.size(), 1u);
+    EXPECT_FLOAT_EQ(model.latents[0][0], 0.5f);
+    ASSERT_EQ(sequence.notes.size(), 1u);
+    EXPECT_EQ(sequence.notes[0].pitch, 60);
+
+    // A batch is scaled once, not at sampling and again at decoding
+    model.latents.clear();
+    std::vector<MidiSequence> sequences = model.sampleBatch(512, 0.0f);
+    EXPECT_EQ(sequences.size(), 512u);
+    EXPECT_EQ(model.numRows, 512u);
+    for (const auto& latent : model.latents) {
+        EXPECT_FLOAT_EQ(latent[0], 0.0f);
+    }
+
+    model.latents.clear();
+    sequences = model.sampleBatch(512, 0.5f);
+    float sumOfSquares = 0.0f;
+    for (const auto& latent : model.latents) {
+        sumOfSquares += latent[0] * latent[0];
+    }
+    EXPECT_NEAR(sumOfSquares / model.latents.size(), 0.25f, 0.08f);
 }
 
 // Test error handling
 TEST_F(MusicVAEModelTest, ErrorHandling) {
-    // Try to load non-existent model
-    bool success = m_model->load("non_existent_model");
-    EXPECT_FALSE(success);
-    
-    // Try operations with unloaded model
-    std::vector<float> latentVector;
-    EXPECT_FALSE(m_model->encode(m_testNotes, latentVector));
-    
-    std::vector<MidiNote> decodedNotes;
-    EXPECT_FALSE(m_model->decode(latentVector, decodedNotes));
-    
-    std::vector<MidiNote> sampledNotes;
-    EXPECT_FALSE(m_model->sample(sampledNotes));
-    
-    std::vector<std::vector<MidiNote>> interpolatedPatterns;
-    EXPECT_FALSE(m_model->interpolate(m_testNotes, m_testNotes, 5, interpolatedPatterns));
+    EchoMusicVAEModel model;
+
+    // Latent vectors of the wrong size are rejected before inference
+    EXPECT_TRUE(model.decode(std::vector<float>(3, 0.0f)).notes.empty());
+    EXPECT_TRUE(model.decodeBatch({std::vector<float>(256, 0.0f), std::vector<float>(3, 0.0f)}).empty());
+    EXPECT_EQ(model.numInferences, 0);
+}
+
+// Test interpolation with a working model
+TEST_F(MusicVAEModelTest, InterpolationDecodesOneBatch) {
+    EchoMusicVAEModel model;
+    MidiSequence sequence2 = m_testSequence;
+    sequence2.notes[0].pitch = 72;
+
+    const std::vector<MidiSequence> sequences = model.interpolate(m_testSequence, sequence2, 5);
+    ASSERT_EQ(sequences.size(), 5u);
+
+    // Two encodings and one decoding of all steps
+    EXPECT_EQ(model.numInferences, 3);
+    EXPECT_EQ(model.numRows, 5u);
+
+    // The steps move linearly from the first encoding to the second
+    const float first = 60.0f / 127.0f;
+    const float last = 72.0f / 127.0f;
+    for (size_t step = 0; step < 5; ++step) {
+        const float t = step / 4.0f;
+        EXPECT_NEAR(model.latents[2 + step][0], first + t * (last - first), 1e-5f);
+    }
 }
 
 // Test model metadata
 TEST_F(MusicVAEModelTest, ModelMetadata) {
     // Get model metadata
     ModelMetadata metadata = m_model->getMetadata();
-    
+
     // Check metadata values
-    EXPECT_EQ(metadata.type, ModelType::MusicVAE);
     EXPECT_TRUE(metadata.name.empty());
-    EXPECT_EQ(metadata.memoryUsage, 0);
+    EXPECT_EQ(m_model->getMemoryUsage(), 0u);
 }
 
 int main(int argc, char** argv) {
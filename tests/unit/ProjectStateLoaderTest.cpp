@@ -0,0 +1,130 @@
+#include <gtest/gtest.h>
+#include "plugins/ProjectStateLoader.h"
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace lmms_magenta;
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Stand-ins for the plugins that own deferred settings
+int g_tracks[8];
+
+} // namespace
+
+TEST(ProjectStateLoaderTest, MaterializesOwnersInParallel) {
+    ProjectStateLoader loader(4);
+    const auto delay = std::chrono::milliseconds(100);
+
+    const auto start = Clock::now();
+    std::atomic<int> numMaterialized(0);
+    for (int i = 0; i < 4; ++i) {
+        loader.defer(&g_tracks[i], [&numMaterialized, delay]() {
+            std::this_thread::sleep_for(delay);
+            ++numMaterialized;
+            return true;
+        });
+    }
+
+    // Deferring returns at once; the join waits for the slowest owner
+    EXPECT_LT(Clock::now() - start, delay);
+    EXPECT_EQ(loader.waitForAll(), 0u);
+    EXPECT_EQ(numMaterialized, 4);
+    EXPECT_LT(Clock::now() - start, 3 * delay);
+    EXPECT_EQ(loader.getPendingCount(), 0u);
+}
+
+TEST(ProjectStateLoaderTest, RunsTasksOfAnOwnerInOrder) {
+    ProjectStateLoader loader(4);
+    std::vector<int> order;
+
+    for (int i = 0; i < 5; ++i) {
+        loader.defer(&g_tracks[0], [&order, i]() {
+            // Later tasks must still wait for this one
+            std::this_thread::sleep_for(std::chrono::milliseconds(5 - i));
+            order.push_back(i);
+            return true;
+        });
+    }
+
+    EXPECT_TRUE(loader.wait(&g_tracks[0]));
+    EXPECT_EQ(order, (std::vector<int>{0, 1, 2, 3, 4}));
+    EXPECT_FALSE(loader.isPending(&g_tracks[0]));
+}
+
+TEST(ProjectStateLoaderTest, WaitsForOneOwner) {
+    ProjectStateLoader loader(2);
+    std::atomic<bool> isReleased(false);
+    std::atomic<bool> isMaterialized(false);
+
+    loader.defer(&g_tracks[0], [&isReleased]() {
+        while (!isReleased) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return true;
+    });
+    loader.defer(&g_tracks[1], [&isMaterialized]() {
+        isMaterialized = true;
+        return true;
+    });
+
+    // The second owner does not wait for the first
+    EXPECT_TRUE(loader.wait(&g_tracks[1]));
+    EXPECT_TRUE(isMaterialized);
+    EXPECT_TRUE(loader.isPending(&g_tracks[0]));
+
+    isReleased = true;
+    EXPECT_TRUE(loader.wait(&g_tracks[0]));
+}
+
+TEST(ProjectStateLoaderTest, ReportsFailures) {
+    ProjectStateLoader loader(2);
+
+    loader.defer(&g_tracks[0], []() { return false; });
+    loader.defer(&g_tracks[1], []() -> bool { throw std::runtime_error("corrupt state"); });
+    loader.defer(&g_tracks[2], []() { return true; });
+
+    EXPECT_EQ(loader.waitForAll(), 2u);
+    EXPECT_EQ(loader.getPendingCount(), 0u);
+}
+
+TEST(ProjectStateLoaderTest, FailureCarriesOverToLaterTasksOfTheOwner) {
+    ProjectStateLoader loader(2);
+
+    loader.defer(&g_tracks[0], []() { return false; });
+    loader.defer(&g_tracks[0], []() { return true; });
+    EXPECT_FALSE(loader.wait(&g_tracks[0]));
+
+    // Waiting releases the owner, so its next load starts clean
+    loader.defer(&g_tracks[0], []() { return true; });
+    EXPECT_TRUE(loader.wait(&g_tracks[0]));
+}
+
+TEST(ProjectStateLoaderTest, WaitWithoutTasksSucceeds) {
+    ProjectStateLoader loader(1);
+    EXPECT_TRUE(loader.wait(&g_tracks[0]));
+    EXPECT_EQ(loader.waitForAll(), 0u);
+}
+
+TEST(ProjectStateLoaderTest, DestructorWaitsForTasks) {
+    std::atomic<bool> isMaterialized(false);
+    {
+        ProjectStateLoader loader(1);
+        loader.defer(&g_tracks[0], [&isMaterialized]() {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            isMaterialized = true;
+            return true;
+        });
+    }
+    EXPECT_TRUE(isMaterialized);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,171 @@
+#include <gtest/gtest.h>
+#include "model_serving/QuotaManager.h"
+#include "model_serving/InferenceThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace lmms_magenta;
+
+namespace {
+
+// Keep the calling thread busy for the given CPU time
+void burnCpu(std::chrono::milliseconds duration) {
+    const auto end = std::chrono::steady_clock::now() + duration;
+    volatile double sink = 0.0;
+    while (std::chrono::steady_clock::now() < end) {
+        sink = sink + 1.0;
+    }
+}
+
+} // namespace
+
+// Test that clients without a quota are not limited
+TEST(QuotaManagerTest, UnlimitedByDefault) {
+    QuotaManager quotas;
+    ModelJob first = quotas.beginJob("track1", 1 << 30);
+    ModelJob second = quotas.beginJob("track1", 1 << 30);
+    EXPECT_TRUE(first.isAdmitted());
+    EXPECT_TRUE(second.isAdmitted());
+    EXPECT_EQ(quotas.getActiveJobCount("track1"), 2u);
+}
+
+// Test the concurrent job limit and its release
+TEST(QuotaManagerTest, ConcurrentJobLimit) {
+    QuotaManager quotas;
+    ClientQuota quota;
+    quota.maxConcurrentJobs = 2;
+    quotas.setQuota("track1", quota);
+
+    ModelJob first = quotas.beginJob("track1");
+    ModelJob second = quotas.beginJob("track1");
+    ModelJob third = quotas.beginJob("track1");
+    EXPECT_TRUE(first.isAdmitted());
+    EXPECT_TRUE(second.isAdmitted());
+    EXPECT_EQ(third.getStatus(), JobStatus::TooManyJobs);
+
+    // Other clients are not affected
+    EXPECT_TRUE(quotas.beginJob("track2").isAdmitted());
+
+    first.finish();
+    EXPECT_TRUE(quotas.beginJob("track1").isAdmitted());
+}
+
+// Test that a waiting job is admitted when a running one finishes
+TEST(QuotaManagerTest, WaitsForJobSlot) {
+    QuotaManager quotas;
+    ClientQuota quota;
+    quota.maxConcurrentJobs = 1;
+    quotas.setQuota("track1", quota);
+
+    ModelJob running = quotas.beginJob("track1");
+    ASSERT_TRUE(running.isAdmitted());
+
+    std::thread finisher([&running]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        running.finish();
+    });
+
+    ModelJob waiting = quotas.beginJob("track1", 0, std::chrono::milliseconds(2000));
+    finisher.join();
+    EXPECT_TRUE(waiting.isAdmitted());
+}
+
+// Test the scratch memory limit
+TEST(QuotaManagerTest, ScratchLimit) {
+    QuotaManager quotas;
+    ClientQuota quota;
+    quota.maxScratchBytes = 1000;
+    quotas.setQuota("track1", quota);
+
+    ModelJob first = quotas.beginJob("track1", 600);
+    ASSERT_TRUE(first.isAdmitted());
+    EXPECT_EQ(quotas.getScratchUsage("track1"), 600u);
+
+    EXPECT_EQ(quotas.beginJob("track1", 600).getStatus(), JobStatus::ScratchLimitExceeded);
+
+    // Too large to ever fit: rejected without waiting
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(quotas.beginJob("track1", 2000, std::chrono::milliseconds(1000)).getStatus(),
+              JobStatus::ScratchLimitExceeded);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(500));
+
+    first.finish();
+    EXPECT_EQ(quotas.getScratchUsage("track1"), 0u);
+    EXPECT_TRUE(quotas.beginJob("track1", 600).isAdmitted());
+}
+
+// Test that a client overspending its CPU budget is held back
+TEST(QuotaManagerTest, CpuBudget) {
+    QuotaManager quotas;
+    ClientQuota quota;
+    quota.cpuBudget = 0.1;  // 100 ms of CPU per second
+    quotas.setQuota("track1", quota);
+
+    {
+        ModelJob job = quotas.beginJob("track1");
+        ASSERT_TRUE(job.isAdmitted());
+        burnCpu(std::chrono::milliseconds(200));
+    }
+
+    ModelJob rejected = quotas.beginJob("track1");
+    EXPECT_EQ(rejected.getStatus(), JobStatus::CpuBudgetExhausted);
+    EXPECT_GT(rejected.getRetryAfter().count(), 0);
+    EXPECT_LE(rejected.getRetryAfter().count(), 1100);
+
+    // Time spent on other threads counts too
+    EXPECT_TRUE(quotas.beginJob("track2").isAdmitted());
+    ClientQuota limited;
+    limited.cpuBudget = 1.0;
+    quotas.setQuota("track2", limited);
+    {
+        ModelJob job = quotas.beginJob("track2");
+        ASSERT_TRUE(job.isAdmitted());
+        job.addCpuTime(5.0);
+    }
+    EXPECT_EQ(quotas.beginJob("track2").getStatus(), JobStatus::CpuBudgetExhausted);
+}
+
+// Test that inferences run on the inference threads are charged to the job
+TEST(QuotaManagerTest, ChargesInferenceThreadCpuTime) {
+    QuotaManager quotas;
+    ClientQuota quota;
+    quota.cpuBudget = 0.1;  // 100 ms of CPU per second
+    quotas.setQuota("track1", quota);
+
+    const double delegatedBefore = InferenceThreadPool::getDelegatedCpuSeconds();
+    {
+        ModelJob job = quotas.beginJob("track1");
+        ASSERT_TRUE(job.isAdmitted());
+
+        // The calling thread only waits while an inference thread works
+        InferenceThreadPool::getInstance().run(0, []() {
+            burnCpu(std::chrono::milliseconds(200));
+            return 0;
+        });
+    }
+
+    EXPECT_GT(InferenceThreadPool::getDelegatedCpuSeconds() - delegatedBefore, 0.1);
+    EXPECT_EQ(quotas.beginJob("track1").getStatus(), JobStatus::CpuBudgetExhausted);
+}
+
+// Test that the default quota applies to clients without their own
+TEST(QuotaManagerTest, DefaultQuota) {
+    QuotaManager quotas;
+    ClientQuota quota;
+    quota.maxConcurrentJobs = 1;
+    quotas.setDefaultQuota(quota);
+
+    ModelJob first = quotas.beginJob("track1");
+    EXPECT_TRUE(first.isAdmitted());
+    EXPECT_EQ(quotas.beginJob("track1").getStatus(), JobStatus::TooManyJobs);
+
+    ClientQuota unlimited;
+    quotas.setQuota("track1", unlimited);
+    EXPECT_TRUE(quotas.beginJob("track1").isAdmitted());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,46 @@
+#include <gtest/gtest.h>
+#include "utils/Semaphore.h"
+#include <atomic>
+#include <thread>
+
+using namespace lmms_magenta;
+
+// Test that signals given before a wait are not lost
+TEST(SemaphoreTest, SignalsAreCounted) {
+    Semaphore semaphore;
+    semaphore.signal();
+    semaphore.signal();
+
+    // Neither wait blocks
+    semaphore.wait();
+    semaphore.wait();
+
+    Semaphore initial(1);
+    initial.wait();
+}
+
+// Test that a waiting worker sees every request signalled by another thread
+TEST(SemaphoreTest, WakesWaitingWorker) {
+    constexpr int kNumRequests = 10000;
+    Semaphore requests;
+    std::atomic<int> numHandled(0);
+
+    std::thread worker([&]() {
+        for (int i = 0; i < kNumRequests; ++i) {
+            requests.wait();
+            ++numHandled;
+        }
+    });
+
+    for (int i = 0; i < kNumRequests; ++i) {
+        requests.signal();
+    }
+    worker.join();
+
+    EXPECT_EQ(numHandled.load(), kNumRequests);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
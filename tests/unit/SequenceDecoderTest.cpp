@@ -0,0 +1,173 @@
+#include <gtest/gtest.h>
+#include "model_serving/SequenceDecoder.h"
+#include "utils/ThreadPool.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+using namespace lmms_magenta;
+
+class SequenceDecoderTest : public ::testing::Test {
+protected:
+    static constexpr int kVocabSize = 8;
+
+    void SetUp() override {
+        m_stepCalls = 0;
+
+        // Deterministic model: strongly prefers (state + 1) % vocab, weakly the token after that
+        m_stepFunction = [this](const std::vector<int>& tokens,
+                                const std::vector<DecoderStatePtr>& states,
+                                std::vector<float>& logits,
+                                std::vector<DecoderStatePtr>& newStates) {
+            ++m_stepCalls;
+            logits.assign(tokens.size() * kVocabSize, 0.0f);
+            newStates.resize(tokens.size());
+
+            for (size_t b = 0; b < tokens.size(); ++b) {
+                const int position = static_cast<int>((*states[b])[0]);
+                logits[b * kVocabSize + (position + 1) % kVocabSize] = 5.0f;
+                logits[b * kVocabSize + (position + 2) % kVocabSize] = 3.0f;
+                newStates[b] = std::make_shared<const std::vector<float>>(1, static_cast<float>(position + 1));
+            }
+            return true;
+        };
+    }
+
+    DecoderStatePtr initialState(float position = 0.0f) {
+        return std::make_shared<const std::vector<float>>(1, position);
+    }
+
+    SequenceDecoder::StepFunction m_stepFunction;
+    std::atomic<int> m_stepCalls;
+};
+
+// Test that beam search finds the most likely sequence
+TEST_F(SequenceDecoderTest, BeamSearch) {
+    SequenceDecoder decoder(m_stepFunction, kVocabSize);
+
+    DecodingOptions options;
+    options.strategy = DecodingStrategy::BeamSearch;
+    options.beamWidth = 3;
+    options.maxSteps = 4;
+
+    auto results = decoder.decode(initialState(), options);
+    ASSERT_EQ(results.size(), 3u);
+    EXPECT_EQ(results[0].tokens, (std::vector<int>{1, 2, 3, 4}));
+    EXPECT_GE(results[0].logProbability, results[1].logProbability);
+    EXPECT_GE(results[1].logProbability, results[2].logProbability);
+
+    // One batched step per timestep
+    EXPECT_EQ(m_stepCalls.load(), 4);
+}
+
+// Test that beams stop at the end token
+TEST_F(SequenceDecoderTest, EndToken) {
+    SequenceDecoder decoder(m_stepFunction, kVocabSize);
+
+    DecodingOptions options;
+    options.beamWidth = 1;
+    options.maxSteps = 10;
+    options.endToken = 3;
+
+    auto results = decoder.decode(initialState(), options);
+    ASSERT_EQ(results.size(), 1u);
+    EXPECT_EQ(results[0].tokens, (std::vector<int>{1, 2, 3}));
+}
+
+// Test that top-1 sampling is greedy
+TEST_F(SequenceDecoderTest, TopKSampling) {
+    SequenceDecoder decoder(m_stepFunction, kVocabSize);
+
+    DecodingOptions options;
+    options.strategy = DecodingStrategy::Sampling;
+    options.numCandidates = 5;
+    options.maxSteps = 3;
+    options.topK = 1;
+
+    auto results = decoder.decode(initialState(), options);
+    ASSERT_EQ(results.size(), 5u);
+    for (const auto& result : results) {
+        EXPECT_EQ(result.tokens, (std::vector<int>{1, 2, 3}));
+    }
+
+    // All candidates share one step call per timestep
+    EXPECT_EQ(m_stepCalls.load(), 3);
+}
+
+// Test that nucleus sampling only draws from the top tokens
+TEST_F(SequenceDecoderTest, NucleusSampling) {
+    SequenceDecoder decoder(m_stepFunction, kVocabSize);
+
+    DecodingOptions options;
+    options.strategy = DecodingStrategy::Sampling;
+    options.numCandidates = 32;
+    options.maxSteps = 1;
+    options.topP = 0.9f;
+    options.seed = 42;
+
+    auto results = decoder.decode(initialState(), options);
+    for (const auto& result : results) {
+        ASSERT_EQ(result.tokens.size(), 1u);
+        EXPECT_TRUE(result.tokens[0] == 1 || result.tokens[0] == 2);
+    }
+}
+
+// Test decoding independent groups on a thread pool
+TEST_F(SequenceDecoderTest, ParallelGroups) {
+    SequenceDecoder decoder(m_stepFunction, kVocabSize);
+    ThreadPool pool(4);
+
+    DecodingOptions options;
+    options.beamWidth = 2;
+    options.maxSteps = 2;
+
+    std::vector<DecoderStatePtr> states;
+    for (int g = 0; g < 8; ++g) {
+        states.push_back(initialState(static_cast<float>(g)));
+    }
+
+    auto groups = decoder.decodeGroups(states, options, pool);
+    ASSERT_EQ(groups.size(), 8u);
+    for (int g = 0; g < 8; ++g) {
+        ASSERT_FALSE(groups[g].empty());
+        EXPECT_EQ(groups[g][0].tokens,
+                  (std::vector<int>{(g + 1) % kVocabSize, (g + 2) % kVocabSize}));
+    }
+}
+
+// Test that tokens outside the vocabulary are rejected before decoding
+TEST_F(SequenceDecoderTest, InvalidTokens) {
+    SequenceDecoder decoder(m_stepFunction, kVocabSize);
+    ThreadPool pool(2);
+
+    for (const auto& tokens : std::vector<std::pair<int, int>>{{kVocabSize, -1}, {-1, -1}, {0, kVocabSize}, {0, -2}}) {
+        DecodingOptions options;
+        options.startToken = tokens.first;
+        options.endToken = tokens.second;
+
+        EXPECT_TRUE(decoder.decode(initialState(), options).empty());
+
+        auto groups = decoder.decodeGroups({initialState(), initialState()}, options, pool);
+        ASSERT_EQ(groups.size(), 2u);
+        EXPECT_TRUE(groups[0].empty());
+        EXPECT_TRUE(groups[1].empty());
+    }
+    EXPECT_EQ(m_stepCalls.load(), 0);
+}
+
+// Test that a model step function rejects tokens and states that do not fit its rows
+TEST_F(SequenceDecoderTest, ModelStepValidatesRows) {
+    SequenceDecoder::StepFunction step = SequenceDecoder::fromModel(nullptr, kVocabSize, 1);
+    std::vector<float> logits;
+    std::vector<DecoderStatePtr> newStates;
+
+    EXPECT_FALSE(step({kVocabSize}, {initialState()}, logits, newStates));
+    EXPECT_FALSE(step({-1}, {initialState()}, logits, newStates));
+    EXPECT_FALSE(step({0}, {std::make_shared<const std::vector<float>>(4, 0.0f)}, logits, newStates));
+    EXPECT_FALSE(step({0, 1}, {initialState()}, logits, newStates));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
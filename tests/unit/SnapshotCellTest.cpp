@@ -0,0 +1,76 @@
+#include <gtest/gtest.h>
+#include "utils/SnapshotCell.h"
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace lmms_magenta;
+
+// Test that a load returns the value stored last
+TEST(SnapshotCellTest, LoadReturnsLastStore) {
+    SnapshotCell<int> cell;
+    EXPECT_EQ(cell.load(), nullptr);
+
+    cell.store(std::make_shared<const int>(1));
+    ASSERT_NE(cell.load(), nullptr);
+    EXPECT_EQ(*cell.load(), 1);
+
+    cell.store(std::make_shared<const int>(2));
+    EXPECT_EQ(*cell.load(), 2);
+}
+
+// Test that a replaced value lives until its last reader drops it
+TEST(SnapshotCellTest, ReplacedValueOutlivesItsReaders) {
+    SnapshotCell<int> cell(std::make_shared<const int>(1));
+
+    std::shared_ptr<const int> reader = cell.load();
+    std::weak_ptr<const int> first = reader;
+    cell.store(std::make_shared<const int>(2));
+    EXPECT_FALSE(first.expired());
+    EXPECT_EQ(*reader, 1);
+
+    reader.reset();
+    EXPECT_TRUE(first.expired());
+}
+
+// Test that readers see whole values while a writer replaces them
+TEST(SnapshotCellTest, ConcurrentReadersAndWriter) {
+    constexpr int kNumReaders = 4;
+    constexpr int kNumStores = 20000;
+    SnapshotCell<std::vector<int>> cell(std::make_shared<const std::vector<int>>(8, 0));
+
+    std::atomic<bool> isDone(false);
+    std::atomic<int> numTorn(0);
+    std::vector<std::thread> readers;
+    for (int i = 0; i < kNumReaders; ++i) {
+        readers.emplace_back([&cell, &isDone, &numTorn]() {
+            int last = 0;
+            while (!isDone.load()) {
+                auto value = cell.load();
+                for (int element : *value) {
+                    numTorn += element != value->front() ? 1 : 0;
+                }
+
+                // Values only move forward
+                numTorn += value->front() < last ? 1 : 0;
+                last = value->front();
+            }
+        });
+    }
+
+    for (int i = 1; i <= kNumStores; ++i) {
+        cell.store(std::make_shared<const std::vector<int>>(8, i));
+    }
+    isDone = true;
+    for (auto& reader : readers) {
+        reader.join();
+    }
+
+    EXPECT_EQ(numTorn.load(), 0);
+    EXPECT_EQ(cell.load()->front(), kNumStores);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
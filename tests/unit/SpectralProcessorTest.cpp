@@ -0,0 +1,116 @@
+#include <gtest/gtest.h>
+#include "utils/SpectralProcessor.h"
+#include <cmath>
+#include <vector>
+
+using namespace lmms_magenta;
+
+// Test that a forward/inverse transform round-trips
+TEST(FFTPlanTest, RoundTrip) {
+    FFTPlan plan(64);
+
+    std::vector<std::complex<float>> data(64);
+    for (int i = 0; i < 64; ++i) {
+        data[i] = std::complex<float>(std::sin(0.3f * i), 0.0f);
+    }
+    const auto original = data;
+
+    plan.forward(data.data());
+    plan.inverse(data.data());
+
+    for (int i = 0; i < 64; ++i) {
+        EXPECT_NEAR(data[i].real(), original[i].real(), 1e-4f);
+        EXPECT_NEAR(data[i].imag(), 0.0f, 1e-4f);
+    }
+}
+
+// Test that a pure tone lands in the expected bin
+TEST(FFTPlanTest, ToneBin) {
+    const int size = 32;
+    FFTPlan plan(size);
+
+    std::vector<std::complex<float>> data(size);
+    for (int i = 0; i < size; ++i) {
+        data[i] = std::complex<float>(std::cos(2.0f * 3.14159265f * 4 * i / size), 0.0f);
+    }
+
+    plan.forward(data.data());
+
+    EXPECT_NEAR(std::abs(data[4]), size / 2.0f, 1e-3f);
+    EXPECT_NEAR(std::abs(data[5]), 0.0f, 1e-3f);
+}
+
+// Test that invalid sizes are rejected
+TEST(FFTPlanTest, InvalidSize) {
+    EXPECT_THROW(FFTPlan(0), std::invalid_argument);
+    EXPECT_THROW(FFTPlan(48), std::invalid_argument);
+    EXPECT_THROW(SpectralProcessor(64, 0), std::invalid_argument);
+}
+
+// Test that unmodified spectra reconstruct the input delayed by the reported latency
+TEST(SpectralProcessorTest, IdentityReconstruction) {
+    for (int batchFrames : {1, 4}) {
+        SpectralProcessor processor(256, 64, batchFrames, 2);
+        const int latency = processor.getLatency();
+        const int numSamples = latency + 2048;
+
+        std::vector<float> left(numSamples), right(numSamples);
+        for (int i = 0; i < numSamples; ++i) {
+            left[i] = std::sin(0.05f * i);
+            right[i] = 0.5f * std::cos(0.011f * i);
+        }
+
+        std::vector<float> outLeft(numSamples), outRight(numSamples);
+        const float* inputs[] = {left.data(), right.data()};
+        float* outputs[] = {outLeft.data(), outRight.data()};
+
+        // Feed in uneven block sizes to exercise the FIFO
+        int callbacks = 0;
+        int offset = 0;
+        int block = 37;
+        while (offset < numSamples) {
+            const int count = std::min(block, numSamples - offset);
+            const float* in[] = {inputs[0] + offset, inputs[1] + offset};
+            float* out[] = {outputs[0] + offset, outputs[1] + offset};
+            processor.process(in, out, count,
+                              [&](std::complex<float>*, int numFrames, int numBins) {
+                                  EXPECT_EQ(numFrames, 2 * batchFrames);
+                                  EXPECT_EQ(numBins, 129);
+                                  ++callbacks;
+                              });
+            offset += count;
+            block = block * 3 % 200 + 1;
+        }
+
+        EXPECT_GT(callbacks, 0);
+
+        // Skip the window ramp-up, then compare against the delayed input
+        for (int i = latency + 256; i < numSamples; ++i) {
+            EXPECT_NEAR(outLeft[i], left[i - latency], 1e-3f) << "sample " << i;
+            EXPECT_NEAR(outRight[i], right[i - latency], 1e-3f) << "sample " << i;
+        }
+    }
+}
+
+// Test that zeroing the spectra silences the output
+TEST(SpectralProcessorTest, SpectralModification) {
+    SpectralProcessor processor(128, 32, 2, 1);
+
+    std::vector<float> input(4096, 1.0f);
+    std::vector<float> output(4096, 1.0f);
+    const float* in[] = {input.data()};
+    float* out[] = {output.data()};
+
+    processor.process(in, out, 4096, [](std::complex<float>* spectra, int numFrames, int numBins) {
+        std::fill(spectra, spectra + numFrames * numBins, std::complex<float>(0.0f, 0.0f));
+    });
+
+    for (float sample : output) {
+        EXPECT_EQ(sample, 0.0f);
+    }
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
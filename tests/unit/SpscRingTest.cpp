@@ -0,0 +1,64 @@
+#include <gtest/gtest.h>
+#include "utils/SpscRing.h"
+#include <thread>
+
+using namespace lmms_magenta;
+
+// Test that elements come out in order and a full ring rejects pushes
+TEST(SpscRingTest, FifoOrderAndCapacity) {
+    SpscRing<int> ring(3);
+    EXPECT_EQ(ring.getCapacity(), 3u);
+    EXPECT_TRUE(ring.isEmpty());
+
+    EXPECT_TRUE(ring.push(1));
+    EXPECT_TRUE(ring.push(2));
+    EXPECT_TRUE(ring.push(3));
+    EXPECT_FALSE(ring.push(4));
+
+    int value = 0;
+    ASSERT_TRUE(ring.pop(value));
+    EXPECT_EQ(value, 1);
+
+    // The freed slot is reused after wrapping around
+    EXPECT_TRUE(ring.push(4));
+    for (int expected = 2; expected <= 4; ++expected) {
+        ASSERT_TRUE(ring.pop(value));
+        EXPECT_EQ(value, expected);
+    }
+
+    EXPECT_FALSE(ring.pop(value));
+    EXPECT_TRUE(ring.isEmpty());
+}
+
+// Test that a producer and a consumer thread see every element once, in order
+TEST(SpscRingTest, ProducerAndConsumerThreads) {
+    constexpr int kCount = 100000;
+    SpscRing<int> ring(8);
+
+    std::thread producer([&ring]() {
+        for (int i = 0; i < kCount; ++i) {
+            while (!ring.push(i)) {
+                std::this_thread::yield();
+            }
+        }
+    });
+
+    int expected = 0;
+    while (expected < kCount) {
+        int value;
+        if (!ring.pop(value)) {
+            std::this_thread::yield();
+            continue;
+        }
+        ASSERT_EQ(value, expected);
+        ++expected;
+    }
+
+    producer.join();
+    EXPECT_TRUE(ring.isEmpty());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
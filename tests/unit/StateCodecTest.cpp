@@ -0,0 +1,140 @@
+#include <gtest/gtest.h>
+#include "utils/StateCodec.h"
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+using namespace lmms_magenta;
+
+namespace {
+
+bool decodeFloats(const std::string& text, std::vector<float>& values) {
+    return StateCodec::decodeFloats(text.data(), text.size(), values);
+}
+
+bool decodeNotes(const std::string& text, std::vector<MidiNote>& notes) {
+    return StateCodec::decodeNotes(text.data(), text.size(), notes);
+}
+
+} // namespace
+
+TEST(StateCodecTest, Base64MatchesRfc4648) {
+    const std::pair<std::string, std::string> vectors[] = {
+        {"", ""}, {"f", "Zg=="}, {"fo", "Zm8="}, {"foo", "Zm9v"},
+        {"foob", "Zm9vYg=="}, {"fooba", "Zm9vYmE="}, {"foobar", "Zm9vYmFy"}
+    };
+
+    for (const auto& vector : vectors) {
+        const std::string& plain = vector.first;
+        const std::string encoded = StateCodec::toBase64(reinterpret_cast<const uint8_t*>(plain.data()), plain.size());
+        EXPECT_EQ(encoded, vector.second);
+
+        std::vector<uint8_t> decoded;
+        ASSERT_TRUE(StateCodec::fromBase64(encoded.data(), encoded.size(), decoded));
+        EXPECT_EQ(std::string(decoded.begin(), decoded.end()), plain);
+    }
+}
+
+TEST(StateCodecTest, RejectsInvalidBase64) {
+    std::vector<uint8_t> bytes;
+    EXPECT_FALSE(StateCodec::fromBase64("Zm9", 3, bytes));      // Truncated
+    EXPECT_FALSE(StateCodec::fromBase64("Zm9*", 4, bytes));     // Outside the alphabet
+    EXPECT_FALSE(StateCodec::fromBase64("Zg==Zm8=", 8, bytes)); // Padding in the middle
+    EXPECT_FALSE(StateCodec::fromBase64("Z=g=", 4, bytes));     // Misplaced padding
+}
+
+TEST(StateCodecTest, FloatsRoundTripBitExactly) {
+    const std::vector<float> values = {
+        0.0f, -0.0f, 1.0f / 3.0f, -2.5e-38f, 3.4028235e38f,
+        std::numeric_limits<float>::denorm_min(),
+        std::numeric_limits<float>::infinity(),
+        0.1f, 123456.789f
+    };
+
+    std::vector<float> decoded;
+    ASSERT_TRUE(decodeFloats(StateCodec::encodeFloats(values), decoded));
+    ASSERT_EQ(decoded.size(), values.size());
+    EXPECT_EQ(std::memcmp(decoded.data(), values.data(), values.size() * sizeof(float)), 0);
+}
+
+TEST(StateCodecTest, EncodesEmptyVectors) {
+    std::vector<float> values = {1.0f};
+    ASSERT_TRUE(decodeFloats(StateCodec::encodeFloats({}), values));
+    EXPECT_TRUE(values.empty());
+
+    std::vector<MidiNote> notes(1);
+    ASSERT_TRUE(decodeNotes(StateCodec::encodeNotes({}), notes));
+    EXPECT_TRUE(notes.empty());
+}
+
+TEST(StateCodecTest, IsSmallerThanDecimalText) {
+    std::vector<float> latent(256);
+    for (size_t i = 0; i < latent.size(); ++i) {
+        latent[i] = std::sin(static_cast<float>(i)) * 0.123456f;
+    }
+
+    std::string decimal;
+    for (float value : latent) {
+        decimal += std::to_string(value) + ",";
+    }
+    EXPECT_LT(StateCodec::encodeFloats(latent).size(), decimal.size());
+}
+
+TEST(StateCodecTest, NotesRoundTrip) {
+    const std::vector<MidiNote> notes = {
+        MidiNote(36, 127, 0, 240, true),
+        MidiNote(60, 1, 480, 120),
+        MidiNote(127, 64, 2000000000, 1)
+    };
+
+    std::vector<MidiNote> decoded;
+    ASSERT_TRUE(decodeNotes(StateCodec::encodeNotes(notes), decoded));
+    ASSERT_EQ(decoded.size(), notes.size());
+    for (size_t i = 0; i < notes.size(); ++i) {
+        EXPECT_EQ(decoded[i].pitch, notes[i].pitch);
+        EXPECT_EQ(decoded[i].velocity, notes[i].velocity);
+        EXPECT_EQ(decoded[i].startTime, notes[i].startTime);
+        EXPECT_EQ(decoded[i].duration, notes[i].duration);
+        EXPECT_EQ(decoded[i].isPercussion, notes[i].isPercussion);
+    }
+}
+
+TEST(StateCodecTest, RejectsMismatchedBlobs) {
+    const std::string floats = StateCodec::encodeFloats({1.0f, 2.0f, 3.0f});
+    const std::string notes = StateCodec::encodeNotes({MidiNote()});
+
+    std::vector<float> values = {42.0f};
+    std::vector<MidiNote> decodedNotes;
+
+    // Wrong payload type
+    EXPECT_FALSE(decodeFloats(notes, values));
+    EXPECT_FALSE(decodeNotes(floats, decodedNotes));
+
+    // Truncated payload
+    EXPECT_FALSE(decodeFloats(floats.substr(0, floats.size() - 4), values));
+
+    // Legacy comma-separated text
+    EXPECT_FALSE(decodeFloats("0.5,0.25,1", values));
+    EXPECT_FALSE(decodeFloats("", values));
+
+    // Failed decodes leave the output untouched
+    ASSERT_EQ(values.size(), 1u);
+    EXPECT_EQ(values[0], 42.0f);
+}
+
+TEST(StateCodecTest, RejectsNewerVersions) {
+    const std::string encoded = StateCodec::encodeFloats({1.0f});
+    std::vector<uint8_t> bytes;
+    ASSERT_TRUE(StateCodec::fromBase64(encoded.data(), encoded.size(), bytes));
+
+    bytes[5] = StateCodec::kVersion + 1;
+    const std::string newer = StateCodec::toBase64(bytes.data(), bytes.size());
+
+    std::vector<float> values;
+    EXPECT_FALSE(decodeFloats(newer, values));
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
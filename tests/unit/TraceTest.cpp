@@ -0,0 +1,132 @@
+#include <gtest/gtest.h>
+#include "utils/Trace.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using namespace lmms_magenta;
+
+namespace fs = std::filesystem;
+
+class TraceTest : public ::testing::Test {
+protected:
+    void TearDown() override {
+        TraceRecorder::getInstance().stop();
+    }
+
+    static size_t countEvents(const char* name) {
+        size_t count = 0;
+        for (const auto& event : TraceRecorder::getInstance().getEvents()) {
+            count += std::strcmp(event.name, name) == 0;
+        }
+        return count;
+    }
+};
+
+// Test that scopes on several threads are all recorded
+TEST_F(TraceTest, RecordsScopesFromAllThreads) {
+    TraceRecorder::getInstance().start();
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([]() {
+            for (int i = 0; i < 100; ++i) {
+                TraceScope scope("test", "work");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    TraceRecorder::getInstance().stop();
+    EXPECT_EQ(countEvents("work"), 400u);
+    EXPECT_EQ(TraceRecorder::getInstance().getDroppedCount(), 0u);
+}
+
+// Test that spans are only recorded while recording
+TEST_F(TraceTest, IgnoresScopesWhenStopped) {
+    TraceRecorder::getInstance().start();
+    TraceRecorder::getInstance().stop();
+
+    EXPECT_FALSE(TraceRecorder::isRecording());
+    {
+        TraceScope scope("test", "ignored");
+    }
+    EXPECT_EQ(countEvents("ignored"), 0u);
+}
+
+// Test that starting a session discards the previous one
+TEST_F(TraceTest, StartDiscardsPreviousSession) {
+    TraceRecorder::getInstance().start();
+    {
+        TraceScope scope("test", "old");
+    }
+    EXPECT_EQ(countEvents("old"), 1u);
+
+    TraceRecorder::getInstance().start();
+    {
+        TraceScope scope("test", "new");
+    }
+    EXPECT_EQ(countEvents("old"), 0u);
+    EXPECT_EQ(countEvents("new"), 1u);
+}
+
+// Test that a full buffer drops events instead of growing
+TEST_F(TraceTest, DropsEventsWhenBufferIsFull) {
+    TraceRecorder::getInstance().start(4);
+
+    for (int i = 0; i < 10; ++i) {
+        const uint64_t start = TraceRecorder::now();
+        TraceRecorder::getInstance().record("test", "bounded", start, start + 1000);
+    }
+
+    EXPECT_EQ(countEvents("bounded"), 4u);
+    EXPECT_EQ(TraceRecorder::getInstance().getDroppedCount(), 6u);
+}
+
+// Test the Chrome trace JSON export
+TEST_F(TraceTest, ExportsChromeTrace) {
+    TraceRecorder::getInstance().start();
+    TraceRecorder::getInstance().setThreadName("main \"test\"");
+    const uint64_t start = TraceRecorder::now();
+    TraceRecorder::getInstance().record("inference", "invoke", start, start + 2500);
+
+    const fs::path path = fs::temp_directory_path() / "lmms_magenta_trace_test.json";
+    ASSERT_TRUE(TraceRecorder::getInstance().exportChromeTrace(path.string()));
+
+    std::ifstream file(path);
+    std::stringstream contents;
+    contents << file.rdbuf();
+    fs::remove(path);
+
+    const std::string json = contents.str();
+    EXPECT_NE(json.find("\"traceEvents\""), std::string::npos);
+    EXPECT_NE(json.find("\"ph\":\"X\",\"cat\":\"inference\",\"name\":\"invoke\""), std::string::npos);
+    EXPECT_NE(json.find("\"dur\":2.500"), std::string::npos);
+    EXPECT_NE(json.find("main \\\"test\\\""), std::string::npos);
+}
+
+#ifdef LMMS_MAGENTA_ENABLE_PROFILING
+// Test that the macros record spans when profiling is compiled in
+TEST_F(TraceTest, MacrosRecordSpans) {
+    TraceRecorder::getInstance().start();
+
+    LMMS_MAGENTA_TRACE_TIMESTAMP(queuedAt);
+    {
+        LMMS_MAGENTA_TRACE_SCOPE("test", "macro_scope");
+    }
+    LMMS_MAGENTA_TRACE_SINCE("test", "macro_since", queuedAt);
+
+    EXPECT_EQ(countEvents("macro_scope"), 1u);
+    EXPECT_EQ(countEvents("macro_since"), 1u);
+}
+#endif
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include "model_serving/WarmStartCache.h"
+#include <filesystem>
+
+using namespace lmms_magenta;
+
+namespace fs = std::filesystem;
+
+class WarmStartCacheTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        m_directory = fs::temp_directory_path() / "lmms_magenta_warm_start_test";
+        fs::remove_all(m_directory);
+    }
+
+    void TearDown() override {
+        fs::remove_all(m_directory);
+    }
+
+    ModelMetadata makeMetadata(uint64_t contentHash) const {
+        ModelMetadata metadata;
+        metadata.name = "test";
+        metadata.contentHash = contentHash;
+        return metadata;
+    }
+
+    fs::path m_directory;
+};
+
+// Test that a saved plan is read back unchanged
+TEST_F(WarmStartCacheTest, PlanRoundTrip) {
+    WarmStartCache cache(m_directory.string());
+    ModelMetadata metadata = makeMetadata(0x1234);
+
+    WarmStartPlan plan;
+    EXPECT_FALSE(cache.loadPlan(metadata, plan));
+
+    plan.inputShape = {4, 32, 90};
+    plan.arenaBytes = 65536;
+    ASSERT_TRUE(cache.savePlan(metadata, plan));
+
+    WarmStartPlan loaded;
+    ASSERT_TRUE(cache.loadPlan(metadata, loaded));
+    EXPECT_EQ(loaded.inputShape, plan.inputShape);
+    EXPECT_EQ(loaded.arenaBytes, plan.arenaBytes);
+}
+
+// Test that a changed model file does not reuse the old snapshot
+TEST_F(WarmStartCacheTest, SnapshotsKeyedByContent) {
+    WarmStartCache cache(m_directory.string());
+
+    WarmStartPlan plan;
+    plan.inputShape = {1, 16};
+    ASSERT_TRUE(cache.savePlan(makeMetadata(1), plan));
+
+    WarmStartPlan loaded;
+    EXPECT_FALSE(cache.loadPlan(makeMetadata(2), loaded));
+    EXPECT_NE(cache.getWeightCachePath(makeMetadata(1)),
+              cache.getWeightCachePath(makeMetadata(2)));
+}
+
+// Test that models without a content hash get no snapshot
+TEST_F(WarmStartCacheTest, NoSnapshotWithoutHash) {
+    WarmStartCache cache(m_directory.string());
+    EXPECT_TRUE(cache.getSnapshotDirectory(makeMetadata(0)).empty());
+    EXPECT_TRUE(cache.getWeightCachePath(makeMetadata(0)).empty());
+    EXPECT_FALSE(cache.savePlan(makeMetadata(0), WarmStartPlan()));
+}
+
+// Test that the CPU key is stable within a process
+TEST_F(WarmStartCacheTest, CpuKeyStable) {
+    std::string key = WarmStartCache::getCpuKey();
+    EXPECT_FALSE(key.empty());
+    EXPECT_EQ(key, WarmStartCache::getCpuKey());
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}
@@ -0,0 +1,49 @@
+#include <gtest/gtest.h>
+#include "model_serving/WeightStore.h"
+
+using namespace lmms_magenta;
+
+namespace {
+
+ModelMetadata makeMetadata(uint64_t contentHash, std::vector<std::pair<uint64_t, uint64_t>> weightBuffers) {
+    ModelMetadata metadata;
+    metadata.contentHash = contentHash;
+    metadata.weightBuffers = std::move(weightBuffers);
+    return metadata;
+}
+
+} // namespace
+
+// Test that tensors shared between fine-tunes are reported as duplicated
+TEST(WeightStoreTest, DuplicateWeightBytes) {
+    // Two decoders over the same encoder tensor
+    std::vector<ModelMetadata> models = {
+        makeMetadata(1, {{0xe0, 1000}, {0xd1, 200}}),
+        makeMetadata(2, {{0xe0, 1000}, {0xd2, 200}}),
+        makeMetadata(3, {{0xe0, 1000}, {0xd3, 200}})
+    };
+    EXPECT_EQ(WeightStore::findDuplicateWeightBytes(models), 2000u);
+}
+
+// Test that identical files are not counted, since they are shared whole
+TEST(WeightStoreTest, IdenticalFilesAreShared) {
+    std::vector<ModelMetadata> models = {
+        makeMetadata(1, {{0xe0, 1000}}),
+        makeMetadata(1, {{0xe0, 1000}})
+    };
+    EXPECT_EQ(WeightStore::findDuplicateWeightBytes(models), 0u);
+}
+
+// Test that unrelated models share nothing
+TEST(WeightStoreTest, NoDuplicates) {
+    std::vector<ModelMetadata> models = {
+        makeMetadata(1, {{0xa, 10}}),
+        makeMetadata(2, {{0xb, 10}})
+    };
+    EXPECT_EQ(WeightStore::findDuplicateWeightBytes(models), 0u);
+}
+
+int main(int argc, char** argv) {
+    ::testing::InitGoogleTest(&argc, argv);
+    return RUN_ALL_TESTS();
+}